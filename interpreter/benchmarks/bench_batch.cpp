@@ -0,0 +1,89 @@
+#include <random>
+
+#include <benchmark/benchmark.h>
+
+#include <gravlax/batch.h>
+#include <gravlax/interpreter.h>
+#include <gravlax/parser.h>
+#include <gravlax/scanner.h>
+
+using gravlax::BatchColumn;
+using gravlax::BatchProgram;
+using gravlax::BatchResult;
+using gravlax::Interpreter;
+using gravlax::Value;
+
+namespace
+{
+
+const char *formula = "(price * quantity - discount) * 1.2 > limit";
+const std::vector<std::string> names{"price", "quantity", "discount",
+                                     "limit"};
+
+struct Columns {
+    std::vector<std::vector<double>> values;
+    std::vector<BatchColumn> columns;
+
+    explicit Columns(std::size_t rows)
+    {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<double> dist(0.0, 100.0);
+
+        values.assign(names.size(), std::vector<double>(rows));
+        for (auto &column : values) {
+            for (auto &value : column)
+                value = dist(rng);
+            columns.push_back({column.data()});
+        }
+    }
+};
+
+std::shared_ptr<gravlax::Expr<Value>> parseFormula()
+{
+    gravlax::Scanner scanner;
+    gravlax::Parser<Value> parser;
+    return parser.parse(scanner.scanString(formula));
+}
+
+void BM_PerRowInterpreter(benchmark::State &state)
+{
+    std::size_t rows = state.range(0);
+    Columns data(rows);
+    auto expr = parseFormula();
+    Interpreter interpreter;
+
+    for (auto _ : state) {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < rows; i++) {
+            for (std::size_t c = 0; c < names.size(); c++)
+                interpreter.define(names[c], data.values[c][i]);
+            count += std::get<bool>(interpreter.evaluate(*expr));
+        }
+        benchmark::DoNotOptimize(count);
+    }
+
+    state.SetItemsProcessed(state.iterations() * rows);
+}
+
+void BM_Batch(benchmark::State &state)
+{
+    std::size_t rows = state.range(0);
+    Columns data(rows);
+    auto expr = parseFormula();
+    std::string error;
+    auto program = BatchProgram::compile(*expr, names, error);
+    BatchResult result;
+
+    for (auto _ : state) {
+        program->evaluate(data.columns, rows, result);
+        benchmark::DoNotOptimize(result.values.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * rows);
+}
+
+}; // namespace
+
+// Items per second is rows per second.
+BENCHMARK(BM_PerRowInterpreter)->Arg(1 << 16);
+BENCHMARK(BM_Batch)->Arg(1 << 16)->Arg(1 << 20);
@@ -0,0 +1,109 @@
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include <benchmark/benchmark.h>
+
+#include <gravlax/embed.h>
+
+using gravlax::Context;
+using gravlax::Script;
+
+namespace
+{
+
+std::shared_ptr<const Script> prepare(const std::string &code)
+{
+    gravlax::Diagnostics diagnostics;
+    return Script::prepare(code, diagnostics);
+}
+
+double add(double a, double b)
+{
+    return a + b;
+}
+
+// A host call into a Lox function of two numbers, arguments and result
+// converted.
+void BM_HostCallsScript(benchmark::State &state)
+{
+    auto script = prepare("fun add(a, b) { return a + b; }");
+    std::ostringstream out;
+    Context context(script, out);
+    context.run();
+    auto function = context.function("add");
+
+    double x = 0;
+    for (auto _ : state)
+        x = context.call<double>(function, x, 1.0);
+    benchmark::DoNotOptimize(x);
+}
+
+// A host call straight into a bound native, the cost of the call and the
+// conversions alone.
+void BM_HostCallsNative(benchmark::State &state)
+{
+    auto script = prepare("");
+    std::ostringstream out;
+    Context context(script, out);
+    context.bind<add>("add");
+    auto function = context.function("add");
+
+    double x = 0;
+    for (auto _ : state)
+        x = context.call<double>(function, x, 1.0);
+    benchmark::DoNotOptimize(x);
+}
+
+// Lox calling a bound native in a loop, against the same loop calling a Lox
+// function.
+void runLoop(benchmark::State &state, const char *function)
+{
+    auto script = prepare(std::string(function) +
+                          "fun loop(n) {\n"
+                          "  var x = 0;\n"
+                          "  for (var i = 0; i < n; i = i + 1) x = add(x, i);\n"
+                          "  return x;\n"
+                          "}");
+    std::ostringstream out;
+    Context context(script, out);
+    context.bind<add>("native");
+    context.run();
+    auto loop = context.function("loop");
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(context.call<double>(loop, 1000));
+    state.SetItemsProcessed(state.iterations() * 1000);
+}
+
+void BM_ScriptCallsNative(benchmark::State &state)
+{
+    runLoop(state, "var add = native;\n");
+}
+
+void BM_ScriptCallsScript(benchmark::State &state)
+{
+    runLoop(state, "fun add(a, b) { return a + b; }\n");
+}
+
+void BM_PrepareOnce(benchmark::State &state)
+{
+    auto script = prepare("var greeting = \"hello\";\n"
+                          "fun greet(name) { return greeting + name; }");
+    std::ostringstream out;
+
+    for (auto _ : state) {
+        Context context(script, out);
+        context.run();
+        benchmark::DoNotOptimize(
+            context.call<std::string>(context.function("greet"), "you"));
+    }
+}
+
+}; // namespace
+
+BENCHMARK(BM_HostCallsScript);
+BENCHMARK(BM_HostCallsNative);
+BENCHMARK(BM_ScriptCallsNative);
+BENCHMARK(BM_ScriptCallsScript);
+BENCHMARK(BM_PrepareOnce);
@@ -0,0 +1,103 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <gravlax/runtime/heap.h>
+
+using gravlax::runtime::Heap;
+using gravlax::runtime::Obj;
+using gravlax::runtime::ObjInstance;
+using gravlax::runtime::ObjString;
+using gravlax::runtime::Rooted;
+using gravlax::runtime::Value;
+
+namespace
+{
+
+void reportPauses(benchmark::State &state, const Heap &heap)
+{
+    auto &stats = heap.stats();
+    state.counters["minor"] = stats.minorCollections;
+    state.counters["major"] = stats.majorCollections;
+    state.counters["minor_p50_us"] = stats.minorPauses.percentileMicros(0.5);
+    state.counters["minor_p99_us"] = stats.minorPauses.percentileMicros(0.99);
+    state.counters["minor_max_us"] = stats.minorPauses.maxNanos / 1e3;
+    state.counters["major_max_us"] = stats.majorPauses.maxNanos / 1e3;
+    state.SetBytesProcessed(stats.bytesAllocated);
+}
+
+// s = s + piece in a loop, printing and starting over once s reaches the
+// given length, like a script that builds the lines or pages of a report.
+void BM_StringBuilding(benchmark::State &state)
+{
+    Heap heap;
+    Rooted<ObjString> piece(heap, heap.string("0123456789"));
+    Rooted<Obj> s(heap, heap.string(""));
+    auto limit = static_cast<std::uint32_t>(state.range(0));
+
+    for (auto _ : state) {
+        s = heap.concat(s, piece);
+        if (gravlax::runtime::stringLength(s) >= limit) {
+            benchmark::DoNotOptimize(heap.flatten(s)->hash);
+            s = heap.string("");
+        }
+    }
+
+    reportPauses(state, heap);
+    state.SetItemsProcessed(state.iterations());
+}
+
+// The same with reference counted std::string, for comparison.
+void BM_SharedPtrStringBuilding(benchmark::State &state)
+{
+    auto piece = std::make_shared<std::string>("0123456789");
+    auto s = std::make_shared<std::string>();
+    auto limit = static_cast<std::size_t>(state.range(0));
+
+    for (auto _ : state) {
+        s = std::make_shared<std::string>(*s + *piece);
+        if (s->size() >= limit)
+            s = std::make_shared<std::string>();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Allocates instances and keeps a sliding window of them alive, linked from
+// older ones through the write barrier. Most objects die young, the window
+// is promoted and churns the old generation.
+void BM_InstanceChurn(benchmark::State &state)
+{
+    Heap heap;
+    std::vector<Value> window(state.range(0));
+    heap.addRoots(&window);
+    std::size_t next = 0;
+
+    for (auto _ : state) {
+        auto instance = heap.instance(2);
+        instance->fields()[0] = Value::fromNumber(static_cast<double>(next));
+
+        Value previous = window[next % window.size()];
+        if (previous.isObject()) {
+            heap.setField(static_cast<ObjInstance *>(previous.asObject()), 1,
+                          Value::fromObject(instance));
+        }
+        window[next % window.size()] = Value::fromObject(instance);
+        next += 7;
+    }
+
+    heap.removeRoots(&window);
+    reportPauses(state, heap);
+    state.SetItemsProcessed(state.iterations());
+}
+
+}; // namespace
+
+BENCHMARK(BM_StringBuilding)->Arg(1 << 10)->Arg(64 << 10)->Arg(4 << 20);
+BENCHMARK(BM_SharedPtrStringBuilding)
+    ->Arg(1 << 10)
+    ->Arg(64 << 10)
+    ->Arg(4 << 20);
+BENCHMARK(BM_InstanceChurn)->Arg(1 << 10)->Arg(1 << 16);
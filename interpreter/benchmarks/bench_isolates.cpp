@@ -0,0 +1,60 @@
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <gravlax/isolate.h>
+
+using gravlax::Context;
+using gravlax::Isolate;
+using gravlax::Scheduler;
+using gravlax::Script;
+
+namespace
+{
+
+constexpr int IsolateCount = 256;
+constexpr int TasksPerIsolate = 4;
+
+// Many isolates of one script, each given calls of a recursive function,
+// on a pool of state.range(0) workers. Wall-clock time, as the work is
+// spread over the threads.
+void BM_IsolateScaling(benchmark::State &state)
+{
+    gravlax::Diagnostics diagnostics;
+    auto script = Script::prepare("fun fib(n) {\n"
+                                  "  if (n < 2) return n;\n"
+                                  "  return fib(n - 1) + fib(n - 2);\n"
+                                  "}",
+                                  diagnostics);
+    std::ostringstream out;
+    std::vector<std::unique_ptr<Isolate>> isolates;
+    for (int i = 0; i < IsolateCount; i++) {
+        isolates.push_back(std::make_unique<Isolate>(script, out));
+        isolates.back()->context().run();
+    }
+
+    Scheduler scheduler(state.range(0));
+    for (auto _ : state) {
+        for (int t = 0; t < TasksPerIsolate; t++)
+            for (auto &isolate : isolates)
+                scheduler.post(*isolate, [](Context &context) {
+                    benchmark::DoNotOptimize(
+                        context.call<double>(context.function("fib"), 12));
+                });
+        scheduler.wait();
+    }
+    state.SetItemsProcessed(state.iterations() * IsolateCount *
+                            TasksPerIsolate);
+}
+
+}; // namespace
+
+BENCHMARK(BM_IsolateScaling)
+    ->ArgName("threads")
+    ->RangeMultiplier(2)
+    ->Range(1, 64)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
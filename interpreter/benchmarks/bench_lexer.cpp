@@ -0,0 +1,86 @@
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include <gravlax/lexer.h>
+#include <gravlax/scanner.h>
+#include <gravlax/utf8.h>
+
+namespace
+{
+
+// Functions of statements, comments and string literals, about 1 MiB. The
+// Unicode one has some names and strings outside ASCII.
+std::string source(bool unicode = false)
+{
+    std::string total = unicode ? "größe" : "total";
+    std::string much = unicode ? "zu viel → ✗" : "too much";
+    std::string code;
+    for (int f = 0; code.size() < (1 << 20); f++) {
+        code += "// Adds up the weights below the limit.\n";
+        code += "fun weigh" + std::to_string(f) + "(items, limit) {\n";
+        code += "  var " + total + " = 0.5;\n";
+        code += "  for (var i = 0; i < items; i = i + 1) {\n";
+        code += "    if (" + total + " >= limit and !heavy(i)) return \"" +
+                much + "\";\n";
+        code += "    " + total + " = " + total +
+                " + weight(i) * 1.25 - discount;\n";
+        code += "  }\n";
+        code += "  return " + total + ";\n";
+        code += "}\n";
+    }
+    return code;
+}
+
+// The DFA alone, finding the lexemes without making tokens.
+void BM_LexerDfa(benchmark::State &state)
+{
+    std::string code = source();
+    for (auto _ : state) {
+        int tokens = 0;
+        for (int start = 0; start < static_cast<int>(code.size());) {
+            gravlax::lexer::Lexeme lexeme = gravlax::lexer::scan(code, start);
+            tokens += lexeme.kind == gravlax::lexer::Lexeme::Kind::Token;
+            start = lexeme.end;
+        }
+        benchmark::DoNotOptimize(tokens);
+    }
+    state.SetBytesProcessed(state.iterations() * code.size());
+}
+
+// The Scanner, which also copies lexemes and converts literals.
+void BM_Scanner(benchmark::State &state)
+{
+    std::string code = source();
+    for (auto _ : state) {
+        gravlax::Scanner scanner;
+        benchmark::DoNotOptimize(scanner.scanString(code));
+    }
+    state.SetBytesProcessed(state.iterations() * code.size());
+}
+
+// Names outside ASCII are decoded and looked up in the XID tables.
+void BM_ScannerUnicode(benchmark::State &state)
+{
+    std::string code = source(true);
+    for (auto _ : state) {
+        gravlax::Scanner scanner;
+        benchmark::DoNotOptimize(scanner.scanString(code));
+    }
+    state.SetBytesProcessed(state.iterations() * code.size());
+}
+
+void BM_Utf8Validate(benchmark::State &state)
+{
+    std::string code = source(state.range(0));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(gravlax::utf8::validate(code));
+    state.SetBytesProcessed(state.iterations() * code.size());
+}
+
+}; // namespace
+
+BENCHMARK(BM_LexerDfa);
+BENCHMARK(BM_Scanner);
+BENCHMARK(BM_ScannerUnicode);
+BENCHMARK(BM_Utf8Validate)->ArgName("unicode")->Arg(0)->Arg(1);
@@ -0,0 +1,53 @@
+#include <sstream>
+
+#include <benchmark/benchmark.h>
+
+#include <gravlax/executor.h>
+#include <gravlax/parser.h>
+#include <gravlax/profiler.h>
+#include <gravlax/resolver.h>
+#include <gravlax/scanner.h>
+
+using gravlax::Executor;
+
+namespace
+{
+
+// Calls and loop iterations, the safe points that poll for samples.
+const char *script = "fun fib(n) {\n"
+                     "  if (n < 2) return n;\n"
+                     "  return fib(n - 1) + fib(n - 2);\n"
+                     "}\n"
+                     "var sum = 0;\n"
+                     "for (var i = 0; i < 20000; i = i + 1) sum = sum + i;\n"
+                     "fib(20);\n";
+
+// The script without the profiler, and sampled at 1 kHz.
+void BM_Profiled(benchmark::State &state)
+{
+    std::ostringstream out;
+    Executor executor(out);
+    gravlax::profiler::Profile profile;
+    if (state.range(0)) {
+        executor.setProfile(&profile);
+        gravlax::profiler::start(1000);
+    }
+
+    for (auto _ : state) {
+        gravlax::Diagnostics diagnostics;
+        gravlax::Scanner scanner(diagnostics);
+        gravlax::Parser<Executor::Value> parser(diagnostics);
+        gravlax::Resolver<Executor::Value> resolver(executor.globalNames(),
+                                                   diagnostics);
+        auto program = parser.parseStatements(scanner.scanString(script));
+        auto info = resolver.resolve(program);
+        executor.execute(std::move(program), info);
+    }
+
+    gravlax::profiler::stop();
+    state.counters["samples"] = static_cast<double>(profile.sampleCount());
+}
+
+}; // namespace
+
+BENCHMARK(BM_Profiled)->ArgName("profile")->Arg(0)->Arg(1);
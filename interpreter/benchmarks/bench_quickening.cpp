@@ -0,0 +1,56 @@
+#include <sstream>
+
+#include <benchmark/benchmark.h>
+
+#include <gravlax/executor.h>
+#include <gravlax/parser.h>
+#include <gravlax/resolver.h>
+#include <gravlax/scanner.h>
+
+using gravlax::Executor;
+
+namespace
+{
+
+// Loops of numeric operators, whose sites only ever see numbers.
+const char *script =
+    "var sum = 0;\n"
+    "for (var i = 0; i < 20000; i = i + 1) {\n"
+    "  var x = i / 100;\n"
+    "  sum = sum + (3 * x * x - 2 * x + 1) / (x + 1);\n"
+    "  if (i - 2 * (i / 2) == 0 and x >= 10) sum = sum - x;\n"
+    "}\n"
+    "fun fib(n) {\n"
+    "  if (n < 2) return n;\n"
+    "  return fib(n - 1) + fib(n - 2);\n"
+    "}\n"
+    "fib(18);\n";
+
+// The same program run with and without quickening. It is parsed once, so
+// that from the second run on every site has been rewritten.
+void BM_NumericLoops(benchmark::State &state)
+{
+    std::ostringstream out;
+    Executor executor(out);
+    executor.setQuickening(state.range(0));
+
+    gravlax::Diagnostics diagnostics;
+    gravlax::Scanner scanner(diagnostics);
+    gravlax::Parser<Executor::Value> parser(diagnostics);
+    gravlax::Resolver<Executor::Value> resolver(executor.globalNames(),
+                                               diagnostics);
+    parser.setLazyFunctions(false);
+    auto program = parser.parseStatements(scanner.scanString(script));
+    auto info = resolver.resolve(program);
+
+    for (auto _ : state)
+        executor.run(program, info);
+}
+
+}; // namespace
+
+BENCHMARK(BM_NumericLoops)
+    ->ArgName("quicken")
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond);
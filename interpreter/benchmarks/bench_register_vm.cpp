@@ -0,0 +1,183 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <benchmark/benchmark.h>
+
+#include <gravlax/interpreter.h>
+#include <gravlax/parser.h>
+#include <gravlax/register_vm.h>
+#include <gravlax/scanner.h>
+
+using gravlax::Interpreter;
+using gravlax::RegisterProgram;
+using gravlax::Value;
+
+namespace
+{
+
+// Pricing and scoring formulas, arithmetic with some comparisons and
+// logic, like the formula scripts of a tenant.
+const std::vector<std::string> formulas{
+    "principal * (rate / 12) / (1 - 1 / ((1 + rate / 12) * (1 + rate / 12) "
+    "* (1 + rate / 12) * (1 + rate / 12)))",
+    "(price * quantity - discount) * (1 + tax) - fee * 2.5",
+    "(a * x * x * x + b * x * x + c * x + d) / (x * x + 1)",
+    "(score - mean) / deviation * 15 + 100",
+    "(price * quantity > limit and score >= 600) or vip",
+    "-(x - a) * (x - b) / (b - a) + 0.5 * (a + b) - c * d",
+};
+
+const std::vector<std::pair<std::string, Value>> values{
+    {"principal", 250000.0}, {"rate", 0.045},    {"price", 19.99},
+    {"quantity", 12.0},      {"discount", 5.0},  {"tax", 0.2},
+    {"fee", 1.25},           {"a", 1.5},         {"b", -2.0},
+    {"c", 0.75},             {"d", 4.0},         {"x", 1.1},
+    {"score", 640.0},        {"mean", 580.0},    {"deviation", 45.0},
+    {"limit", 200.0},        {"vip", false},
+};
+
+std::vector<std::shared_ptr<gravlax::Expr<Value>>> parseFormulas()
+{
+    std::vector<std::shared_ptr<gravlax::Expr<Value>>> trees;
+    for (auto &formula : formulas) {
+        gravlax::Scanner scanner;
+        gravlax::Parser<Value> parser;
+        trees.push_back(parser.parse(scanner.scanString(formula)));
+    }
+    return trees;
+}
+
+// Counts the instructions retired by this thread while it is enabled. Not
+// every machine lets a process count them, and then the benchmarks go
+// without the counter.
+class InstructionCounter
+{
+    int fd = -1;
+
+  public:
+    InstructionCounter()
+    {
+        perf_event_attr attr{};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(
+            syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    ~InstructionCounter()
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    void start()
+    {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    // Per evaluation, in the benchmark's counters.
+    void stop(benchmark::State &state, std::int64_t evaluations)
+    {
+        std::uint64_t count = 0;
+        if (fd < 0)
+            return;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, &count, sizeof(count)) == sizeof(count))
+            state.counters["instructions"] = benchmark::Counter(
+                static_cast<double>(count) / evaluations);
+    }
+};
+
+// The nodes an AST walk visits, one virtual dispatch each.
+std::size_t countNodes(gravlax::Expr<Value> &expr)
+{
+    using namespace gravlax::generated;
+    switch (expr.kind()) {
+    case gravlax::ExprKind::Binary: {
+        auto &node = static_cast<Binary<Value> &>(expr);
+        return 1 + countNodes(*node.left) + countNodes(*node.right);
+    }
+    case gravlax::ExprKind::Logical: {
+        auto &node = static_cast<Logical<Value> &>(expr);
+        return 1 + countNodes(*node.left) + countNodes(*node.right);
+    }
+    case gravlax::ExprKind::Grouping:
+        return 1 + countNodes(*static_cast<Grouping<Value> &>(expr).expression);
+    case gravlax::ExprKind::Unary:
+        return 1 + countNodes(*static_cast<Unary<Value> &>(expr).right);
+    default:
+        return 1;
+    }
+}
+
+void BM_AstWalk(benchmark::State &state)
+{
+    auto trees = parseFormulas();
+    Interpreter interpreter;
+    for (auto &[name, value] : values)
+        interpreter.define(name, value);
+
+    InstructionCounter counter;
+    counter.start();
+    for (auto _ : state)
+        for (auto &tree : trees)
+            benchmark::DoNotOptimize(interpreter.evaluate(*tree));
+    counter.stop(state, state.iterations() * trees.size());
+
+    std::size_t nodes = 0;
+    for (auto &tree : trees)
+        nodes += countNodes(*tree);
+    state.counters["dispatches"] =
+        benchmark::Counter(static_cast<double>(nodes) / trees.size());
+    state.SetItemsProcessed(state.iterations() * trees.size());
+}
+
+void BM_RegisterVm(benchmark::State &state)
+{
+    struct Compiled {
+        std::unique_ptr<RegisterProgram> program;
+        std::vector<Value> inputs;
+    };
+    std::vector<Compiled> compiled;
+    std::size_t instructions = 0;
+    for (auto &tree : parseFormulas()) {
+        std::string error;
+        Compiled c{RegisterProgram::compile(*tree, error), {}};
+        for (auto &name : c.program->inputs())
+            for (auto &[n, value] : values)
+                if (n == name)
+                    c.inputs.push_back(value);
+        instructions += c.program->instructions().size();
+        compiled.push_back(std::move(c));
+    }
+
+    std::vector<Value> frame;
+    InstructionCounter counter;
+    counter.start();
+    for (auto _ : state)
+        for (auto &c : compiled)
+            benchmark::DoNotOptimize(c.program->evaluate(c.inputs, frame));
+    counter.stop(state, state.iterations() * compiled.size());
+
+    state.counters["dispatches"] = benchmark::Counter(
+        static_cast<double>(instructions) / compiled.size());
+    state.SetItemsProcessed(state.iterations() * compiled.size());
+}
+
+}; // namespace
+
+BENCHMARK(BM_AstWalk);
+BENCHMARK(BM_RegisterVm);
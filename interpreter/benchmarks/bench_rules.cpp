@@ -0,0 +1,122 @@
+#include <benchmark/benchmark.h>
+
+#include <gravlax/interpreter.h>
+#include <gravlax/parser.h>
+#include <gravlax/rules.h>
+#include <gravlax/scanner.h>
+
+using gravlax::Interpreter;
+using gravlax::RuleCompiler;
+using gravlax::RuleResult;
+using gravlax::Value;
+
+namespace
+{
+
+// Generated rules that reuse a small set of building blocks, like the rule
+// sets of a tenant do.
+std::vector<std::string> makeRules(std::size_t count)
+{
+    std::vector<std::string> rules;
+    for (std::size_t i = 0; i < count; i++) {
+        rules.push_back(fmt::format(
+            "(amount * rate{} - fee) > {} == (score{} >= {})", i % 8, i % 100,
+            i % 16, i % 5));
+    }
+    return rules;
+}
+
+std::vector<std::pair<std::string, Value>> makeInput()
+{
+    std::vector<std::pair<std::string, Value>> input{{"amount", 120.0},
+                                                     {"fee", 3.5}};
+    for (int i = 0; i < 16; i++) {
+        input.push_back({fmt::format("rate{}", i), 0.1 * i});
+        input.push_back({fmt::format("score{}", i), 1.0 * i});
+    }
+    return input;
+}
+
+void BM_CompileSeparately(benchmark::State &state)
+{
+    auto rules = makeRules(state.range(0));
+
+    for (auto _ : state) {
+        std::vector<std::shared_ptr<gravlax::Expr<Value>>> trees;
+        for (auto &rule : rules) {
+            gravlax::Scanner scanner;
+            gravlax::Parser<Value> parser;
+            trees.push_back(parser.parse(scanner.scanString(rule)));
+        }
+        benchmark::DoNotOptimize(trees.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * rules.size());
+}
+
+void BM_CompileShared(benchmark::State &state)
+{
+    auto rules = makeRules(state.range(0));
+    std::vector<std::string> errors;
+
+    for (auto _ : state) {
+        auto program = RuleCompiler::compile(rules, errors);
+        benchmark::DoNotOptimize(program.instructions().data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * rules.size());
+}
+
+void BM_EvaluateSeparately(benchmark::State &state)
+{
+    auto rules = makeRules(state.range(0));
+    std::vector<std::shared_ptr<gravlax::Expr<Value>>> trees;
+    for (auto &rule : rules) {
+        gravlax::Scanner scanner;
+        gravlax::Parser<Value> parser;
+        trees.push_back(parser.parse(scanner.scanString(rule)));
+    }
+
+    Interpreter interpreter;
+    for (auto &[name, value] : makeInput())
+        interpreter.define(name, value);
+
+    for (auto _ : state) {
+        std::vector<Value> results;
+        for (auto &tree : trees)
+            results.push_back(interpreter.evaluate(*tree));
+        benchmark::DoNotOptimize(results.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * rules.size());
+}
+
+void BM_EvaluateShared(benchmark::State &state)
+{
+    auto rules = makeRules(state.range(0));
+    std::vector<std::string> errors;
+    auto program = RuleCompiler::compile(rules, errors);
+
+    std::vector<Value> inputs(program.inputs().size());
+    for (auto &[name, value] : makeInput()) {
+        int index = program.inputIndex(name);
+        if (index >= 0)
+            inputs[index] = value;
+    }
+
+    std::vector<RuleResult> results;
+    for (auto _ : state) {
+        program.evaluate(inputs, results);
+        benchmark::DoNotOptimize(results.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * rules.size());
+}
+
+}; // namespace
+
+// Items per second is rules per second.
+BENCHMARK(BM_CompileSeparately)->Arg(10000);
+BENCHMARK(BM_CompileShared)->Arg(10000);
+BENCHMARK(BM_EvaluateSeparately)->Arg(10000);
+BENCHMARK(BM_EvaluateShared)->Arg(10000);
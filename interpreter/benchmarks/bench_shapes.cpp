@@ -0,0 +1,165 @@
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <gravlax/runtime/heap.h>
+#include <gravlax/runtime/property.h>
+#include <gravlax/runtime/shape.h>
+
+using gravlax::runtime::Heap;
+using gravlax::runtime::ObjClass;
+using gravlax::runtime::ObjInstance;
+using gravlax::runtime::PropertyCache;
+using gravlax::runtime::ShapeTree;
+using gravlax::runtime::Value;
+
+namespace
+{
+
+const char *fieldNames[] = {"x", "y", "z", "w", "name", "next"};
+
+// Instances of shapeCount different shapes, all with the fields above.
+struct Objects {
+    Heap heap;
+    ShapeTree shapes;
+    std::vector<Value> instances;
+
+    explicit Objects(int shapeCount, int instanceCount = 64)
+    {
+        heap.addRoots(&instances);
+        for (int c = 0; c < shapeCount; c++) {
+            auto klass = heap.klass(heap.string("C"), shapes);
+            instances.push_back(Value::fromObject(klass));
+            gravlax::runtime::defineMethod(heap, klass, "area",
+                                           Value::fromNumber(c));
+        }
+
+        for (int i = 0; i < instanceCount; i++) {
+            auto klass = static_cast<ObjClass *>(
+                instances[i % shapeCount].asObject());
+            auto instance = heap.instance(klass);
+            instances.push_back(Value::fromObject(instance));
+            for (auto name : fieldNames) {
+                PropertyCache cache;
+                gravlax::runtime::setProperty(heap, instance, name,
+                                              Value::fromNumber(i), cache);
+            }
+        }
+        instances.erase(instances.begin(), instances.begin() + shapeCount);
+    }
+
+    ~Objects() { heap.removeRoots(&instances); }
+
+    ObjInstance *at(std::size_t i)
+    {
+        return static_cast<ObjInstance *>(
+            instances[i % instances.size()].asObject());
+    }
+};
+
+// o.z in a loop over objects of range(0) shapes, through one cache.
+void BM_FieldGet(benchmark::State &state)
+{
+    Objects objects(state.range(0));
+    PropertyCache cache;
+    std::size_t i = 0;
+
+    for (auto _ : state) {
+        Value value;
+        gravlax::runtime::getProperty(objects.at(i++), "z", cache, value);
+        benchmark::DoNotOptimize(value);
+    }
+
+    state.counters["misses"] = cache.misses;
+}
+
+// The same lookup without a cache: a walk up the shape chain.
+void BM_FieldGetUncached(benchmark::State &state)
+{
+    Objects objects(1);
+    std::size_t i = 0;
+
+    for (auto _ : state) {
+        PropertyCache cache;
+        Value value;
+        gravlax::runtime::getProperty(objects.at(i++), "z", cache, value);
+        benchmark::DoNotOptimize(value);
+    }
+}
+
+// The same with fields in a hash map per instance.
+void BM_FieldGetHashMap(benchmark::State &state)
+{
+    std::vector<std::unordered_map<std::string, Value>> instances(64);
+    for (std::size_t i = 0; i < instances.size(); i++) {
+        for (auto name : fieldNames)
+            instances[i][name] = Value::fromNumber(i);
+    }
+    std::size_t i = 0;
+
+    for (auto _ : state) {
+        std::string_view name = "z";
+        auto &fields = instances[i++ % instances.size()];
+        Value value = fields.find(std::string(name))->second;
+        benchmark::DoNotOptimize(value);
+    }
+}
+
+// o.x = o.x + 1 in a loop.
+void BM_FieldSet(benchmark::State &state)
+{
+    Objects objects(state.range(0));
+    PropertyCache get;
+    PropertyCache set;
+    std::size_t i = 0;
+
+    for (auto _ : state) {
+        ObjInstance *instance = objects.at(i++);
+        Value value;
+        gravlax::runtime::getProperty(instance, "x", get, value);
+        gravlax::runtime::setProperty(objects.heap, instance, "x",
+                                      Value::fromNumber(value.asNumber() + 1),
+                                      set);
+    }
+}
+
+// Looking up the method of o.area(), which sits behind the fields.
+void BM_MethodLookup(benchmark::State &state)
+{
+    Objects objects(state.range(0));
+    PropertyCache cache;
+    std::size_t i = 0;
+
+    for (auto _ : state) {
+        Value method;
+        gravlax::runtime::getProperty(objects.at(i++), "area", cache, method);
+        benchmark::DoNotOptimize(method);
+    }
+
+    state.counters["misses"] = cache.misses;
+}
+
+void BM_MethodLookupUncached(benchmark::State &state)
+{
+    Objects objects(1);
+    std::size_t i = 0;
+
+    for (auto _ : state) {
+        PropertyCache cache;
+        Value method;
+        gravlax::runtime::getProperty(objects.at(i++), "area", cache, method);
+        benchmark::DoNotOptimize(method);
+    }
+}
+
+}; // namespace
+
+// 1 shape is monomorphic, 4 polymorphic and 8 megamorphic.
+BENCHMARK(BM_FieldGet)->Arg(1)->Arg(4)->Arg(8);
+BENCHMARK(BM_FieldGetUncached);
+BENCHMARK(BM_FieldGetHashMap);
+BENCHMARK(BM_FieldSet)->Arg(1)->Arg(4);
+BENCHMARK(BM_MethodLookup)->Arg(1)->Arg(4)->Arg(8);
+BENCHMARK(BM_MethodLookupUncached);
@@ -0,0 +1,160 @@
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include <gravlax/compile_time.h>
+#include <gravlax/executor.h>
+#include <gravlax/parser.h>
+#include <gravlax/resolver.h>
+#include <gravlax/scanner.h>
+
+using gravlax::Executor;
+
+namespace
+{
+
+// Declares range(0) functions of some twenty lines each. The benchmarks call
+// only the first, like a big script of which one command runs.
+std::string script(int functions)
+{
+    std::string code;
+    for (int f = 0; f < functions; f++) {
+        code += "fun helper" + std::to_string(f) + "(a, b) {\n";
+        code += "  var total = 0;\n";
+        code += "  for (var i = 0; i < a; i = i + 1) {\n";
+        for (int line = 0; line < 16; line++) {
+            code += "    if (i > " + std::to_string(line) +
+                    ") total = total + b * " + std::to_string(line) + ";\n";
+        }
+        code += "  }\n";
+        code += "  return total;\n";
+        code += "}\n";
+    }
+    return code;
+}
+
+const char *command = "print helper0(3, 2);\n";
+
+void run(Executor &executor, const std::string &code, bool lazy = true)
+{
+    gravlax::Diagnostics diagnostics;
+    gravlax::Scanner scanner(diagnostics);
+    gravlax::Parser<Executor::Value> parser(diagnostics);
+    gravlax::Resolver<Executor::Value> resolver(executor.globalNames(),
+                                               diagnostics);
+    parser.setLazyFunctions(lazy);
+
+    auto program = parser.parseStatements(scanner.scanString(code));
+    auto info = resolver.resolve(program);
+    executor.execute(std::move(program), info);
+}
+
+void runScript(benchmark::State &state, bool lazy)
+{
+    std::string code = script(static_cast<int>(state.range(0))) + command;
+
+    for (auto _ : state) {
+        std::ostringstream out;
+        Executor executor(out);
+        run(executor, code, lazy);
+        benchmark::DoNotOptimize(out.str());
+    }
+
+    state.SetBytesProcessed(state.iterations() * code.size());
+}
+
+// A prelude of range(0) functions that also works out some tables when it
+// starts, which is what a snapshot saves besides parsing.
+std::string prelude(int functions)
+{
+    return script(functions) +
+           "fun square(x) { return x * x; }\n"
+           "var squares = \"\";\n"
+           "var sum = 0;\n"
+           "for (var i = 0; i < 1000; i = i + 1) {\n"
+           "  sum = sum + square(i);\n"
+           "  squares = squares + \"+\";\n"
+           "}\n";
+}
+
+void BM_StartupWithoutSnapshot(benchmark::State &state)
+{
+    std::string code = prelude(static_cast<int>(state.range(0)));
+
+    for (auto _ : state) {
+        std::ostringstream out;
+        Executor executor(out);
+        run(executor, code);
+        run(executor, command);
+        benchmark::DoNotOptimize(out.str());
+    }
+}
+
+// Maps the image instead, and rebuilds the functions from the metadata
+// without scanning them.
+void BM_StartupWithSnapshot(benchmark::State &state)
+{
+    std::string code = prelude(static_cast<int>(state.range(0)));
+    std::string path = "bench_startup.snapshot";
+    {
+        std::ostringstream out;
+        Executor executor(out);
+        run(executor, code);
+        executor.saveSnapshot(path, code);
+    }
+
+    for (auto _ : state) {
+        std::ostringstream out;
+        Executor executor(out);
+        executor.loadSnapshot(path);
+        run(executor, command);
+        benchmark::DoNotOptimize(out.str());
+    }
+
+    std::remove(path.c_str());
+}
+
+void BM_StartupEager(benchmark::State &state)
+{
+    runScript(state, false);
+}
+
+// Only helper0's body is parsed and resolved.
+void BM_StartupLazy(benchmark::State &state)
+{
+    runScript(state, true);
+}
+
+// A built-in snippet of the host, scanned and parsed at startup against
+// built from the tree that compile_time_parse() left in the binary.
+#define SNIPPET                                                                \
+    "clamp(limit - used * (1 + margin), 0, quota) > 0 and enabled or force"
+
+void BM_SnippetParse(benchmark::State &state)
+{
+    for (auto _ : state) {
+        gravlax::Scanner scanner;
+        gravlax::Parser<Executor::Value> parser;
+        benchmark::DoNotOptimize(parser.parse(scanner.scanString(SNIPPET)));
+    }
+}
+
+void BM_SnippetCompileTime(benchmark::State &state)
+{
+    constexpr auto ast = gravlax::compile_time_parse<SNIPPET>();
+    for (auto _ : state) {
+        gravlax::ExprFactory<Executor::Value> factory;
+        benchmark::DoNotOptimize(ast.build(factory));
+    }
+}
+
+}; // namespace
+
+BENCHMARK(BM_SnippetParse);
+BENCHMARK(BM_SnippetCompileTime);
+BENCHMARK(BM_StartupEager)->RangeMultiplier(4)->Range(16, 1024);
+BENCHMARK(BM_StartupLazy)->RangeMultiplier(4)->Range(16, 1024);
+BENCHMARK(BM_StartupWithoutSnapshot)->RangeMultiplier(4)->Range(16, 1024);
+BENCHMARK(BM_StartupWithSnapshot)->RangeMultiplier(4)->Range(16, 1024);
@@ -0,0 +1,192 @@
+#include <cctype>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <gravlax/runtime/heap.h>
+#include <gravlax/runtime/table.h>
+
+using gravlax::runtime::Heap;
+using gravlax::runtime::ObjString;
+using gravlax::runtime::Table;
+using gravlax::runtime::Value;
+
+namespace
+{
+
+const char *words[] = {"i",    "x",     "y",    "n",     "count", "name",
+                       "next", "left",  "right", "value", "node",  "total",
+                       "index", "tmp",  "result", "size"};
+constexpr std::size_t WordCount = std::size(words);
+
+// Names the way Lox programs spell them: the first few are short words,
+// then camelCase pairs, then pairs with a counter.
+std::vector<std::string> identifiers(std::size_t count)
+{
+    std::vector<std::string> names;
+    for (std::size_t i = 0; i < count; i++) {
+        std::string name = words[i % WordCount];
+        if (i >= WordCount) {
+            std::string second = words[(i / WordCount) % WordCount];
+            second[0] = static_cast<char>(std::toupper(second[0]));
+            name += second;
+        }
+        if (i >= WordCount * WordCount)
+            name += std::to_string(i / (WordCount * WordCount));
+        names.push_back(std::move(name));
+    }
+    return names;
+}
+
+// range(0) interned names, and the order in which the benchmarks look them
+// up, the same for every container.
+struct Keys {
+    Heap heap;
+    std::vector<std::string> names;
+    std::vector<ObjString *> strings;
+    std::vector<std::uint32_t> order;
+
+    explicit Keys(std::size_t count) : names(identifiers(count))
+    {
+        for (auto &name : names)
+            strings.push_back(heap.intern(name));
+
+        std::mt19937 random(7);
+        order.resize(4096);
+        for (auto &i : order)
+            i = static_cast<std::uint32_t>(random() % count);
+    }
+};
+
+struct PointerHash {
+    std::size_t operator()(const ObjString *s) const { return s->hash; }
+};
+
+// Global or field lookup by an interned name.
+void BM_TableGet(benchmark::State &state)
+{
+    Keys keys(state.range(0));
+    Table table;
+    for (std::size_t i = 0; i < keys.strings.size(); i++)
+        table.set(keys.strings[i], Value::fromNumber(i));
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        Value value;
+        table.get(keys.strings[keys.order[i++ & 4095]], value);
+        benchmark::DoNotOptimize(value);
+    }
+}
+
+// The same, with the same precomputed hashes.
+void BM_UnorderedMapGet(benchmark::State &state)
+{
+    Keys keys(state.range(0));
+    std::unordered_map<const ObjString *, Value, PointerHash> map;
+    for (std::size_t i = 0; i < keys.strings.size(); i++)
+        map[keys.strings[i]] = Value::fromNumber(i);
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        auto it = map.find(keys.strings[keys.order[i++ & 4095]]);
+        benchmark::DoNotOptimize(it->second);
+    }
+}
+
+// By contents, as without interning.
+void BM_UnorderedMapStringGet(benchmark::State &state)
+{
+    Keys keys(state.range(0));
+    std::unordered_map<std::string, Value> map;
+    for (std::size_t i = 0; i < keys.names.size(); i++)
+        map[keys.names[i]] = Value::fromNumber(i);
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        auto it = map.find(keys.names[keys.order[i++ & 4095]]);
+        benchmark::DoNotOptimize(it->second);
+    }
+}
+
+// Interning a name that is already in the set, given its hash.
+void BM_TableFindString(benchmark::State &state)
+{
+    Keys keys(state.range(0));
+    Table table;
+    for (auto s : keys.strings)
+        table.set(s, Value());
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        ObjString *s = keys.strings[keys.order[i++ & 4095]];
+        benchmark::DoNotOptimize(table.findString(s->view(), s->hash));
+    }
+}
+
+// An intern set of std::unordered_map with the hashes cached in the keys.
+void BM_UnorderedMapFindString(benchmark::State &state)
+{
+    Keys keys(state.range(0));
+    struct Hash {
+        std::size_t operator()(std::string_view s) const
+        {
+            return gravlax::runtime::hashChars(s);
+        }
+    };
+    std::unordered_map<std::string_view, ObjString *, Hash> map;
+    for (auto s : keys.strings)
+        map[s->view()] = s;
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        ObjString *s = keys.strings[keys.order[i++ & 4095]];
+        benchmark::DoNotOptimize(map.find(s->view()));
+    }
+}
+
+// Adding and removing at a steady size, like the fields of short-lived
+// records or a REPL redefining globals.
+void BM_TableChurn(benchmark::State &state)
+{
+    Keys keys(state.range(0) * 2);
+    Table table;
+    for (std::size_t i = 0; i < keys.strings.size(); i += 2)
+        table.set(keys.strings[i], Value());
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        ObjString *s = keys.strings[keys.order[i++ & 4095]];
+        if (!table.remove(s))
+            table.set(s, Value());
+    }
+    state.counters["capacity"] = table.capacity();
+}
+
+void BM_UnorderedMapChurn(benchmark::State &state)
+{
+    Keys keys(state.range(0) * 2);
+    std::unordered_map<const ObjString *, Value, PointerHash> map;
+    for (std::size_t i = 0; i < keys.strings.size(); i += 2)
+        map[keys.strings[i]] = Value();
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        ObjString *s = keys.strings[keys.order[i++ & 4095]];
+        if (!map.erase(s))
+            map[s] = Value();
+    }
+}
+
+}; // namespace
+
+BENCHMARK(BM_TableGet)->RangeMultiplier(8)->Range(8, 1 << 15);
+BENCHMARK(BM_UnorderedMapGet)->RangeMultiplier(8)->Range(8, 1 << 15);
+BENCHMARK(BM_UnorderedMapStringGet)->RangeMultiplier(8)->Range(8, 1 << 15);
+BENCHMARK(BM_TableFindString)->RangeMultiplier(8)->Range(8, 1 << 15);
+BENCHMARK(BM_UnorderedMapFindString)->RangeMultiplier(8)->Range(8, 1 << 15);
+BENCHMARK(BM_TableChurn)->RangeMultiplier(8)->Range(8, 1 << 15);
+BENCHMARK(BM_UnorderedMapChurn)->RangeMultiplier(8)->Range(8, 1 << 15);
@@ -4,32 +4,73 @@
 #include <variant>
 
 #include <gravlax/expression.h>
+#include <gravlax/statement.h>
 
+#include <gravlax/generated/assign.h>
 #include <gravlax/generated/binary.h>
+#include <gravlax/generated/call.h>
 #include <gravlax/generated/grouping.h>
 #include <gravlax/generated/literal.h>
+#include <gravlax/generated/logical.h>
 #include <gravlax/generated/unary.h>
+#include <gravlax/generated/variable.h>
+
+#include <gravlax/generated/stmt_block.h>
+#include <gravlax/generated/stmt_expression.h>
+#include <gravlax/generated/stmt_function.h>
+#include <gravlax/generated/stmt_if.h>
+#include <gravlax/generated/stmt_print.h>
+#include <gravlax/generated/stmt_return.h>
+#include <gravlax/generated/stmt_var.h>
+#include <gravlax/generated/stmt_while.h>
 
 namespace gravlax
 {
 
-class AstPrinter : public gravlax::generated::ExprVisitorBase<std::string>
+class AstPrinter : public gravlax::generated::ExprVisitorBase<std::string>,
+                   public gravlax::generated::StmtVisitorBase<std::string>
 {
   public:
+    virtual std::string
+    visitAssignExpr(gravlax::generated::Assign<std::string> &expr) override;
     virtual std::string
     visitBinaryExpr(gravlax::generated::Binary<std::string> &expr) override;
     virtual std::string
+    visitCallExpr(gravlax::generated::Call<std::string> &expr) override;
+    virtual std::string
     visitGroupingExpr(gravlax::generated::Grouping<std::string> &expr) override;
     virtual std::string
     visitLiteralExpr(gravlax::generated::Literal<std::string> &expr) override;
     virtual std::string
+    visitLogicalExpr(gravlax::generated::Logical<std::string> &expr) override;
+    virtual std::string
     visitUnaryExpr(gravlax::generated::Unary<std::string> &expr) override;
+    virtual std::string
+    visitVariableExpr(gravlax::generated::Variable<std::string> &expr) override;
+
+    virtual std::string
+    visitBlockStmt(gravlax::generated::Block<std::string> &stmt) override;
+    virtual std::string visitExpressionStmt(
+        gravlax::generated::Expression<std::string> &stmt) override;
+    virtual std::string
+    visitFunctionStmt(gravlax::generated::Function<std::string> &stmt) override;
+    virtual std::string
+    visitIfStmt(gravlax::generated::If<std::string> &stmt) override;
+    virtual std::string
+    visitPrintStmt(gravlax::generated::Print<std::string> &stmt) override;
+    virtual std::string
+    visitReturnStmt(gravlax::generated::Return<std::string> &stmt) override;
+    virtual std::string
+    visitVarStmt(gravlax::generated::Var<std::string> &stmt) override;
+    virtual std::string
+    visitWhileStmt(gravlax::generated::While<std::string> &stmt) override;
 
     std::string parenthesize(Expr<std::string> &expr);
 
     std::string parenthesize(std::string name, auto... exprs);
 
     std::string print(Expr<std::string> &expr);
+    std::string print(Stmt<std::string> &stmt);
 };
 
 }; // namespace gravlax
\ No newline at end of file
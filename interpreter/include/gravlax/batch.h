@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gravlax/expression.h>
+#include <gravlax/token.h>
+
+#include <gravlax/generated/binary.h>
+#include <gravlax/generated/grouping.h>
+#include <gravlax/generated/literal.h>
+#include <gravlax/generated/unary.h>
+#include <gravlax/generated/variable.h>
+
+namespace gravlax
+{
+
+// A column of numbers. Rows whose valid byte is 0 are nil, a missing valid
+// array means that every row has a value.
+struct BatchColumn {
+    const double *values;
+    const std::uint8_t *valid = nullptr;
+};
+
+struct BatchResult {
+    enum class Type { Number, Bool, Nil };
+
+    Type type = Type::Nil;
+    // Booleans are stored as 0 and 1.
+    std::vector<double> values;
+    // 0 where the result is nil or evaluating the row failed.
+    std::vector<std::uint8_t> valid;
+    // 1 where the tree-walking Interpreter would throw a RuntimeError.
+    std::vector<std::uint8_t> error;
+};
+
+// Evaluates one expression over columns of numbers. The tree is compiled into
+// a list of column-at-a-time operations that each run as a branch-free loop
+// over a chunk of rows, so the per-node dispatch cost is paid once per chunk
+// instead of once per row. Nil rows and runtime errors are tracked in byte
+// masks next to the values and follow the same rules as the Interpreter.
+//
+// Shared nodes of a hash-consed tree are evaluated once per chunk.
+class BatchProgram
+{
+  public:
+    static constexpr std::size_t chunkSize = 2048;
+
+    using Type = BatchResult::Type;
+
+    enum class Op : std::uint8_t {
+        Column,
+        Constant,
+        Fail,
+        Negate,
+        Not,
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+        Greater,
+        GreaterEqual,
+        Less,
+        LessEqual,
+        Equal,
+        NotEqual,
+    };
+
+    struct Instruction {
+        Op op;
+        int dst;
+        int a;
+        int b;
+        double constant;
+    };
+
+    // Binds every variable in expr to the column with the same name, the
+    // columns passed to evaluate() must be in the same order. Returns an
+    // empty pointer and sets error if the expression can not be evaluated
+    // in batches, i.e. because it contains strings.
+    template <typename R>
+    static std::unique_ptr<BatchProgram>
+    compile(Expr<R> &expr, const std::vector<std::string> &columns,
+            std::string &error)
+    {
+        std::unique_ptr<BatchProgram> program(new BatchProgram());
+        std::unordered_map<const Expr<R> *, int> compiled;
+
+        program->result =
+            program->compileNode(expr, columns, compiled, error);
+        if (program->result < 0)
+            return {};
+
+        return program;
+    }
+
+    void evaluate(std::span<const BatchColumn> columns, std::size_t rows,
+                  BatchResult &result) const;
+
+    Type resultType() const { return types[result]; }
+    std::size_t registerCount() const { return types.size(); }
+    const std::vector<Instruction> &instructions() const { return code; }
+
+  private:
+    std::vector<Instruction> code;
+    std::vector<Type> types;
+    int result = -1;
+
+    BatchProgram() = default;
+
+    int emit(Op op, Type type, int a = -1, int b = -1, double constant = 0);
+    int emitLiteral(const Token::Literal &value, std::string &error);
+    int emitUnary(Token::Type oper, int right);
+    int emitBinary(Token::Type oper, int left, int right);
+
+    template <typename R>
+    int compileNode(Expr<R> &expr, const std::vector<std::string> &columns,
+                    std::unordered_map<const Expr<R> *, int> &compiled,
+                    std::string &error)
+    {
+        auto it = compiled.find(&expr);
+        if (it != compiled.end())
+            return it->second;
+
+        int reg = -1;
+
+        switch (expr.kind()) {
+        case ExprKind::Binary: {
+            auto &node = static_cast<gravlax::generated::Binary<R> &>(expr);
+            int left = compileNode(*node.left, columns, compiled, error);
+            if (left < 0)
+                return -1;
+            int right = compileNode(*node.right, columns, compiled, error);
+            if (right < 0)
+                return -1;
+            reg = emitBinary(node.oper.type, left, right);
+            break;
+        }
+        case ExprKind::Grouping: {
+            auto &node = static_cast<gravlax::generated::Grouping<R> &>(expr);
+            reg = compileNode(*node.expression, columns, compiled, error);
+            break;
+        }
+        case ExprKind::Literal: {
+            auto &node = static_cast<gravlax::generated::Literal<R> &>(expr);
+            reg = emitLiteral(node.value, error);
+            break;
+        }
+        case ExprKind::Unary: {
+            auto &node = static_cast<gravlax::generated::Unary<R> &>(expr);
+            int right = compileNode(*node.right, columns, compiled, error);
+            if (right < 0)
+                return -1;
+            reg = emitUnary(node.oper.type, right);
+            break;
+        }
+        case ExprKind::Variable: {
+            auto &node = static_cast<gravlax::generated::Variable<R> &>(expr);
+            for (std::size_t i = 0; i < columns.size(); i++) {
+                if (columns[i] == node.name.lexeme) {
+                    reg = emit(Op::Column, Type::Number, static_cast<int>(i));
+                    break;
+                }
+            }
+            if (reg < 0)
+                error = "Unknown column '" + node.name.lexeme + "'.";
+            break;
+        }
+        case ExprKind::Assign:
+        case ExprKind::Call:
+        case ExprKind::Logical: {
+            auto name = gravlax::generated::ExprKindNames[static_cast<int>(
+                expr.kind())];
+            error = std::string(name) +
+                    " is not supported in batch expressions.";
+            break;
+        }
+        }
+
+        if (reg >= 0)
+            compiled.emplace(&expr, reg);
+        return reg;
+    }
+};
+
+}; // namespace gravlax
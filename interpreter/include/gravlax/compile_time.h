@@ -0,0 +1,365 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gravlax/expr_factory.h>
+#include <gravlax/expression.h>
+#include <gravlax/lexer.h>
+#include <gravlax/token.h>
+
+namespace gravlax
+{
+
+// A string literal as a template argument.
+template <std::size_t N> struct FixedString {
+    char chars[N] = {};
+
+    consteval FixedString(const char (&s)[N])
+    {
+        for (std::size_t i = 0; i < N; i++)
+            chars[i] = s[i];
+    }
+
+    constexpr std::string_view view() const { return {chars, N - 1}; }
+};
+
+// A token of a snippet. The lexeme is a slice of the snippet.
+struct StaticToken {
+    Token::Type type = Token::Type::END_OF_FILE;
+    std::uint32_t offset = 0;
+    std::uint32_t length = 0;
+    // The value of a NUMBER.
+    double number = 0;
+};
+
+// A node of a flat AST. Children are indices into the same array, and
+// groupings are left out like the Parser leaves them out. A call has its
+// callee in left and its first argument in right, and each argument links
+// to the next one.
+struct StaticNode {
+    static constexpr std::uint16_t None = 0xffff;
+
+    ExprKind kind = ExprKind::Literal;
+    // The operator, name or literal, or the ')' of a call.
+    std::uint16_t token = None;
+    std::uint16_t left = None;
+    std::uint16_t right = None;
+    std::uint16_t next = None;
+};
+
+// The tokens and tree of an expression, made by compile_time_parse(). Each
+// node consumes a token, so TokenCount bounds the nodes too.
+template <std::size_t TokenCount> struct StaticAst {
+    std::string_view source;
+    std::array<StaticToken, TokenCount> tokens{};
+    std::array<StaticNode, TokenCount> nodes{};
+    std::uint16_t nodeCount = 0;
+    std::uint16_t root = StaticNode::None;
+
+    constexpr std::string_view lexeme(const StaticToken &token) const
+    {
+        return source.substr(token.offset, token.length);
+    }
+
+    // The tree the Parser makes of the snippet, built without scanning or
+    // parsing. Token offsets are into the snippet.
+    template <typename R>
+    std::shared_ptr<Expr<R>> build(ExprFactory<R> &factory) const
+    {
+        return build(factory, root);
+    }
+
+  private:
+    Token token(std::uint16_t index) const
+    {
+        const StaticToken &t = tokens[index];
+        Token::Literal literal;
+        if (t.type == Token::Type::NUMBER)
+            literal = t.number;
+        else if (t.type == Token::Type::STRING)
+            literal = std::string(lexeme(t).substr(1, t.length - 2));
+        return Token(t.type, std::string(lexeme(t)), std::move(literal),
+                     static_cast<int>(t.offset));
+    }
+
+    template <typename R>
+    std::shared_ptr<Expr<R>> build(ExprFactory<R> &factory,
+                                   std::uint16_t index) const
+    {
+        const StaticNode &node = nodes[index];
+        switch (node.kind) {
+        case ExprKind::Assign:
+            return factory.assign(token(node.token),
+                                  build(factory, node.right));
+        case ExprKind::Binary:
+            return factory.binary(build(factory, node.left),
+                                  token(node.token),
+                                  build(factory, node.right));
+        case ExprKind::Call: {
+            std::vector<std::shared_ptr<Expr<R>>> arguments;
+            for (auto i = node.right; i != StaticNode::None; i = nodes[i].next)
+                arguments.push_back(build(factory, i));
+            return factory.call(build(factory, node.left), token(node.token),
+                                std::move(arguments));
+        }
+        case ExprKind::Literal:
+            switch (tokens[node.token].type) {
+            case Token::Type::FALSE:
+                return factory.literal(false);
+            case Token::Type::TRUE:
+                return factory.literal(true);
+            case Token::Type::NIL:
+                return factory.literal(Token::Literal());
+            default:
+                return factory.literal(token(node.token).literal);
+            }
+        case ExprKind::Logical:
+            return factory.logical(build(factory, node.left),
+                                   token(node.token),
+                                   build(factory, node.right));
+        case ExprKind::Unary:
+            return factory.unary(token(node.token),
+                                 build(factory, node.right));
+        case ExprKind::Variable:
+            return factory.variable(token(node.token));
+        default:
+            return {};
+        }
+    }
+};
+
+namespace detail
+{
+
+// Not constexpr: reaching it in constant evaluation is the compile error,
+// and the diagnostic quotes the message of the call.
+inline void snippetError(const char *) {}
+
+consteval std::size_t countTokens(std::string_view source)
+{
+    std::size_t count = 1;
+    for (int start = 0; start < static_cast<int>(source.size());) {
+        lexer::Lexeme lexeme = lexer::scan(source, start);
+        if (lexeme.kind == lexer::Lexeme::Kind::Token)
+            count++;
+        start = lexeme.end;
+    }
+    return count;
+}
+
+// The recursive descent of Parser::expression(), over a snippet's tokens.
+template <std::size_t N> class SnippetParser
+{
+    using Type = Token::Type;
+
+    StaticAst<N> &ast;
+    std::uint16_t current = 0;
+
+    consteval Type peek() const { return ast.tokens[current].type; }
+
+    consteval bool match(auto... types)
+    {
+        if (((peek() != types) && ...))
+            return false;
+        current++;
+        return true;
+    }
+
+    consteval void consume(Type type, const char *message)
+    {
+        if (peek() != type)
+            snippetError(message);
+        current++;
+    }
+
+    consteval std::uint16_t node(ExprKind kind, std::uint16_t token,
+                                 std::uint16_t left = StaticNode::None,
+                                 std::uint16_t right = StaticNode::None)
+    {
+        ast.nodes[ast.nodeCount] = {kind, token, left, right};
+        return ast.nodeCount++;
+    }
+
+    // A left-associative level of binary operators over operand().
+    consteval std::uint16_t binary(ExprKind kind, auto operand,
+                                   auto... operators)
+    {
+        std::uint16_t expr = (this->*operand)();
+        while (match(operators...)) {
+            std::uint16_t oper = current - 1;
+            expr = node(kind, oper, expr, (this->*operand)());
+        }
+        return expr;
+    }
+
+    consteval std::uint16_t assignment()
+    {
+        std::uint16_t expr = orExpression();
+        if (!match(Type::EQUAL))
+            return expr;
+
+        std::uint16_t value = assignment();
+        if (ast.nodes[expr].kind != ExprKind::Variable)
+            snippetError("Invalid assignment target.");
+        // The variable node stays behind, unreferenced.
+        return node(ExprKind::Assign, ast.nodes[expr].token,
+                    StaticNode::None, value);
+    }
+
+    consteval std::uint16_t orExpression()
+    {
+        return binary(ExprKind::Logical, &SnippetParser::andExpression,
+                      Type::OR);
+    }
+
+    consteval std::uint16_t andExpression()
+    {
+        return binary(ExprKind::Logical, &SnippetParser::equality, Type::AND);
+    }
+
+    consteval std::uint16_t equality()
+    {
+        return binary(ExprKind::Binary, &SnippetParser::comparison,
+                      Type::BANG_EQUAL, Type::EQUAL_EQUAL);
+    }
+
+    consteval std::uint16_t comparison()
+    {
+        return binary(ExprKind::Binary, &SnippetParser::term, Type::GREATER,
+                      Type::GREATER_EQUAL, Type::LESS, Type::LESS_EQUAL);
+    }
+
+    consteval std::uint16_t term()
+    {
+        return binary(ExprKind::Binary, &SnippetParser::factor, Type::MINUS,
+                      Type::PLUS);
+    }
+
+    consteval std::uint16_t factor()
+    {
+        return binary(ExprKind::Binary, &SnippetParser::unary, Type::SLASH,
+                      Type::STAR);
+    }
+
+    consteval std::uint16_t unary()
+    {
+        if (match(Type::BANG, Type::MINUS)) {
+            std::uint16_t oper = current - 1;
+            return node(ExprKind::Unary, oper, StaticNode::None, unary());
+        }
+        return call();
+    }
+
+    consteval std::uint16_t call()
+    {
+        std::uint16_t expr = primary();
+        while (match(Type::LEFT_PAREN)) {
+            std::uint16_t first = StaticNode::None;
+            std::uint16_t last = StaticNode::None;
+            std::size_t count = 0;
+            if (peek() != Type::RIGHT_PAREN) {
+                do {
+                    if (count++ >= 255)
+                        snippetError("Can't have more than 255 arguments.");
+                    std::uint16_t argument = assignment();
+                    if (last == StaticNode::None)
+                        first = argument;
+                    else
+                        ast.nodes[last].next = argument;
+                    last = argument;
+                } while (match(Type::COMMA));
+            }
+            consume(Type::RIGHT_PAREN, "Expect ')' after arguments.");
+            expr = node(ExprKind::Call, current - 1, expr, first);
+        }
+        return expr;
+    }
+
+    consteval std::uint16_t primary()
+    {
+        if (match(Type::FALSE, Type::TRUE, Type::NIL, Type::NUMBER,
+                  Type::STRING))
+            return node(ExprKind::Literal, current - 1);
+        if (match(Type::IDENTIFIER))
+            return node(ExprKind::Variable, current - 1);
+        if (match(Type::LEFT_PAREN)) {
+            std::uint16_t expr = assignment();
+            consume(Type::RIGHT_PAREN, "Expect ')' after expression.");
+            return expr;
+        }
+        snippetError("Expect expression.");
+        return StaticNode::None;
+    }
+
+  public:
+    consteval explicit SnippetParser(StaticAst<N> &ast) : ast(ast) {}
+
+    consteval std::uint16_t parse()
+    {
+        std::uint16_t root = assignment();
+        if (peek() != Type::END_OF_FILE)
+            snippetError("Expect end of expression.");
+        return root;
+    }
+};
+
+}; // namespace detail
+
+// Scans and parses a Lox expression during compilation. The result is a
+// constant that can live in the binary, and a malformed snippet does not
+// compile:
+//
+//     constexpr auto ast = compile_time_parse<"limit - used > 0">();
+//     auto expr = ast.build(factory);
+template <FixedString Source> consteval auto compile_time_parse()
+{
+    constexpr std::string_view source = Source.view();
+    constexpr std::size_t count = detail::countTokens(source);
+    static_assert(count < StaticNode::None, "Snippet is too long.");
+
+    StaticAst<count> ast;
+    ast.source = source;
+
+    std::size_t index = 0;
+    for (int start = 0; start < static_cast<int>(source.size());) {
+        lexer::Lexeme lexeme = lexer::scan(source, start);
+        switch (lexeme.kind) {
+        case lexer::Lexeme::Kind::Token: {
+            StaticToken &token = ast.tokens[index++];
+            token.type = lexeme.type;
+            token.offset = lexeme.begin;
+            token.length = lexeme.end - lexeme.begin;
+            if (token.type == Token::Type::NUMBER)
+                token.number = lexer::numberValue(ast.lexeme(token));
+            // The XID tables are not available in constant evaluation.
+            if (token.type == Token::Type::IDENTIFIER)
+                for (char c : ast.lexeme(token))
+                    if (static_cast<unsigned char>(c) >= 0x80)
+                        detail::snippetError("Expect an ASCII name.");
+            break;
+        }
+        case lexer::Lexeme::Kind::Unterminated:
+            detail::snippetError("Unterminated string.");
+            break;
+        case lexer::Lexeme::Kind::Unexpected:
+            detail::snippetError("Unexpected character.");
+            break;
+        default:
+            break;
+        }
+        start = lexeme.end;
+    }
+    ast.tokens[index] = {Token::Type::END_OF_FILE,
+                         static_cast<std::uint32_t>(source.size()), 0};
+
+    ast.root = detail::SnippetParser<count>(ast).parse();
+    return ast;
+}
+
+}; // namespace gravlax
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <gravlax/line_index.h>
+
+namespace gravlax
+{
+
+struct Diagnostic {
+    // Byte offset in the source the diagnostic refers to.
+    int offset;
+    // Optional context, i.e. " at 'foo'" or " at end".
+    std::string where;
+    std::string message;
+};
+
+// Collects errors from the scanner and parser instead of printing them as
+// they happen. Offsets are only turned into lines and columns when the
+// diagnostics are formatted.
+class Diagnostics
+{
+    std::vector<Diagnostic> entries;
+
+  public:
+    void error(int offset, std::string message);
+    void error(int offset, std::string where, std::string message);
+
+    bool hadError() const { return !entries.empty(); }
+    std::size_t count() const { return entries.size(); }
+    const std::vector<Diagnostic> &all() const { return entries; }
+
+    void clear() { entries.clear(); }
+
+    static std::string format(const Diagnostic &diagnostic,
+                              const LineIndex &lines);
+
+    void print(std::ostream &out, const LineIndex &lines) const;
+};
+
+}; // namespace gravlax
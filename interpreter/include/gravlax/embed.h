@@ -0,0 +1,256 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <gravlax/diagnostics.h>
+#include <gravlax/executor.h>
+#include <gravlax/resolution.h>
+#include <gravlax/resolver.h>
+
+#include <gravlax/runtime/heap.h>
+#include <gravlax/runtime/object.h>
+#include <gravlax/runtime/value.h>
+
+namespace gravlax
+{
+
+// How C++ values cross into Lox and back. from() takes an argument or
+// result, to() makes a value, and both are inlined into the natives that
+// Context::bind() generates. Values that do not fit throw
+// runtime::NativeError.
+template <typename T> struct Binding;
+
+template <> struct Binding<runtime::Value> {
+    static runtime::Value from(runtime::Heap &, runtime::Value value)
+    {
+        return value;
+    }
+    static runtime::Value to(runtime::Heap &, runtime::Value value)
+    {
+        return value;
+    }
+};
+
+template <typename T>
+    requires std::is_arithmetic_v<T> && (!std::is_same_v<T, bool>)
+struct Binding<T> {
+    static T from(runtime::Heap &, runtime::Value value)
+    {
+        if (!value.isNumber())
+            throw runtime::NativeError("Operand must be a number.");
+        return static_cast<T>(value.asNumber());
+    }
+    static runtime::Value to(runtime::Heap &, T n)
+    {
+        return runtime::Value::fromNumber(static_cast<double>(n));
+    }
+};
+
+template <> struct Binding<bool> {
+    static bool from(runtime::Heap &, runtime::Value value)
+    {
+        if (!value.isBool())
+            throw runtime::NativeError("Operand must be a boolean.");
+        return value.asBool();
+    }
+    static runtime::Value to(runtime::Heap &, bool b)
+    {
+        return runtime::Value::fromBool(b);
+    }
+};
+
+// The characters of a string argument, valid until the next allocation.
+// prepare() flattens ropes up front, so that taking the characters of one
+// argument does not allocate and move those of another.
+template <> struct Binding<std::string_view> {
+    static void prepare(runtime::Heap &heap, runtime::Value value)
+    {
+        if (runtime::isString(value))
+            heap.flatten(value.asObject());
+    }
+    static std::string_view from(runtime::Heap &heap, runtime::Value value)
+    {
+        if (!runtime::isString(value))
+            throw runtime::NativeError("Operand must be a string.");
+        return heap.flatten(value.asObject())->view();
+    }
+};
+
+template <> struct Binding<std::string> {
+    static std::string from(runtime::Heap &heap, runtime::Value value)
+    {
+        return std::string(Binding<std::string_view>::from(heap, value));
+    }
+    static runtime::Value to(runtime::Heap &heap, const std::string &s)
+    {
+        return runtime::Value::fromObject(heap.string(s));
+    }
+};
+
+template <> struct Binding<const char *> {
+    static runtime::Value to(runtime::Heap &heap, const char *s)
+    {
+        return runtime::Value::fromObject(heap.string(s));
+    }
+};
+
+// A native that unpacks its arguments with their Binding and calls F, a
+// function or a lambda without captures.
+template <auto F, typename Signature = decltype(+F)> struct Native;
+
+template <auto F, typename R, typename... Args>
+struct Native<F, R (*)(Args...)> {
+    static constexpr std::uint32_t arity = sizeof...(Args);
+
+    static runtime::Value call(runtime::Heap &heap,
+                               const runtime::Value *args)
+    {
+        return invoke(heap, args, std::index_sequence_for<Args...>{});
+    }
+
+  private:
+    template <typename T>
+    static void prepare(runtime::Heap &heap, runtime::Value value)
+    {
+        if constexpr (requires { Binding<T>::prepare(heap, value); })
+            Binding<T>::prepare(heap, value);
+    }
+
+    template <std::size_t... I>
+    static runtime::Value invoke(runtime::Heap &heap,
+                                 const runtime::Value *args,
+                                 std::index_sequence<I...>)
+    {
+        // The arguments are on the executor's stack, which the collector
+        // updates, so args stays valid.
+        (prepare<std::decay_t<Args>>(heap, args[I]), ...);
+        if constexpr (std::is_void_v<R>) {
+            F(Binding<std::decay_t<Args>>::from(heap, args[I])...);
+            return runtime::Value();
+        } else {
+            return Binding<std::decay_t<R>>::to(
+                heap, F(Binding<std::decay_t<Args>>::from(heap, args[I])...));
+        }
+    }
+};
+
+template <auto F, typename R, typename... Args>
+struct Native<F, R (*)(Args...) noexcept> : Native<F, R (*)(Args...)> {
+};
+
+// A script that was scanned, parsed and resolved once, to be run by any
+// number of Contexts. It is immutable, so contexts on different threads can
+// run it at the same time. Function bodies are parsed up front for that
+// reason.
+class Script
+{
+    std::string code;
+    Globals names;
+    Executor::Program statements;
+    FunctionInfo topLevel;
+
+    Script() = default;
+
+  public:
+    // Returns nullptr if the source has errors, which are reported to
+    // diagnostics. Their offsets are into source.
+    static std::shared_ptr<const Script> prepare(std::string source,
+                                                 Diagnostics &diagnostics);
+
+    const std::string &source() const { return code; }
+    // The globals the script was resolved against, by index.
+    const Globals &globalNames() const { return names; }
+    const Executor::Program &program() const { return statements; }
+    const FunctionInfo &info() const { return topLevel; }
+};
+
+// Runs a prepared script with its own heap, globals and natives. A context
+// is used by one thread at a time.
+class Context
+{
+    std::shared_ptr<const Script> prepared;
+    Executor runner;
+    // The arguments of call(), rooted while they are converted.
+    std::vector<runtime::Value> arguments;
+
+  public:
+    // A global found once by name, to call without looking it up again.
+    struct Function {
+        std::uint32_t global;
+    };
+
+    explicit Context(std::shared_ptr<const Script> script,
+                     std::ostream &out = std::cout,
+                     runtime::HeapOptions options = {});
+    ~Context();
+
+    Context(const Context &) = delete;
+    Context &operator=(const Context &) = delete;
+
+    // Defines a native that calls F, a function or a lambda without
+    // captures, with its arguments unpacked by their Binding.
+    template <auto F> void bind(const std::string &name)
+    {
+        runner.defineNative(name, &Native<F>::call, Native<F>::arity);
+    }
+
+    // Limits each later run() and call(), see Budget.
+    void setBudget(const Budget &budget) { runner.setBudget(budget); }
+    // Stops the running run() or call() with BudgetError. May be called
+    // from any thread.
+    void preempt() { runner.preempt(); }
+
+    // Runs the top level of the script. Throws RuntimeError.
+    void run() { runner.run(prepared->program(), prepared->info()); }
+
+    Function function(const std::string &name)
+    {
+        return {runner.globalNames().indexOf(name)};
+    }
+
+    // Calls a function that the script defined, or a native, and converts
+    // the result with its Binding. Throws RuntimeError.
+    template <typename R = runtime::Value, typename... Args>
+    R call(Function function, const Args &...args)
+    {
+        runtime::Heap &heap = runner.heap();
+        arguments.clear();
+        (arguments.push_back(
+             Binding<std::decay_t<const Args &>>::to(heap, args)),
+         ...);
+
+        runtime::Value callee;
+        if (!runner.global(function.global, callee))
+            undefined(function);
+        runtime::Value result = runner.call(
+            callee, arguments.data(),
+            static_cast<std::uint32_t>(arguments.size()));
+
+        if constexpr (!std::is_void_v<R>) {
+            try {
+                return Binding<R>::from(heap, result);
+            } catch (runtime::NativeError &error) {
+                throw RuntimeError(
+                    Token(Token::Type::IDENTIFIER,
+                          runner.globalNames().name(function.global), 0),
+                    error.what());
+            }
+        }
+    }
+
+    Executor &executor() { return runner; }
+
+  private:
+    [[noreturn]] void undefined(Function function);
+};
+
+}; // namespace gravlax
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <gravlax/diagnostics.h>
+#include <gravlax/expression.h>
+#include <gravlax/interpreter.h>
+#include <gravlax/profiler.h>
+#include <gravlax/resolution.h>
+#include <gravlax/resolver.h>
+#include <gravlax/snapshot.h>
+#include <gravlax/statement.h>
+#include <gravlax/token.h>
+
+#include <gravlax/runtime/heap.h>
+#include <gravlax/runtime/object.h>
+#include <gravlax/runtime/value.h>
+
+namespace gravlax
+{
+
+// Limits on each run of a program or call from C++, see
+// Executor::setBudget(). Zero means no limit.
+struct Budget {
+    // Function calls and loop iterations.
+    std::uint64_t steps = 0;
+    // Wall-clock time from the start of the run.
+    std::chrono::nanoseconds time{0};
+    // Bytes the run may allocate on the heap.
+    std::uint64_t heapBytes = 0;
+};
+
+// Thrown when a run goes over its Budget or is preempted. The executor is
+// then ready for the next run, as after any RuntimeError.
+class BudgetError : public RuntimeError
+{
+  public:
+    enum class Reason { Steps, Deadline, Heap, Preempted };
+
+    Reason reason;
+
+    BudgetError(const Token &token, Reason reason);
+};
+
+// Runs programs that went through the Resolver, with values on a runtime
+// Heap.
+//
+// Variables are never looked up by name. Locals live in frame slots on one
+// value stack, which also holds the callee, the arguments and the
+// temporaries of expressions so that the collector sees them. Captured
+// variables are reached through the upvalues of the running closure and
+// globals are indexed by their Globals index.
+//
+// Runtime errors throw RuntimeError and leave the executor ready to run the
+// next program.
+//
+// Every call and loop iteration is a step. Steps count down a fuel counter,
+// and only when it runs out are the budget, the clock and preemption
+// checked, so that the steps in between pay one decrement each.
+class Executor : private runtime::RootSource
+{
+  public:
+    using Value = runtime::Value;
+    using Program = std::vector<std::shared_ptr<Stmt<Value>>>;
+
+    // Deep enough for real recursion, shallow enough that the C++ stack of
+    // the tree walk does not run out first.
+    static constexpr std::size_t MaxFrames = 1024;
+
+    // Steps between checks of the clock and of preempt().
+    static constexpr std::uint64_t CheckInterval = 1024;
+
+    // Starts with the given global names, i.e. those a prepared Script was
+    // resolved against.
+    explicit Executor(std::ostream &out = std::cout,
+                      runtime::HeapOptions options = {}, Globals names = {});
+    ~Executor();
+
+    Executor(const Executor &) = delete;
+    Executor &operator=(const Executor &) = delete;
+
+    // Resolve programs against these names before running them.
+    Globals &globalNames() { return names; }
+    runtime::Heap &heap() { return objects; }
+
+    void defineNative(const std::string &name, runtime::NativeFn function,
+                      std::uint32_t arity);
+
+    // The executor keeps the program, closures refer to its functions.
+    // Throws RuntimeError.
+    void execute(Program program, const FunctionInfo &script);
+    // The same for a program that the caller keeps alive for the life of
+    // the executor. The program must have been parsed eagerly if other
+    // threads run it at the same time.
+    void run(const Program &program, const FunctionInfo &script);
+
+    // Calls a function or native from C++, between programs. The result is
+    // not rooted. Throws RuntimeError.
+    Value call(Value callee, const Value *args, std::uint32_t argCount);
+
+    // Errors in the bodies of lazily parsed functions, which are found when
+    // the functions are first called. Such a call throws RuntimeError.
+    const Diagnostics &compileErrors() const { return deferredErrors; }
+
+    // Returns false if the global has not been defined.
+    bool global(const std::string &name, Value &value) const;
+    bool global(std::uint32_t index, Value &value) const
+    {
+        if (index >= defined.size() || !defined[index])
+            return false;
+        value = globals[index];
+        return true;
+    }
+
+    // Saves the globals and the objects they refer to. The executor must
+    // have run nothing but prelude, the script the functions were declared
+    // in. Classes and instances cannot be saved yet. Throws SnapshotError.
+    void saveSnapshot(const std::string &path, std::string_view prelude);
+    // Starts from a saved snapshot instead of running its prelude, before
+    // any program runs. The natives the prelude used have to be defined
+    // first. Throws SnapshotError.
+    void loadSnapshot(const std::string &path);
+    // The loaded snapshot, or nullptr.
+    const Snapshot *snapshot() const { return image.get(); }
+
+    // Limits the runs that start from now on.
+    void setBudget(const Budget &budget) { this->budget = budget; }
+    // Makes the running program or call, or else the next one, throw
+    // BudgetError within CheckInterval steps. May be called from any
+    // thread.
+    void preempt() { preemptRequested.store(true, std::memory_order_relaxed); }
+
+    // Whether binary operators rewrite themselves into an operation for the
+    // operand types they see, such as adding two numbers, which then only
+    // checks that the types still fit. Off by default.
+    void setQuickening(bool enabled) { quickening = enabled; }
+
+    // Records the samples this executor takes into profile, see
+    // profiler::start(). nullptr stops sampling.
+    void setProfile(profiler::Profile *profile) { this->profile = profile; }
+
+    // Flattens strings.
+    std::string stringify(Value value);
+
+  private:
+    enum class Completion { Normal, Return };
+
+    // The running calls, innermost last. The top level runs in a frame
+    // without a closure.
+    struct Frame {
+        runtime::ObjClosure *closure;
+        std::uint32_t base;
+        // The call that made the frame, for the profiler.
+        const Token *site = nullptr;
+    };
+
+    std::ostream &out;
+    // The heap and the restored functions refer to it, so it goes last.
+    std::unique_ptr<Snapshot> image;
+    runtime::Heap objects;
+    Globals names;
+
+    std::vector<Value> globals;
+    std::vector<std::uint8_t> defined;
+    std::vector<Value> stack;
+    std::vector<Frame> frames;
+    // Sorted by slot.
+    std::vector<runtime::ObjUpvalue *> openUpvalues;
+    // Interned strings of string literals and the functions of declarations,
+    // made once per node.
+    std::vector<Value> constants;
+    std::unordered_map<const void *, std::uint32_t> constantIndex;
+    std::vector<Program> programs;
+    Diagnostics deferredErrors;
+    // By name, for the natives of a snapshot.
+    std::unordered_map<std::string, runtime::NativeFn> natives;
+    profiler::Profile *profile = nullptr;
+    bool quickening = false;
+
+    Budget budget;
+    // Steps left until refuel(), and the steps of the budget beyond them.
+    std::uint64_t fuel = 0;
+    std::uint64_t stepsLeft = 0;
+    std::chrono::steady_clock::time_point deadline;
+    std::atomic<bool> preemptRequested{false};
+
+    // Of the running frame.
+    std::uint32_t frameBase = 0;
+    runtime::ObjClosure *closure = nullptr;
+    Value returnValue;
+
+    void traceRoots(runtime::Tracer &tracer) override;
+
+    Completion execute(Stmt<Value> &stmt);
+    Value evaluate(Expr<Value> &expr);
+
+    // A binary operator that checks its operand types.
+    Value binary(const Token &oper, Value left, Value right);
+    // The same, through the operation site was rewritten into.
+    Value quickened(Quickening &site, const Token &oper, Value left,
+                    Value right);
+
+    Value read(const Token &name, const Resolution &resolution);
+    void write(const Token &name, const Resolution &resolution,
+               Value value);
+    void declare(const Resolution &resolution, Value value);
+
+    Value constant(const void *node, std::string_view string);
+    Value makeClosure(Stmt<Value> &declaration);
+    // Parses and resolves the body of a lazily parsed function.
+    void compile(Stmt<Value> &declaration);
+    runtime::ObjUpvalue *captureUpvalue(std::uint32_t slot);
+    void closeUpvalues(std::uint32_t fromSlot);
+
+    // Calls the callee at calleeSlot with the arguments above it and pops
+    // them all.
+    Value call(std::size_t calleeSlot, std::uint32_t argCount,
+               const Token &paren);
+
+    // Starts the budget of a run, and ends it.
+    void startBudget();
+    void endBudget();
+    // At the step at site, once the fuel has run out. Throws BudgetError.
+    void refuel(const Token &site);
+
+    // At the safe points, calls and loop iterations, once profiler::due().
+    // Records the stack with the innermost frame at site.
+    void sample(const Token &site);
+
+    // Flattens strings of the same length.
+    bool isEqual(Value a, Value b);
+};
+
+}; // namespace gravlax
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <bit>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <gravlax/expression.h>
+#include <gravlax/stats.h>
+#include <gravlax/token.h>
+
+#include <gravlax/generated/assign.h>
+#include <gravlax/generated/binary.h>
+#include <gravlax/generated/call.h>
+#include <gravlax/generated/grouping.h>
+#include <gravlax/generated/literal.h>
+#include <gravlax/generated/logical.h>
+#include <gravlax/generated/unary.h>
+#include <gravlax/generated/variable.h>
+
+namespace gravlax
+{
+
+// Creates expression nodes for the parser. With sharing enabled the factory
+// hash-conses the nodes: a structurally identical subtree that was built
+// before is returned instead of a new node, which turns the parsed trees into
+// a DAG. Because children are shared too, two nodes are identical when their
+// kinds, operators and literal values match and their children are the same
+// objects, so a lookup never has to compare whole subtrees.
+//
+// Shared nodes keep the operator token of their first occurrence. Anything
+// that evaluates a shared tree can cache results per node pointer.
+//
+// Assignments and calls have side effects and are never shared. Variables
+// are, so trees that the Resolver annotates must be built without sharing.
+template <typename R> class ExprFactory
+{
+    using Assign = gravlax::generated::Assign<R>;
+    using Binary = gravlax::generated::Binary<R>;
+    using Call = gravlax::generated::Call<R>;
+    using Grouping = gravlax::generated::Grouping<R>;
+    using Literal = gravlax::generated::Literal<R>;
+    using Logical = gravlax::generated::Logical<R>;
+    using Unary = gravlax::generated::Unary<R>;
+    using Variable = gravlax::generated::Variable<R>;
+
+    bool sharing = false;
+    std::unordered_multimap<std::uint64_t, std::shared_ptr<Expr<R>>> nodes;
+
+    static bool sameField(const Token &a, const Token &b)
+    {
+        return a.type == b.type && (a.type != Token::Type::IDENTIFIER ||
+                                    a.lexeme == b.lexeme);
+    }
+
+    static bool sameField(const Token::Literal &a, const Token::Literal &b)
+    {
+        // Compare numbers bitwise so that 0 and -0 stay apart and NaN
+        // literals can be shared.
+        auto da = std::get_if<double>(&a);
+        auto db = std::get_if<double>(&b);
+        if (da && db)
+            return std::bit_cast<std::uint64_t>(*da) ==
+                   std::bit_cast<std::uint64_t>(*db);
+        return a == b;
+    }
+
+    static bool sameField(const std::shared_ptr<Expr<R>> &a,
+                          const std::shared_ptr<Expr<R>> &b)
+    {
+        return a == b;
+    }
+
+    // Returns an existing node of type T with the given fields, or makes one.
+    template <typename T>
+    std::shared_ptr<Expr<R>> make(ExprKind kind, auto matches,
+                                  const auto &...fields)
+    {
+        if (!sharing) {
+            GRAVLAX_STATS_COUNT_NODE(kind);
+            return std::make_shared<T>(fields...);
+        }
+
+        std::uint64_t hash = hashNode(kind, fields...);
+
+        auto [begin, end] = nodes.equal_range(hash);
+        for (auto it = begin; it != end; ++it) {
+            if (it->second->kind() == kind &&
+                matches(static_cast<T &>(*it->second)))
+                return it->second;
+        }
+
+        GRAVLAX_STATS_COUNT_NODE(kind);
+        std::shared_ptr<Expr<R>> node = std::make_shared<T>(fields...);
+        nodes.emplace(hash, node);
+        return node;
+    }
+
+  public:
+    ExprFactory() = default;
+    explicit ExprFactory(bool sharing) : sharing(sharing) {}
+
+    bool isSharing() const { return sharing; }
+    void setSharing(bool enable) { sharing = enable; }
+
+    // Number of distinct nodes created while sharing was enabled.
+    std::size_t sharedNodeCount() const { return nodes.size(); }
+
+    // Forgets all shared nodes. Trees already built are not affected.
+    void clear() { nodes.clear(); }
+
+    std::shared_ptr<Expr<R>> assign(const Token &name,
+                                    const std::shared_ptr<Expr<R>> &value)
+    {
+        GRAVLAX_STATS_COUNT_NODE(ExprKind::Assign);
+        return std::make_shared<Assign>(name, value);
+    }
+
+    std::shared_ptr<Expr<R>> binary(const std::shared_ptr<Expr<R>> &left,
+                                    const Token &oper,
+                                    const std::shared_ptr<Expr<R>> &right)
+    {
+        return make<Binary>(
+            ExprKind::Binary,
+            [&](Binary &node) {
+                return sameField(node.left, left) &&
+                       sameField(node.oper, oper) &&
+                       sameField(node.right, right);
+            },
+            left, oper, right);
+    }
+
+    std::shared_ptr<Expr<R>>
+    call(const std::shared_ptr<Expr<R>> &callee, const Token &paren,
+         std::vector<std::shared_ptr<Expr<R>>> arguments)
+    {
+        GRAVLAX_STATS_COUNT_NODE(ExprKind::Call);
+        return std::make_shared<Call>(callee, paren, std::move(arguments));
+    }
+
+    std::shared_ptr<Expr<R>>
+    grouping(const std::shared_ptr<Expr<R>> &expression)
+    {
+        return make<Grouping>(
+            ExprKind::Grouping,
+            [&](Grouping &node) {
+                return sameField(node.expression, expression);
+            },
+            expression);
+    }
+
+    std::shared_ptr<Expr<R>> literal(const Token::Literal &value)
+    {
+        return make<Literal>(
+            ExprKind::Literal,
+            [&](Literal &node) { return sameField(node.value, value); },
+            value);
+    }
+
+    std::shared_ptr<Expr<R>> logical(const std::shared_ptr<Expr<R>> &left,
+                                     const Token &oper,
+                                     const std::shared_ptr<Expr<R>> &right)
+    {
+        return make<Logical>(
+            ExprKind::Logical,
+            [&](Logical &node) {
+                return sameField(node.left, left) &&
+                       sameField(node.oper, oper) &&
+                       sameField(node.right, right);
+            },
+            left, oper, right);
+    }
+
+    std::shared_ptr<Expr<R>> unary(const Token &oper,
+                                   const std::shared_ptr<Expr<R>> &right)
+    {
+        return make<Unary>(
+            ExprKind::Unary,
+            [&](Unary &node) {
+                return sameField(node.oper, oper) &&
+                       sameField(node.right, right);
+            },
+            oper, right);
+    }
+
+    std::shared_ptr<Expr<R>> variable(const Token &name)
+    {
+        return make<Variable>(
+            ExprKind::Variable,
+            [&](Variable &node) { return sameField(node.name, name); }, name);
+    }
+};
+
+}; // namespace gravlax
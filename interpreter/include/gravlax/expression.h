@@ -1,5 +1,11 @@
 #pragma once
 
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
 #include <gravlax/token.h>
 
 #include <gravlax/generated/visitor_base.h>
@@ -7,8 +13,95 @@
 namespace gravlax
 {
 
+using gravlax::generated::ExprKind;
+
 template <typename R> struct Expr {
+    virtual ~Expr() = default;
+
     virtual R accept(gravlax::generated::ExprVisitorBase<R> &visitor) = 0;
+    virtual ExprKind kind() const = 0;
+
+    // Hash over the node kind, operators, literal values and the hashes of
+    // the children. It only depends on the structure of the tree, so it is
+    // the same from run to run.
+    std::size_t structuralHash() const { return hash; }
+
+  protected:
+    std::size_t hash = 0;
 };
 
+inline std::uint64_t hashMix(std::uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+inline std::uint64_t hashCombine(std::uint64_t seed, std::uint64_t value)
+{
+    return hashMix(seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) +
+                           (seed >> 2)));
+}
+
+// FNV-1a
+inline std::uint64_t hashString(std::string_view s)
+{
+    std::uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Operators are identified by their type, names by their lexeme.
+inline std::uint64_t hashField(const Token &token)
+{
+    std::uint64_t h = static_cast<std::uint64_t>(token.type);
+    if (token.type == Token::Type::IDENTIFIER)
+        h = hashCombine(h, hashString(token.lexeme));
+    return h;
+}
+
+inline std::uint64_t hashField(const Token::Literal &literal)
+{
+    std::uint64_t h = literal.index();
+
+    if (auto b = std::get_if<bool>(&literal)) {
+        h = hashCombine(h, *b);
+    } else if (auto d = std::get_if<double>(&literal)) {
+        h = hashCombine(h, std::bit_cast<std::uint64_t>(*d));
+    } else if (auto s = std::get_if<std::string>(&literal)) {
+        h = hashCombine(h, hashString(*s));
+    }
+
+    return h;
+}
+
+template <typename R>
+std::uint64_t hashField(const std::shared_ptr<Expr<R>> &expr)
+{
+    return expr ? expr->structuralHash() : 0;
+}
+
+template <typename R>
+std::uint64_t hashField(const std::vector<std::shared_ptr<Expr<R>>> &exprs)
+{
+    std::uint64_t h = exprs.size();
+    for (auto &expr : exprs)
+        h = hashCombine(h, hashField(expr));
+    return h;
+}
+
+template <typename Kind>
+std::uint64_t hashNode(Kind kind, const auto &...fields)
+{
+    std::uint64_t h = hashMix(static_cast<std::uint64_t>(kind) + 1);
+    ((h = hashCombine(h, hashField(fields))), ...);
+    return h;
+}
+
 }; // namespace gravlax
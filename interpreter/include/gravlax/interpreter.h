@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include <gravlax/expression.h>
+#include <gravlax/token.h>
+
+#include <gravlax/generated/assign.h>
+#include <gravlax/generated/binary.h>
+#include <gravlax/generated/call.h>
+#include <gravlax/generated/grouping.h>
+#include <gravlax/generated/literal.h>
+#include <gravlax/generated/logical.h>
+#include <gravlax/generated/unary.h>
+#include <gravlax/generated/variable.h>
+
+namespace gravlax
+{
+
+// Runtime values are the same as the literal values for now.
+using Value = Token::Literal;
+
+class RuntimeError : public std::runtime_error
+{
+  public:
+    Token token;
+
+    RuntimeError(const Token &token, std::string message)
+        : std::runtime_error(message), token(token)
+    {
+    }
+};
+
+// Apply a unary or binary operator with Lox semantics. Returns nullptr on
+// success, or the runtime error message if the operand types do not fit.
+const char *unaryOperation(Token::Type oper, const Value &right,
+                           Value &result);
+const char *binaryOperation(Token::Type oper, const Value &left,
+                            const Value &right, Value &result);
+
+// Tree-walking evaluator for expressions, with variables looked up by name.
+// It has nothing to call, see Executor for programs with functions.
+class Interpreter : public gravlax::generated::ExprVisitorBase<Value>
+{
+    std::unordered_map<std::string, Value> globals;
+
+  public:
+    virtual Value
+    visitAssignExpr(gravlax::generated::Assign<Value> &expr) override;
+    virtual Value
+    visitBinaryExpr(gravlax::generated::Binary<Value> &expr) override;
+    virtual Value
+    visitCallExpr(gravlax::generated::Call<Value> &expr) override;
+    virtual Value
+    visitGroupingExpr(gravlax::generated::Grouping<Value> &expr) override;
+    virtual Value
+    visitLiteralExpr(gravlax::generated::Literal<Value> &expr) override;
+    virtual Value
+    visitLogicalExpr(gravlax::generated::Logical<Value> &expr) override;
+    virtual Value
+    visitUnaryExpr(gravlax::generated::Unary<Value> &expr) override;
+    virtual Value
+    visitVariableExpr(gravlax::generated::Variable<Value> &expr) override;
+
+    // Throws RuntimeError.
+    Value evaluate(Expr<Value> &expr);
+
+    void define(const std::string &name, Value value);
+
+    static bool isTruthy(const Value &value);
+    static bool isEqual(const Value &a, const Value &b);
+    static std::string stringify(const Value &value);
+};
+
+}; // namespace gravlax
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include <gravlax/embed.h>
+
+#include <gravlax/runtime/heap.h>
+
+#include <gravlax/utils/mpsc_queue.h>
+
+namespace gravlax
+{
+
+class Scheduler;
+
+// A Context that a Scheduler runs tasks in. Its heap, globals and interned
+// strings are its own, while the script, and the lexer and keyword tables
+// that are constants of the binary, are shared read-only with every other
+// isolate. Tasks posted to an isolate run one at a time and in order, so
+// they need no locks of their own. An isolate must outlive its tasks.
+class Isolate
+{
+    struct Task : utils::MpscQueue::Node {
+        std::function<void(Context &)> run;
+    };
+
+    Context runner;
+    utils::MpscQueue tasks;
+    // Tasks posted and not yet run. The post that makes it 1 schedules the
+    // isolate, and the worker that runs the last task lets it go.
+    std::atomic<std::size_t> pending{0};
+
+    friend class Scheduler;
+
+  public:
+    explicit Isolate(std::shared_ptr<const Script> script,
+                     std::ostream &out = std::cout,
+                     runtime::HeapOptions options = {});
+    ~Isolate();
+
+    Isolate(const Isolate &) = delete;
+    Isolate &operator=(const Isolate &) = delete;
+
+    // Only to be used while no task of the isolate runs.
+    Context &context() { return runner; }
+};
+
+// Runs the tasks of isolates on a fixed pool of threads. Each worker has a
+// lock-free queue of isolates with tasks, takes from its own queue first and
+// steals from the others when it is empty, and sleeps on an atomic while
+// there is nothing to steal. Posting is a push onto the isolate's queue, and
+// only the post that finds the isolate idle touches a run queue. A worker
+// runs a batch of an isolate's tasks before it moves on, so that one busy
+// isolate does not hold a thread.
+class Scheduler
+{
+  public:
+    using Task = std::function<void(Context &)>;
+
+    // Tasks of an isolate that a worker runs before it moves on.
+    static constexpr std::size_t BatchSize = 64;
+
+    explicit Scheduler(
+        std::size_t workers = std::thread::hardware_concurrency());
+    // Runs the tasks that were posted, then stops the workers.
+    ~Scheduler();
+
+    Scheduler(const Scheduler &) = delete;
+    Scheduler &operator=(const Scheduler &) = delete;
+
+    // May be called from any thread, tasks included.
+    void post(Isolate &isolate, Task task);
+    // Blocks until every posted task has run, and rethrows the first
+    // exception that a task threw since the last wait(). Not to be called
+    // from a task.
+    void wait();
+
+    std::size_t workerCount() const { return workers.size(); }
+
+  private:
+    struct Worker;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    // Tasks posted and not yet run, for wait().
+    std::atomic<std::size_t> outstanding{0};
+    // Bumped to wake sleeping workers, which wait on it.
+    std::atomic<std::uint32_t> wakeups{0};
+    std::atomic<std::size_t> sleepers{0};
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+
+    void work(Worker &self);
+    Isolate *find(Worker &self);
+    void run(Worker &self, Isolate &isolate);
+    void schedule(Isolate &isolate);
+    void drain();
+};
+
+}; // namespace gravlax
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+#include <gravlax/token.h>
+
+#include <gravlax/generated/lexer_tables.h>
+
+// The lexical rules of Lox as constexpr functions, shared by the Scanner and
+// by compile_time_parse(), which scans snippets during constant evaluation.
+// The rules themselves are in tools/tokens.spec.
+namespace gravlax::lexer
+{
+
+// What comes next in the source.
+struct Lexeme {
+    enum class Kind {
+        Token,
+        Whitespace,
+        // Runs to the end of the line, or of the source.
+        Comment,
+        // A string without its closing quote, up to the end of the source.
+        Unterminated,
+        Unexpected,
+    };
+
+    Kind kind;
+    Token::Type type;
+    // Whitespace before a lexeme is skipped, so it may begin after the
+    // offset it was scanned at.
+    int begin;
+    int end;
+    // Where the DFA stopped. Only when that is the end of the code could
+    // more input make a longer lexeme.
+    int stop;
+};
+
+namespace detail
+{
+
+// The transitions by state and byte, with the byte classes folded in. The
+// start state loops on whitespace, so that the whitespace between tokens
+// does not cost a lexeme of its own.
+inline constexpr auto transitions = [] {
+    namespace dfa = generated::lexer;
+    static_assert(dfa::StateCount <= 256);
+
+    std::array<std::uint8_t, dfa::StateCount * 256> table{};
+    for (int s = 0; s < dfa::StateCount; s++) {
+        for (int b = 0; b < 256; b++) {
+            int next = dfa::Transitions[s][dfa::ByteClass[b]];
+            if (s == dfa::StartState && dfa::Accepts[next] == dfa::WHITESPACE)
+                next = dfa::StartState;
+            table[s * 256 + b] = static_cast<std::uint8_t>(next);
+        }
+    }
+    return table;
+}();
+
+}; // namespace detail
+
+// Where the DFA is in a scan, so that a scan that ran out of input can go
+// on once more input follows instead of starting over.
+struct Progress {
+    int state;
+    // Whitespace before the lexeme is skipped, as in Lexeme.
+    int begin;
+    int current;
+};
+
+constexpr Progress startAt(int offset)
+{
+    return {generated::lexer::StartState, offset, offset};
+}
+
+// Runs the DFA from progress over the rest of code until it dies, or until
+// it runs out of input, and leaves progress where it stopped.
+constexpr void advance(std::string_view code, Progress &progress)
+{
+    namespace dfa = generated::lexer;
+
+    const int size = static_cast<int>(code.size());
+    // Most bytes keep the DFA in its state, in the body of a name, a number,
+    // a string or whitespace, and then the branch is predicted and the next
+    // load does not wait for this one.
+    int state = progress.state;
+    int begin = progress.begin;
+    int current = progress.current;
+    for (; current < size; current++) {
+        auto byte = static_cast<unsigned char>(code[current]);
+        int next = detail::transitions[state * 256 + byte];
+        if (next != state) {
+            if (next == dfa::DeadState)
+                break;
+            state = next;
+        } else if (state == dfa::StartState) {
+            begin = current + 1;
+        }
+    }
+    progress = {state, begin, current};
+}
+
+// The lexeme that was scanned from start up to where advance() stopped.
+constexpr Lexeme match(std::string_view code, int start,
+                       const Progress &progress)
+{
+    namespace dfa = generated::lexer;
+    using Kind = Lexeme::Kind;
+
+    const int size = static_cast<int>(code.size());
+    auto [state, begin, current] = progress;
+
+    if (state == dfa::StartState) {
+        // Lines are recovered from offsets on demand, see LineIndex.
+        if (begin > start)
+            return {Kind::Whitespace, Token::Type::END_OF_FILE, start, begin,
+                    current};
+        return {Kind::Unexpected, Token::Type::END_OF_FILE, start,
+                start + 1, current};
+    }
+
+    // Nearly always the DFA dies right after the longest match. Otherwise
+    // run it again and remember where it last accepted, which only "1." and
+    // errors need.
+    std::int16_t accepted = dfa::Accepts[state];
+    int end = current;
+    if (accepted == dfa::NoMatch) {
+        state = dfa::StartState;
+        for (int i = begin; i < current; i++) {
+            auto byte = static_cast<unsigned char>(code[i]);
+            state = detail::transitions[state * 256 + byte];
+            if (dfa::Accepts[state] != dfa::NoMatch) {
+                accepted = dfa::Accepts[state];
+                end = i + 1;
+            }
+        }
+    }
+
+    switch (accepted) {
+    case dfa::NoMatch:
+        // Only a string without its closing quote runs to the end unmatched.
+        if (current == size && code[begin] == '"')
+            return {Kind::Unterminated, Token::Type::STRING, begin, size,
+                    current};
+        return {Kind::Unexpected, Token::Type::END_OF_FILE, begin,
+                begin + 1, current};
+    case dfa::COMMENT:
+        return {Kind::Comment, Token::Type::SLASH, begin, end, current};
+    default:
+        return {Kind::Token, static_cast<Token::Type>(accepted), begin,
+                end, current};
+    }
+}
+
+// Scans the longest lexeme at start, which must be inside code, with the
+// DFA that lexer_generator made of tools/tokens.spec. Literal values are left
+// to the caller.
+constexpr Lexeme scan(std::string_view code, int start)
+{
+    Progress progress = startAt(start);
+    advance(code, progress);
+    return match(code, start, progress);
+}
+
+// The value of a NUMBER lexeme in constant evaluation, where
+// std::from_chars cannot be used. Literals of up to 15 significant digits
+// and 22 decimals are exact, which is the fast path of Clinger's algorithm;
+// longer ones may differ from std::from_chars in the last bit.
+constexpr double numberValue(std::string_view lexeme)
+{
+    constexpr double powers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                 1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                 1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    std::uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool fraction = false;
+    for (char c : lexeme) {
+        if (c == '.') {
+            fraction = true;
+        } else if (digits < 19) {
+            mantissa = mantissa * 10 + (c - '0');
+            digits += mantissa != 0;
+            exponent -= fraction;
+        } else if (!fraction) {
+            // Digits past the 19th only scale the integer part.
+            exponent++;
+        }
+    }
+
+    double value = static_cast<double>(mantissa);
+    for (; exponent > 22; exponent--)
+        value *= 10;
+    for (; exponent < -22; exponent++)
+        value /= 10;
+    return exponent >= 0 ? value * powers[exponent]
+                         : value / powers[-exponent];
+}
+
+}; // namespace gravlax::lexer
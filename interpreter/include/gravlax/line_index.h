@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+namespace gravlax
+{
+
+// 1-based line and column of a byte offset in the source.
+struct SourceLocation {
+    int line;
+    int column;
+};
+
+// Maps byte offsets to lines and columns. The table of line start offsets is
+// only built on the first lookup, so scanning never pays for line tracking.
+class LineIndex
+{
+    std::string_view source;
+    mutable std::vector<int> lineStarts;
+    mutable bool built = false;
+
+    void build() const;
+
+  public:
+    LineIndex() = default;
+    explicit LineIndex(std::string_view source);
+
+    void reset(std::string_view source);
+
+    SourceLocation locate(int offset) const;
+    int line(int offset) const { return locate(offset).line; }
+    int column(int offset) const { return locate(offset).column; }
+
+    int lineCount() const;
+
+    // Text of the given 1-based line without its line terminator.
+    std::string_view lineText(int line) const;
+};
+
+}; // namespace gravlax
@@ -3,42 +3,123 @@
 #include <memory>
 #include <vector>
 
+#include <gravlax/diagnostics.h>
+#include <gravlax/expr_factory.h>
 #include <gravlax/expression.h>
+#include <gravlax/statement.h>
+#include <gravlax/stats.h>
 #include <gravlax/token.h>
+#include <gravlax/trace.h>
 
-#include <gravlax/generated/binary.h>
-#include <gravlax/generated/grouping.h>
-#include <gravlax/generated/literal.h>
-#include <gravlax/generated/unary.h>
+#include <gravlax/generated/stmt_block.h>
+#include <gravlax/generated/stmt_expression.h>
+#include <gravlax/generated/stmt_function.h>
+#include <gravlax/generated/stmt_if.h>
+#include <gravlax/generated/stmt_print.h>
+#include <gravlax/generated/stmt_return.h>
+#include <gravlax/generated/stmt_var.h>
+#include <gravlax/generated/stmt_while.h>
 
 namespace gravlax
 {
-using gravlax::generated::Binary;
-using gravlax::generated::Literal;
-using gravlax::generated::Unary;
-
-class ParseError : public std::runtime_error
-{
-  public:
-    ParseError() : std::runtime_error("") {}
-    ParseError(std::string message) : std::runtime_error(message) {}
-};
 
+// Errors do not throw. A rule that fails records a diagnostic and returns an
+// empty pointer, which its callers pass on until parseProgram() or
+// declaration() synchronizes at the next statement boundary and carries on.
 template <typename R> class Parser
 {
-    std::unique_ptr<std::vector<Token>> tokens;
+    using StmtPtr = std::shared_ptr<Stmt<R>>;
+    using Block = gravlax::generated::Block<R>;
+    using Expression = gravlax::generated::Expression<R>;
+    using Function = gravlax::generated::Function<R>;
+    using If = gravlax::generated::If<R>;
+    using Print = gravlax::generated::Print<R>;
+    using Return = gravlax::generated::Return<R>;
+    using Var = gravlax::generated::Var<R>;
+    using While = gravlax::generated::While<R>;
+
+    // Parameters and arguments, like the book.
+    static constexpr std::size_t MaxArguments = 255;
+
+    // Shared with the lazy function bodies of the parsed program.
+    std::shared_ptr<const std::vector<Token>> tokens;
     int current = 0;
+    // Parsing stops here, before the end of the input when parsing a lazy
+    // function body.
+    std::size_t limit = 0;
+    bool lazyFunctions = false;
+
+    Diagnostics ownDiagnostics;
+    Diagnostics *diagnostics = &ownDiagnostics;
+
+    ExprFactory<R> nodes;
+
+    std::shared_ptr<Expr<R>> expression() { return assignment(); }
+
+    std::shared_ptr<Expr<R>> assignment()
+    {
+        std::shared_ptr<Expr<R>> expr = orExpression();
+
+        if (expr && match(Token::Type::EQUAL)) {
+            const Token &equals = previous();
+            std::shared_ptr<Expr<R>> value = assignment();
+            if (!value)
+                return {};
+
+            if (expr->kind() == ExprKind::Variable) {
+                auto &name =
+                    static_cast<gravlax::generated::Variable<R> &>(*expr).name;
+                return nodes.assign(name, value);
+            }
+
+            // Reported, but the parser is not confused, so carry on.
+            error(equals, "Invalid assignment target.");
+        }
 
-    std::shared_ptr<Expr<R>> expression() { return equality(); }
+        return expr;
+    }
+
+    std::shared_ptr<Expr<R>> orExpression()
+    {
+        std::shared_ptr<Expr<R>> expr = andExpression();
+
+        while (expr && match(Token::Type::OR)) {
+            const Token &oper = previous();
+            std::shared_ptr<Expr<R>> right = andExpression();
+            if (!right)
+                return {};
+            expr = nodes.logical(expr, oper, right);
+        }
+
+        return expr;
+    }
+
+    std::shared_ptr<Expr<R>> andExpression()
+    {
+        std::shared_ptr<Expr<R>> expr = equality();
+
+        while (expr && match(Token::Type::AND)) {
+            const Token &oper = previous();
+            std::shared_ptr<Expr<R>> right = equality();
+            if (!right)
+                return {};
+            expr = nodes.logical(expr, oper, right);
+        }
+
+        return expr;
+    }
 
     std::shared_ptr<Expr<R>> equality()
     {
         std::shared_ptr<Expr<R>> expr = comparison();
 
-        while (match(Token::Type::BANG_EQUAL, Token::Type::EQUAL_EQUAL)) {
-            Token oper = previous();
+        while (expr &&
+               match(Token::Type::BANG_EQUAL, Token::Type::EQUAL_EQUAL)) {
+            const Token &oper = previous();
             std::shared_ptr<Expr<R>> right = comparison();
-            expr = std::make_shared<Binary<R>>(expr, oper, right);
+            if (!right)
+                return {};
+            expr = nodes.binary(expr, oper, right);
         }
 
         return expr;
@@ -63,28 +144,41 @@ template <typename R> class Parser
         return peek().type == type;
     }
 
-    Token advance()
+    const Token &advance()
     {
         if (!isAtEnd())
             current++;
         return previous();
     }
 
-    bool isAtEnd() { return peek().type == Token::Type::END_OF_FILE; }
+    bool isAtEnd()
+    {
+        return static_cast<std::size_t>(current) >= limit ||
+               peek().type == Token::Type::END_OF_FILE;
+    }
+
+    void start(std::shared_ptr<const std::vector<Token>> input)
+    {
+        tokens = std::move(input);
+        current = 0;
+        limit = tokens->size();
+    }
 
-    Token peek() { return (*tokens)[current]; }
+    const Token &peek() { return (*tokens)[current]; }
 
-    Token previous() { return (*tokens)[current - 1]; }
+    const Token &previous() { return (*tokens)[current - 1]; }
 
     std::shared_ptr<Expr<R>> comparison()
     {
         std::shared_ptr<Expr<R>> expr = term();
 
-        while (match(Token::Type::GREATER, Token::Type::GREATER_EQUAL,
-                     Token::Type::LESS, Token::Type::LESS_EQUAL)) {
-            Token oper = previous();
+        while (expr && match(Token::Type::GREATER, Token::Type::GREATER_EQUAL,
+                             Token::Type::LESS, Token::Type::LESS_EQUAL)) {
+            const Token &oper = previous();
             std::shared_ptr<Expr<R>> right = term();
-            expr = std::make_shared<Binary<R>>(expr, oper, right);
+            if (!right)
+                return {};
+            expr = nodes.binary(expr, oper, right);
         }
 
         return expr;
@@ -94,10 +188,12 @@ template <typename R> class Parser
     {
         std::shared_ptr<Expr<R>> expr = factor();
 
-        while (match(Token::Type::MINUS, Token::Type::PLUS)) {
-            Token oper = previous();
+        while (expr && match(Token::Type::MINUS, Token::Type::PLUS)) {
+            const Token &oper = previous();
             std::shared_ptr<Expr<R>> right = factor();
-            expr = std::make_shared<Binary<R>>(expr, oper, right);
+            if (!right)
+                return {};
+            expr = nodes.binary(expr, oper, right);
         }
 
         return expr;
@@ -107,10 +203,12 @@ template <typename R> class Parser
     {
         std::shared_ptr<Expr<R>> expr = unary();
 
-        while (match(Token::Type::SLASH, Token::Type::STAR)) {
-            Token oper = previous();
+        while (expr && match(Token::Type::SLASH, Token::Type::STAR)) {
+            const Token &oper = previous();
             std::shared_ptr<Expr<R>> right = unary();
-            expr = std::make_shared<Binary<R>>(expr, oper, right);
+            if (!right)
+                return {};
+            expr = nodes.binary(expr, oper, right);
         }
 
         return expr;
@@ -119,34 +217,76 @@ template <typename R> class Parser
     std::shared_ptr<Expr<R>> unary()
     {
         if (match(Token::Type::BANG, Token::Type::MINUS)) {
-            Token oper = previous();
+            const Token &oper = previous();
             std::shared_ptr<Expr<R>> right = unary();
-            return std::make_shared<Unary<R>>(oper, right);
+            if (!right)
+                return {};
+            return nodes.unary(oper, right);
         }
 
-        return primary();
+        return call();
+    }
+
+    std::shared_ptr<Expr<R>> call()
+    {
+        std::shared_ptr<Expr<R>> expr = primary();
+
+        while (expr && match(Token::Type::LEFT_PAREN))
+            expr = finishCall(expr);
+
+        return expr;
+    }
+
+    std::shared_ptr<Expr<R>> finishCall(const std::shared_ptr<Expr<R>> &callee)
+    {
+        std::vector<std::shared_ptr<Expr<R>>> arguments;
+
+        if (!check(Token::Type::RIGHT_PAREN)) {
+            do {
+                if (arguments.size() >= MaxArguments)
+                    error(peek(), "Can't have more than 255 arguments.");
+                auto argument = expression();
+                if (!argument)
+                    return {};
+                arguments.push_back(std::move(argument));
+            } while (match(Token::Type::COMMA));
+        }
+
+        if (!consume(Token::Type::RIGHT_PAREN, "Expect ')' after arguments."))
+            return {};
+
+        return nodes.call(callee, previous(), std::move(arguments));
     }
 
     std::shared_ptr<Expr<R>> primary()
     {
         if (match(Token::Type::FALSE))
-            return std::make_shared<Literal<R>>(false);
+            return nodes.literal(false);
         if (match(Token::Type::TRUE))
-            return std::make_shared<Literal<R>>(true);
+            return nodes.literal(true);
         if (match(Token::Type::NIL))
-            return std::make_shared<Literal<R>>(Token::Literal());
+            return nodes.literal(Token::Literal());
 
         if (match(Token::Type::NUMBER, Token::Type::STRING)) {
-            return std::make_shared<Literal<R>>(previous().literal);
+            return nodes.literal(previous().literal);
+        }
+
+        if (match(Token::Type::IDENTIFIER)) {
+            return nodes.variable(previous());
         }
 
         if (match(Token::Type::LEFT_PAREN)) {
             auto expr = expression();
-            consume(Token::Type::RIGHT_PAREN, "Expect ')' after expression.");
+            if (!expr)
+                return {};
+            if (!consume(Token::Type::RIGHT_PAREN,
+                         "Expect ')' after expression."))
+                return {};
             return expr; // std::make_shared<Grouping<R>>(expr);
         }
 
-        throw ParseError("Unknown token!");
+        error(peek(), "Expect expression.");
+        return {};
     }
 
     void synchronize()
@@ -167,36 +307,413 @@ template <typename R> class Parser
             case Token::Type::PRINT:
             case Token::Type::RETURN:
                 return;
+            default:
+                break;
             }
 
             advance();
         }
     }
 
-    Token consume(Token::Type type, std::string message)
+    // The message is only turned into a string on error.
+    bool consume(Token::Type type, const char *message)
     {
-        if (check(type))
-            return advance();
+        if (check(type)) {
+            advance();
+            return true;
+        }
+
+        error(peek(), message);
+        return false;
+    }
+
+    void error(const Token &token, std::string message)
+    {
+        if (token.type == Token::Type::END_OF_FILE) {
+            diagnostics->error(token.offset, " at end", std::move(message));
+        } else {
+            diagnostics->error(token.offset,
+                               fmt::format(" at '{}'", token.lexeme),
+                               std::move(message));
+        }
+    }
+
+    // An expression followed by ';', or by the end of the input.
+    std::shared_ptr<Expr<R>> topLevelExpression()
+    {
+        auto expr = expression();
+        if (!expr)
+            return {};
+        if (!isAtEnd() &&
+            !consume(Token::Type::SEMICOLON, "Expect ';' after expression."))
+            return {};
+        return expr;
+    }
+
+    // Returns an empty pointer after synchronizing if the declaration does
+    // not parse.
+    StmtPtr declaration()
+    {
+        StmtPtr stmt;
+
+        if (match(Token::Type::FUN)) {
+            stmt = function();
+        } else if (match(Token::Type::VAR)) {
+            stmt = varDeclaration();
+        } else {
+            stmt = statement();
+        }
+
+        if (!stmt)
+            synchronize();
+        return stmt;
+    }
+
+    StmtPtr function()
+    {
+        if (!consume(Token::Type::IDENTIFIER, "Expect function name."))
+            return {};
+        const Token &name = previous();
+
+        if (!consume(Token::Type::LEFT_PAREN,
+                     "Expect '(' after function name."))
+            return {};
+
+        std::vector<Token> params;
+        if (!check(Token::Type::RIGHT_PAREN)) {
+            do {
+                if (params.size() >= MaxArguments)
+                    error(peek(), "Can't have more than 255 parameters.");
+                if (!consume(Token::Type::IDENTIFIER,
+                             "Expect parameter name."))
+                    return {};
+                params.push_back(previous());
+            } while (match(Token::Type::COMMA));
+        }
+
+        if (!consume(Token::Type::RIGHT_PAREN,
+                     "Expect ')' after parameters.") ||
+            !consume(Token::Type::LEFT_BRACE,
+                     "Expect '{' before function body."))
+            return {};
+
+        auto sourceBegin = static_cast<std::uint32_t>(peek().offset);
+        std::shared_ptr<Function> function;
+        if (lazyFunctions) {
+            function = skipFunctionBody(name, std::move(params));
+        } else {
+            std::vector<StmtPtr> body;
+            if (block(body))
+                function = std::make_shared<Function>(
+                    name, std::move(params), std::move(body));
+        }
+        if (!function)
+            return {};
 
-        throw error(peek(), message);
+        function->lazy.sourceBegin = sourceBegin;
+        function->lazy.sourceEnd =
+            static_cast<std::uint32_t>(previous().offset);
+        return function;
     }
 
-    ParseError error(Token token, std::string message)
+    // Only matches braces, so errors in the body wait for the first call.
+    std::shared_ptr<Function> skipFunctionBody(const Token &name,
+                                               std::vector<Token> params)
     {
-        return ParseError(message);
+        auto begin = static_cast<std::uint32_t>(current);
+        int depth = 1;
+        while (!isAtEnd()) {
+            Token::Type type = advance().type;
+            if (type == Token::Type::LEFT_BRACE) {
+                depth++;
+            } else if (type == Token::Type::RIGHT_BRACE && --depth == 0) {
+                break;
+            }
+        }
+        if (depth > 0) {
+            error(peek(), "Expect '}' after block.");
+            return {};
+        }
+
+        auto function = std::make_shared<Function>(name, std::move(params),
+                                                   std::vector<StmtPtr>{});
+        function->lazy.tokens = tokens;
+        function->lazy.begin = begin;
+        function->lazy.end = static_cast<std::uint32_t>(current - 1);
+        return function;
+    }
+
+    StmtPtr varDeclaration()
+    {
+        if (!consume(Token::Type::IDENTIFIER, "Expect variable name."))
+            return {};
+        const Token &name = previous();
+
+        std::shared_ptr<Expr<R>> initializer;
+        if (match(Token::Type::EQUAL)) {
+            initializer = expression();
+            if (!initializer)
+                return {};
+        }
+
+        if (!consume(Token::Type::SEMICOLON,
+                     "Expect ';' after variable declaration."))
+            return {};
+        return std::make_shared<Var>(name, std::move(initializer));
+    }
+
+    StmtPtr statement()
+    {
+        if (match(Token::Type::FOR))
+            return forStatement();
+        if (match(Token::Type::IF))
+            return ifStatement();
+        if (match(Token::Type::PRINT))
+            return printStatement();
+        if (match(Token::Type::RETURN))
+            return returnStatement();
+        if (match(Token::Type::WHILE))
+            return whileStatement();
+        if (match(Token::Type::LEFT_BRACE)) {
+            std::vector<StmtPtr> statements;
+            if (!block(statements))
+                return {};
+            return std::make_shared<Block>(std::move(statements));
+        }
+
+        return expressionStatement();
+    }
+
+    // Declarations up to the closing brace. Declarations that fail have
+    // already synchronized and are left out.
+    bool block(std::vector<StmtPtr> &statements)
+    {
+        while (!check(Token::Type::RIGHT_BRACE) && !isAtEnd()) {
+            if (auto stmt = declaration())
+                statements.push_back(std::move(stmt));
+        }
+
+        return consume(Token::Type::RIGHT_BRACE, "Expect '}' after block.");
+    }
+
+    // Desugared into a while loop, like the book.
+    StmtPtr forStatement()
+    {
+        const Token &keyword = previous();
+        if (!consume(Token::Type::LEFT_PAREN, "Expect '(' after 'for'."))
+            return {};
+
+        StmtPtr initializer;
+        if (match(Token::Type::VAR)) {
+            if (!(initializer = varDeclaration()))
+                return {};
+        } else if (!match(Token::Type::SEMICOLON)) {
+            if (!(initializer = expressionStatement()))
+                return {};
+        }
+
+        std::shared_ptr<Expr<R>> condition;
+        if (!check(Token::Type::SEMICOLON) && !(condition = expression()))
+            return {};
+        if (!consume(Token::Type::SEMICOLON,
+                     "Expect ';' after loop condition."))
+            return {};
+
+        std::shared_ptr<Expr<R>> increment;
+        if (!check(Token::Type::RIGHT_PAREN) && !(increment = expression()))
+            return {};
+        if (!consume(Token::Type::RIGHT_PAREN,
+                     "Expect ')' after for clauses."))
+            return {};
+
+        StmtPtr body = statement();
+        if (!body)
+            return {};
+
+        if (increment) {
+            body = std::make_shared<Block>(std::vector<StmtPtr>{
+                body, std::make_shared<Expression>(increment)});
+        }
+        if (!condition)
+            condition = nodes.literal(true);
+        body = std::make_shared<While>(keyword, condition, body);
+        if (initializer) {
+            body = std::make_shared<Block>(
+                std::vector<StmtPtr>{initializer, body});
+        }
+
+        return body;
+    }
+
+    StmtPtr ifStatement()
+    {
+        if (!consume(Token::Type::LEFT_PAREN, "Expect '(' after 'if'."))
+            return {};
+        auto condition = expression();
+        if (!condition || !consume(Token::Type::RIGHT_PAREN,
+                                   "Expect ')' after if condition."))
+            return {};
+
+        StmtPtr thenBranch = statement();
+        if (!thenBranch)
+            return {};
+        StmtPtr elseBranch;
+        if (match(Token::Type::ELSE) && !(elseBranch = statement()))
+            return {};
+
+        return std::make_shared<If>(condition, thenBranch, elseBranch);
+    }
+
+    StmtPtr printStatement()
+    {
+        auto value = expression();
+        if (!value ||
+            !consume(Token::Type::SEMICOLON, "Expect ';' after value."))
+            return {};
+        return std::make_shared<Print>(value);
+    }
+
+    StmtPtr returnStatement()
+    {
+        const Token &keyword = previous();
+
+        std::shared_ptr<Expr<R>> value;
+        if (!check(Token::Type::SEMICOLON) && !(value = expression()))
+            return {};
+        if (!consume(Token::Type::SEMICOLON,
+                     "Expect ';' after return value."))
+            return {};
+
+        return std::make_shared<Return>(keyword, value);
+    }
+
+    StmtPtr whileStatement()
+    {
+        const Token &keyword = previous();
+        if (!consume(Token::Type::LEFT_PAREN, "Expect '(' after 'while'."))
+            return {};
+        auto condition = expression();
+        if (!condition ||
+            !consume(Token::Type::RIGHT_PAREN, "Expect ')' after condition."))
+            return {};
+
+        StmtPtr body = statement();
+        if (!body)
+            return {};
+        return std::make_shared<While>(keyword, condition, body);
+    }
+
+    StmtPtr expressionStatement()
+    {
+        auto expr = expression();
+        if (!expr ||
+            !consume(Token::Type::SEMICOLON, "Expect ';' after expression."))
+            return {};
+        return std::make_shared<Expression>(expr);
     }
 
   public:
+    Parser() = default;
+    // Report errors into a sink shared with, i.e., the scanner.
+    explicit Parser(Diagnostics &diagnostics) : diagnostics(&diagnostics) {}
+
+    // Hash-cons the parsed trees so that repeated subexpressions, also across
+    // separate parse calls, become a single shared node. See ExprFactory.
+    void shareSubexpressions(bool enable) { nodes.setSharing(enable); }
+    const ExprFactory<R> &factory() const { return nodes; }
+
+    // Skip the bodies of function declarations until the functions are
+    // first called, see parseLazyBody(). Errors in a body are only reported
+    // then, so a body that is never called is never checked.
+    void setLazyFunctions(bool enable) { lazyFunctions = enable; }
+
+    const Diagnostics &errors() const { return *diagnostics; }
+    bool hadError() const { return diagnostics->hadError(); }
+
+    // Parses a single expression. Returns an empty pointer on error.
     std::shared_ptr<Expr<R>> parse(std::unique_ptr<std::vector<Token>> tokens)
     {
-        this->tokens = std::move(tokens);
+        GRAVLAX_STATS_PHASE(Parse);
+        GRAVLAX_TRACE_SCOPE("Parser::parse");
 
-        try {
-            return expression();
-        } catch (ParseError error) {
-            return {};
-        };
+        start(std::move(tokens));
+
+        return expression();
+    }
+
+    // Parses a sequence of ';' separated expressions, recovering from errors
+    // so that every malformed statement gets reported. Statements that fail
+    // to parse are left out of the result.
+    std::vector<std::shared_ptr<Expr<R>>>
+    parseProgram(std::unique_ptr<std::vector<Token>> tokens)
+    {
+        GRAVLAX_STATS_PHASE(Parse);
+        GRAVLAX_TRACE_SCOPE("Parser::parseProgram");
+
+        start(std::move(tokens));
+
+        std::vector<std::shared_ptr<Expr<R>>> program;
+
+        while (!isAtEnd()) {
+            auto expr = topLevelExpression();
+            if (expr) {
+                program.push_back(expr);
+            } else {
+                synchronize();
+            }
+        }
+
+        return program;
+    }
+
+    // Parses a program of declarations and statements with the grammar of
+    // the book. Declarations that fail to parse are reported and left out.
+    std::vector<std::shared_ptr<Stmt<R>>>
+    parseStatements(std::unique_ptr<std::vector<Token>> tokens)
+    {
+        GRAVLAX_STATS_PHASE(Parse);
+        GRAVLAX_TRACE_SCOPE("Parser::parseStatements");
+
+        start(std::move(tokens));
+
+        // The Resolver annotates variables in place, so statements never
+        // share nodes.
+        bool sharing = nodes.isSharing();
+        nodes.setSharing(false);
+
+        std::vector<std::shared_ptr<Stmt<R>>> program;
+        while (!isAtEnd()) {
+            if (auto stmt = declaration())
+                program.push_back(std::move(stmt));
+        }
+
+        nodes.setSharing(sharing);
+        return program;
+    }
+
+    // Parses the body that a lazy parse skipped. Its own functions are
+    // skipped again if lazy functions are enabled.
+    std::vector<std::shared_ptr<Stmt<R>>> parseLazyBody(const LazyBody &body)
+    {
+        GRAVLAX_STATS_PHASE(Parse);
+        GRAVLAX_TRACE_SCOPE("Parser::parseLazyBody");
+
+        start(body.tokens);
+        current = static_cast<int>(body.begin);
+        limit = body.end;
+
+        bool sharing = nodes.isSharing();
+        nodes.setSharing(false);
+
+        std::vector<std::shared_ptr<Stmt<R>>> statements;
+        while (!isAtEnd()) {
+            if (auto stmt = declaration())
+                statements.push_back(std::move(stmt));
+        }
+
+        nodes.setSharing(sharing);
+        return statements;
     }
 };
 
-}; // namespace gravlax
\ No newline at end of file
+}; // namespace gravlax
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include <gravlax/parser.h>
+#include <gravlax/scanner.h>
+#include <gravlax/statement.h>
+#include <gravlax/token.h>
+#include <gravlax/utils/generator.h>
+
+namespace gravlax
+{
+
+// The front end as a pipeline of coroutines: a reader yields chunks of a
+// file descriptor as they arrive, the scanner yields the tokens that each
+// chunk completes, and the parser yields top-level statements as soon as
+// their tokens are in. Statements at the top of a script are parsed while
+// the rest is still being read, which matters for pipes and stdin.
+
+constexpr std::size_t DefaultChunkSize = 64 << 10;
+
+// Yields what each read(2) returns, at most chunkSize bytes, until end of
+// file. A chunk is valid until the next one is asked for. Throws
+// std::system_error if reading fails.
+utils::Generator<std::string_view> readChunks(int fd,
+                                              std::size_t chunkSize =
+                                                  DefaultChunkSize);
+
+// Scans chunks in the streaming mode of the scanner, ending with
+// END_OF_FILE. Afterwards scanner.source() holds the whole input.
+utils::Generator<Token> scanChunks(Scanner &scanner,
+                                   utils::Generator<std::string_view> chunks);
+
+// Cuts the token stream into top-level statements and parses each of them
+// once it is complete. A statement ends with a ';' or '}' outside of any
+// parentheses and braces, unless an 'else' follows. Each statement gets its
+// own token vector, which its lazily parsed functions keep.
+template <typename R>
+utils::Generator<std::shared_ptr<Stmt<R>>>
+parseTokens(Parser<R> &parser, utils::Generator<Token> tokens)
+{
+    auto segment = std::make_unique<std::vector<Token>>();
+    int depth = 0;
+    // The segment ends with a statement if the next token is not 'else'.
+    bool ended = false;
+
+    for (Token &token : tokens) {
+        if (ended && token.type != Token::Type::ELSE) {
+            segment->push_back(
+                Token(Token::Type::END_OF_FILE, "", {}, token.offset));
+            for (auto &stmt : parser.parseStatements(std::move(segment)))
+                co_yield std::move(stmt);
+            segment = std::make_unique<std::vector<Token>>();
+            depth = 0;
+        }
+        ended = false;
+
+        switch (token.type) {
+        case Token::Type::LEFT_PAREN:
+        case Token::Type::LEFT_BRACE:
+            depth++;
+            break;
+        case Token::Type::RIGHT_PAREN:
+            depth--;
+            break;
+        case Token::Type::RIGHT_BRACE:
+            ended = --depth <= 0;
+            break;
+        case Token::Type::SEMICOLON:
+            ended = depth <= 0;
+            break;
+        default:
+            break;
+        }
+        segment->push_back(std::move(token));
+    }
+
+    // The scanner's END_OF_FILE closes the last segment.
+    if (!segment->empty()) {
+        for (auto &stmt : parser.parseStatements(std::move(segment)))
+            co_yield std::move(stmt);
+    }
+}
+
+// Reads, scans and parses fd to its end.
+template <typename R>
+std::vector<std::shared_ptr<Stmt<R>>>
+parseStream(int fd, Scanner &scanner, Parser<R> &parser,
+            std::size_t chunkSize = DefaultChunkSize)
+{
+    std::vector<std::shared_ptr<Stmt<R>>> program;
+    for (auto &stmt : parseTokens(
+             parser, scanChunks(scanner, readChunks(fd, chunkSize))))
+        program.push_back(std::move(stmt));
+    return program;
+}
+
+}; // namespace gravlax
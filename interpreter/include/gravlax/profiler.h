@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <gravlax/line_index.h>
+
+// Sampling of the Lox call stacks of running scripts. A timer on the CPU
+// time of the process raises SIGPROF, and its handler only sets a flag.
+// Executors poll the flag where they call functions and loop, and the one
+// that takes it records its stack into its Profile. While no timer runs, a
+// poll costs one relaxed atomic load.
+namespace gravlax::profiler
+{
+
+namespace detail
+{
+extern std::atomic<bool> pending;
+}; // namespace detail
+
+// Starts the timer with hz samples per second of CPU time. Throws
+// std::system_error.
+void start(int hz = 1000);
+void stop();
+
+// Whether a sample is due. Cheap enough for every call and loop iteration.
+inline bool due()
+{
+    return detail::pending.load(std::memory_order_relaxed);
+}
+
+// Claims the due sample, which only one thread gets.
+inline bool take()
+{
+    return detail::pending.exchange(false, std::memory_order_relaxed);
+}
+
+// A function of a sampled stack, and the offset in the source where it was:
+// the call to the next frame, or the safe point of the innermost one.
+struct Frame {
+    std::string function;
+    int offset;
+
+    auto operator<=>(const Frame &) const = default;
+};
+
+// The samples of one executor, counted by stack.
+class Profile
+{
+    std::map<std::vector<Frame>, std::uint64_t> stacks;
+    std::uint64_t samples = 0;
+
+  public:
+    // The outermost frame first.
+    void record(std::vector<Frame> stack);
+    std::uint64_t sampleCount() const { return samples; }
+    void clear();
+
+    // One "function:line;function:line count" line per stack, the format of
+    // flamegraph.pl and speedscope.
+    void writeCollapsed(std::ostream &out, const LineIndex &lines) const;
+
+    // The functions with the most samples, on top of the stack and on it at
+    // all, and the lines with the most samples on top.
+    std::string formatHotSpots(const LineIndex &lines,
+                               std::size_t limit = 10) const;
+};
+
+}; // namespace gravlax::profiler
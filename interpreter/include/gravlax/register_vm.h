@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <gravlax/expression.h>
+#include <gravlax/interpreter.h>
+#include <gravlax/token.h>
+
+namespace gravlax
+{
+
+// An expression compiled to three-address instructions over a register
+// file, to evaluate many times. The first registers of a frame hold the
+// inputs, the variables of the expression, and the rest hold temporaries,
+// which are reused once their value has been read. Number literals are
+// operands of the instructions that use them, so that a node of the tree
+// costs at most one dispatch and a literal none. Evaluation follows the
+// Interpreter, errors included.
+class RegisterProgram
+{
+  public:
+    // Binary operators come in threes: both operands in registers, the
+    // right one a constant, and the left one a constant.
+    enum class Op : std::uint8_t {
+        Move,
+        LoadNumber,
+        LoadConstant,
+        Negate,
+        Not,
+        Add,
+        AddK,
+        KAdd,
+        Subtract,
+        SubtractK,
+        KSubtract,
+        Multiply,
+        MultiplyK,
+        KMultiply,
+        Divide,
+        DivideK,
+        KDivide,
+        Greater,
+        GreaterK,
+        KGreater,
+        GreaterEqual,
+        GreaterEqualK,
+        KGreaterEqual,
+        Less,
+        LessK,
+        KLess,
+        LessEqual,
+        LessEqualK,
+        KLessEqual,
+        Equal,
+        EqualK,
+        KEqual,
+        NotEqual,
+        NotEqualK,
+        KNotEqual,
+        // To the instruction in b if register a is falsey, or truthy.
+        JumpIfFalse,
+        JumpIfTrue,
+    };
+
+    // a and b are registers, an index into the constant pool for
+    // LoadConstant, or a jump target. k is the number operand.
+    struct Instruction {
+        Op op;
+        std::uint16_t dst;
+        std::uint16_t a;
+        std::uint16_t b;
+        double k;
+    };
+
+    // Returns an empty pointer and sets error if the expression assigns or
+    // calls, or needs more registers than an instruction can name.
+    static std::unique_ptr<RegisterProgram> compile(Expr<Value> &expr,
+                                                    std::string &error);
+
+    // Names of the inputs, in the order evaluate() expects them.
+    const std::vector<std::string> &inputs() const { return inputNames; }
+    std::size_t registerCount() const { return registers; }
+    const std::vector<Instruction> &instructions() const { return code; }
+
+    // frame is the register file, kept by the caller so that evaluating
+    // does not allocate. Throws RuntimeError, and "Undefined variable" for
+    // inputs that are not given.
+    Value evaluate(std::span<const Value> inputs,
+                   std::vector<Value> &frame) const;
+    Value evaluate(std::span<const Value> inputs) const
+    {
+        std::vector<Value> frame;
+        return evaluate(inputs, frame);
+    }
+
+  private:
+    friend class RegisterCompiler;
+
+    std::vector<Instruction> code;
+    // The operator of each instruction, for its runtime errors.
+    std::vector<Token> sites;
+    std::vector<Value> constants;
+    std::vector<std::string> inputNames;
+    std::vector<Token> inputTokens;
+    std::size_t registers = 0;
+    std::uint16_t result = 0;
+
+    RegisterProgram() = default;
+
+    [[noreturn]] void fail(std::size_t pc, const char *error) const;
+};
+
+}; // namespace gravlax
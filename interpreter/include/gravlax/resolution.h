@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gravlax/token.h>
+
+namespace gravlax
+{
+
+// Where a variable lives, as worked out by the Resolver.
+//
+// A local is a slot in the frame of the function that declares it. depth
+// counts the functions between the use and the declaration: at depth 0 the
+// variable is read from the current frame, otherwise the current function
+// has captured it and reaches it through one of its upvalues. Globals are
+// dense indices into the global table, see Globals.
+struct Resolution {
+    enum class Kind : std::uint8_t { Unresolved, Local, Upvalue, Global };
+
+    Kind kind = Kind::Unresolved;
+    std::uint16_t depth = 0;
+    // The frame slot of a local, the upvalue index of a captured variable
+    // or the index of a global.
+    std::uint32_t index = 0;
+
+    bool operator==(const Resolution &) const = default;
+};
+
+// How a closure captures one variable when it is created: a slot of the
+// enclosing frame, or one of the enclosing closure's own upvalues.
+struct UpvalueDescriptor {
+    bool isLocal;
+    std::uint32_t index;
+
+    bool operator==(const UpvalueDescriptor &) const = default;
+};
+
+struct FunctionInfo {
+    // The name of a captured variable and the number of functions between
+    // it and the capturing function.
+    struct Capture {
+        std::string name;
+        std::uint16_t depth;
+    };
+
+    // Frame size. Parameters take the first slots, locals of blocks that
+    // are not open at the same time share slots.
+    std::uint32_t slotCount = 0;
+    // Only the variables the function or its inner functions actually use.
+    std::vector<UpvalueDescriptor> upvalues;
+    // By upvalue index. A body that is resolved after its enclosing
+    // functions, see LazyBody, finds its captured variables here by name.
+    std::vector<Capture> captures;
+};
+
+struct BlockInfo {
+    // The first slot of the locals declared in the block.
+    std::uint32_t firstSlot = 0;
+    // Whether a closure captures one of them, in which case the captured
+    // values have to be moved off the frame when the block exits.
+    bool captures = false;
+};
+
+// The body of a function that the parser skipped, see
+// Parser::setLazyFunctions(). It is parsed and resolved when the function is
+// first called, see Resolver::resolveLazy(). Before that the Resolver
+// captures every variable of the enclosing functions whose name appears in
+// the body.
+struct LazyBody {
+    // The tokens of the whole program, null unless the body is still
+    // waiting to be parsed.
+    std::shared_ptr<const std::vector<Token>> tokens;
+    // The body's tokens, from after '{' up to the matching '}'.
+    std::uint32_t begin = 0;
+    std::uint32_t end = 0;
+
+    // Byte offsets of the body's first token and of its '}' in the script.
+    // Set for every function, so that a snapshot can bring it back as a
+    // lazy function.
+    std::uint32_t sourceBegin = 0;
+    std::uint32_t sourceEnd = 0;
+    // Instead of tokens, the script that a function restored from a
+    // snapshot has to scan its body from. It outlives the function.
+    std::string_view source;
+
+    bool isPending() const { return tokens || !source.empty(); }
+};
+
+// The operation a Binary was rewritten into by the Executor after it saw
+// the types of its operands, see Executor::setQuickening(). Executors on
+// different threads may run the same node, so the operation is an atomic
+// that any of them may rewrite. Every operation computes the right result,
+// one that does not fit the operands only costs time.
+struct Quickening {
+    enum class Op : std::uint8_t {
+        // Not run yet.
+        Unobserved,
+        // Checks the operand types on every evaluation.
+        Generic,
+        AddNumbers,
+        SubtractNumbers,
+        MultiplyNumbers,
+        DivideNumbers,
+        GreaterNumbers,
+        GreaterEqualNumbers,
+        LessNumbers,
+        LessEqualNumbers,
+        EqualNumbers,
+        NotEqualNumbers,
+        ConcatStrings,
+    };
+
+    Quickening() = default;
+    Quickening(const Quickening &other) : op(other.load()) {}
+    Quickening &operator=(const Quickening &other)
+    {
+        store(other.load());
+        return *this;
+    }
+
+    Op load() const { return op.load(std::memory_order_relaxed); }
+    void store(Op op) { this->op.store(op, std::memory_order_relaxed); }
+
+    // Whether the operation takes two numbers.
+    bool onNumbers() const
+    {
+        Op op = load();
+        return op >= Op::AddNumbers && op <= Op::NotEqualNumbers;
+    }
+
+  private:
+    std::atomic<Op> op{Op::Unobserved};
+};
+
+}; // namespace gravlax
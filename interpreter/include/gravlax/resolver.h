@@ -0,0 +1,452 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include <gravlax/diagnostics.h>
+#include <gravlax/expression.h>
+#include <gravlax/resolution.h>
+#include <gravlax/statement.h>
+#include <gravlax/stats.h>
+#include <gravlax/token.h>
+#include <gravlax/trace.h>
+
+#include <gravlax/generated/assign.h>
+#include <gravlax/generated/binary.h>
+#include <gravlax/generated/call.h>
+#include <gravlax/generated/grouping.h>
+#include <gravlax/generated/literal.h>
+#include <gravlax/generated/logical.h>
+#include <gravlax/generated/unary.h>
+#include <gravlax/generated/variable.h>
+
+#include <gravlax/generated/stmt_block.h>
+#include <gravlax/generated/stmt_expression.h>
+#include <gravlax/generated/stmt_function.h>
+#include <gravlax/generated/stmt_if.h>
+#include <gravlax/generated/stmt_print.h>
+#include <gravlax/generated/stmt_return.h>
+#include <gravlax/generated/stmt_var.h>
+#include <gravlax/generated/stmt_while.h>
+
+namespace gravlax
+{
+
+// The names of the globals that programs refer to, each with a dense index.
+// The table only grows, so indices stay valid for every program resolved
+// against it, i.e. the lines of a REPL.
+class Globals
+{
+    std::unordered_map<std::string, std::uint32_t> indices;
+    std::vector<std::string> names;
+
+  public:
+    // Adds the name if it is new.
+    std::uint32_t indexOf(const std::string &name);
+    // Returns -1 if no program has used the name.
+    int find(const std::string &name) const;
+
+    const std::string &name(std::uint32_t index) const { return names[index]; }
+    std::size_t size() const { return names.size(); }
+};
+
+// Works out where every variable lives before anything runs, so that the
+// executor reads and writes variables by index instead of looking names up
+// in a chain of environments.
+//
+// Locals get a slot in the frame of their function. Slots are handed out in
+// declaration order and given back when a block ends, so sibling blocks share
+// them. A function that uses a local of an enclosing function captures it
+// through an upvalue, and only the variables that are used get one. All
+// other names are globals. The results are stored in the Resolution,
+// FunctionInfo and BlockInfo annotations of the tree, so the tree must not
+// share nodes, see Parser::parseStatements().
+//
+// Errors are reported like parse errors and do not stop the pass.
+template <typename R> class Resolver
+{
+    using Assign = gravlax::generated::Assign<R>;
+    using Binary = gravlax::generated::Binary<R>;
+    using Call = gravlax::generated::Call<R>;
+    using Grouping = gravlax::generated::Grouping<R>;
+    using Logical = gravlax::generated::Logical<R>;
+    using Unary = gravlax::generated::Unary<R>;
+    using Variable = gravlax::generated::Variable<R>;
+
+    using Block = gravlax::generated::Block<R>;
+    using Expression = gravlax::generated::Expression<R>;
+    using Function = gravlax::generated::Function<R>;
+    using If = gravlax::generated::If<R>;
+    using Print = gravlax::generated::Print<R>;
+    using Return = gravlax::generated::Return<R>;
+    using Var = gravlax::generated::Var<R>;
+    using While = gravlax::generated::While<R>;
+
+    struct Local {
+        std::string_view name;
+        int depth;
+        bool defined;
+        bool captured;
+    };
+
+    // The function being resolved. The locals that are in scope are kept
+    // in slot order, so a local's slot is its index.
+    struct FunctionState {
+        FunctionState *enclosing;
+        FunctionInfo *info;
+        std::vector<Local> locals{};
+        int scopeDepth = 0;
+        // Set for a lazily parsed function resolved on its own, which finds
+        // its enclosing variables in info->captures.
+        bool detached = false;
+    };
+
+    Globals &globals;
+    Diagnostics &diagnostics;
+    FunctionState *current = nullptr;
+
+    void error(const Token &token, std::string message)
+    {
+        diagnostics.error(token.offset, fmt::format(" at '{}'", token.lexeme),
+                          std::move(message));
+    }
+
+    void beginScope() { current->scopeDepth++; }
+
+    // Returns whether a closure captured one of the block's locals.
+    bool endScope()
+    {
+        bool captures = false;
+        auto &locals = current->locals;
+        while (!locals.empty() && locals.back().depth == current->scopeDepth) {
+            captures |= locals.back().captured;
+            locals.pop_back();
+        }
+        current->scopeDepth--;
+        return captures;
+    }
+
+    void declare(const Token &name, Resolution &resolution)
+    {
+        if (current->scopeDepth == 0) {
+            resolution = {Resolution::Kind::Global, 0,
+                          globals.indexOf(name.lexeme)};
+            return;
+        }
+
+        auto &locals = current->locals;
+        for (auto it = locals.rbegin(); it != locals.rend(); ++it) {
+            if (it->depth < current->scopeDepth)
+                break;
+            if (it->name == name.lexeme)
+                error(name, "Already a variable with this name in this scope.");
+        }
+
+        auto slot = static_cast<std::uint32_t>(locals.size());
+        locals.push_back({name.lexeme, current->scopeDepth, false, false});
+        current->info->slotCount =
+            std::max(current->info->slotCount, slot + 1);
+        resolution = {Resolution::Kind::Local, 0, slot};
+    }
+
+    void define()
+    {
+        if (current->scopeDepth > 0)
+            current->locals.back().defined = true;
+    }
+
+    static int findLocal(const FunctionState &state, std::string_view name)
+    {
+        for (int i = static_cast<int>(state.locals.size()) - 1; i >= 0; i--) {
+            if (state.locals[i].name == name)
+                return i;
+        }
+        return -1;
+    }
+
+    static std::uint32_t addUpvalue(FunctionState &state, std::string_view name,
+                                    std::uint16_t depth,
+                                    UpvalueDescriptor upvalue)
+    {
+        auto &upvalues = state.info->upvalues;
+        auto it = std::find(upvalues.begin(), upvalues.end(), upvalue);
+        if (it != upvalues.end())
+            return static_cast<std::uint32_t>(it - upvalues.begin());
+
+        upvalues.push_back(upvalue);
+        state.info->captures.push_back({std::string(name), depth});
+        return static_cast<std::uint32_t>(upvalues.size() - 1);
+    }
+
+    // Captures the variable in state and every function between it and the
+    // function that declares the variable. Returns the upvalue index in
+    // state, or -1 for a global. depth is set to the number of functions
+    // crossed.
+    int resolveUpvalue(FunctionState &state, std::string_view name,
+                       std::uint16_t &depth)
+    {
+        if (!state.enclosing)
+            return state.detached ? findCapture(*state.info, name, depth)
+                                  : -1;
+
+        int local = findLocal(*state.enclosing, name);
+        if (local >= 0) {
+            state.enclosing->locals[local].captured = true;
+            depth = 1;
+            return addUpvalue(state, name, depth,
+                              {true, static_cast<std::uint32_t>(local)});
+        }
+
+        int upvalue = resolveUpvalue(*state.enclosing, name, depth);
+        if (upvalue < 0)
+            return -1;
+        depth++;
+        return addUpvalue(state, name, depth,
+                          {false, static_cast<std::uint32_t>(upvalue)});
+    }
+
+    static int findCapture(const FunctionInfo &info, std::string_view name,
+                           std::uint16_t &depth)
+    {
+        for (std::size_t i = 0; i < info.captures.size(); i++) {
+            if (info.captures[i].name == name) {
+                depth = info.captures[i].depth;
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    void resolveName(const Token &name, Resolution &resolution)
+    {
+        int slot = findLocal(*current, name.lexeme);
+        if (slot >= 0) {
+            resolution = {Resolution::Kind::Local, 0,
+                          static_cast<std::uint32_t>(slot)};
+            return;
+        }
+
+        std::uint16_t depth = 0;
+        int upvalue = resolveUpvalue(*current, name.lexeme, depth);
+        if (upvalue >= 0) {
+            resolution = {Resolution::Kind::Upvalue, depth,
+                          static_cast<std::uint32_t>(upvalue)};
+            return;
+        }
+
+        resolution = {Resolution::Kind::Global, 0,
+                      globals.indexOf(name.lexeme)};
+    }
+
+    // Captures every enclosing variable that the skipped body mentions,
+    // which is all that it or its inner functions can use. Capturing more
+    // than the body turns out to need only costs an upvalue.
+    void captureLazy(Function &function)
+    {
+        FunctionState state{current, &function.info};
+        auto &tokens = *function.lazy.tokens;
+
+        for (std::uint32_t i = function.lazy.begin; i < function.lazy.end;
+             i++) {
+            const Token &token = tokens[i];
+            if (token.type != Token::Type::IDENTIFIER)
+                continue;
+            auto &params = function.params;
+            if (std::any_of(params.begin(), params.end(), [&](auto &param) {
+                    return param.lexeme == token.lexeme;
+                }))
+                continue;
+
+            std::uint16_t depth = 0;
+            resolveUpvalue(state, token.lexeme, depth);
+        }
+    }
+
+    void resolveFunction(Function &function)
+    {
+        if (function.lazy.isPending()) {
+            captureLazy(function);
+            return;
+        }
+
+        FunctionState state{current, &function.info};
+        current = &state;
+        beginScope();
+
+        Resolution parameter;
+        for (auto &param : function.params) {
+            declare(param, parameter);
+            define();
+        }
+        for (auto &stmt : function.body)
+            resolve(*stmt);
+
+        current = state.enclosing;
+    }
+
+    void resolve(Stmt<R> &stmt)
+    {
+        switch (stmt.kind()) {
+        case StmtKind::Block: {
+            auto &node = static_cast<Block &>(stmt);
+            beginScope();
+            node.info.firstSlot =
+                static_cast<std::uint32_t>(current->locals.size());
+            for (auto &statement : node.statements)
+                resolve(*statement);
+            node.info.captures = endScope();
+            break;
+        }
+        case StmtKind::Expression:
+            resolve(*static_cast<Expression &>(stmt).expression);
+            break;
+        case StmtKind::Function: {
+            // Declared before the body so that the function can call itself.
+            auto &node = static_cast<Function &>(stmt);
+            declare(node.name, node.resolution);
+            define();
+            resolveFunction(node);
+            break;
+        }
+        case StmtKind::If: {
+            auto &node = static_cast<If &>(stmt);
+            resolve(*node.condition);
+            resolve(*node.thenBranch);
+            if (node.elseBranch)
+                resolve(*node.elseBranch);
+            break;
+        }
+        case StmtKind::Print:
+            resolve(*static_cast<Print &>(stmt).expression);
+            break;
+        case StmtKind::Return: {
+            auto &node = static_cast<Return &>(stmt);
+            if (!current->enclosing && !current->detached)
+                error(node.keyword, "Can't return from top-level code.");
+            if (node.value)
+                resolve(*node.value);
+            break;
+        }
+        case StmtKind::Var: {
+            auto &node = static_cast<Var &>(stmt);
+            declare(node.name, node.resolution);
+            if (node.initializer)
+                resolve(*node.initializer);
+            define();
+            break;
+        }
+        case StmtKind::While: {
+            auto &node = static_cast<While &>(stmt);
+            resolve(*node.condition);
+            resolve(*node.body);
+            break;
+        }
+        }
+    }
+
+    void resolve(Expr<R> &expr)
+    {
+        switch (expr.kind()) {
+        case ExprKind::Assign: {
+            auto &node = static_cast<Assign &>(expr);
+            resolve(*node.value);
+            resolveName(node.name, node.resolution);
+            break;
+        }
+        case ExprKind::Binary: {
+            auto &node = static_cast<Binary &>(expr);
+            resolve(*node.left);
+            resolve(*node.right);
+            break;
+        }
+        case ExprKind::Call: {
+            auto &node = static_cast<Call &>(expr);
+            resolve(*node.callee);
+            for (auto &argument : node.arguments)
+                resolve(*argument);
+            break;
+        }
+        case ExprKind::Grouping:
+            resolve(*static_cast<Grouping &>(expr).expression);
+            break;
+        case ExprKind::Literal:
+            break;
+        case ExprKind::Logical: {
+            auto &node = static_cast<Logical &>(expr);
+            resolve(*node.left);
+            resolve(*node.right);
+            break;
+        }
+        case ExprKind::Unary:
+            resolve(*static_cast<Unary &>(expr).right);
+            break;
+        case ExprKind::Variable: {
+            auto &node = static_cast<Variable &>(expr);
+            int slot = findLocal(*current, node.name.lexeme);
+            if (slot >= 0 && !current->locals[slot].defined) {
+                error(node.name,
+                      "Can't read local variable in its own initializer.");
+            }
+            resolveName(node.name, node.resolution);
+            break;
+        }
+        }
+    }
+
+  public:
+    Resolver(Globals &globals, Diagnostics &diagnostics)
+        : globals(globals), diagnostics(diagnostics)
+    {
+    }
+
+    // Annotates the program and returns the frame layout of its top level.
+    // The top level declares globals, its blocks declare locals.
+    FunctionInfo resolve(const std::vector<std::shared_ptr<Stmt<R>>> &program)
+    {
+        GRAVLAX_STATS_PHASE(Resolve);
+        GRAVLAX_TRACE_SCOPE("Resolver::resolve");
+
+        FunctionInfo script;
+        FunctionState state{nullptr, &script};
+        current = &state;
+
+        for (auto &stmt : program)
+            resolve(*stmt);
+
+        current = nullptr;
+        return script;
+    }
+
+    // Resolves the body of a lazily parsed function once
+    // Parser::parseLazyBody() has filled it in. The function's upvalues
+    // were fixed when its declaration was resolved and stay as they are.
+    void resolveLazy(Function &function)
+    {
+        GRAVLAX_STATS_PHASE(Resolve);
+        GRAVLAX_TRACE_SCOPE("Resolver::resolveLazy");
+
+        FunctionState state{nullptr, &function.info};
+        state.detached = true;
+        current = &state;
+        beginScope();
+
+        Resolution parameter;
+        for (auto &param : function.params) {
+            declare(param, parameter);
+            define();
+        }
+        for (auto &stmt : function.body)
+            resolve(*stmt);
+
+        current = nullptr;
+    }
+};
+
+}; // namespace gravlax
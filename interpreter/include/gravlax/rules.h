@@ -0,0 +1,98 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gravlax/diagnostics.h>
+#include <gravlax/interpreter.h>
+#include <gravlax/parser.h>
+#include <gravlax/scanner.h>
+
+namespace gravlax
+{
+
+struct RuleResult {
+    Value value;
+    // Runtime or parse error message, nullptr if the rule evaluated fine.
+    const char *error = nullptr;
+};
+
+// Many small expressions merged into one program. Literals are kept in a
+// single constant pool, variables are read from one dense input array and
+// every distinct subexpression is one instruction, so a subexpression used
+// by many rules is computed once per evaluation.
+class RuleProgram
+{
+  public:
+    // None is the missing right operand of a unary operator, Invalid the
+    // result of a rule that failed to parse.
+    enum class Source : std::uint8_t { Constant, Input, Slot, None, Invalid };
+
+    struct Operand {
+        Source source;
+        int index;
+    };
+
+    // and and or evaluate both operands, which are pure, and pick one.
+    struct Instruction {
+        Token::Type oper;
+        Operand a;
+        // Source::None for unary operators.
+        Operand b;
+    };
+
+    // Names of the inputs, in the order evaluate() expects them.
+    const std::vector<std::string> &inputs() const { return inputNames; }
+    // Index of the named input, or -1 if no rule reads it.
+    int inputIndex(const std::string &name) const;
+
+    std::size_t ruleCount() const { return rules.size(); }
+    const std::vector<Value> &constantPool() const { return constants; }
+    const std::vector<Instruction> &instructions() const { return code; }
+
+    // Evaluates every rule. Results are in the order the rules were added.
+    void evaluate(std::span<const Value> inputs,
+                  std::vector<RuleResult> &results) const;
+
+  private:
+    friend class RuleCompiler;
+
+    std::vector<Value> constants;
+    std::vector<std::string> inputNames;
+    std::vector<Instruction> code;
+    std::vector<Operand> rules;
+};
+
+// Parses rules with one scanner and one hash-consing parser, so the keyword
+// table, the parser state and the node table are shared by all of them.
+class RuleCompiler
+{
+    Diagnostics diagnostics;
+    Scanner scanner;
+    Parser<Value> parser;
+
+    std::vector<std::shared_ptr<Expr<Value>>> roots;
+    std::vector<std::string> errorMessages;
+
+    // Reports the assignments and calls in expr, which rules cannot have.
+    void checkPure(Expr<Value> &expr);
+
+  public:
+    RuleCompiler();
+
+    // Returns the index of the rule. A rule that fails to parse, or that
+    // assigns or calls, keeps its index and always evaluates to an error.
+    std::size_t add(const std::string &source);
+
+    // Parse errors, prefixed with the index of the rule.
+    const std::vector<std::string> &errors() const { return errorMessages; }
+
+    RuleProgram compile() const;
+
+    static RuleProgram compile(const std::vector<std::string> &sources,
+                               std::vector<std::string> &errors);
+};
+
+}; // namespace gravlax
@@ -0,0 +1,331 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gravlax/runtime/object.h>
+#include <gravlax/runtime/shape.h>
+#include <gravlax/runtime/table.h>
+#include <gravlax/runtime/value.h>
+
+namespace gravlax::runtime
+{
+
+struct HeapOptions {
+    // New objects are bump allocated in the nursery. A minor collection
+    // runs when it is full.
+    std::size_t nurseryBytes = 1 << 20;
+    // Survivors are copied into blocks of this many bytes, a power of two
+    // from 16 KiB to 512 KiB. Objects larger than a quarter block get a
+    // block of their own and are never moved.
+    std::size_t blockBytes = 1 << 18;
+    // A major collection runs once the old generation has grown past this,
+    // or past twice what survived the last major collection.
+    std::size_t majorThreshold = 16 << 20;
+};
+
+// Collection pauses in power-of-two buckets: bucket i counts the pauses of
+// less than 2^i microseconds.
+struct PauseHistogram {
+    static constexpr int BucketCount = 24;
+
+    std::array<std::uint64_t, BucketCount> buckets{};
+    std::uint64_t count = 0;
+    std::uint64_t totalNanos = 0;
+    std::uint64_t maxNanos = 0;
+
+    void record(std::uint64_t nanos);
+    // Upper bound of the bucket that holds the given fraction of pauses.
+    std::uint64_t percentileMicros(double fraction) const;
+    std::string format() const;
+};
+
+struct HeapStats {
+    std::uint64_t objectsAllocated = 0;
+    std::uint64_t bytesAllocated = 0;
+    std::uint64_t bytesPromoted = 0;
+    std::uint64_t minorCollections = 0;
+    std::uint64_t majorCollections = 0;
+    PauseHistogram minorPauses;
+    PauseHistogram majorPauses;
+};
+
+// Thrown by an allocation over the limit, see Heap::setAllocationLimit().
+class HeapLimitError : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+// Visits the slots that hold object references, see RootSource.
+class Tracer
+{
+  public:
+    virtual void visit(Obj *&object) = 0;
+
+    void visit(Value &value)
+    {
+        if (value.isObject())
+            visit(value.objectSlot());
+    }
+
+  protected:
+    ~Tracer() = default;
+};
+
+// Something that holds references into the heap outside of heap objects,
+// i.e. an interpreter's stack or its globals.
+class RootSource
+{
+  public:
+    virtual void traceRoots(Tracer &tracer) = 0;
+
+  protected:
+    ~RootSource() = default;
+};
+
+// A generational heap for the objects of one thread.
+//
+// Objects are bump allocated in a nursery. A minor collection copies the
+// ones that are still reachable into the old generation and empties the
+// nursery. Reachable means reachable from the roots (root sources, root
+// vectors and Rooted handles) or from an old object that was written to
+// since the last collection. Writes of references into old objects have to
+// go through writeBarrier(), which marks the card of the written slot, so
+// that a minor collection only scans the dirty cards of the old generation.
+//
+// A major collection copies all reachable objects into fresh blocks, which
+// also compacts the old generation. Large objects are marked and swept in
+// place instead.
+//
+// Images of objects that were laid out ahead of time, see Snapshot, are
+// added as a whole. They belong to the old generation but are never moved
+// or freed, and every major collection traces all of them.
+//
+// Anything that allocates may collect and move objects. C++ code that holds
+// object pointers across an allocation must keep them in a Rooted handle.
+class Heap
+{
+    struct Block;
+
+    HeapOptions options;
+
+    char *nursery = nullptr;
+    char *nurseryTop = nullptr;
+    char *nurseryEnd = nullptr;
+
+    std::vector<Block *> blocks;
+    Block *currentBlock = nullptr;
+    std::vector<Obj *> largeObjects;
+    // Large and image objects that were written a young reference.
+    std::vector<Obj *> rememberedLarge;
+    std::size_t oldBytes = 0;
+    std::size_t largeBytes = 0;
+    std::size_t nextMajor = 0;
+    std::uint32_t epoch = 0;
+    bool major = false;
+
+    struct Image {
+        char *begin;
+        char *end;
+    };
+    std::vector<Image> images;
+
+    std::vector<RootSource *> rootSources;
+    std::vector<std::vector<Value> *> rootVectors;
+    std::vector<Obj **> rootedPointers;
+    std::vector<Value *> rootedValues;
+
+    std::vector<Obj *> gray;
+    HeapStats counters;
+    std::uint64_t allocationLimit = 0;
+
+    // Weak, see sweepInterned().
+    Table interned;
+
+    void checkLimit(std::size_t size);
+    Obj *allocateSlow(ObjType type, std::size_t size);
+    Obj *allocateLarge(ObjType type, std::size_t size);
+    char *allocateOld(std::size_t size);
+    Block *newBlock();
+    Block *blockOf(const void *p) const;
+    void rememberSlow(Obj *holder, const void *slot);
+
+    void forward(Obj *&object);
+    void traceRoots();
+    void traceImages();
+    void scanDirtyCards();
+    void drain();
+    void collectMinor();
+    void collectMajor();
+    void sweepInterned();
+
+    friend class HeapTracer;
+
+  public:
+    explicit Heap(HeapOptions options = {});
+    ~Heap();
+
+    Heap(const Heap &) = delete;
+    Heap &operator=(const Heap &) = delete;
+
+    // Returns uninitialized memory for an object of size bytes, with only
+    // the header set up. May collect.
+    Obj *allocate(ObjType type, std::size_t size)
+    {
+        size = (size + 7) & ~std::size_t(7);
+        if (static_cast<std::size_t>(nurseryEnd - nurseryTop) < size ||
+            size > options.blockBytes / 4)
+            return allocateSlow(type, size);
+
+        auto object = reinterpret_cast<Obj *>(nurseryTop);
+        nurseryTop += size;
+        *object = {type, 0, 0, static_cast<std::uint32_t>(size)};
+        counters.objectsAllocated++;
+        counters.bytesAllocated += size;
+        return object;
+    }
+
+    // Concatenations shorter than this are copied right away instead of
+    // making a rope.
+    static constexpr std::uint32_t MinRopeLength = 64;
+
+    // The characters must not point into another heap string, which a
+    // collection could move. Use concat() to combine heap strings.
+    ObjString *string(std::string_view chars);
+    // A flat string or a rope with the characters of a followed by those of
+    // b, which may each be either.
+    Obj *concat(Obj *a, Obj *b);
+    // The characters of a flat string or rope as a flat string. Flattening a
+    // rope copies its characters once, later calls return the same string.
+    ObjString *flatten(Obj *s);
+    // The one string with these characters, made the first time. Interned
+    // strings are equal only if they are the same object, and are dropped
+    // from the intern set once nothing else refers to them.
+    ObjString *intern(std::string_view chars);
+    // An instance with all fields nil.
+    ObjInstance *instance(std::uint32_t fieldCount);
+    // An instance of the class, without properties.
+    ObjInstance *instance(ObjClass *klass);
+    ObjClass *klass(ObjString *name, ShapeTree &shapes);
+    // Slots with all values nil.
+    ObjSlots *slots(std::uint32_t capacity);
+    ObjFunction *function(ObjString *name, const void *code,
+                          std::uint32_t arity, std::uint32_t upvalueCount);
+    // A closure of the function whose upvalues are all still null.
+    ObjClosure *closure(ObjFunction *function);
+    // An open upvalue for the stack slot.
+    ObjUpvalue *upvalue(std::uint32_t slot);
+    ObjNative *native(ObjString *name, NativeFn function,
+                      std::uint32_t arity);
+
+    bool isYoung(const void *p) const
+    {
+        return static_cast<std::size_t>(static_cast<const char *>(p) -
+                                        nursery) <
+               static_cast<std::size_t>(nurseryEnd - nursery);
+    }
+
+    // Call after storing value into a slot of holder.
+    void writeBarrier(Obj *holder, const void *slot, Value value)
+    {
+        if (value.isObject() && isYoung(value.asObject()) && !isYoung(holder))
+            rememberSlow(holder, slot);
+    }
+
+    void setField(ObjInstance *instance, std::uint32_t index, Value value)
+    {
+        instance->fields()[index] = value;
+        writeBarrier(instance, &instance->fields()[index], value);
+    }
+
+    // Adopts the objects laid out back to back in [begin, end), which must
+    // stay mapped and writable for the life of the heap. Their references
+    // must all point into the image. Interned strings of the image replace
+    // any interned strings of the heap with the same contents.
+    void addImage(char *begin, char *end);
+
+    void addRoots(RootSource *source);
+    void removeRoots(RootSource *source);
+    // The vector may grow and shrink while registered.
+    void addRoots(std::vector<Value> *values);
+    void removeRoots(std::vector<Value> *values);
+
+    void pushRoot(Obj **object) { rootedPointers.push_back(object); }
+    void popRoot() { rootedPointers.pop_back(); }
+    void pushRoot(Value *value) { rootedValues.push_back(value); }
+    void popValueRoot() { rootedValues.pop_back(); }
+
+    // Runs a minor collection, or a major one if full is set.
+    void collect(bool full = false);
+
+    // Allocations throw HeapLimitError once the heap would have allocated
+    // more than bytes in all, see HeapStats::bytesAllocated. Only checked
+    // when the nursery is full and for large objects, so that the limit may
+    // be overshot by up to a nursery. 0 means no limit.
+    void setAllocationLimit(std::uint64_t bytes) { allocationLimit = bytes; }
+
+    const HeapStats &stats() const { return counters; }
+    std::size_t nurseryUsed() const { return nurseryTop - nursery; }
+    std::size_t internedCount() const { return interned.size(); }
+    // Bytes held by the old generation, large objects included.
+    std::size_t oldGenerationBytes() const { return oldBytes + largeBytes; }
+};
+
+// Keeps an object pointer up to date across collections for as long as it
+// is in scope. Handles must be destroyed in reverse order of creation.
+template <typename T> class Rooted
+{
+    Heap &heap;
+    T *object;
+
+  public:
+    Rooted(Heap &heap, T *object) : heap(heap), object(object)
+    {
+        heap.pushRoot(reinterpret_cast<Obj **>(&this->object));
+    }
+    ~Rooted() { heap.popRoot(); }
+
+    Rooted(const Rooted &) = delete;
+    Rooted &operator=(const Rooted &) = delete;
+
+    T *get() const { return object; }
+    operator T *() const { return object; }
+    T *operator->() const { return object; }
+    Rooted &operator=(T *other)
+    {
+        object = other;
+        return *this;
+    }
+};
+
+class RootedValue
+{
+    Heap &heap;
+    Value value;
+
+  public:
+    RootedValue(Heap &heap, Value value) : heap(heap), value(value)
+    {
+        heap.pushRoot(&this->value);
+    }
+    ~RootedValue() { heap.popValueRoot(); }
+
+    RootedValue(const RootedValue &) = delete;
+    RootedValue &operator=(const RootedValue &) = delete;
+
+    Value get() const { return value; }
+    operator Value() const { return value; }
+    RootedValue &operator=(Value other)
+    {
+        value = other;
+        return *this;
+    }
+};
+
+}; // namespace gravlax::runtime
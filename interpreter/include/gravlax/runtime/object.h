@@ -0,0 +1,268 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+#include <gravlax/runtime/value.h>
+
+namespace gravlax::runtime
+{
+
+class Heap;
+class Shape;
+
+enum class ObjType : std::uint8_t {
+    String,
+    Instance,
+    Class,
+    Slots,
+    Function,
+    Closure,
+    Upvalue,
+    Native,
+    Rope,
+};
+
+// Every heap object starts with this header. Objects are plain data that the
+// collector copies with memcpy, so they must not hold anything with a
+// destructor, and they are at least 16 bytes so that a forwarding pointer
+// fits behind the header.
+struct Obj {
+    enum Flags : std::uint8_t {
+        // Copied, the new address follows the header.
+        Forwarded = 1 << 0,
+        // Lives in a block of its own and never moves.
+        Large = 1 << 1,
+        // Reached in the running major collection. Large objects only.
+        Marked = 1 << 2,
+        // A large or image object in the remembered set.
+        Remembered = 1 << 3,
+        // A string in the heap's intern set, the only string with its
+        // contents.
+        Interned = 1 << 4,
+        // Part of an image that a snapshot mapped into the heap, see
+        // Heap::addImage(). Never moves and is never freed.
+        Image = 1 << 5,
+    };
+
+    ObjType type;
+    std::uint8_t flags;
+    std::uint16_t spare;
+    // Size of the whole object in bytes, a multiple of 8.
+    std::uint32_t size;
+
+    bool is(ObjType t) const { return type == t; }
+};
+
+// Immutable characters, stored inline and zero terminated, with their hash
+// computed once when the string is made.
+struct ObjString : Obj {
+    std::uint32_t length;
+    std::uint32_t hash;
+
+    char *chars() { return reinterpret_cast<char *>(this + 1); }
+    const char *chars() const
+    {
+        return reinterpret_cast<const char *>(this + 1);
+    }
+    std::string_view view() const { return {chars(), length}; }
+};
+
+// A string made by concatenation whose characters have not been copied
+// together yet, so that building a long string piece by piece stays linear.
+// Lox code cannot tell a rope from a flat string, Heap::flatten() turns one
+// into the other when the characters are needed.
+struct ObjRope : Obj {
+    std::uint32_t length;
+    std::uint32_t spare;
+    // Strings or ropes, both null once the rope is flattened.
+    Obj *left;
+    Obj *right;
+    // Set by flattening, so that it is done once.
+    ObjString *flat;
+};
+
+// A growable array of values, i.e. the out of line slots of an instance.
+struct ObjSlots : Obj {
+    std::uint32_t capacity;
+    std::uint32_t spare;
+
+    Value *values() { return reinterpret_cast<Value *>(this + 1); }
+};
+
+struct ObjClass : Obj {
+    ObjString *name;
+    // Root of the shapes of the instances, so that an instance's shape
+    // also determines its class.
+    Shape *instanceShape;
+    // Methods are stored like the fields of an instance.
+    Shape *methodShape;
+    ObjSlots *methods;
+    // Inline slots for new instances. Grows when instances outgrow it.
+    std::uint32_t instanceSlots;
+    std::uint32_t spare;
+};
+
+// An instance of a class, or a plain record of fieldCount values when
+// created without one. The first fieldCount slots are stored inline, the
+// rest in overflow. Instances of a class track their properties in shape.
+struct ObjInstance : Obj {
+    std::uint32_t fieldCount;
+    std::uint32_t spare;
+    Shape *shape;
+    ObjClass *klass;
+    ObjSlots *overflow;
+
+    Value *fields() { return reinterpret_cast<Value *>(this + 1); }
+
+    Value &slot(std::uint32_t index)
+    {
+        return index < fieldCount ? fields()[index]
+                                  : overflow->values()[index - fieldCount];
+    }
+};
+
+// A function as declared. The runtime does not look at the code, which is
+// owned by whoever compiled the function and has to outlive the heap.
+struct ObjFunction : Obj {
+    ObjString *name;
+    const void *code;
+    std::uint32_t arity;
+    std::uint32_t upvalueCount;
+};
+
+// A variable captured by a closure. While the variable's frame or block is
+// still running the upvalue is open and refers to the variable's slot on the
+// stack. When the block exits the value is moved into the upvalue.
+struct ObjUpvalue : Obj {
+    std::uint32_t slot;
+    std::uint32_t open;
+    Value closed;
+};
+
+// A function together with the variables it captured.
+struct ObjClosure : Obj {
+    ObjFunction *function;
+    std::uint32_t upvalueCount;
+    std::uint32_t spare;
+
+    ObjUpvalue **upvalues()
+    {
+        return reinterpret_cast<ObjUpvalue **>(this + 1);
+    }
+};
+
+// Called with exactly arity arguments. May allocate. Throws NativeError for
+// arguments it cannot take.
+using NativeFn = Value (*)(Heap &heap, const Value *args);
+
+// Reported as a runtime error at the call.
+class NativeError : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+struct ObjNative : Obj {
+    NativeFn function;
+    ObjString *name;
+    std::uint32_t arity;
+    std::uint32_t spare;
+};
+
+// FNV-1a, like the front end, folded to 32 bits.
+inline std::uint32_t hashChars(std::string_view s)
+{
+    std::uint32_t h = 2166136261u;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// A flat string or a rope.
+inline bool isString(Value value)
+{
+    return value.isObject() && (value.asObject()->is(ObjType::String) ||
+                                value.asObject()->is(ObjType::Rope));
+}
+
+// Flat strings only, see Heap::flatten().
+inline ObjString *asString(Value value)
+{
+    return static_cast<ObjString *>(value.asObject());
+}
+
+// Of a flat string or a rope.
+inline std::uint32_t stringLength(const Obj *s)
+{
+    return s->is(ObjType::String) ? static_cast<const ObjString *>(s)->length
+                                  : static_cast<const ObjRope *>(s)->length;
+}
+
+// Calls f(Obj *&) for every object reference held by the object, so that
+// the collector can update it. This is the only place that needs to know
+// the layout of each object type.
+template <typename F> void forEachReference(Obj *object, F &&f)
+{
+    auto value = [&](Value &v) {
+        if (v.isObject())
+            f(v.objectSlot());
+    };
+    auto pointer = [&](auto *&p) {
+        if (p)
+            f(reinterpret_cast<Obj *&>(p));
+    };
+
+    switch (object->type) {
+    case ObjType::String:
+        break;
+    case ObjType::Instance: {
+        auto instance = static_cast<ObjInstance *>(object);
+        for (std::uint32_t i = 0; i < instance->fieldCount; i++)
+            value(instance->fields()[i]);
+        pointer(instance->klass);
+        pointer(instance->overflow);
+        break;
+    }
+    case ObjType::Class: {
+        auto klass = static_cast<ObjClass *>(object);
+        pointer(klass->name);
+        pointer(klass->methods);
+        break;
+    }
+    case ObjType::Slots: {
+        auto slots = static_cast<ObjSlots *>(object);
+        for (std::uint32_t i = 0; i < slots->capacity; i++)
+            value(slots->values()[i]);
+        break;
+    }
+    case ObjType::Function:
+        pointer(static_cast<ObjFunction *>(object)->name);
+        break;
+    case ObjType::Closure: {
+        auto closure = static_cast<ObjClosure *>(object);
+        pointer(closure->function);
+        for (std::uint32_t i = 0; i < closure->upvalueCount; i++)
+            pointer(closure->upvalues()[i]);
+        break;
+    }
+    case ObjType::Upvalue:
+        value(static_cast<ObjUpvalue *>(object)->closed);
+        break;
+    case ObjType::Native:
+        pointer(static_cast<ObjNative *>(object)->name);
+        break;
+    case ObjType::Rope: {
+        auto rope = static_cast<ObjRope *>(object);
+        pointer(rope->left);
+        pointer(rope->right);
+        pointer(rope->flat);
+        break;
+    }
+    }
+}
+
+}; // namespace gravlax::runtime
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+#include <gravlax/runtime/heap.h>
+#include <gravlax/runtime/object.h>
+#include <gravlax/runtime/shape.h>
+
+namespace gravlax::runtime
+{
+
+// The inline cache of one property get, set or method call site. It maps
+// the shapes seen at the site to where the property lives, so that a hit
+// costs a shape compare and a load. A site that has seen one shape is
+// monomorphic, up to Ways shapes polymorphic. Beyond that it stops caching
+// and every access takes the slow path.
+//
+// Entries hold shapes and indices but no object references, so caches need
+// not be traced by the collector.
+struct PropertyCache {
+    static constexpr int Ways = 4;
+
+    enum class State { Uninitialized, Monomorphic, Polymorphic, Megamorphic };
+
+    enum class Kind : std::uint8_t {
+        // A slot of the instance.
+        Field,
+        // A slot of the class's methods.
+        Method,
+        // A set that adds a field and moves the instance to target.
+        Add,
+    };
+
+    struct Entry {
+        const Shape *shape;
+        const Shape *target;
+        std::uint32_t index;
+        Kind kind;
+    };
+
+    std::array<Entry, Ways> entries{};
+    std::uint8_t size = 0;
+    bool megamorphic = false;
+    std::uint32_t misses = 0;
+
+    State state() const
+    {
+        if (megamorphic)
+            return State::Megamorphic;
+        if (size == 0)
+            return State::Uninitialized;
+        return size == 1 ? State::Monomorphic : State::Polymorphic;
+    }
+
+    void add(const Entry &entry)
+    {
+        if (size < Ways) {
+            entries[size++] = entry;
+        } else {
+            megamorphic = true;
+        }
+    }
+};
+
+bool getPropertySlow(ObjInstance *instance, std::string_view name,
+                     PropertyCache &cache, Value &result);
+void setPropertySlow(Heap &heap, ObjInstance *instance, std::string_view name,
+                     Value value, PropertyCache &cache);
+
+inline std::uint32_t slotCapacity(ObjInstance *instance)
+{
+    return instance->fieldCount +
+           (instance->overflow ? instance->overflow->capacity : 0);
+}
+
+inline void storeSlot(Heap &heap, ObjInstance *instance, std::uint32_t index,
+                      Value value)
+{
+    if (index < instance->fieldCount) {
+        instance->fields()[index] = value;
+        heap.writeBarrier(instance, &instance->fields()[index], value);
+    } else {
+        std::uint32_t i = index - instance->fieldCount;
+        Value &slot = instance->overflow->values()[i];
+        slot = value;
+        heap.writeBarrier(instance->overflow, &slot, value);
+    }
+}
+
+// Looks up a field of the instance, or else a method of its class. Returns
+// false if there is neither.
+inline bool getProperty(ObjInstance *instance, std::string_view name,
+                        PropertyCache &cache, Value &result)
+{
+    const Shape *shape = instance->shape;
+    for (int i = 0; i < cache.size; i++) {
+        const auto &entry = cache.entries[i];
+        if (entry.shape != shape)
+            continue;
+        if (entry.kind == PropertyCache::Kind::Method) {
+            result = instance->klass->methods->values()[entry.index];
+        } else {
+            result = instance->slot(entry.index);
+        }
+        return true;
+    }
+
+    return getPropertySlow(instance, name, cache, result);
+}
+
+// Sets a field of the instance, adding it if needed. The instance must have
+// a class. May allocate.
+inline void setProperty(Heap &heap, ObjInstance *instance,
+                        std::string_view name, Value value,
+                        PropertyCache &cache)
+{
+    const Shape *shape = instance->shape;
+    for (int i = 0; i < cache.size; i++) {
+        const auto &entry = cache.entries[i];
+        if (entry.shape != shape)
+            continue;
+        if (entry.kind == PropertyCache::Kind::Add) {
+            if (entry.index >= slotCapacity(instance))
+                break;
+            instance->shape = const_cast<Shape *>(entry.target);
+        }
+        storeSlot(heap, instance, entry.index, value);
+        return;
+    }
+
+    setPropertySlow(heap, instance, name, value, cache);
+}
+
+// Adds or replaces a method of the class. May allocate.
+void defineMethod(Heap &heap, ObjClass *klass, std::string_view name,
+                  Value method);
+
+}; // namespace gravlax::runtime
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace gravlax::runtime
+{
+
+// A hidden class: the names of an object's properties in the order they
+// were added, which maps each name to an index into the object's slots.
+//
+// Shapes form transition trees. Adding a property to an object of shape S
+// moves it to the child of S for that name, creating the child the first
+// time, so objects that get the same properties in the same order share
+// their shape. Shapes are immutable once created and are compared by
+// address, which is what inline caches key on.
+class Shape
+{
+    Shape *parent = nullptr;
+    std::string key;
+    std::uint32_t count = 0;
+    std::vector<std::unique_ptr<Shape>> transitions;
+
+    Shape(Shape *parent, std::string_view key);
+
+    friend class ShapeTree;
+
+  public:
+    Shape() = default;
+
+    Shape(const Shape &) = delete;
+    Shape &operator=(const Shape &) = delete;
+
+    Shape *parentShape() const { return parent; }
+    // Name of the property this shape added to its parent.
+    std::string_view name() const { return key; }
+    std::uint32_t slotCount() const { return count; }
+
+    // Slot of the property, or -1. Walks towards the root, which only the
+    // slow paths of the inline caches do.
+    int lookup(std::string_view name) const;
+
+    // The shape with the property added at slot slotCount().
+    Shape *withProperty(std::string_view name);
+
+    std::size_t transitionCount() const { return transitions.size(); }
+    // This shape and all shapes reachable through its transitions.
+    std::size_t treeSize() const;
+};
+
+// Owns the root shapes of a runtime and, through them, all shapes.
+class ShapeTree
+{
+    std::vector<std::unique_ptr<Shape>> roots;
+
+  public:
+    // An empty shape that starts a new tree, i.e. for the instances of one
+    // class, so that their shapes also identify the class.
+    Shape *newRoot();
+
+    std::size_t shapeCount() const;
+};
+
+}; // namespace gravlax::runtime
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+#include <gravlax/runtime/object.h>
+#include <gravlax/runtime/value.h>
+
+namespace gravlax::runtime
+{
+
+class Tracer;
+
+// An open addressing hash table from strings to values, keyed by the address
+// of interned strings and probed with the hash each string carries.
+//
+// A control byte per slot is either Empty or the low 7 bits of the key's
+// hash, and a probe compares 16 control bytes at once with SSE2, so that
+// most lookups touch one cache line of control bytes and the one entry whose
+// byte matches. The control bytes of the first group are repeated after the
+// last one, which lets a group start at any slot.
+//
+// Probing is linear, so a remove shifts the rest of the key's run back into
+// the hole instead of leaving a tombstone, and lookups never slow down from
+// churn. Entries only move on insertion, removal and growth.
+//
+// Keys and values are heap references that the table does not own. A table
+// that keeps them alive has to be traced by its owner, see trace(). A table
+// that only refers to them weakly, like the heap's intern set, has to drop
+// the dead keys after a collection, see removeIf().
+class Table
+{
+  public:
+    struct Entry {
+        ObjString *key;
+        Value value;
+    };
+
+    static constexpr std::size_t GroupSize = 16;
+
+    Table() = default;
+    Table(Table &&other) noexcept;
+    Table &operator=(Table &&other) noexcept;
+    ~Table();
+
+    Table(const Table &) = delete;
+    Table &operator=(const Table &) = delete;
+
+    std::size_t size() const { return count; }
+    std::size_t capacity() const { return mask ? mask + 1 : 0; }
+
+    // The value of the key, or nullptr. The pointer is valid until the next
+    // insertion or removal.
+    Value *find(const ObjString *key);
+    bool get(const ObjString *key, Value &value) const;
+
+    // Returns true if the key was added, false if its value was replaced.
+    bool set(ObjString *key, Value value);
+    // Returns false if the key was not in the table.
+    bool remove(const ObjString *key);
+    void clear();
+
+    // The key with these characters, compared by contents, or nullptr. This
+    // is what interning looks strings up with before they exist.
+    ObjString *findString(std::string_view chars, std::uint32_t hash) const;
+
+    // Visits the keys and values. Moving a key is fine, its slot only depends
+    // on its hash.
+    void trace(Tracer &tracer);
+
+    // Calls f(Entry &) for every entry. f may update the key to a copy of the
+    // same string and may change the value.
+    template <typename F> void forEach(F &&f)
+    {
+        for (std::size_t i = 0; i <= mask && entries; i++) {
+            if (isFull(control[i]))
+                f(entries[i]);
+        }
+    }
+
+    // Removes the entries for which dead(const Entry &) returns true. The
+    // keys of all entries, dead or not, must still carry their hash, see
+    // Heap::sweepInterned().
+    template <typename F> void removeIf(F &&dead)
+    {
+        // A removal shifts a later entry into slot i, so look at i again.
+        // Entries that wrap around to the front are only ever shifted into
+        // slots that were already looked at.
+        for (std::size_t i = 0; i <= mask && entries;) {
+            if (isFull(control[i]) && dead(entries[i])) {
+                erase(i);
+            } else {
+                i++;
+            }
+        }
+    }
+
+  private:
+    static constexpr std::uint8_t Empty = 0x80;
+
+    // Capacity + GroupSize control bytes, the last group copies the first.
+    std::unique_ptr<std::uint8_t[]> control;
+    std::unique_ptr<Entry[]> entries;
+    std::size_t mask = 0;
+    std::size_t count = 0;
+    int shift = 64;
+
+    static bool isFull(std::uint8_t c) { return !(c & Empty); }
+
+    // Fibonacci hashing spreads the 32 bit string hash over the table.
+    std::size_t home(std::uint32_t hash) const
+    {
+        return static_cast<std::size_t>(
+            (hash * 0x9e3779b97f4a7c15ull) >> shift);
+    }
+    static std::uint8_t tag(std::uint32_t hash) { return hash & 0x7f; }
+
+    void setControl(std::size_t i, std::uint8_t c);
+    // Index of the key, or -1.
+    std::ptrdiff_t indexOf(const ObjString *key) const;
+    // The first empty slot of the key's run, which has to exist.
+    std::size_t freeSlot(std::uint32_t hash) const;
+    void erase(std::size_t i);
+    void resize(std::size_t newCapacity);
+};
+
+}; // namespace gravlax::runtime
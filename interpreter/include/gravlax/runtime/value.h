@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+
+namespace gravlax::runtime
+{
+
+struct Obj;
+
+// A Lox value as the runtime sees it: nil, a boolean, a number or a pointer
+// to an object on the Heap. Objects move when they are collected, so a value
+// that refers to one has to be reachable from the heap's roots whenever
+// anything may allocate.
+class Value
+{
+  public:
+    enum class Type : std::uint8_t { Nil, Bool, Number, Object };
+
+  private:
+    Type tag = Type::Nil;
+    union {
+        bool boolean;
+        double number;
+        Obj *object;
+    } as{.number = 0};
+
+  public:
+    constexpr Value() = default;
+
+    static constexpr Value nil() { return Value(); }
+
+    static constexpr Value fromBool(bool b)
+    {
+        Value v;
+        v.tag = Type::Bool;
+        v.as.boolean = b;
+        return v;
+    }
+
+    static constexpr Value fromNumber(double d)
+    {
+        Value v;
+        v.tag = Type::Number;
+        v.as.number = d;
+        return v;
+    }
+
+    static constexpr Value fromObject(Obj *o)
+    {
+        Value v;
+        v.tag = Type::Object;
+        v.as.object = o;
+        return v;
+    }
+
+    constexpr Type type() const { return tag; }
+    constexpr bool isNil() const { return tag == Type::Nil; }
+    constexpr bool isBool() const { return tag == Type::Bool; }
+    constexpr bool isNumber() const { return tag == Type::Number; }
+    constexpr bool isObject() const { return tag == Type::Object; }
+
+    constexpr bool asBool() const { return as.boolean; }
+    constexpr double asNumber() const { return as.number; }
+    constexpr Obj *asObject() const { return as.object; }
+
+    // The collector updates object references in place.
+    Obj *&objectSlot() { return as.object; }
+};
+
+}; // namespace gravlax::runtime
@@ -1,9 +1,13 @@
 #pragma once
 
-#include <map>
 #include <memory>
+#include <string>
+#include <string_view>
 #include <vector>
 
+#include <gravlax/diagnostics.h>
+#include <gravlax/lexer.h>
+#include <gravlax/line_index.h>
 #include <gravlax/token.h>
 
 namespace gravlax
@@ -13,40 +17,74 @@ class Scanner
 {
     std::vector<Token> tokens;
     std::string code;
-    std::map<std::string, Token::Type> keywords;
+    LineIndex lines;
+    Diagnostics ownDiagnostics;
+    Diagnostics *diagnostics = &ownDiagnostics;
 
     int start = 0;
     int current = 0;
-    int line = 1;
 
-    bool hadError = false;
+    // More input may follow, see feed(). A lexeme that reaches the end of
+    // the buffer then sets starved instead of ending there.
+    bool streaming = false;
+    bool starved = false;
+    // Where the DFA stopped in the lexeme that starved, which the next
+    // chunk goes on from, so that a string spanning many chunks is scanned
+    // once.
+    lexer::Progress pending{};
+    bool resuming = false;
+
+    // How much of code is known to be valid UTF-8, and whether that is all
+    // ASCII, in which case names need no decoding. Input is ignored after
+    // invalid UTF-8.
+    std::size_t validated = 0;
+    bool ascii = true;
+    bool invalid = false;
 
     void scanTokens();
     void scanToken();
 
     bool isAtEnd();
-    char advance();
-    bool match(char expected);
-    char peek();
-    char peekNext();
 
+    // Checks the input from validated on. Invalid UTF-8 is reported, and the
+    // input cut short before it.
+    void validate(bool complete);
+
+    // Narrows a name with characters outside ASCII to XID_Continue.
     void identifier();
-    bool isAlpha(char c);
-    bool isAlphaNumeric(char c);
 
+    // Add the literal's token with its value.
     void string();
-    char isDigit(char c);
     void number();
 
-    void error(int line, std::string message);
+    void error(int offset, std::string message);
 
     void addToken(Token::Type tokenType);
     void addToken(Token::Type tokenType, Token::Literal literal);
 
   public:
     Scanner();
+    // Report errors into a sink shared with, i.e., the parser.
+    explicit Scanner(Diagnostics &diagnostics);
     ~Scanner();
 
     std::unique_ptr<std::vector<Token>> scanString(const std::string &code);
+
+    // Scanning of input that arrives in chunks. feed() appends a chunk and
+    // returns the tokens it completed; a token that may continue into the
+    // next chunk is held back until that arrives. finish() returns the rest
+    // and END_OF_FILE. The returned tokens are valid until the next call.
+    void startStream();
+    std::vector<Token> &feed(std::string_view chunk);
+    std::vector<Token> &finish();
+
+    // All of the input so far, which the token offsets point into.
+    const std::string &source() const { return code; }
+
+    // Line and column lookup for the offsets of the last scanned tokens.
+    const LineIndex &lineIndex() const { return lines; }
+
+    const Diagnostics &errors() const { return *diagnostics; }
+    bool hadError() const { return diagnostics->hadError(); }
 };
 }; // namespace gravlax
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace gravlax
+{
+
+// Writing or reading a snapshot failed. The message is meant for the user.
+class SnapshotError : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+// The state that running a prelude left an Executor in, saved so that
+// another executor, usually in another process, can start from it without
+// parsing and running the prelude again. See Executor::saveSnapshot().
+//
+// A snapshot file holds a header, metadata and an image:
+//
+// - The image is the heap objects reachable from the globals, back to back,
+//   laid out as they will sit in memory when mapped at the header's base
+//   address. It is page aligned in the file and mapped copy-on-write, so
+//   processes that load the same snapshot share its pages until they write
+//   to them.
+// - The metadata holds what the image cannot: the offsets of every pointer
+//   in the image, so that an image that could not be mapped at its base
+//   can be relocated; the globals by name; the functions, which the image
+//   refers to by index and which are rebuilt as lazy functions that scan
+//   their bodies from the prelude source on their first call; the natives
+//   by name; and the prelude source itself.
+//
+// Snapshots are only read by the build that wrote them.
+class Snapshot
+{
+  public:
+    struct Header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t valueSize;
+        std::uint64_t base;
+        std::uint64_t metadataSize;
+        std::uint64_t imageOffset;
+        std::uint64_t imageSize;
+    };
+
+    static constexpr char Magic[8] = {'G', 'R', 'V', 'L', 'X', 'S', 'N', 'P'};
+    static constexpr std::uint32_t Version = 1;
+    // Where images are laid out for. Far from where the system maps things
+    // by default, so that the first mapping in a process usually gets it.
+    static constexpr std::uint64_t Base = 0x5a5a00000000;
+    // Of the image in the file, a multiple of any page size.
+    static constexpr std::uint64_t ImageAlignment = 64 << 10;
+
+    // Maps the file. Throws SnapshotError.
+    explicit Snapshot(const std::string &path);
+    ~Snapshot();
+
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+
+    char *image() const { return imageBegin; }
+    std::size_t imageSize() const { return imageBytes; }
+    std::string_view metadata() const { return {metadataBegin, metadataBytes}; }
+    // Whether the image did not get its base address and had its pointers
+    // moved.
+    bool relocated() const { return imageBegin != basePointer(); }
+
+  private:
+    char *imageBegin = nullptr;
+    std::size_t imageBytes = 0;
+    // The header and metadata, mapped read only.
+    char *file = nullptr;
+    std::size_t fileBytes = 0;
+    const char *metadataBegin = nullptr;
+    std::size_t metadataBytes = 0;
+
+    static char *basePointer() { return reinterpret_cast<char *>(Base); }
+};
+
+}; // namespace gravlax
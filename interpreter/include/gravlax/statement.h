@@ -0,0 +1,21 @@
+#pragma once
+
+#include <memory>
+
+#include <gravlax/expression.h>
+
+#include <gravlax/generated/stmt_visitor_base.h>
+
+namespace gravlax
+{
+
+using gravlax::generated::StmtKind;
+
+template <typename R> struct Stmt {
+    virtual ~Stmt() = default;
+
+    virtual R accept(gravlax::generated::StmtVisitorBase<R> &visitor) = 0;
+    virtual StmtKind kind() const = 0;
+};
+
+}; // namespace gravlax
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include <gravlax/expression.h>
+#include <gravlax/token.h>
+
+// Counters are compiled in unless GRAVLAX_ENABLE_STATS is 0. When compiled
+// out the GRAVLAX_STATS_* macros expand to nothing.
+#ifndef GRAVLAX_ENABLE_STATS
+#define GRAVLAX_ENABLE_STATS 1
+#endif
+
+namespace gravlax::stats
+{
+
+enum class Phase { None, Load, Scan, Parse, Resolve, Print, Evaluate };
+inline constexpr int PhaseCount = static_cast<int>(Phase::Evaluate) + 1;
+
+const char *phaseName(Phase phase);
+
+struct PhaseStats {
+    std::uint64_t calls;
+    std::uint64_t wallNanos;
+    std::uint64_t cpuNanos;
+    std::uint64_t allocations;
+    std::uint64_t bytesAllocated;
+};
+
+// Counters of one thread. Allocations outside of any phase are counted in
+// Phase::None. Plain zero-initialized data, so that the allocation hook can
+// use it before anything else is set up.
+struct Stats {
+    std::array<PhaseStats, PhaseCount> phases;
+    std::array<std::uint64_t, Token::TypeCount> tokens;
+    std::array<std::uint64_t, generated::ExprKindCount> nodes;
+    Phase phase;
+};
+
+// Counters of the calling thread.
+Stats &current();
+void reset();
+
+// Peak resident set size of the process, in bytes.
+std::uint64_t peakRss();
+
+std::string formatText(const Stats &stats);
+std::string formatJson(const Stats &stats);
+
+inline void countToken(Token::Type type)
+{
+    current().tokens[type]++;
+}
+
+inline void countNode(ExprKind kind)
+{
+    current().nodes[static_cast<int>(kind)]++;
+}
+
+struct Allocations {
+    std::uint64_t count;
+    std::uint64_t bytes;
+};
+
+// Every allocation the calling thread has made since it started. Unlike the
+// phase counters these are not cleared by reset().
+Allocations threadAllocations();
+
+// Called for every allocation by the replacement operator new of the
+// gravlax_allocation_hook object library, which the gravlax executable and
+// the tests link. Programs that do not link it count no allocations.
+void recordAllocation(std::size_t size);
+
+// Times a phase for as long as it is in scope. A nested timer for the phase
+// that is already running does nothing, so recursive entry points are only
+// counted once.
+class PhaseTimer
+{
+    Phase phase;
+    Phase outer;
+    std::uint64_t wallStart = 0;
+    std::uint64_t cpuStart = 0;
+
+  public:
+    explicit PhaseTimer(Phase phase);
+    ~PhaseTimer();
+
+    PhaseTimer(const PhaseTimer &) = delete;
+    PhaseTimer &operator=(const PhaseTimer &) = delete;
+};
+
+}; // namespace gravlax::stats
+
+#define GRAVLAX_STATS_CONCAT_(a, b) a##b
+#define GRAVLAX_STATS_CONCAT(a, b) GRAVLAX_STATS_CONCAT_(a, b)
+
+#if GRAVLAX_ENABLE_STATS
+#define GRAVLAX_STATS_PHASE(phase)                                             \
+    ::gravlax::stats::PhaseTimer GRAVLAX_STATS_CONCAT(gravlax_phase_,         \
+                                                      __LINE__)(              \
+        ::gravlax::stats::Phase::phase)
+#define GRAVLAX_STATS_COUNT_TOKEN(type) ::gravlax::stats::countToken(type)
+#define GRAVLAX_STATS_COUNT_NODE(kind) ::gravlax::stats::countNode(kind)
+#else
+#define GRAVLAX_STATS_PHASE(phase)
+#define GRAVLAX_STATS_COUNT_TOKEN(type)
+#define GRAVLAX_STATS_COUNT_NODE(kind)
+#endif
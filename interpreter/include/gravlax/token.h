@@ -5,59 +5,15 @@
 
 #include <fmt/format.h>
 
+#include <gravlax/generated/token_type.h>
+
 namespace gravlax
 {
 
 struct Token {
-    enum Type {
-        // Single-character tokens.
-        LEFT_PAREN,
-        RIGHT_PAREN,
-        LEFT_BRACE,
-        RIGHT_BRACE,
-        COMMA,
-        DOT,
-        MINUS,
-        PLUS,
-        SEMICOLON,
-        SLASH,
-        STAR,
-
-        // One or two character tokens.
-        BANG,
-        BANG_EQUAL,
-        EQUAL,
-        EQUAL_EQUAL,
-        GREATER,
-        GREATER_EQUAL,
-        LESS,
-        LESS_EQUAL,
-
-        // Literals.
-        IDENTIFIER,
-        STRING,
-        NUMBER,
-
-        // Keywords.
-        AND,
-        CLASS,
-        ELSE,
-        FALSE,
-        FUN,
-        FOR,
-        IF,
-        NIL,
-        OR,
-        PRINT,
-        RETURN,
-        SUPER,
-        THIS,
-        TRUE,
-        VAR,
-        WHILE,
-
-        END_OF_FILE
-    };
+    // Generated from tools/tokens.spec, like the lexer's tables.
+    using Type = generated::TokenType;
+    static constexpr int TypeCount = generated::TokenTypeCount;
 
     // Since std::variant default constructs using the first alternative we use
     // monostate to indicate a "Nil" value.
@@ -66,19 +22,23 @@ struct Token {
     Type type;
     std::string lexeme;
     Literal literal;
-    int line;
+    // Byte offset of the lexeme in the source. Use the scanner's LineIndex to
+    // turn it into a line and column.
+    int offset;
 
-    Token(Token::Type type, std::string lexeme, Literal literal, int line)
-        : type(type), lexeme(lexeme), literal(literal), line(line)
+    Token(Token::Type type, std::string lexeme, Literal literal, int offset)
+        : type(type), lexeme(std::move(lexeme)), literal(std::move(literal)),
+          offset(offset)
     {
     }
 
-    Token(Token::Type type, std::string lexeme, int line)
-        : type(type), lexeme(lexeme), line(line)
+    Token(Token::Type type, std::string lexeme, int offset)
+        : type(type), lexeme(std::move(lexeme)), offset(offset)
     {
     }
 
     static std::string literal_as_string(const Token::Literal &lit);
+    static std::string type_as_string(Token::Type type);
 };
 
 }; // namespace gravlax
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+// Spans are compiled in unless GRAVLAX_ENABLE_TRACE is 0. When compiled in
+// but not started, a span costs one relaxed atomic load.
+#ifndef GRAVLAX_ENABLE_TRACE
+#define GRAVLAX_ENABLE_TRACE 1
+#endif
+
+namespace gravlax::trace
+{
+
+struct Event {
+    // Must be a string literal or otherwise outlive the trace.
+    const char *name;
+    std::uint64_t beginNanos;
+    std::uint64_t endNanos;
+};
+
+namespace detail
+{
+extern std::atomic<bool> enabled;
+void record(const char *name, std::uint64_t beginNanos);
+std::uint64_t now();
+}; // namespace detail
+
+// Starts recording. Every thread records into its own ring buffer of
+// capacity events, rounded up to a power of two. Once full, the oldest
+// events are overwritten.
+void start(std::size_t capacity = 1 << 16);
+void stop();
+bool isEnabled();
+
+// Drops all recorded events.
+void clear();
+
+// Writes the events of all threads in the Chrome trace event format, which
+// chrome://tracing and Perfetto can open. Call it while no thread records,
+// i.e. after stop() or once the worker threads are done.
+void writeChromeJson(std::ostream &out);
+
+// Number of events currently held for the calling thread.
+std::size_t threadEventCount();
+
+class Span
+{
+    const char *name = nullptr;
+    std::uint64_t begin = 0;
+
+  public:
+    explicit Span(const char *name)
+    {
+        if (detail::enabled.load(std::memory_order_relaxed)) {
+            this->name = name;
+            begin = detail::now();
+        }
+    }
+
+    ~Span()
+    {
+        if (name)
+            detail::record(name, begin);
+    }
+
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+};
+
+}; // namespace gravlax::trace
+
+#define GRAVLAX_TRACE_CONCAT_(a, b) a##b
+#define GRAVLAX_TRACE_CONCAT(a, b) GRAVLAX_TRACE_CONCAT_(a, b)
+
+#if GRAVLAX_ENABLE_TRACE
+#define GRAVLAX_TRACE_SCOPE(name)                                              \
+    ::gravlax::trace::Span GRAVLAX_TRACE_CONCAT(gravlax_span_, __LINE__)(name)
+#else
+#define GRAVLAX_TRACE_SCOPE(name)
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// Source text is UTF-8. The lexer works on bytes, and only names and errors
+// need to know about the characters they are made of.
+namespace gravlax::utf8
+{
+
+// What validate() found.
+struct Validation {
+    // The length of the valid prefix, all of the text when it is valid.
+    std::size_t valid;
+    // The text ends inside a character that more text could complete, which
+    // starts at valid.
+    bool truncated;
+    // Whether the valid prefix is all ASCII.
+    bool ascii;
+};
+
+// Checks that text is well-formed UTF-8, without overlong forms, surrogates
+// or code points past U+10FFFF. ASCII is skipped 64 bytes at a time, so
+// that all-ASCII text costs little more than reading it.
+Validation validate(std::string_view text);
+
+// The character at offset, which must start a valid sequence. Moves offset
+// past it.
+char32_t decode(std::string_view text, std::size_t &offset);
+
+// The Unicode properties of the characters that may start and continue a
+// name, see UAX #31. Only meant for code points from U+0080 up.
+bool isXidStart(char32_t c);
+bool isXidContinue(char32_t c);
+
+}; // namespace gravlax::utf8
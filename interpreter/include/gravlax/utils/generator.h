@@ -0,0 +1,114 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+namespace gravlax::utils
+{
+
+// A coroutine that yields a sequence of T, resumed each time the consumer
+// asks for the next element. The subset of C++23's std::generator that the
+// front end needs: move-only, a single pass, exceptions rethrown to the
+// consumer. A yielded value lives until the coroutine is resumed again.
+template <typename T> class Generator
+{
+  public:
+    struct promise_type {
+        T *value = nullptr;
+        std::exception_ptr exception;
+
+        Generator get_return_object()
+        {
+            return Generator(handle::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+
+        std::suspend_always yield_value(T &v) noexcept
+        {
+            value = std::addressof(v);
+            return {};
+        }
+        std::suspend_always yield_value(T &&v) noexcept
+        {
+            value = std::addressof(v);
+            return {};
+        }
+
+        void return_void() noexcept {}
+        void unhandled_exception() { exception = std::current_exception(); }
+
+        // Generators only yield.
+        template <typename U> void await_transform(U &&) = delete;
+    };
+
+    using handle = std::coroutine_handle<promise_type>;
+
+    class iterator
+    {
+        handle coroutine;
+
+      public:
+        using iterator_category = std::input_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+        using value_type = T;
+
+        iterator() = default;
+        explicit iterator(handle coroutine) : coroutine(coroutine) {}
+
+        T &operator*() const { return *coroutine.promise().value; }
+
+        iterator &operator++()
+        {
+            advance(coroutine);
+            return *this;
+        }
+        void operator++(int) { ++*this; }
+
+        bool operator==(std::default_sentinel_t) const
+        {
+            return !coroutine || coroutine.done();
+        }
+    };
+
+    Generator() = default;
+    Generator(Generator &&other) noexcept
+        : coroutine(std::exchange(other.coroutine, {}))
+    {
+    }
+    Generator &operator=(Generator &&other) noexcept
+    {
+        std::swap(coroutine, other.coroutine);
+        return *this;
+    }
+    ~Generator()
+    {
+        if (coroutine)
+            coroutine.destroy();
+    }
+
+    // Runs the coroutine to its first yield.
+    iterator begin()
+    {
+        advance(coroutine);
+        return iterator(coroutine);
+    }
+    std::default_sentinel_t end() const { return {}; }
+
+  private:
+    handle coroutine;
+
+    explicit Generator(handle coroutine) : coroutine(coroutine) {}
+
+    static void advance(handle coroutine)
+    {
+        coroutine.resume();
+        if (coroutine.done() && coroutine.promise().exception)
+            std::rethrow_exception(coroutine.promise().exception);
+    }
+};
+
+}; // namespace gravlax::utils
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace gravlax::utils
+{
+
+// A bounded queue that any number of threads push to and pop from, without
+// locks (Vyukov's MPMC queue). Each cell has a sequence number that tells
+// whether it is free for the push or full for the pop at a position, so
+// that a push or pop is one compare-and-swap when uncontended.
+template <typename T> class MpmcQueue
+{
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    std::size_t mask;
+    // Apart, so that pushes and pops do not share a cache line.
+    alignas(64) std::atomic<std::size_t> pushPosition{0};
+    alignas(64) std::atomic<std::size_t> popPosition{0};
+
+  public:
+    // Room for capacity values, rounded up to a power of two.
+    explicit MpmcQueue(std::size_t capacity)
+        : cells(new Cell[std::bit_ceil(capacity)]),
+          mask(std::bit_ceil(capacity) - 1)
+    {
+        for (std::size_t i = 0; i <= mask; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MpmcQueue(const MpmcQueue &) = delete;
+    MpmcQueue &operator=(const MpmcQueue &) = delete;
+
+    // Returns false if the queue is full.
+    bool push(T value)
+    {
+        std::size_t position = pushPosition.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell &cell = cells[position & mask];
+            std::size_t sequence =
+                cell.sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<std::intptr_t>(sequence) -
+                              static_cast<std::intptr_t>(position);
+            if (difference == 0) {
+                if (pushPosition.compare_exchange_weak(
+                        position, position + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(position + 1,
+                                        std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = pushPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Returns false if the queue is empty.
+    bool pop(T &value)
+    {
+        std::size_t position = popPosition.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell &cell = cells[position & mask];
+            std::size_t sequence =
+                cell.sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<std::intptr_t>(sequence) -
+                              static_cast<std::intptr_t>(position + 1);
+            if (difference == 0) {
+                if (popPosition.compare_exchange_weak(
+                        position, position + 1, std::memory_order_relaxed)) {
+                    value = std::move(cell.value);
+                    cell.sequence.store(position + mask + 1,
+                                        std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = popPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+}; // namespace gravlax::utils
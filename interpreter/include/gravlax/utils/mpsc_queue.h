@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+
+namespace gravlax::utils
+{
+
+// An intrusive queue that any number of threads push to and one thread
+// pops from, without locks (Vyukov's MPSC queue). A push is one exchange.
+// Elements derive from Node and stay owned by the caller.
+class MpscQueue
+{
+  public:
+    struct Node {
+        std::atomic<Node *> next{nullptr};
+    };
+
+    MpscQueue() : head(&stub), tail(&stub) {}
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    void push(Node *node)
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node *previous = head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    // The oldest node, or nullptr. A push that is still in progress may
+    // hide the nodes behind it for a moment, so nullptr does not mean that
+    // nothing was pushed.
+    Node *pop()
+    {
+        Node *node = tail;
+        Node *next = node->next.load(std::memory_order_acquire);
+        if (node == &stub) {
+            if (!next)
+                return nullptr;
+            tail = next;
+            node = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next) {
+            tail = next;
+            return node;
+        }
+        if (node != head.load(std::memory_order_acquire))
+            return nullptr;
+
+        // node is the last one. The stub goes behind it, so that tail never
+        // becomes empty.
+        push(&stub);
+        next = node->next.load(std::memory_order_acquire);
+        if (next) {
+            tail = next;
+            return node;
+        }
+        return nullptr;
+    }
+
+  private:
+    std::atomic<Node *> head;
+    // Only the consumer touches tail.
+    Node *tail;
+    Node stub;
+};
+
+}; // namespace gravlax::utils
@@ -0,0 +1,51 @@
+#include <cstdlib>
+#include <new>
+
+#include <gravlax/stats.h>
+
+// Replaces the global operator new and delete to count allocations, see
+// gravlax::stats::recordAllocation(). Built as an object library so that
+// only the programs that link it pay for the counting.
+namespace
+{
+
+void *allocate(std::size_t size)
+{
+    gravlax::stats::recordAllocation(size);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+}; // namespace
+
+// The nothrow and aligned forms are left alone, the former call these.
+void *operator new(std::size_t size)
+{
+    return allocate(size);
+}
+
+void *operator new[](std::size_t size)
+{
+    return allocate(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
@@ -2,19 +2,49 @@
 #include <iostream>
 
 #include <gravlax/ast_printer.h>
+#include <gravlax/stats.h>
+#include <gravlax/trace.h>
 
 namespace gravlax
 {
+using gravlax::generated::Assign;
 using gravlax::generated::Binary;
+using gravlax::generated::Block;
+using gravlax::generated::Call;
+using gravlax::generated::Expression;
+using gravlax::generated::Function;
 using gravlax::generated::Grouping;
+using gravlax::generated::If;
 using gravlax::generated::Literal;
+using gravlax::generated::Logical;
+using gravlax::generated::Print;
+using gravlax::generated::Return;
 using gravlax::generated::Unary;
+using gravlax::generated::Var;
+using gravlax::generated::Variable;
+using gravlax::generated::While;
+
+std::string AstPrinter::visitAssignExpr(Assign<std::string> &expr)
+{
+    return parenthesize("= " + expr.name.lexeme, expr.value.get());
+}
 
 std::string AstPrinter::visitBinaryExpr(Binary<std::string> &expr)
 {
     return parenthesize(expr.oper.lexeme, expr.left.get(), expr.right.get());
 }
 
+std::string AstPrinter::visitCallExpr(Call<std::string> &expr)
+{
+    std::string s = "(call " + expr.callee->accept(*this);
+    for (auto &argument : expr.arguments) {
+        s += " ";
+        s += argument->accept(*this);
+    }
+    s += ")";
+    return s;
+}
+
 std::string AstPrinter::visitGroupingExpr(Grouping<std::string> &expr)
 {
     return parenthesize("group", expr.expression.get());
@@ -25,11 +55,94 @@ std::string AstPrinter::visitLiteralExpr(Literal<std::string> &expr)
     return Token::literal_as_string(expr.value);
 }
 
+std::string AstPrinter::visitLogicalExpr(Logical<std::string> &expr)
+{
+    return parenthesize(expr.oper.lexeme, expr.left.get(), expr.right.get());
+}
+
 std::string AstPrinter::visitUnaryExpr(Unary<std::string> &expr)
 {
     return parenthesize(expr.oper.lexeme, expr.right.get());
 }
 
+std::string AstPrinter::visitVariableExpr(Variable<std::string> &expr)
+{
+    return expr.name.lexeme;
+}
+
+std::string AstPrinter::visitBlockStmt(Block<std::string> &stmt)
+{
+    std::string s = "(block";
+    for (auto &statement : stmt.statements) {
+        s += " ";
+        s += statement->accept(*this);
+    }
+    s += ")";
+    return s;
+}
+
+std::string AstPrinter::visitExpressionStmt(Expression<std::string> &stmt)
+{
+    return parenthesize(";", stmt.expression.get());
+}
+
+std::string AstPrinter::visitFunctionStmt(Function<std::string> &stmt)
+{
+    std::string s = "(fun " + stmt.name.lexeme + "(";
+    for (std::size_t i = 0; i < stmt.params.size(); i++) {
+        if (i != 0)
+            s += " ";
+        s += stmt.params[i].lexeme;
+    }
+    s += ")";
+    for (auto &statement : stmt.body) {
+        s += " ";
+        s += statement->accept(*this);
+    }
+    s += ")";
+    return s;
+}
+
+std::string AstPrinter::visitIfStmt(If<std::string> &stmt)
+{
+    std::string s = stmt.elseBranch ? "(if-else " : "(if ";
+    s += stmt.condition->accept(*this);
+    s += " ";
+    s += stmt.thenBranch->accept(*this);
+    if (stmt.elseBranch) {
+        s += " ";
+        s += stmt.elseBranch->accept(*this);
+    }
+    s += ")";
+    return s;
+}
+
+std::string AstPrinter::visitPrintStmt(Print<std::string> &stmt)
+{
+    return parenthesize("print", stmt.expression.get());
+}
+
+std::string AstPrinter::visitReturnStmt(Return<std::string> &stmt)
+{
+    if (!stmt.value)
+        return "(return)";
+    return parenthesize("return", stmt.value.get());
+}
+
+std::string AstPrinter::visitVarStmt(Var<std::string> &stmt)
+{
+    if (!stmt.initializer)
+        return "(var " + stmt.name.lexeme + ")";
+    return parenthesize("var " + stmt.name.lexeme + " =",
+                        stmt.initializer.get());
+}
+
+std::string AstPrinter::visitWhileStmt(While<std::string> &stmt)
+{
+    return "(while " + stmt.condition->accept(*this) + " " +
+           stmt.body->accept(*this) + ")";
+}
+
 std::string AstPrinter::parenthesize(Expr<std::string> &expr)
 {
     return expr.accept(*this);
@@ -54,9 +167,20 @@ std::string AstPrinter::parenthesize(std::string name, auto... exprs)
 
 std::string AstPrinter::print(Expr<std::string> &expr)
 {
+    GRAVLAX_STATS_PHASE(Print);
+    GRAVLAX_TRACE_SCOPE("AstPrinter::print");
+
     return expr.accept(*this);
 }
 
+std::string AstPrinter::print(Stmt<std::string> &stmt)
+{
+    GRAVLAX_STATS_PHASE(Print);
+    GRAVLAX_TRACE_SCOPE("AstPrinter::print");
+
+    return stmt.accept(*this);
+}
+
 }; // namespace gravlax
 
 #if 0
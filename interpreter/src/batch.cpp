@@ -0,0 +1,275 @@
+#include <algorithm>
+
+#include <gravlax/batch.h>
+#include <gravlax/stats.h>
+#include <gravlax/trace.h>
+
+namespace
+{
+using gravlax::BatchProgram;
+using Type = BatchProgram::Type;
+using Op = BatchProgram::Op;
+
+// Read-only view of a register for the current chunk. By convention a row
+// with the error byte set has its valid byte cleared.
+struct Lane {
+    const double *values;
+    const std::uint8_t *valid;
+    const std::uint8_t *error;
+};
+
+// Output arrays of a register.
+struct Out {
+    double *__restrict values;
+    std::uint8_t *__restrict valid;
+    std::uint8_t *__restrict error;
+};
+
+// Numbers in, number or bool out. A nil operand is a runtime error.
+template <typename F>
+void arithmetic(std::size_t n, Lane a, Lane b, Out out, F f)
+{
+    for (std::size_t i = 0; i < n; i++) {
+        std::uint8_t valid = a.valid[i] & b.valid[i];
+        out.values[i] = f(a.values[i], b.values[i]);
+        out.valid[i] = valid;
+        out.error[i] = valid ^ 1;
+    }
+}
+
+void negate(std::size_t n, Lane a, Out out)
+{
+    for (std::size_t i = 0; i < n; i++) {
+        out.values[i] = -a.values[i];
+        out.valid[i] = a.valid[i];
+        out.error[i] = a.valid[i] ^ 1;
+    }
+}
+
+// Only nil and false are falsey.
+void logicalNot(std::size_t n, Type type, Lane a, Out out)
+{
+    for (std::size_t i = 0; i < n; i++) {
+        double truthy = a.valid[i] && (type == Type::Number || a.values[i]);
+        out.values[i] = 1.0 - truthy;
+        out.valid[i] = a.error[i] ^ 1;
+        out.error[i] = a.error[i];
+    }
+}
+
+// Values of different types are never equal, two nils always are.
+void equal(std::size_t n, bool sameType, bool negated, Lane a, Lane b,
+           Out out)
+{
+    for (std::size_t i = 0; i < n; i++) {
+        std::uint8_t bothNil = (a.valid[i] | b.valid[i]) ^ 1;
+        std::uint8_t same = (sameType & a.valid[i] & b.valid[i] &
+                             (a.values[i] == b.values[i])) |
+                            bothNil;
+        std::uint8_t error = a.error[i] | b.error[i];
+        out.values[i] = same ^ negated;
+        out.valid[i] = error ^ 1;
+        out.error[i] = error;
+    }
+}
+
+void fail(std::size_t n, Out out)
+{
+    std::fill_n(out.values, n, 0.0);
+    std::fill_n(out.valid, n, 0);
+    std::fill_n(out.error, n, 1);
+}
+
+}; // namespace
+
+namespace gravlax
+{
+
+int BatchProgram::emit(Op op, Type type, int a, int b, double constant)
+{
+    int dst = static_cast<int>(types.size());
+    types.push_back(type);
+    code.push_back({op, dst, a, b, constant});
+    return dst;
+}
+
+int BatchProgram::emitLiteral(const Token::Literal &value, std::string &error)
+{
+    if (auto b = std::get_if<bool>(&value))
+        return emit(Op::Constant, Type::Bool, -1, -1, *b ? 1.0 : 0.0);
+    if (auto d = std::get_if<double>(&value))
+        return emit(Op::Constant, Type::Number, -1, -1, *d);
+    if (std::holds_alternative<std::monostate>(value))
+        return emit(Op::Constant, Type::Nil);
+
+    error = "String values are not supported in batch expressions.";
+    return -1;
+}
+
+int BatchProgram::emitUnary(Token::Type oper, int right)
+{
+    if (oper == Token::Type::BANG)
+        return emit(Op::Not, Type::Bool, right);
+
+    // MINUS
+    if (types[right] != Type::Number)
+        return emit(Op::Fail, Type::Number);
+    return emit(Op::Negate, Type::Number, right);
+}
+
+int BatchProgram::emitBinary(Token::Type oper, int left, int right)
+{
+    switch (oper) {
+    case Token::Type::BANG_EQUAL:
+        return emit(Op::NotEqual, Type::Bool, left, right);
+    case Token::Type::EQUAL_EQUAL:
+        return emit(Op::Equal, Type::Bool, left, right);
+    default:
+        break;
+    }
+
+    bool numbers = types[left] == Type::Number && types[right] == Type::Number;
+
+    switch (oper) {
+    case Token::Type::GREATER:
+        return emit(numbers ? Op::Greater : Op::Fail, Type::Bool, left, right);
+    case Token::Type::GREATER_EQUAL:
+        return emit(numbers ? Op::GreaterEqual : Op::Fail, Type::Bool, left,
+                    right);
+    case Token::Type::LESS:
+        return emit(numbers ? Op::Less : Op::Fail, Type::Bool, left, right);
+    case Token::Type::LESS_EQUAL:
+        return emit(numbers ? Op::LessEqual : Op::Fail, Type::Bool, left,
+                    right);
+    case Token::Type::MINUS:
+        return emit(numbers ? Op::Subtract : Op::Fail, Type::Number, left,
+                    right);
+    case Token::Type::PLUS:
+        return emit(numbers ? Op::Add : Op::Fail, Type::Number, left, right);
+    case Token::Type::SLASH:
+        return emit(numbers ? Op::Divide : Op::Fail, Type::Number, left,
+                    right);
+    case Token::Type::STAR:
+        return emit(numbers ? Op::Multiply : Op::Fail, Type::Number, left,
+                    right);
+    default:
+        return emit(Op::Fail, Type::Nil);
+    }
+}
+
+void BatchProgram::evaluate(std::span<const BatchColumn> columns,
+                            std::size_t rows, BatchResult &out) const
+{
+    GRAVLAX_STATS_PHASE(Evaluate);
+    GRAVLAX_TRACE_SCOPE("BatchProgram::evaluate");
+
+    std::size_t registers = types.size();
+
+    std::vector<double> values(registers * chunkSize);
+    std::vector<std::uint8_t> valid(registers * chunkSize);
+    std::vector<std::uint8_t> error(registers * chunkSize);
+    std::vector<std::uint8_t> ones(chunkSize, 1);
+    std::vector<std::uint8_t> zeros(chunkSize, 0);
+
+    std::vector<Lane> lanes(registers);
+    std::vector<Out> outs(registers);
+    for (std::size_t r = 0; r < registers; r++) {
+        std::size_t offset = r * chunkSize;
+        outs[r] = {&values[offset], &valid[offset], &error[offset]};
+        lanes[r] = {&values[offset], &valid[offset], &error[offset]};
+    }
+
+    // Constants do not depend on the rows, fill them in once.
+    for (auto &ins : code) {
+        if (ins.op != Op::Constant)
+            continue;
+        Out o = outs[ins.dst];
+        std::fill_n(o.values, chunkSize, ins.constant);
+        std::fill_n(o.valid, chunkSize, types[ins.dst] != Type::Nil);
+        std::fill_n(o.error, chunkSize, 0);
+    }
+
+    out.type = types[result];
+    out.values.resize(rows);
+    out.valid.resize(rows);
+    out.error.resize(rows);
+
+    for (std::size_t begin = 0; begin < rows; begin += chunkSize) {
+        std::size_t n = std::min(chunkSize, rows - begin);
+
+        for (auto &ins : code) {
+            if (ins.op == Op::Column) {
+                // Columns are read in place.
+                const BatchColumn &column = columns[ins.a];
+                lanes[ins.dst] = {column.values + begin,
+                                  column.valid ? column.valid + begin
+                                               : ones.data(),
+                                  zeros.data()};
+                continue;
+            }
+
+            Out o = outs[ins.dst];
+            Lane a = ins.a >= 0 ? lanes[ins.a] : Lane{};
+            Lane b = ins.b >= 0 ? lanes[ins.b] : Lane{};
+
+            switch (ins.op) {
+            case Op::Column:
+            case Op::Constant:
+                break;
+            case Op::Fail:
+                fail(n, o);
+                break;
+            case Op::Negate:
+                negate(n, a, o);
+                break;
+            case Op::Not:
+                logicalNot(n, types[ins.a], a, o);
+                break;
+            case Op::Add:
+                arithmetic(n, a, b, o,
+                           [](double x, double y) { return x + y; });
+                break;
+            case Op::Subtract:
+                arithmetic(n, a, b, o,
+                           [](double x, double y) { return x - y; });
+                break;
+            case Op::Multiply:
+                arithmetic(n, a, b, o,
+                           [](double x, double y) { return x * y; });
+                break;
+            case Op::Divide:
+                arithmetic(n, a, b, o,
+                           [](double x, double y) { return x / y; });
+                break;
+            case Op::Greater:
+                arithmetic(n, a, b, o,
+                           [](double x, double y) { return double(x > y); });
+                break;
+            case Op::GreaterEqual:
+                arithmetic(n, a, b, o,
+                           [](double x, double y) { return double(x >= y); });
+                break;
+            case Op::Less:
+                arithmetic(n, a, b, o,
+                           [](double x, double y) { return double(x < y); });
+                break;
+            case Op::LessEqual:
+                arithmetic(n, a, b, o,
+                           [](double x, double y) { return double(x <= y); });
+                break;
+            case Op::Equal:
+            case Op::NotEqual:
+                equal(n, types[ins.a] == types[ins.b], ins.op == Op::NotEqual,
+                      a, b, o);
+                break;
+            }
+        }
+
+        Lane r = lanes[result];
+        std::copy_n(r.values, n, out.values.begin() + begin);
+        std::copy_n(r.valid, n, out.valid.begin() + begin);
+        std::copy_n(r.error, n, out.error.begin() + begin);
+    }
+}
+
+}; // namespace gravlax
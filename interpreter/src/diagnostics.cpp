@@ -0,0 +1,36 @@
+#include <fmt/core.h>
+
+#include <gravlax/diagnostics.h>
+
+namespace gravlax
+{
+
+void Diagnostics::error(int offset, std::string message)
+{
+    entries.push_back({offset, "", std::move(message)});
+}
+
+void Diagnostics::error(int offset, std::string where, std::string message)
+{
+    entries.push_back({offset, std::move(where), std::move(message)});
+}
+
+std::string Diagnostics::format(const Diagnostic &diagnostic,
+                                const LineIndex &lines)
+{
+    SourceLocation loc = lines.locate(diagnostic.offset);
+    return fmt::format("[line {}:{}] Error{}: {}", loc.line, loc.column,
+                       diagnostic.where, diagnostic.message);
+}
+
+void Diagnostics::print(std::ostream &out, const LineIndex &lines) const
+{
+    std::string text;
+    for (auto &diagnostic : entries) {
+        text += format(diagnostic, lines);
+        text += '\n';
+    }
+    out << text;
+}
+
+}; // namespace gravlax
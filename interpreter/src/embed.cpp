@@ -0,0 +1,51 @@
+#include <fmt/core.h>
+
+#include <gravlax/embed.h>
+#include <gravlax/parser.h>
+#include <gravlax/scanner.h>
+#include <gravlax/trace.h>
+
+namespace gravlax
+{
+
+std::shared_ptr<const Script> Script::prepare(std::string source,
+                                              Diagnostics &diagnostics)
+{
+    GRAVLAX_TRACE_SCOPE("Script::prepare");
+
+    std::shared_ptr<Script> script(new Script);
+    script->code = std::move(source);
+
+    Scanner scanner(diagnostics);
+    Parser<Executor::Value> parser(diagnostics);
+    Resolver<Executor::Value> resolver(script->names, diagnostics);
+
+    script->statements = parser.parseStatements(
+        scanner.scanString(script->code));
+    script->topLevel = resolver.resolve(script->statements);
+    if (diagnostics.hadError())
+        return nullptr;
+    return script;
+}
+
+Context::Context(std::shared_ptr<const Script> script, std::ostream &out,
+                 runtime::HeapOptions options)
+    : prepared(std::move(script)),
+      runner(out, options, prepared->globalNames())
+{
+    runner.heap().addRoots(&arguments);
+}
+
+Context::~Context()
+{
+    runner.heap().removeRoots(&arguments);
+}
+
+void Context::undefined(Function function)
+{
+    const std::string &name = runner.globalNames().name(function.global);
+    throw RuntimeError(Token(Token::Type::IDENTIFIER, name, 0),
+                       fmt::format("Undefined variable '{}'.", name));
+}
+
+}; // namespace gravlax
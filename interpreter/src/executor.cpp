@@ -0,0 +1,902 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include <fmt/core.h>
+
+#include <gravlax/executor.h>
+#include <gravlax/parser.h>
+#include <gravlax/scanner.h>
+#include <gravlax/stats.h>
+#include <gravlax/trace.h>
+
+#include <gravlax/generated/assign.h>
+#include <gravlax/generated/binary.h>
+#include <gravlax/generated/call.h>
+#include <gravlax/generated/grouping.h>
+#include <gravlax/generated/literal.h>
+#include <gravlax/generated/logical.h>
+#include <gravlax/generated/unary.h>
+#include <gravlax/generated/variable.h>
+
+#include <gravlax/generated/stmt_block.h>
+#include <gravlax/generated/stmt_expression.h>
+#include <gravlax/generated/stmt_function.h>
+#include <gravlax/generated/stmt_if.h>
+#include <gravlax/generated/stmt_print.h>
+#include <gravlax/generated/stmt_return.h>
+#include <gravlax/generated/stmt_var.h>
+#include <gravlax/generated/stmt_while.h>
+
+namespace
+{
+using namespace gravlax::runtime;
+
+using Assign = gravlax::generated::Assign<Value>;
+using Binary = gravlax::generated::Binary<Value>;
+using Call = gravlax::generated::Call<Value>;
+using Grouping = gravlax::generated::Grouping<Value>;
+using Literal = gravlax::generated::Literal<Value>;
+using Logical = gravlax::generated::Logical<Value>;
+using Unary = gravlax::generated::Unary<Value>;
+using Variable = gravlax::generated::Variable<Value>;
+
+using Block = gravlax::generated::Block<Value>;
+using Expression = gravlax::generated::Expression<Value>;
+using Function = gravlax::generated::Function<Value>;
+using If = gravlax::generated::If<Value>;
+using Print = gravlax::generated::Print<Value>;
+using Return = gravlax::generated::Return<Value>;
+using Var = gravlax::generated::Var<Value>;
+using While = gravlax::generated::While<Value>;
+
+bool isTruthy(Value value)
+{
+    if (value.isNil())
+        return false;
+    if (value.isBool())
+        return value.asBool();
+    return true;
+}
+
+bool isObject(Value value, ObjType type)
+{
+    return value.isObject() && value.asObject()->is(type);
+}
+
+// A function restored from a snapshot only has the source of its body. It
+// scanned without errors when the snapshot was made.
+void scanBody(gravlax::LazyBody &lazy, gravlax::Diagnostics &diagnostics)
+{
+    gravlax::Scanner scanner(diagnostics);
+    auto tokens = scanner.scanString(std::string(
+        lazy.source.substr(lazy.sourceBegin,
+                           lazy.sourceEnd - lazy.sourceBegin)));
+    for (auto &token : *tokens)
+        token.offset += static_cast<int>(lazy.sourceBegin);
+
+    lazy.begin = 0;
+    lazy.end = static_cast<std::uint32_t>(tokens->size() - 1);
+    lazy.tokens = std::move(tokens);
+    lazy.source = {};
+}
+
+// Where errors outside of any call are reported, the start of the script.
+const gravlax::Token scriptStart(gravlax::Token::Type::RIGHT_PAREN, ")", 0);
+
+const char *budgetMessage(gravlax::BudgetError::Reason reason)
+{
+    using Reason = gravlax::BudgetError::Reason;
+    switch (reason) {
+    case Reason::Steps:
+        return "Step budget exhausted.";
+    case Reason::Deadline:
+        return "Deadline exceeded.";
+    case Reason::Heap:
+        return "Heap budget exhausted.";
+    case Reason::Preempted:
+        return "Preempted.";
+    }
+    return "Budget exhausted.";
+}
+
+Value clockNative(Heap &, const Value *)
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return Value::fromNumber(std::chrono::duration<double>(now).count());
+}
+
+// The operation for the operands that a site saw first.
+gravlax::Quickening::Op specialize(gravlax::Token::Type oper, Value left,
+                                   Value right)
+{
+    using gravlax::Token;
+    using Op = gravlax::Quickening::Op;
+    if (oper == Token::Type::PLUS && isString(left) && isString(right))
+        return Op::ConcatStrings;
+    if (!left.isNumber() || !right.isNumber())
+        return Op::Generic;
+
+    switch (oper) {
+    case Token::Type::PLUS:
+        return Op::AddNumbers;
+    case Token::Type::MINUS:
+        return Op::SubtractNumbers;
+    case Token::Type::STAR:
+        return Op::MultiplyNumbers;
+    case Token::Type::SLASH:
+        return Op::DivideNumbers;
+    case Token::Type::GREATER:
+        return Op::GreaterNumbers;
+    case Token::Type::GREATER_EQUAL:
+        return Op::GreaterEqualNumbers;
+    case Token::Type::LESS:
+        return Op::LessNumbers;
+    case Token::Type::LESS_EQUAL:
+        return Op::LessEqualNumbers;
+    case Token::Type::EQUAL_EQUAL:
+        return Op::EqualNumbers;
+    case Token::Type::BANG_EQUAL:
+        return Op::NotEqualNumbers;
+    default:
+        return Op::Generic;
+    }
+}
+
+}; // namespace
+
+namespace gravlax
+{
+using namespace gravlax::runtime;
+
+BudgetError::BudgetError(const Token &token, Reason reason)
+    : RuntimeError(token, budgetMessage(reason)), reason(reason)
+{
+}
+
+Executor::Executor(std::ostream &out, HeapOptions options, Globals names)
+    : out(out), objects(options), names(std::move(names))
+{
+    objects.addRoots(&globals);
+    objects.addRoots(&stack);
+    objects.addRoots(&constants);
+    objects.addRoots(this);
+
+    defineNative("clock", clockNative, 0);
+}
+
+Executor::~Executor()
+{
+    objects.removeRoots(this);
+    objects.removeRoots(&constants);
+    objects.removeRoots(&stack);
+    objects.removeRoots(&globals);
+}
+
+void Executor::traceRoots(Tracer &tracer)
+{
+    for (auto &frame : frames) {
+        if (frame.closure)
+            tracer.visit(reinterpret_cast<Obj *&>(frame.closure));
+    }
+    // The running frame's closure, cached outside of frames.
+    if (closure)
+        tracer.visit(reinterpret_cast<Obj *&>(closure));
+    for (auto &upvalue : openUpvalues)
+        tracer.visit(reinterpret_cast<Obj *&>(upvalue));
+    tracer.visit(returnValue);
+}
+
+void Executor::defineNative(const std::string &name, NativeFn function,
+                            std::uint32_t arity)
+{
+    std::uint32_t index = names.indexOf(name);
+    ObjNative *native = objects.native(objects.intern(name), function, arity);
+    natives[name] = function;
+
+    globals.resize(names.size());
+    defined.resize(names.size());
+    globals[index] = Value::fromObject(native);
+    defined[index] = true;
+}
+
+bool Executor::global(const std::string &name, Value &value) const
+{
+    int index = names.find(name);
+    if (index < 0 || static_cast<std::size_t>(index) >= defined.size() ||
+        !defined[index])
+        return false;
+    value = globals[index];
+    return true;
+}
+
+void Executor::execute(Program program, const FunctionInfo &script)
+{
+    GRAVLAX_STATS_PHASE(Evaluate);
+    GRAVLAX_TRACE_SCOPE("Executor::execute");
+
+    programs.push_back(std::move(program));
+    run(programs.back(), script);
+}
+
+void Executor::run(const Program &program, const FunctionInfo &script)
+{
+    globals.resize(names.size());
+    defined.resize(names.size());
+
+    frames.push_back({nullptr, 0});
+    frameBase = 0;
+    closure = nullptr;
+    stack.assign(script.slotCount, Value());
+    startBudget();
+
+    try {
+        try {
+            for (auto &stmt : program)
+                execute(*stmt);
+        } catch (HeapLimitError &) {
+            throw BudgetError(scriptStart, BudgetError::Reason::Heap);
+        }
+    } catch (RuntimeError &) {
+        // Closures that outlive the failed program must not refer to the
+        // stack any more.
+        closeUpvalues(0);
+        frames.clear();
+        stack.clear();
+        endBudget();
+        throw;
+    }
+
+    closeUpvalues(0);
+    frames.clear();
+    stack.clear();
+    endBudget();
+}
+
+Executor::Value Executor::call(Value callee, const Value *args,
+                               std::uint32_t argCount)
+{
+    frames.push_back({nullptr, 0});
+    frameBase = 0;
+    closure = nullptr;
+    stack.push_back(callee);
+    stack.insert(stack.end(), args, args + argCount);
+    startBudget();
+
+    Value result;
+    try {
+        // Errors are reported at the start of the script.
+        result = call(0, argCount, scriptStart);
+    } catch (RuntimeError &) {
+        closeUpvalues(0);
+        frames.clear();
+        stack.clear();
+        endBudget();
+        throw;
+    }
+
+    frames.clear();
+    endBudget();
+    return result;
+}
+
+Executor::Completion Executor::execute(Stmt<Value> &stmt)
+{
+    switch (stmt.kind()) {
+    case StmtKind::Block: {
+        auto &node = static_cast<Block &>(stmt);
+        Completion completion = Completion::Normal;
+        for (auto &statement : node.statements) {
+            completion = execute(*statement);
+            if (completion == Completion::Return)
+                break;
+        }
+        if (node.info.captures)
+            closeUpvalues(frameBase + node.info.firstSlot);
+        return completion;
+    }
+    case StmtKind::Expression:
+        evaluate(*static_cast<Expression &>(stmt).expression);
+        return Completion::Normal;
+    case StmtKind::Function: {
+        auto &node = static_cast<Function &>(stmt);
+        declare(node.resolution, makeClosure(node));
+        return Completion::Normal;
+    }
+    case StmtKind::If: {
+        auto &node = static_cast<If &>(stmt);
+        if (isTruthy(evaluate(*node.condition)))
+            return execute(*node.thenBranch);
+        if (node.elseBranch)
+            return execute(*node.elseBranch);
+        return Completion::Normal;
+    }
+    case StmtKind::Print:
+        out << stringify(evaluate(*static_cast<Print &>(stmt).expression))
+            << '\n';
+        return Completion::Normal;
+    case StmtKind::Return: {
+        auto &node = static_cast<Return &>(stmt);
+        returnValue = node.value ? evaluate(*node.value) : Value();
+        return Completion::Return;
+    }
+    case StmtKind::Var: {
+        auto &node = static_cast<Var &>(stmt);
+        Value value = node.initializer ? evaluate(*node.initializer) : Value();
+        declare(node.resolution, value);
+        return Completion::Normal;
+    }
+    case StmtKind::While: {
+        auto &node = static_cast<While &>(stmt);
+        while (isTruthy(evaluate(*node.condition))) {
+            if (fuel-- == 0)
+                refuel(node.keyword);
+            if (profiler::due())
+                sample(node.keyword);
+            if (execute(*node.body) == Completion::Return)
+                return Completion::Return;
+        }
+        return Completion::Normal;
+    }
+    }
+    return Completion::Normal;
+}
+
+Executor::Value Executor::evaluate(Expr<Value> &expr)
+{
+    switch (expr.kind()) {
+    case ExprKind::Assign: {
+        auto &node = static_cast<Assign &>(expr);
+        Value value = evaluate(*node.value);
+        write(node.name, node.resolution, value);
+        return value;
+    }
+    case ExprKind::Binary: {
+        auto &node = static_cast<Binary &>(expr);
+        // The left operand stays on the stack while the right one is
+        // evaluated, which may collect. A site quickened for numbers skips
+        // that when it gets a number, which is not on the heap.
+        Value left = evaluate(*node.left);
+        Value right;
+        if (quickening && left.isNumber() && node.quickening.onNumbers()) {
+            right = evaluate(*node.right);
+        } else {
+            stack.push_back(left);
+            right = evaluate(*node.right);
+            left = stack.back();
+            stack.pop_back();
+        }
+
+        if (quickening)
+            return quickened(node.quickening, node.oper, left, right);
+        return binary(node.oper, left, right);
+    }
+    case ExprKind::Call: {
+        auto &node = static_cast<Call &>(expr);
+        std::size_t calleeSlot = stack.size();
+        stack.push_back(evaluate(*node.callee));
+        for (auto &argument : node.arguments)
+            stack.push_back(evaluate(*argument));
+        return call(calleeSlot,
+                    static_cast<std::uint32_t>(node.arguments.size()),
+                    node.paren);
+    }
+    case ExprKind::Grouping:
+        return evaluate(*static_cast<Grouping &>(expr).expression);
+    case ExprKind::Literal: {
+        auto &value = static_cast<Literal &>(expr).value;
+        if (auto b = std::get_if<bool>(&value))
+            return Value::fromBool(*b);
+        if (auto d = std::get_if<double>(&value))
+            return Value::fromNumber(*d);
+        if (auto s = std::get_if<std::string>(&value))
+            return constant(&expr, *s);
+        return Value();
+    }
+    case ExprKind::Logical: {
+        auto &node = static_cast<Logical &>(expr);
+        Value left = evaluate(*node.left);
+        if (node.oper.type == Token::Type::OR ? isTruthy(left)
+                                              : !isTruthy(left))
+            return left;
+        return evaluate(*node.right);
+    }
+    case ExprKind::Unary: {
+        auto &node = static_cast<Unary &>(expr);
+        Value right = evaluate(*node.right);
+        if (node.oper.type == Token::Type::BANG)
+            return Value::fromBool(!isTruthy(right));
+        if (!right.isNumber())
+            throw RuntimeError(node.oper, "Operand must be a number.");
+        return Value::fromNumber(-right.asNumber());
+    }
+    case ExprKind::Variable: {
+        auto &node = static_cast<Variable &>(expr);
+        return read(node.name, node.resolution);
+    }
+    }
+    return Value();
+}
+
+Executor::Value Executor::binary(const Token &oper, Value left, Value right)
+{
+    switch (oper.type) {
+    case Token::Type::BANG_EQUAL:
+        return Value::fromBool(!isEqual(left, right));
+    case Token::Type::EQUAL_EQUAL:
+        return Value::fromBool(isEqual(left, right));
+    case Token::Type::PLUS:
+        if (isString(left) && isString(right))
+            return Value::fromObject(
+                objects.concat(left.asObject(), right.asObject()));
+        if (!left.isNumber() || !right.isNumber())
+            throw RuntimeError(oper,
+                               "Operands must be two numbers or two strings.");
+        return Value::fromNumber(left.asNumber() + right.asNumber());
+    default:
+        break;
+    }
+
+    if (!left.isNumber() || !right.isNumber())
+        throw RuntimeError(oper, "Operands must be numbers.");
+    double a = left.asNumber();
+    double b = right.asNumber();
+
+    switch (oper.type) {
+    case Token::Type::GREATER:
+        return Value::fromBool(a > b);
+    case Token::Type::GREATER_EQUAL:
+        return Value::fromBool(a >= b);
+    case Token::Type::LESS:
+        return Value::fromBool(a < b);
+    case Token::Type::LESS_EQUAL:
+        return Value::fromBool(a <= b);
+    case Token::Type::MINUS:
+        return Value::fromNumber(a - b);
+    case Token::Type::SLASH:
+        return Value::fromNumber(a / b);
+    case Token::Type::STAR:
+        return Value::fromNumber(a * b);
+    default:
+        throw RuntimeError(oper, "Unknown binary operator.");
+    }
+}
+
+// Inline, so that the operation is picked right in evaluate().
+inline Executor::Value Executor::quickened(Quickening &site,
+                                           const Token &oper, Value left,
+                                           Value right)
+{
+    using Op = Quickening::Op;
+    // Each specialized operation only guards the operand types, the
+    // operator is part of it.
+    bool numbers = left.isNumber() && right.isNumber();
+    double a = numbers ? left.asNumber() : 0;
+    double b = numbers ? right.asNumber() : 0;
+    switch (site.load()) {
+    case Op::Unobserved:
+        site.store(specialize(oper.type, left, right));
+        return binary(oper, left, right);
+    case Op::Generic:
+        return binary(oper, left, right);
+    case Op::AddNumbers:
+        if (numbers)
+            return Value::fromNumber(a + b);
+        break;
+    case Op::SubtractNumbers:
+        if (numbers)
+            return Value::fromNumber(a - b);
+        break;
+    case Op::MultiplyNumbers:
+        if (numbers)
+            return Value::fromNumber(a * b);
+        break;
+    case Op::DivideNumbers:
+        if (numbers)
+            return Value::fromNumber(a / b);
+        break;
+    case Op::GreaterNumbers:
+        if (numbers)
+            return Value::fromBool(a > b);
+        break;
+    case Op::GreaterEqualNumbers:
+        if (numbers)
+            return Value::fromBool(a >= b);
+        break;
+    case Op::LessNumbers:
+        if (numbers)
+            return Value::fromBool(a < b);
+        break;
+    case Op::LessEqualNumbers:
+        if (numbers)
+            return Value::fromBool(a <= b);
+        break;
+    case Op::EqualNumbers:
+        if (numbers)
+            return Value::fromBool(a == b);
+        break;
+    case Op::NotEqualNumbers:
+        if (numbers)
+            return Value::fromBool(a != b);
+        break;
+    case Op::ConcatStrings:
+        if (isString(left) && isString(right))
+            return Value::fromObject(
+                objects.concat(left.asObject(), right.asObject()));
+        break;
+    }
+
+    // A guard missed. The site saw more than one kind of operand and stays
+    // generic, rather than flip between specializations.
+    site.store(Op::Generic);
+    return binary(oper, left, right);
+}
+
+Executor::Value Executor::read(const Token &name, const Resolution &resolution)
+{
+    switch (resolution.kind) {
+    case Resolution::Kind::Local:
+        return stack[frameBase + resolution.index];
+    case Resolution::Kind::Upvalue: {
+        ObjUpvalue *upvalue = closure->upvalues()[resolution.index];
+        return upvalue->open ? stack[upvalue->slot] : upvalue->closed;
+    }
+    case Resolution::Kind::Global:
+        if (defined[resolution.index])
+            return globals[resolution.index];
+        break;
+    case Resolution::Kind::Unresolved:
+        break;
+    }
+
+    throw RuntimeError(name,
+                       fmt::format("Undefined variable '{}'.", name.lexeme));
+}
+
+void Executor::write(const Token &name, const Resolution &resolution,
+                     Value value)
+{
+    switch (resolution.kind) {
+    case Resolution::Kind::Local:
+        stack[frameBase + resolution.index] = value;
+        return;
+    case Resolution::Kind::Upvalue: {
+        ObjUpvalue *upvalue = closure->upvalues()[resolution.index];
+        if (upvalue->open) {
+            stack[upvalue->slot] = value;
+        } else {
+            upvalue->closed = value;
+            objects.writeBarrier(upvalue, &upvalue->closed, value);
+        }
+        return;
+    }
+    case Resolution::Kind::Global:
+        if (defined[resolution.index]) {
+            globals[resolution.index] = value;
+            return;
+        }
+        break;
+    case Resolution::Kind::Unresolved:
+        break;
+    }
+
+    throw RuntimeError(name,
+                       fmt::format("Undefined variable '{}'.", name.lexeme));
+}
+
+void Executor::declare(const Resolution &resolution, Value value)
+{
+    if (resolution.kind == Resolution::Kind::Global) {
+        globals[resolution.index] = value;
+        defined[resolution.index] = true;
+    } else {
+        stack[frameBase + resolution.index] = value;
+    }
+}
+
+Executor::Value Executor::constant(const void *node, std::string_view string)
+{
+    auto [it, added] = constantIndex.emplace(
+        node, static_cast<std::uint32_t>(constants.size()));
+    if (added)
+        constants.push_back(Value::fromObject(objects.intern(string)));
+    return constants[it->second];
+}
+
+Executor::Value Executor::makeClosure(Stmt<Value> &declaration)
+{
+    auto &node = static_cast<Function &>(declaration);
+
+    auto [it, added] = constantIndex.emplace(
+        &node, static_cast<std::uint32_t>(constants.size()));
+    if (added) {
+        constants.push_back(Value());
+        ObjFunction *function = objects.function(
+            objects.intern(node.name.lexeme), &node,
+            static_cast<std::uint32_t>(node.params.size()),
+            static_cast<std::uint32_t>(node.info.upvalues.size()));
+        constants[it->second] = Value::fromObject(function);
+    }
+
+    auto function = static_cast<ObjFunction *>(
+        constants[it->second].asObject());
+    stack.push_back(Value::fromObject(objects.closure(function)));
+
+    auto &upvalues = node.info.upvalues;
+    for (std::size_t i = 0; i < upvalues.size(); i++) {
+        ObjUpvalue *upvalue =
+            upvalues[i].isLocal ? captureUpvalue(frameBase + upvalues[i].index)
+                                : closure->upvalues()[upvalues[i].index];
+        auto made = static_cast<ObjClosure *>(stack.back().asObject());
+        made->upvalues()[i] = upvalue;
+        objects.writeBarrier(made, &made->upvalues()[i],
+                             Value::fromObject(upvalue));
+    }
+
+    Value made = stack.back();
+    stack.pop_back();
+    return made;
+}
+
+void Executor::compile(Stmt<Value> &declaration)
+{
+    GRAVLAX_TRACE_SCOPE("Executor::compile");
+    auto &node = static_cast<Function &>(declaration);
+
+    std::size_t errors = deferredErrors.count();
+    if (!node.lazy.tokens)
+        scanBody(node.lazy, deferredErrors);
+    Parser<Value> parser(deferredErrors);
+    parser.setLazyFunctions(true);
+    node.body = parser.parseLazyBody(node.lazy);
+    Resolver<Value> resolver(names, deferredErrors);
+    resolver.resolveLazy(node);
+
+    if (deferredErrors.count() > errors) {
+        // Reported again by the next call.
+        node.body.clear();
+        node.info.slotCount = 0;
+        throw RuntimeError(node.name, fmt::format("Could not compile '{}'.",
+                                                  node.name.lexeme));
+    }
+
+    node.lazy.tokens.reset();
+    // The body may use globals that nothing has mentioned so far.
+    globals.resize(names.size());
+    defined.resize(names.size());
+}
+
+ObjUpvalue *Executor::captureUpvalue(std::uint32_t slot)
+{
+    auto it = openUpvalues.end();
+    while (it != openUpvalues.begin() && (*(it - 1))->slot >= slot) {
+        --it;
+        if ((*it)->slot == slot)
+            return *it;
+    }
+
+    std::size_t position = it - openUpvalues.begin();
+    ObjUpvalue *upvalue = objects.upvalue(slot);
+    openUpvalues.insert(openUpvalues.begin() + position, upvalue);
+    return upvalue;
+}
+
+void Executor::closeUpvalues(std::uint32_t fromSlot)
+{
+    while (!openUpvalues.empty() && openUpvalues.back()->slot >= fromSlot) {
+        ObjUpvalue *upvalue = openUpvalues.back();
+        upvalue->closed = stack[upvalue->slot];
+        upvalue->open = 0;
+        objects.writeBarrier(upvalue, &upvalue->closed, upvalue->closed);
+        openUpvalues.pop_back();
+    }
+}
+
+Executor::Value Executor::call(std::size_t calleeSlot, std::uint32_t argCount,
+                               const Token &paren)
+{
+    Value callee = stack[calleeSlot];
+
+    if (isObject(callee, ObjType::Native)) {
+        auto native = static_cast<ObjNative *>(callee.asObject());
+        if (argCount != native->arity) {
+            throw RuntimeError(
+                paren, fmt::format("Expected {} arguments but got {}.",
+                                   native->arity, argCount));
+        }
+        Value result;
+        try {
+            result = native->function(objects, stack.data() + calleeSlot + 1);
+        } catch (NativeError &error) {
+            throw RuntimeError(paren, error.what());
+        } catch (HeapLimitError &) {
+            throw BudgetError(paren, BudgetError::Reason::Heap);
+        }
+        stack.resize(calleeSlot);
+        return result;
+    }
+
+    if (!isObject(callee, ObjType::Closure))
+        throw RuntimeError(paren, "Can only call functions and classes.");
+
+    auto target = static_cast<ObjClosure *>(callee.asObject());
+    ObjFunction *function = target->function;
+    if (argCount != function->arity) {
+        throw RuntimeError(paren,
+                           fmt::format("Expected {} arguments but got {}.",
+                                       function->arity, argCount));
+    }
+    if (frames.size() >= MaxFrames)
+        throw RuntimeError(paren, "Stack overflow.");
+    if (fuel-- == 0)
+        refuel(paren);
+    if (profiler::due())
+        sample(paren);
+
+    // The code is the declaration, which the executor owns.
+    auto &declaration =
+        *static_cast<Function *>(const_cast<void *>(function->code));
+    if (declaration.lazy.isPending())
+        compile(declaration);
+
+    auto base = static_cast<std::uint32_t>(calleeSlot + 1);
+    stack.resize(base + declaration.info.slotCount);
+
+    frames.push_back({target, base, &paren});
+    frameBase = base;
+    closure = target;
+
+    Completion completion = Completion::Normal;
+    try {
+        for (auto &stmt : declaration.body) {
+            completion = execute(*stmt);
+            if (completion == Completion::Return)
+                break;
+        }
+    } catch (HeapLimitError &) {
+        throw BudgetError(paren, BudgetError::Reason::Heap);
+    }
+    Value result = completion == Completion::Return ? returnValue : Value();
+    returnValue = Value();
+
+    closeUpvalues(base);
+    frames.pop_back();
+    closure = frames.back().closure;
+    frameBase = frames.back().base;
+    stack.resize(calleeSlot);
+
+    return result;
+}
+
+void Executor::startBudget()
+{
+    // The first step refuels.
+    fuel = 0;
+    stepsLeft = budget.steps;
+    deadline = budget.time.count()
+                   ? std::chrono::steady_clock::now() + budget.time
+                   : std::chrono::steady_clock::time_point::max();
+    objects.setAllocationLimit(
+        budget.heapBytes ? objects.stats().bytesAllocated + budget.heapBytes
+                         : 0);
+}
+
+void Executor::endBudget()
+{
+    objects.setAllocationLimit(0);
+}
+
+void Executor::refuel(const Token &site)
+{
+    if (preemptRequested.exchange(false, std::memory_order_relaxed))
+        throw BudgetError(site, BudgetError::Reason::Preempted);
+    if (deadline != std::chrono::steady_clock::time_point::max() &&
+        std::chrono::steady_clock::now() >= deadline)
+        throw BudgetError(site, BudgetError::Reason::Deadline);
+
+    std::uint64_t steps = CheckInterval;
+    if (budget.steps) {
+        if (stepsLeft == 0)
+            throw BudgetError(site, BudgetError::Reason::Steps);
+        steps = std::min(steps, stepsLeft);
+        stepsLeft -= steps;
+    }
+    // Less the step that is being taken.
+    fuel = steps - 1;
+}
+
+void Executor::sample(const Token &site)
+{
+    // Without a profile the sample is left to another executor.
+    if (!profile || !profiler::take())
+        return;
+
+    std::vector<profiler::Frame> stack;
+    stack.reserve(frames.size());
+    for (std::size_t i = 0; i < frames.size(); i++) {
+        const Token &at = i + 1 < frames.size() ? *frames[i + 1].site : site;
+        if (!frames[i].closure) {
+            stack.push_back({"<script>", at.offset});
+            continue;
+        }
+        auto &declaration = *static_cast<const Function *>(
+            frames[i].closure->function->code);
+        stack.push_back({declaration.name.lexeme, at.offset});
+    }
+    profile->record(std::move(stack));
+}
+
+bool Executor::isEqual(Value a, Value b)
+{
+    if (a.type() != b.type())
+        return false;
+
+    switch (a.type()) {
+    case Value::Type::Nil:
+        return true;
+    case Value::Type::Bool:
+        return a.asBool() == b.asBool();
+    case Value::Type::Number:
+        return a.asNumber() == b.asNumber();
+    case Value::Type::Object:
+        break;
+    }
+
+    if (a.asObject() == b.asObject())
+        return true;
+    if (!isString(a) || !isString(b))
+        return false;
+    if (stringLength(a.asObject()) != stringLength(b.asObject()))
+        return false;
+    if (a.asObject()->flags & b.asObject()->flags & Obj::Interned)
+        return false;
+
+    // Flattening either may move the other. Once both are flat, flatten()
+    // no longer allocates.
+    RootedValue left(objects, a);
+    RootedValue right(objects, b);
+    objects.flatten(left.get().asObject());
+    ObjString *y = objects.flatten(right.get().asObject());
+    ObjString *x = objects.flatten(left.get().asObject());
+    return x->hash == y->hash && x->view() == y->view();
+}
+
+std::string Executor::stringify(Value value)
+{
+    switch (value.type()) {
+    case Value::Type::Nil:
+        return "nil";
+    case Value::Type::Bool:
+        return value.asBool() ? "true" : "false";
+    case Value::Type::Number:
+        return fmt::format("{}", value.asNumber());
+    case Value::Type::Object:
+        break;
+    }
+
+    Obj *object = value.asObject();
+    switch (object->type) {
+    case ObjType::String:
+    case ObjType::Rope:
+        return std::string(objects.flatten(object)->view());
+    case ObjType::Closure:
+        return fmt::format(
+            "<fn {}>",
+            static_cast<ObjClosure *>(object)->function->name->view());
+    case ObjType::Function:
+        return fmt::format("<fn {}>",
+                           static_cast<ObjFunction *>(object)->name->view());
+    case ObjType::Native:
+        return "<native fn>";
+    case ObjType::Class:
+        return std::string(static_cast<ObjClass *>(object)->name->view());
+    case ObjType::Instance:
+        return "<instance>";
+    case ObjType::Slots:
+    case ObjType::Upvalue:
+        break;
+    }
+    return "<object>";
+}
+
+}; // namespace gravlax
@@ -0,0 +1,208 @@
+#include <fmt/core.h>
+
+#include <gravlax/interpreter.h>
+
+namespace gravlax
+{
+using gravlax::generated::Assign;
+using gravlax::generated::Binary;
+using gravlax::generated::Call;
+using gravlax::generated::Grouping;
+using gravlax::generated::Literal;
+using gravlax::generated::Logical;
+using gravlax::generated::Unary;
+using gravlax::generated::Variable;
+
+Value Interpreter::evaluate(Expr<Value> &expr)
+{
+    return expr.accept(*this);
+}
+
+void Interpreter::define(const std::string &name, Value value)
+{
+    globals.insert_or_assign(name, std::move(value));
+}
+
+Value Interpreter::visitLiteralExpr(Literal<Value> &expr)
+{
+    return expr.value;
+}
+
+Value Interpreter::visitGroupingExpr(Grouping<Value> &expr)
+{
+    return evaluate(*expr.expression);
+}
+
+Value Interpreter::visitVariableExpr(Variable<Value> &expr)
+{
+    auto it = globals.find(expr.name.lexeme);
+    if (it == globals.end()) {
+        throw RuntimeError(expr.name, fmt::format("Undefined variable '{}'.",
+                                                  expr.name.lexeme));
+    }
+    return it->second;
+}
+
+Value Interpreter::visitAssignExpr(Assign<Value> &expr)
+{
+    Value value = evaluate(*expr.value);
+
+    auto it = globals.find(expr.name.lexeme);
+    if (it == globals.end()) {
+        throw RuntimeError(expr.name, fmt::format("Undefined variable '{}'.",
+                                                  expr.name.lexeme));
+    }
+    it->second = value;
+    return value;
+}
+
+Value Interpreter::visitCallExpr(Call<Value> &expr)
+{
+    evaluate(*expr.callee);
+    for (auto &argument : expr.arguments)
+        evaluate(*argument);
+    throw RuntimeError(expr.paren, "Can only call functions and classes.");
+}
+
+Value Interpreter::visitLogicalExpr(Logical<Value> &expr)
+{
+    Value left = evaluate(*expr.left);
+
+    if (expr.oper.type == Token::Type::OR) {
+        if (isTruthy(left))
+            return left;
+    } else if (!isTruthy(left)) {
+        return left;
+    }
+
+    return evaluate(*expr.right);
+}
+
+Value Interpreter::visitUnaryExpr(Unary<Value> &expr)
+{
+    Value right = evaluate(*expr.right);
+
+    Value result;
+    if (auto error = unaryOperation(expr.oper.type, right, result))
+        throw RuntimeError(expr.oper, error);
+    return result;
+}
+
+Value Interpreter::visitBinaryExpr(Binary<Value> &expr)
+{
+    Value left = evaluate(*expr.left);
+    Value right = evaluate(*expr.right);
+
+    Value result;
+    if (auto error = binaryOperation(expr.oper.type, left, right, result))
+        throw RuntimeError(expr.oper, error);
+    return result;
+}
+
+const char *unaryOperation(Token::Type oper, const Value &right,
+                           Value &result)
+{
+    switch (oper) {
+    case Token::Type::BANG:
+        result = !Interpreter::isTruthy(right);
+        return nullptr;
+    case Token::Type::MINUS:
+        if (!std::holds_alternative<double>(right))
+            return "Operand must be a number.";
+        result = -std::get<double>(right);
+        return nullptr;
+    default:
+        return "Unknown unary operator.";
+    }
+}
+
+const char *binaryOperation(Token::Type oper, const Value &left,
+                            const Value &right, Value &result)
+{
+    switch (oper) {
+    case Token::Type::BANG_EQUAL:
+        result = !Interpreter::isEqual(left, right);
+        return nullptr;
+    case Token::Type::EQUAL_EQUAL:
+        result = Interpreter::isEqual(left, right);
+        return nullptr;
+    case Token::Type::PLUS:
+        if (std::holds_alternative<std::string>(left) &&
+            std::holds_alternative<std::string>(right)) {
+            result = std::get<std::string>(left) + std::get<std::string>(right);
+            return nullptr;
+        }
+        if (!std::holds_alternative<double>(left) ||
+            !std::holds_alternative<double>(right))
+            return "Operands must be two numbers or two strings.";
+        break;
+    default:
+        if (!std::holds_alternative<double>(left) ||
+            !std::holds_alternative<double>(right))
+            return "Operands must be numbers.";
+        break;
+    }
+
+    double a = std::get<double>(left);
+    double b = std::get<double>(right);
+
+    switch (oper) {
+    case Token::Type::GREATER:
+        result = a > b;
+        break;
+    case Token::Type::GREATER_EQUAL:
+        result = a >= b;
+        break;
+    case Token::Type::LESS:
+        result = a < b;
+        break;
+    case Token::Type::LESS_EQUAL:
+        result = a <= b;
+        break;
+    case Token::Type::MINUS:
+        result = a - b;
+        break;
+    case Token::Type::PLUS:
+        result = a + b;
+        break;
+    case Token::Type::SLASH:
+        result = a / b;
+        break;
+    case Token::Type::STAR:
+        result = a * b;
+        break;
+    default:
+        return "Unknown binary operator.";
+    }
+
+    return nullptr;
+}
+
+bool Interpreter::isTruthy(const Value &value)
+{
+    if (std::holds_alternative<std::monostate>(value))
+        return false;
+    if (std::holds_alternative<bool>(value))
+        return std::get<bool>(value);
+    return true;
+}
+
+bool Interpreter::isEqual(const Value &a, const Value &b)
+{
+    // Values of different types are never equal, numbers compare as IEEE
+    // doubles so NaN is not equal to itself.
+    return a == b;
+}
+
+std::string Interpreter::stringify(const Value &value)
+{
+    if (std::holds_alternative<std::monostate>(value))
+        return "nil";
+    if (std::holds_alternative<bool>(value))
+        return std::get<bool>(value) ? "true" : "false";
+    if (std::holds_alternative<double>(value))
+        return fmt::format("{}", std::get<double>(value));
+    return std::get<std::string>(value);
+}
+
+}; // namespace gravlax
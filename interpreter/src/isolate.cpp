@@ -0,0 +1,187 @@
+#include <algorithm>
+
+#include <gravlax/isolate.h>
+#include <gravlax/trace.h>
+
+#include <gravlax/utils/mpmc_queue.h>
+
+namespace gravlax
+{
+
+namespace
+{
+
+// Isolates with tasks that one worker's queue holds. When every queue is
+// full a post waits for the workers, and a worker keeps running the
+// isolate it has.
+constexpr std::size_t RunQueueCapacity = 4096;
+
+// Where the posts of a thread start looking for room, so that they spread
+// over the workers without a shared counter.
+thread_local std::size_t nextWorker = 0;
+
+}; // namespace
+
+Isolate::Isolate(std::shared_ptr<const Script> script, std::ostream &out,
+                 runtime::HeapOptions options)
+    : runner(std::move(script), out, options)
+{
+}
+
+Isolate::~Isolate()
+{
+    // Only tasks of a scheduler that was destroyed first are left, and no
+    // one pushes any more.
+    while (auto *node = tasks.pop())
+        delete static_cast<Task *>(node);
+}
+
+struct alignas(64) Scheduler::Worker {
+    std::size_t index;
+    utils::MpmcQueue<Isolate *> queue{RunQueueCapacity};
+    std::thread thread;
+};
+
+Scheduler::Scheduler(std::size_t count)
+{
+    count = std::max<std::size_t>(count, 1);
+    for (std::size_t i = 0; i < count; i++)
+        workers.push_back(std::make_unique<Worker>(i));
+    // Only started once every worker exists, as they steal from each other.
+    for (auto &worker : workers)
+        worker->thread = std::thread([this, &worker] { work(*worker); });
+}
+
+Scheduler::~Scheduler()
+{
+    drain();
+    stopping.store(true);
+    wakeups.fetch_add(1);
+    wakeups.notify_all();
+    for (auto &worker : workers)
+        worker->thread.join();
+}
+
+void Scheduler::post(Isolate &isolate, Task task)
+{
+    auto *node = new Isolate::Task;
+    node->run = std::move(task);
+    outstanding.fetch_add(1, std::memory_order_relaxed);
+    isolate.tasks.push(node);
+    if (isolate.pending.fetch_add(1, std::memory_order_acq_rel) == 0)
+        schedule(isolate);
+}
+
+void Scheduler::wait()
+{
+    drain();
+    if (failed.load(std::memory_order_acquire)) {
+        std::exception_ptr first = std::move(error);
+        error = nullptr;
+        failed.store(false, std::memory_order_relaxed);
+        std::rethrow_exception(first);
+    }
+}
+
+void Scheduler::drain()
+{
+    for (std::size_t n; (n = outstanding.load()) != 0;)
+        outstanding.wait(n);
+}
+
+void Scheduler::schedule(Isolate &isolate)
+{
+    std::size_t first = nextWorker++;
+    for (std::size_t i = first;; i++) {
+        if (workers[i % workers.size()]->queue.push(&isolate))
+            break;
+        if ((i + 1 - first) % workers.size() == 0)
+            std::this_thread::yield();
+    }
+
+    // Either a worker that goes to sleep sees the isolate in its queue, or
+    // this sees the worker among the sleepers and wakes it.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers.load(std::memory_order_relaxed) != 0) {
+        wakeups.fetch_add(1);
+        wakeups.notify_one();
+    }
+}
+
+Isolate *Scheduler::find(Worker &self)
+{
+    Isolate *isolate;
+    if (self.queue.pop(isolate))
+        return isolate;
+
+    // The neighbours first, so that thieves do not all start at one.
+    for (std::size_t i = 1; i < workers.size(); i++) {
+        Worker &victim = *workers[(self.index + i) % workers.size()];
+        if (victim.queue.pop(isolate))
+            return isolate;
+    }
+    return nullptr;
+}
+
+void Scheduler::work(Worker &self)
+{
+    for (;;) {
+        if (Isolate *isolate = find(self)) {
+            run(self, *isolate);
+            continue;
+        }
+
+        std::uint32_t seen = wakeups.load();
+        sleepers.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        Isolate *isolate = find(self);
+        if (!isolate && !stopping.load())
+            wakeups.wait(seen);
+        sleepers.fetch_sub(1);
+
+        if (isolate)
+            run(self, *isolate);
+        else if (stopping.load())
+            return;
+    }
+}
+
+void Scheduler::run(Worker &self, Isolate &isolate)
+{
+    GRAVLAX_TRACE_SCOPE("Scheduler::run");
+
+    for (;;) {
+        // The posts counted in pending have pushed their tasks, but a push
+        // in progress in front of them may hide them for a moment.
+        std::size_t batch = std::min(
+            isolate.pending.load(std::memory_order_acquire), BatchSize);
+        for (std::size_t i = 0; i < batch; i++) {
+            utils::MpscQueue::Node *node;
+            while (!(node = isolate.tasks.pop()))
+                std::this_thread::yield();
+
+            auto *task = static_cast<Isolate::Task *>(node);
+            try {
+                task->run(isolate.runner);
+            } catch (...) {
+                if (!failed.exchange(true, std::memory_order_acq_rel))
+                    error = std::current_exception();
+            }
+            delete task;
+        }
+
+        bool more = isolate.pending.fetch_sub(
+                        batch, std::memory_order_acq_rel) != batch;
+        if (outstanding.fetch_sub(batch) == batch)
+            outstanding.notify_all();
+        if (!more)
+            return;
+
+        // To the back of this worker's queue, behind the isolates that
+        // waited. With every queue full, keep running this one.
+        if (self.queue.push(&isolate))
+            return;
+    }
+}
+
+}; // namespace gravlax
@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <gravlax/line_index.h>
+
+namespace
+{
+
+// Appends the offset following every '\n' in data to starts. Sixteen bytes
+// are compared at a time, the scalar tail handles whatever is left.
+void findLineStarts(const char *data, std::size_t size,
+                    std::vector<int> &starts)
+{
+    std::size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        unsigned mask = static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+
+        while (mask != 0) {
+            starts.push_back(static_cast<int>(i + __builtin_ctz(mask) + 1));
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    while (i < size) {
+        auto found = static_cast<const char *>(
+            std::memchr(data + i, '\n', size - i));
+        if (found == nullptr)
+            break;
+        i = found - data + 1;
+        starts.push_back(static_cast<int>(i));
+    }
+}
+
+}; // namespace
+
+namespace gravlax
+{
+
+LineIndex::LineIndex(std::string_view source) : source(source) {}
+
+void LineIndex::reset(std::string_view source)
+{
+    this->source = source;
+    lineStarts.clear();
+    built = false;
+}
+
+void LineIndex::build() const
+{
+    if (built)
+        return;
+
+    lineStarts.clear();
+    lineStarts.push_back(0);
+    findLineStarts(source.data(), source.size(), lineStarts);
+    built = true;
+}
+
+SourceLocation LineIndex::locate(int offset) const
+{
+    build();
+
+    offset = std::clamp(offset, 0, static_cast<int>(source.size()));
+
+    // The last line start that is not past offset.
+    auto it = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset);
+    int line = static_cast<int>(it - lineStarts.begin());
+
+    return {line, offset - lineStarts[line - 1] + 1};
+}
+
+int LineIndex::lineCount() const
+{
+    build();
+    return static_cast<int>(lineStarts.size());
+}
+
+std::string_view LineIndex::lineText(int line) const
+{
+    build();
+
+    if (line < 1 || line > static_cast<int>(lineStarts.size()))
+        return {};
+
+    std::size_t begin = lineStarts[line - 1];
+    std::size_t end = line < static_cast<int>(lineStarts.size())
+                          ? lineStarts[line] - 1
+                          : source.size();
+
+    if (end > begin && source[end - 1] == '\r')
+        end--;
+
+    return source.substr(begin, end - begin);
+}
+
+}; // namespace gravlax
@@ -1,7 +1,255 @@
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <string_view>
+#include <system_error>
 
-int main(int argc, char *argv[])
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+
+#include <gravlax/ast_printer.h>
+#include <gravlax/diagnostics.h>
+#include <gravlax/executor.h>
+#include <gravlax/parser.h>
+#include <gravlax/pipeline.h>
+#include <gravlax/profiler.h>
+#include <gravlax/resolver.h>
+#include <gravlax/scanner.h>
+#include <gravlax/stats.h>
+#include <gravlax/trace.h>
+
+namespace
+{
+
+enum class StatsFormat { None, Text, Json };
+
+struct Options {
+    // A path, or "-" for stdin.
+    const char *script = nullptr;
+    const char *traceFile = nullptr;
+    // Sample the script's call stacks into this file as collapsed stacks.
+    const char *profileFile = nullptr;
+    // Start from this snapshot instead of an empty executor.
+    const char *snapshot = nullptr;
+    // Save the state the script leaves behind, so that it can be used as
+    // the prelude of later runs.
+    const char *saveSnapshot = nullptr;
+    bool printAst = false;
+    // Parse function bodies up front instead of on their first call, so
+    // that all compile errors are reported before anything runs.
+    bool eager = false;
+    // Rewrite binary operators for the operand types they see.
+    bool quicken = false;
+    StatsFormat stats = StatsFormat::None;
+};
+
+void usage()
+{
+    std::cerr << "Usage: gravlax [--print] [--eager] [--quicken] "
+                 "[--stats[=json]] [--trace=<file.json>] "
+                 "[--profile=<file.folded>] "
+                 "[--snapshot=<file>] [--save-snapshot=<file>] "
+                 "<script | ->\n";
+}
+
+bool parseArguments(int argc, char *argv[], Options &options)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+
+        if (arg == "--print") {
+            options.printAst = true;
+        } else if (arg == "--eager") {
+            options.eager = true;
+        } else if (arg == "--quicken") {
+            options.quicken = true;
+        } else if (arg == "--stats" || arg == "--stats=text") {
+            options.stats = StatsFormat::Text;
+        } else if (arg == "--stats=json") {
+            options.stats = StatsFormat::Json;
+        } else if (arg.starts_with("--trace=")) {
+            options.traceFile = argv[i] + std::strlen("--trace=");
+        } else if (arg.starts_with("--profile=")) {
+            options.profileFile = argv[i] + std::strlen("--profile=");
+        } else if (arg.starts_with("--snapshot=")) {
+            options.snapshot = argv[i] + std::strlen("--snapshot=");
+        } else if (arg.starts_with("--save-snapshot=")) {
+            options.saveSnapshot = argv[i] + std::strlen("--save-snapshot=");
+        } else if ((arg.starts_with("-") && arg != "-") || options.script) {
+            return false;
+        } else {
+            options.script = argv[i];
+        }
+    }
+
+    return options.script != nullptr;
+}
+
+int openScript(const char *path)
+{
+    if (std::string_view(path) == "-")
+        return STDIN_FILENO;
+    return ::open(path, O_RDONLY);
+}
+
+// Exit codes follow sysexits.h like the book does. The script is read,
+// scanned and parsed in a pipeline, see pipeline.h.
+int printAst(int fd)
+{
+    gravlax::Diagnostics diagnostics;
+    gravlax::Scanner scanner(diagnostics);
+    gravlax::Parser<std::string> parser(diagnostics);
+    gravlax::AstPrinter printer;
+
+    auto program = gravlax::parseStream(fd, scanner, parser);
+    if (diagnostics.hadError()) {
+        diagnostics.print(std::cerr, scanner.lineIndex());
+        return 65;
+    }
+
+    for (auto &stmt : program)
+        std::cout << printer.print(*stmt) << '\n';
+    return 0;
+}
+
+// Stops the profiler however the script ends. Does nothing if it was not
+// started.
+struct ProfilerGuard {
+    ~ProfilerGuard() { gravlax::profiler::stop(); }
+};
+
+int run(int fd, const Options &options)
 {
-    std::cout << "Hello world\n";
+    gravlax::Diagnostics diagnostics;
+    gravlax::Scanner scanner(diagnostics);
+    gravlax::Parser<gravlax::Executor::Value> parser(diagnostics);
+    gravlax::Executor executor;
+    parser.setLazyFunctions(!options.eager);
+    executor.setQuickening(options.quicken);
+
+    if (options.snapshot) {
+        try {
+            executor.loadSnapshot(options.snapshot);
+        } catch (gravlax::SnapshotError &error) {
+            std::cerr << error.what() << '\n';
+            return 66;
+        }
+    }
+
+    auto program = gravlax::parseStream(fd, scanner, parser);
+    gravlax::Resolver<gravlax::Executor::Value> resolver(
+        executor.globalNames(), diagnostics);
+    auto script = resolver.resolve(program);
+    if (diagnostics.hadError()) {
+        diagnostics.print(std::cerr, scanner.lineIndex());
+        return 65;
+    }
+
+    gravlax::profiler::Profile profile;
+    if (options.profileFile) {
+        executor.setProfile(&profile);
+        try {
+            gravlax::profiler::start();
+        } catch (std::system_error &error) {
+            std::cerr << fmt::format("Could not start the profiler: {}\n",
+                                     error.code().message());
+            return 71;
+        }
+    }
+
+    int status = 0;
+    {
+        ProfilerGuard guard;
+        try {
+            executor.execute(std::move(program), script);
+        } catch (gravlax::RuntimeError &error) {
+            // A function that was called for the first time did not compile.
+            if (executor.compileErrors().hadError()) {
+                executor.compileErrors().print(std::cerr,
+                                               scanner.lineIndex());
+                status = 65;
+            } else {
+                std::cerr << fmt::format(
+                    "{}\n[line {}]\n", error.what(),
+                    scanner.lineIndex().line(error.token.offset));
+                status = 70;
+            }
+        }
+    }
+
+    // Failing scripts are profiled too.
+    if (options.profileFile) {
+        std::ofstream out(options.profileFile);
+        profile.writeCollapsed(out, scanner.lineIndex());
+        std::cerr << profile.formatHotSpots(scanner.lineIndex());
+        if (!out) {
+            std::cerr << fmt::format("Could not write '{}'\n",
+                                     options.profileFile);
+            return status ? status : 74;
+        }
+    }
+    if (status != 0)
+        return status;
+
+    if (options.saveSnapshot) {
+        try {
+            executor.saveSnapshot(options.saveSnapshot, scanner.source());
+        } catch (gravlax::SnapshotError &error) {
+            std::cerr << error.what() << '\n';
+            return 74;
+        }
+    }
+
     return 0;
-}
\ No newline at end of file
+}
+
+}; // namespace
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        usage();
+        return 64;
+    }
+
+    if (options.traceFile)
+        gravlax::trace::start();
+
+    int fd = openScript(options.script);
+    int status;
+    try {
+        if (fd < 0)
+            throw std::system_error(errno, std::generic_category());
+        status = options.printAst ? printAst(fd) : run(fd, options);
+    } catch (std::system_error &error) {
+        std::cerr << fmt::format("Could not read '{}': {}\n", options.script,
+                                 std::strerror(error.code().value()));
+        status = 66;
+    }
+    if (fd > STDIN_FILENO)
+        ::close(fd);
+
+    std::cout.flush();
+    if (options.stats == StatsFormat::Text) {
+        std::cerr << gravlax::stats::formatText(gravlax::stats::current());
+    } else if (options.stats == StatsFormat::Json) {
+        std::cerr << gravlax::stats::formatJson(gravlax::stats::current())
+                  << '\n';
+    }
+
+    if (options.traceFile) {
+        gravlax::trace::stop();
+        std::ofstream out(options.traceFile);
+        gravlax::trace::writeChromeJson(out);
+        if (!out) {
+            std::cerr << fmt::format("Could not write '{}'\n",
+                                     options.traceFile);
+            return 74;
+        }
+    }
+
+    return status;
+}
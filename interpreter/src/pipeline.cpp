@@ -0,0 +1,53 @@
+#include <cerrno>
+#include <string>
+#include <system_error>
+
+#include <unistd.h>
+
+#include <gravlax/pipeline.h>
+#include <gravlax/stats.h>
+#include <gravlax/trace.h>
+
+namespace gravlax
+{
+
+namespace
+{
+
+// One read(2), retried if a signal interrupts it.
+std::size_t readSome(int fd, char *buffer, std::size_t size)
+{
+    GRAVLAX_STATS_PHASE(Load);
+    GRAVLAX_TRACE_SCOPE("read");
+
+    for (;;) {
+        ssize_t n = ::read(fd, buffer, size);
+        if (n >= 0)
+            return static_cast<std::size_t>(n);
+        if (errno != EINTR)
+            throw std::system_error(errno, std::generic_category(), "read");
+    }
+}
+
+}; // namespace
+
+utils::Generator<std::string_view> readChunks(int fd, std::size_t chunkSize)
+{
+    std::string buffer(chunkSize, '\0');
+    while (std::size_t n = readSome(fd, buffer.data(), buffer.size()))
+        co_yield std::string_view(buffer.data(), n);
+}
+
+utils::Generator<Token> scanChunks(Scanner &scanner,
+                                   utils::Generator<std::string_view> chunks)
+{
+    scanner.startStream();
+    for (std::string_view chunk : chunks) {
+        for (Token &token : scanner.feed(chunk))
+            co_yield std::move(token);
+    }
+    for (Token &token : scanner.finish())
+        co_yield std::move(token);
+}
+
+}; // namespace gravlax
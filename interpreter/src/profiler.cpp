@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <set>
+#include <system_error>
+#include <utility>
+
+#include <fmt/core.h>
+
+#include <gravlax/profiler.h>
+
+namespace
+{
+
+timer_t timer;
+bool running = false;
+struct sigaction previous;
+
+void onSignal(int)
+{
+    gravlax::profiler::detail::pending.store(true, std::memory_order_relaxed);
+}
+
+[[noreturn]] void fail()
+{
+    throw std::system_error(errno, std::generic_category());
+}
+
+// The entries with the highest counts, most first, as a table.
+std::string top(const char *title,
+                const std::map<std::string, std::uint64_t> &counts,
+                std::uint64_t total, std::size_t limit)
+{
+    std::vector<std::pair<std::string, std::uint64_t>> sorted(counts.begin(),
+                                                              counts.end());
+    std::stable_sort(sorted.begin(), sorted.end(), [](auto &a, auto &b) {
+        return a.second > b.second;
+    });
+    if (sorted.size() > limit)
+        sorted.resize(limit);
+
+    std::string s = fmt::format("{:<40} {:>8} {:>7}\n", title, "samples", "%");
+    for (auto &[name, count] : sorted)
+        s += fmt::format("{:<40} {:>8} {:>7.1f}\n", name, count,
+                         100.0 * count / total);
+    return s;
+}
+
+}; // namespace
+
+namespace gravlax::profiler
+{
+
+std::atomic<bool> detail::pending{false};
+
+void start(int hz)
+{
+    if (running)
+        stop();
+
+    struct sigaction action = {};
+    action.sa_handler = onSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, &previous) != 0)
+        fail();
+
+    sigevent event = {};
+    event.sigev_notify = SIGEV_SIGNAL;
+    event.sigev_signo = SIGPROF;
+    if (timer_create(CLOCK_PROCESS_CPUTIME_ID, &event, &timer) != 0) {
+        int error = errno;
+        sigaction(SIGPROF, &previous, nullptr);
+        errno = error;
+        fail();
+    }
+
+    long nanos = 1'000'000'000L / std::max(hz, 1);
+    itimerspec interval = {};
+    interval.it_interval.tv_sec = nanos / 1'000'000'000L;
+    interval.it_interval.tv_nsec = nanos % 1'000'000'000L;
+    interval.it_value = interval.it_interval;
+    if (timer_settime(timer, 0, &interval, nullptr) != 0) {
+        int error = errno;
+        timer_delete(timer);
+        sigaction(SIGPROF, &previous, nullptr);
+        errno = error;
+        fail();
+    }
+    running = true;
+}
+
+void stop()
+{
+    if (!running)
+        return;
+
+    timer_delete(timer);
+    sigaction(SIGPROF, &previous, nullptr);
+    detail::pending.store(false, std::memory_order_relaxed);
+    running = false;
+}
+
+void Profile::record(std::vector<Frame> stack)
+{
+    stacks[std::move(stack)]++;
+    samples++;
+}
+
+void Profile::clear()
+{
+    stacks.clear();
+    samples = 0;
+}
+
+void Profile::writeCollapsed(std::ostream &out, const LineIndex &lines) const
+{
+    for (auto &[stack, count] : stacks) {
+        std::string line;
+        for (auto &frame : stack) {
+            if (!line.empty())
+                line += ';';
+            line += fmt::format("{}:{}", frame.function,
+                                lines.line(frame.offset));
+        }
+        out << line << ' ' << count << '\n';
+    }
+}
+
+std::string Profile::formatHotSpots(const LineIndex &lines,
+                                    std::size_t limit) const
+{
+    std::map<std::string, std::uint64_t> self;
+    std::map<std::string, std::uint64_t> total;
+    std::map<std::string, std::uint64_t> selfLines;
+
+    for (auto &[stack, count] : stacks) {
+        if (stack.empty())
+            continue;
+        const Frame &innermost = stack.back();
+        self[innermost.function] += count;
+        selfLines[fmt::format("{} line {}", innermost.function,
+                              lines.line(innermost.offset))] += count;
+
+        // Recursion counts a function once per sample.
+        std::set<std::string_view> seen;
+        for (auto &frame : stack) {
+            if (seen.insert(frame.function).second)
+                total[frame.function] += count;
+        }
+    }
+
+    std::uint64_t all = std::max<std::uint64_t>(samples, 1);
+    return fmt::format("{} samples\n", samples) +
+           top("self", self, all, limit) + top("total", total, all, limit) +
+           top("line", selfLines, all, limit);
+}
+
+}; // namespace gravlax::profiler
@@ -0,0 +1,493 @@
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+#include <fmt/core.h>
+
+#include <gravlax/register_vm.h>
+#include <gravlax/trace.h>
+
+#include <gravlax/generated/assign.h>
+#include <gravlax/generated/binary.h>
+#include <gravlax/generated/call.h>
+#include <gravlax/generated/grouping.h>
+#include <gravlax/generated/literal.h>
+#include <gravlax/generated/logical.h>
+#include <gravlax/generated/unary.h>
+#include <gravlax/generated/variable.h>
+
+namespace
+{
+using namespace gravlax;
+using Op = RegisterProgram::Op;
+using gravlax::generated::Binary;
+using gravlax::generated::Grouping;
+using gravlax::generated::Literal;
+using gravlax::generated::Logical;
+using gravlax::generated::Unary;
+using gravlax::generated::Variable;
+
+constexpr std::size_t MaxRegisters = std::numeric_limits<std::uint16_t>::max();
+
+// The first of the three ops of a binary operator, see Op.
+Op binaryOp(Token::Type oper)
+{
+    switch (oper) {
+    case Token::Type::PLUS:
+        return Op::Add;
+    case Token::Type::MINUS:
+        return Op::Subtract;
+    case Token::Type::STAR:
+        return Op::Multiply;
+    case Token::Type::SLASH:
+        return Op::Divide;
+    case Token::Type::GREATER:
+        return Op::Greater;
+    case Token::Type::GREATER_EQUAL:
+        return Op::GreaterEqual;
+    case Token::Type::LESS:
+        return Op::Less;
+    case Token::Type::LESS_EQUAL:
+        return Op::LessEqual;
+    case Token::Type::EQUAL_EQUAL:
+        return Op::Equal;
+    default:
+        return Op::NotEqual;
+    }
+}
+
+const double *number(const Value &value)
+{
+    return std::get_if<double>(&value);
+}
+
+const double *number(const double &k)
+{
+    return &k;
+}
+
+const Value &boxed(const Value &value)
+{
+    return value;
+}
+
+Value boxed(double k)
+{
+    return k;
+}
+
+// Two numbers are the fast path. Anything else goes through
+// binaryOperation(), for strings and for the error. dst may be one of the
+// operands.
+template <Token::Type Oper, typename A, typename B>
+inline const char *binary(Value &dst, const A &a, const B &b)
+{
+    const double *x = number(a);
+    const double *y = number(b);
+    if (x && y) [[likely]] {
+        if constexpr (Oper == Token::Type::PLUS)
+            dst = *x + *y;
+        else if constexpr (Oper == Token::Type::MINUS)
+            dst = *x - *y;
+        else if constexpr (Oper == Token::Type::STAR)
+            dst = *x * *y;
+        else if constexpr (Oper == Token::Type::SLASH)
+            dst = *x / *y;
+        else if constexpr (Oper == Token::Type::GREATER)
+            dst = *x > *y;
+        else if constexpr (Oper == Token::Type::GREATER_EQUAL)
+            dst = *x >= *y;
+        else if constexpr (Oper == Token::Type::LESS)
+            dst = *x < *y;
+        else if constexpr (Oper == Token::Type::LESS_EQUAL)
+            dst = *x <= *y;
+        else if constexpr (Oper == Token::Type::EQUAL_EQUAL)
+            dst = *x == *y;
+        else
+            dst = *x != *y;
+        return nullptr;
+    }
+    return binaryOperation(Oper, boxed(a), boxed(b), dst);
+}
+
+}; // namespace
+
+namespace gravlax
+{
+
+// Compiles the tree in post-order. Each temporary is read once, by the
+// instruction of its parent, so a register is free again as soon as that
+// instruction is emitted, and the parent can write its result over an
+// operand. This is linear scan over the intervals of a tree.
+class RegisterCompiler
+{
+    // A register, or a number that is not in one yet.
+    struct Operand {
+        bool constant;
+        bool temporary;
+        std::uint16_t reg;
+        double k;
+    };
+
+    RegisterProgram &program;
+    std::string &error;
+    std::unordered_map<std::string, std::uint16_t> inputs;
+    std::vector<std::uint16_t> freeRegisters;
+
+  public:
+    RegisterCompiler(RegisterProgram &program, std::string &error)
+        : program(program), error(error)
+    {
+    }
+
+    bool compile(Expr<Value> &expr)
+    {
+        // The inputs take the first registers, so they are found first.
+        findInputs(expr);
+        program.registers = program.inputNames.size();
+
+        Operand result = compileNode(expr);
+        if (!error.empty())
+            return false;
+        program.result = inRegister(result, nullptr).reg;
+        if (program.registers > MaxRegisters) {
+            error = "Expression is too large.";
+            return false;
+        }
+        return true;
+    }
+
+  private:
+    void findInputs(Expr<Value> &expr)
+    {
+        switch (expr.kind()) {
+        case ExprKind::Binary: {
+            auto &node = static_cast<Binary<Value> &>(expr);
+            findInputs(*node.left);
+            findInputs(*node.right);
+            break;
+        }
+        case ExprKind::Grouping:
+            findInputs(*static_cast<Grouping<Value> &>(expr).expression);
+            break;
+        case ExprKind::Logical: {
+            auto &node = static_cast<Logical<Value> &>(expr);
+            findInputs(*node.left);
+            findInputs(*node.right);
+            break;
+        }
+        case ExprKind::Unary:
+            findInputs(*static_cast<Unary<Value> &>(expr).right);
+            break;
+        case ExprKind::Variable: {
+            auto &name = static_cast<Variable<Value> &>(expr).name;
+            auto index = static_cast<std::uint16_t>(inputs.size());
+            if (inputs.emplace(name.lexeme, index).second) {
+                program.inputNames.push_back(name.lexeme);
+                program.inputTokens.push_back(name);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    std::uint16_t allocate()
+    {
+        if (freeRegisters.empty())
+            return static_cast<std::uint16_t>(program.registers++);
+        std::uint16_t reg = freeRegisters.back();
+        freeRegisters.pop_back();
+        return reg;
+    }
+
+    void release(const Operand &operand)
+    {
+        if (operand.temporary)
+            freeRegisters.push_back(operand.reg);
+    }
+
+    void emit(Op op, const Token *site, std::uint16_t dst,
+              std::uint16_t a = 0, std::uint16_t b = 0, double k = 0)
+    {
+        program.code.push_back({op, dst, a, b, k});
+        program.sites.push_back(
+            site ? *site : Token(Token::Type::END_OF_FILE, "", 0));
+    }
+
+    Operand temporary(std::uint16_t reg)
+    {
+        return {false, true, reg, 0};
+    }
+
+    // Loads a number operand into a temporary.
+    Operand inRegister(Operand operand, const Token *site)
+    {
+        if (!operand.constant)
+            return operand;
+        std::uint16_t reg = allocate();
+        emit(Op::LoadNumber, site, reg, 0, 0, operand.k);
+        return temporary(reg);
+    }
+
+    Operand compileNode(Expr<Value> &expr)
+    {
+        switch (expr.kind()) {
+        case ExprKind::Binary: {
+            auto &node = static_cast<Binary<Value> &>(expr);
+            Operand left = compileNode(*node.left);
+            Operand right = compileNode(*node.right);
+            if (left.constant && right.constant)
+                left = inRegister(left, &node.oper);
+            release(left);
+            release(right);
+
+            std::uint16_t dst = allocate();
+            auto op = static_cast<int>(binaryOp(node.oper.type));
+            if (right.constant)
+                emit(Op(op + 1), &node.oper, dst, left.reg, 0, right.k);
+            else if (left.constant)
+                emit(Op(op + 2), &node.oper, dst, 0, right.reg, left.k);
+            else
+                emit(Op(op), &node.oper, dst, left.reg, right.reg);
+            return temporary(dst);
+        }
+        case ExprKind::Grouping:
+            return compileNode(
+                *static_cast<Grouping<Value> &>(expr).expression);
+        case ExprKind::Literal: {
+            const Value &value = static_cast<Literal<Value> &>(expr).value;
+            if (auto k = std::get_if<double>(&value))
+                return {true, false, 0, *k};
+            if (program.constants.size() > MaxRegisters)
+                error = "Expression is too large.";
+            std::uint16_t reg = allocate();
+            emit(Op::LoadConstant, nullptr, reg,
+                 static_cast<std::uint16_t>(program.constants.size()));
+            program.constants.push_back(value);
+            return temporary(reg);
+        }
+        case ExprKind::Logical: {
+            auto &node = static_cast<Logical<Value> &>(expr);
+            // The result is the left operand unless the right one is
+            // evaluated, so both end up in dst.
+            Operand left = compileNode(*node.left);
+            std::uint16_t dst;
+            if (left.temporary) {
+                dst = left.reg;
+            } else {
+                dst = allocate();
+                if (left.constant)
+                    emit(Op::LoadNumber, &node.oper, dst, 0, 0, left.k);
+                else
+                    emit(Op::Move, &node.oper, dst, left.reg);
+            }
+
+            std::size_t jump = program.code.size();
+            emit(node.oper.type == Token::Type::OR ? Op::JumpIfTrue
+                                                   : Op::JumpIfFalse,
+                 &node.oper, 0, dst);
+
+            Operand right = compileNode(*node.right);
+            if (right.constant)
+                emit(Op::LoadNumber, &node.oper, dst, 0, 0, right.k);
+            else if (right.reg != dst)
+                emit(Op::Move, &node.oper, dst, right.reg);
+            release(right);
+            program.code[jump].b =
+                static_cast<std::uint16_t>(program.code.size());
+            if (program.code.size() > MaxRegisters)
+                error = "Expression is too large.";
+            return temporary(dst);
+        }
+        case ExprKind::Unary: {
+            auto &node = static_cast<Unary<Value> &>(expr);
+            Operand right = compileNode(*node.right);
+            // A negative literal stays a constant.
+            if (right.constant && node.oper.type == Token::Type::MINUS)
+                return {true, false, 0, -right.k};
+            right = inRegister(right, &node.oper);
+            release(right);
+
+            std::uint16_t dst = allocate();
+            emit(node.oper.type == Token::Type::MINUS ? Op::Negate : Op::Not,
+                 &node.oper, dst, right.reg);
+            return temporary(dst);
+        }
+        case ExprKind::Variable: {
+            auto &name = static_cast<Variable<Value> &>(expr).name;
+            return {false, false, inputs.at(name.lexeme), 0};
+        }
+        case ExprKind::Assign:
+        case ExprKind::Call: {
+            auto name = gravlax::generated::ExprKindNames[static_cast<int>(
+                expr.kind())];
+            error = std::string(name) +
+                    " is not supported in register programs.";
+            return {true, false, 0, 0};
+        }
+        }
+        return {true, false, 0, 0};
+    }
+};
+
+std::unique_ptr<RegisterProgram> RegisterProgram::compile(Expr<Value> &expr,
+                                                          std::string &error)
+{
+    GRAVLAX_TRACE_SCOPE("RegisterProgram::compile");
+
+    std::unique_ptr<RegisterProgram> program(new RegisterProgram());
+    if (!RegisterCompiler(*program, error).compile(expr))
+        return {};
+    return program;
+}
+
+void RegisterProgram::fail(std::size_t pc, const char *error) const
+{
+    throw RuntimeError(sites[pc], error);
+}
+
+Value RegisterProgram::evaluate(std::span<const Value> inputs,
+                                std::vector<Value> &frame) const
+{
+    if (inputs.size() < inputNames.size()) {
+        const Token &name = inputTokens[inputs.size()];
+        throw RuntimeError(name, fmt::format("Undefined variable '{}'.",
+                                             name.lexeme));
+    }
+    frame.resize(registers);
+    std::copy_n(inputs.begin(), inputNames.size(), frame.begin());
+
+    using enum Token::Type;
+    Value *r = frame.data();
+    const Instruction *instructions = code.data();
+    const std::size_t size = code.size();
+    for (std::size_t pc = 0; pc < size;) {
+        const Instruction &i = instructions[pc++];
+        const char *error = nullptr;
+        switch (i.op) {
+        case Op::Move:
+            r[i.dst] = r[i.a];
+            break;
+        case Op::LoadNumber:
+            r[i.dst] = i.k;
+            break;
+        case Op::LoadConstant:
+            r[i.dst] = constants[i.a];
+            break;
+        case Op::Negate:
+            if (auto x = number(r[i.a]))
+                r[i.dst] = -*x;
+            else
+                error = unaryOperation(MINUS, r[i.a], r[i.dst]);
+            break;
+        case Op::Not:
+            r[i.dst] = !Interpreter::isTruthy(r[i.a]);
+            break;
+        case Op::Add:
+            error = binary<PLUS>(r[i.dst], r[i.a], r[i.b]);
+            break;
+        case Op::AddK:
+            error = binary<PLUS>(r[i.dst], r[i.a], i.k);
+            break;
+        case Op::KAdd:
+            error = binary<PLUS>(r[i.dst], i.k, r[i.b]);
+            break;
+        case Op::Subtract:
+            error = binary<MINUS>(r[i.dst], r[i.a], r[i.b]);
+            break;
+        case Op::SubtractK:
+            error = binary<MINUS>(r[i.dst], r[i.a], i.k);
+            break;
+        case Op::KSubtract:
+            error = binary<MINUS>(r[i.dst], i.k, r[i.b]);
+            break;
+        case Op::Multiply:
+            error = binary<STAR>(r[i.dst], r[i.a], r[i.b]);
+            break;
+        case Op::MultiplyK:
+            error = binary<STAR>(r[i.dst], r[i.a], i.k);
+            break;
+        case Op::KMultiply:
+            error = binary<STAR>(r[i.dst], i.k, r[i.b]);
+            break;
+        case Op::Divide:
+            error = binary<SLASH>(r[i.dst], r[i.a], r[i.b]);
+            break;
+        case Op::DivideK:
+            error = binary<SLASH>(r[i.dst], r[i.a], i.k);
+            break;
+        case Op::KDivide:
+            error = binary<SLASH>(r[i.dst], i.k, r[i.b]);
+            break;
+        case Op::Greater:
+            error = binary<GREATER>(r[i.dst], r[i.a], r[i.b]);
+            break;
+        case Op::GreaterK:
+            error = binary<GREATER>(r[i.dst], r[i.a], i.k);
+            break;
+        case Op::KGreater:
+            error = binary<GREATER>(r[i.dst], i.k, r[i.b]);
+            break;
+        case Op::GreaterEqual:
+            error = binary<GREATER_EQUAL>(r[i.dst], r[i.a], r[i.b]);
+            break;
+        case Op::GreaterEqualK:
+            error = binary<GREATER_EQUAL>(r[i.dst], r[i.a], i.k);
+            break;
+        case Op::KGreaterEqual:
+            error = binary<GREATER_EQUAL>(r[i.dst], i.k, r[i.b]);
+            break;
+        case Op::Less:
+            error = binary<LESS>(r[i.dst], r[i.a], r[i.b]);
+            break;
+        case Op::LessK:
+            error = binary<LESS>(r[i.dst], r[i.a], i.k);
+            break;
+        case Op::KLess:
+            error = binary<LESS>(r[i.dst], i.k, r[i.b]);
+            break;
+        case Op::LessEqual:
+            error = binary<LESS_EQUAL>(r[i.dst], r[i.a], r[i.b]);
+            break;
+        case Op::LessEqualK:
+            error = binary<LESS_EQUAL>(r[i.dst], r[i.a], i.k);
+            break;
+        case Op::KLessEqual:
+            error = binary<LESS_EQUAL>(r[i.dst], i.k, r[i.b]);
+            break;
+        case Op::Equal:
+            error = binary<EQUAL_EQUAL>(r[i.dst], r[i.a], r[i.b]);
+            break;
+        case Op::EqualK:
+            error = binary<EQUAL_EQUAL>(r[i.dst], r[i.a], i.k);
+            break;
+        case Op::KEqual:
+            error = binary<EQUAL_EQUAL>(r[i.dst], i.k, r[i.b]);
+            break;
+        case Op::NotEqual:
+            error = binary<BANG_EQUAL>(r[i.dst], r[i.a], r[i.b]);
+            break;
+        case Op::NotEqualK:
+            error = binary<BANG_EQUAL>(r[i.dst], r[i.a], i.k);
+            break;
+        case Op::KNotEqual:
+            error = binary<BANG_EQUAL>(r[i.dst], i.k, r[i.b]);
+            break;
+        case Op::JumpIfFalse:
+            if (!Interpreter::isTruthy(r[i.a]))
+                pc = i.b;
+            break;
+        case Op::JumpIfTrue:
+            if (Interpreter::isTruthy(r[i.a]))
+                pc = i.b;
+            break;
+        }
+        if (error) [[unlikely]]
+            fail(pc - 1, error);
+    }
+    return r[result];
+}
+
+}; // namespace gravlax
@@ -0,0 +1,21 @@
+#include <gravlax/resolver.h>
+
+namespace gravlax
+{
+
+std::uint32_t Globals::indexOf(const std::string &name)
+{
+    auto [it, added] =
+        indices.emplace(name, static_cast<std::uint32_t>(names.size()));
+    if (added)
+        names.push_back(name);
+    return it->second;
+}
+
+int Globals::find(const std::string &name) const
+{
+    auto it = indices.find(name);
+    return it == indices.end() ? -1 : static_cast<int>(it->second);
+}
+
+}; // namespace gravlax
@@ -0,0 +1,270 @@
+#include <fmt/core.h>
+
+#include <gravlax/rules.h>
+#include <gravlax/stats.h>
+#include <gravlax/trace.h>
+
+namespace
+{
+using namespace gravlax;
+using Operand = RuleProgram::Operand;
+using Source = RuleProgram::Source;
+using gravlax::generated::Binary;
+using gravlax::generated::Grouping;
+using gravlax::generated::Literal;
+using gravlax::generated::Logical;
+using gravlax::generated::Unary;
+using gravlax::generated::Variable;
+
+const char *parseFailed = "Rule failed to parse.";
+
+// Flattens the shared trees of all rules into one instruction list in
+// dependency order, visiting every shared node once.
+struct Flattener {
+    std::vector<Value> &constants;
+    std::vector<std::string> &inputNames;
+    std::vector<RuleProgram::Instruction> &code;
+
+    std::unordered_map<const Expr<Value> *, Operand> done{};
+    std::unordered_map<std::string, int> inputs{};
+
+    Operand flatten(Expr<Value> &expr)
+    {
+        auto it = done.find(&expr);
+        if (it != done.end())
+            return it->second;
+
+        Operand result{Source::Invalid, -1};
+
+        switch (expr.kind()) {
+        case ExprKind::Binary: {
+            auto &node = static_cast<Binary<Value> &>(expr);
+            Operand left = flatten(*node.left);
+            Operand right = flatten(*node.right);
+            code.push_back({node.oper.type, left, right});
+            result = {Source::Slot, static_cast<int>(code.size() - 1)};
+            break;
+        }
+        case ExprKind::Grouping:
+            result = flatten(*static_cast<Grouping<Value> &>(expr).expression);
+            break;
+        case ExprKind::Literal:
+            constants.push_back(static_cast<Literal<Value> &>(expr).value);
+            result = {Source::Constant, static_cast<int>(constants.size() - 1)};
+            break;
+        case ExprKind::Unary: {
+            auto &node = static_cast<Unary<Value> &>(expr);
+            Operand right = flatten(*node.right);
+            code.push_back({node.oper.type, right, {Source::None, -1}});
+            result = {Source::Slot, static_cast<int>(code.size() - 1)};
+            break;
+        }
+        case ExprKind::Variable: {
+            auto &name = static_cast<Variable<Value> &>(expr).name.lexeme;
+            auto [input, added] =
+                inputs.emplace(name, static_cast<int>(inputNames.size()));
+            if (added)
+                inputNames.push_back(name);
+            result = {Source::Input, input->second};
+            break;
+        }
+        case ExprKind::Logical: {
+            auto &node = static_cast<Logical<Value> &>(expr);
+            Operand left = flatten(*node.left);
+            Operand right = flatten(*node.right);
+            code.push_back({node.oper.type, left, right});
+            result = {Source::Slot, static_cast<int>(code.size() - 1)};
+            break;
+        }
+        case ExprKind::Assign:
+        case ExprKind::Call:
+            // RuleCompiler::add() turns rules with these into errors.
+            break;
+        }
+
+        done.emplace(&expr, result);
+        return result;
+    }
+};
+
+}; // namespace
+
+namespace gravlax
+{
+
+RuleCompiler::RuleCompiler() : scanner(diagnostics), parser(diagnostics)
+{
+    parser.shareSubexpressions(true);
+}
+
+std::size_t RuleCompiler::add(const std::string &source)
+{
+    std::size_t index = roots.size();
+
+    diagnostics.clear();
+    auto expr = parser.parse(scanner.scanString(source));
+    if (!diagnostics.hadError() && expr)
+        checkPure(*expr);
+
+    if (!diagnostics.hadError() && expr) {
+        roots.push_back(expr);
+        return index;
+    }
+
+    for (auto &diagnostic : diagnostics.all()) {
+        errorMessages.push_back(fmt::format(
+            "rule {}: {}", index,
+            Diagnostics::format(diagnostic, scanner.lineIndex())));
+    }
+    roots.push_back({});
+    return index;
+}
+
+void RuleCompiler::checkPure(Expr<Value> &expr)
+{
+    switch (expr.kind()) {
+    case ExprKind::Assign: {
+        auto &node = static_cast<gravlax::generated::Assign<Value> &>(expr);
+        diagnostics.error(node.name.offset,
+                          fmt::format(" at '{}'", node.name.lexeme),
+                          "Can't assign in a rule.");
+        checkPure(*node.value);
+        break;
+    }
+    case ExprKind::Binary: {
+        auto &node = static_cast<Binary<Value> &>(expr);
+        checkPure(*node.left);
+        checkPure(*node.right);
+        break;
+    }
+    case ExprKind::Call: {
+        auto &node = static_cast<gravlax::generated::Call<Value> &>(expr);
+        diagnostics.error(node.paren.offset, " at ')'",
+                          "Can't call functions in a rule.");
+        break;
+    }
+    case ExprKind::Grouping:
+        checkPure(*static_cast<Grouping<Value> &>(expr).expression);
+        break;
+    case ExprKind::Logical: {
+        auto &node = static_cast<Logical<Value> &>(expr);
+        checkPure(*node.left);
+        checkPure(*node.right);
+        break;
+    }
+    case ExprKind::Unary:
+        checkPure(*static_cast<Unary<Value> &>(expr).right);
+        break;
+    case ExprKind::Literal:
+    case ExprKind::Variable:
+        break;
+    }
+}
+
+RuleProgram RuleCompiler::compile() const
+{
+    GRAVLAX_TRACE_SCOPE("RuleCompiler::compile");
+
+    RuleProgram program;
+    Flattener flattener{program.constants, program.inputNames, program.code};
+
+    for (auto &root : roots) {
+        if (root) {
+            program.rules.push_back(flattener.flatten(*root));
+        } else {
+            program.rules.push_back({Source::Invalid, -1});
+        }
+    }
+
+    return program;
+}
+
+RuleProgram RuleCompiler::compile(const std::vector<std::string> &sources,
+                                  std::vector<std::string> &errors)
+{
+    RuleCompiler compiler;
+    for (auto &source : sources)
+        compiler.add(source);
+    errors = compiler.errors();
+    return compiler.compile();
+}
+
+int RuleProgram::inputIndex(const std::string &name) const
+{
+    for (std::size_t i = 0; i < inputNames.size(); i++) {
+        if (inputNames[i] == name)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+void RuleProgram::evaluate(std::span<const Value> inputs,
+                           std::vector<RuleResult> &results) const
+{
+    GRAVLAX_STATS_PHASE(Evaluate);
+    GRAVLAX_TRACE_SCOPE("RuleProgram::evaluate");
+
+    static const Value nil;
+
+    std::vector<Value> slots(code.size());
+    std::vector<const char *> errors(code.size(), nullptr);
+
+    // Missing inputs read as nil.
+    auto fetch = [&](Operand operand, const char *&error) -> const Value & {
+        switch (operand.source) {
+        case Source::Constant:
+            return constants[operand.index];
+        case Source::Input:
+            return static_cast<std::size_t>(operand.index) < inputs.size()
+                       ? inputs[operand.index]
+                       : nil;
+        case Source::Slot:
+            if (errors[operand.index])
+                error = errors[operand.index];
+            return slots[operand.index];
+        case Source::None:
+            return nil;
+        case Source::Invalid:
+            error = parseFailed;
+            return nil;
+        }
+        return nil;
+    };
+
+    for (std::size_t i = 0; i < code.size(); i++) {
+        const Instruction &ins = code[i];
+        const char *error = nullptr;
+
+        const Value &a = fetch(ins.a, error);
+        if (ins.b.source == Source::None) {
+            if (!error)
+                error = unaryOperation(ins.oper, a, slots[i]);
+        } else if (ins.oper == Token::Type::AND ||
+                   ins.oper == Token::Type::OR) {
+            // The right operand, and its error, only count when it is the
+            // result.
+            if (!error) {
+                bool truthy = Interpreter::isTruthy(a);
+                if (ins.oper == Token::Type::OR ? truthy : !truthy)
+                    slots[i] = a;
+                else
+                    slots[i] = fetch(ins.b, error);
+            }
+        } else {
+            const Value &b = fetch(ins.b, error);
+            if (!error)
+                error = binaryOperation(ins.oper, a, b, slots[i]);
+        }
+
+        errors[i] = error;
+    }
+
+    results.resize(rules.size());
+    for (std::size_t r = 0; r < rules.size(); r++) {
+        const char *error = nullptr;
+        results[r].value = fetch(rules[r], error);
+        results[r].error = error;
+    }
+}
+
+}; // namespace gravlax
@@ -0,0 +1,739 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include <fmt/core.h>
+
+#include <gravlax/runtime/heap.h>
+#include <gravlax/trace.h>
+
+namespace
+{
+
+// One card covers 512 bytes of a block.
+constexpr int CardShift = 9;
+
+// Crossing entries are 16-bit word offsets, which reach 512 KiB.
+constexpr std::size_t MaxBlockBytes = std::size_t(1) << 19;
+
+std::size_t align8(std::size_t n)
+{
+    return (n + 7) & ~std::size_t(7);
+}
+
+std::uint64_t nowNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+}; // namespace
+
+namespace gravlax::runtime
+{
+
+// The header of an old generation block, followed by a card byte and a
+// crossing entry per 512 bytes of the block, and then by the objects. Blocks
+// are aligned to their size, so the block of an object is found by masking
+// its address.
+struct Heap::Block {
+    char *top;
+    char *end;
+    std::size_t cardCount;
+    // Major collection that created the block.
+    std::uint32_t epoch;
+    // Set when any card is.
+    bool dirty;
+
+    std::uint8_t *cards() { return reinterpret_cast<std::uint8_t *>(this + 1); }
+
+    // Offset in words of the object that covers the start of each card, so
+    // that a dirty card can be scanned without walking the block from the
+    // start.
+    std::uint16_t *crossing()
+    {
+        return reinterpret_cast<std::uint16_t *>(cards() + cardCount);
+    }
+
+    char *firstObject()
+    {
+        return reinterpret_cast<char *>(this) +
+               align8(sizeof(Block) + cardCount * 3);
+    }
+};
+
+class HeapTracer : public Tracer
+{
+    Heap &heap;
+
+  public:
+    explicit HeapTracer(Heap &heap) : heap(heap) {}
+
+    using Tracer::visit;
+    void visit(Obj *&object) override
+    {
+        if (object)
+            heap.forward(object);
+    }
+};
+
+void PauseHistogram::record(std::uint64_t nanos)
+{
+    int bucket = std::bit_width(nanos / 1000);
+    buckets[std::min(bucket, BucketCount - 1)]++;
+    count++;
+    totalNanos += nanos;
+    maxNanos = std::max(maxNanos, nanos);
+}
+
+std::uint64_t PauseHistogram::percentileMicros(double fraction) const
+{
+    auto target = static_cast<std::uint64_t>(std::ceil(fraction * count));
+    std::uint64_t seen = 0;
+    for (int i = 0; i < BucketCount; i++) {
+        seen += buckets[i];
+        if (seen >= target && seen > 0)
+            return std::uint64_t(1) << i;
+    }
+    return 0;
+}
+
+std::string PauseHistogram::format() const
+{
+    std::string s = fmt::format("{} pauses, mean {:.1f} us, max {:.1f} us\n",
+                                count, count ? totalNanos / 1e3 / count : 0.0,
+                                maxNanos / 1e3);
+    for (int i = 0; i < BucketCount; i++) {
+        if (buckets[i] != 0)
+            s += fmt::format("  < {:>8} us: {}\n", std::uint64_t(1) << i,
+                             buckets[i]);
+    }
+    return s;
+}
+
+Heap::Heap(HeapOptions options) : options(options)
+{
+    this->options.blockBytes = std::bit_ceil(std::clamp<std::size_t>(
+        options.blockBytes, std::size_t(1) << 14, MaxBlockBytes));
+    // The nursery has to fit any object that is not large.
+    this->options.nurseryBytes = align8(std::max(
+        options.nurseryBytes, this->options.blockBytes / 4));
+
+    nursery = static_cast<char *>(std::malloc(this->options.nurseryBytes));
+    if (!nursery)
+        throw std::bad_alloc();
+    nurseryTop = nursery;
+    nurseryEnd = nursery + this->options.nurseryBytes;
+    nextMajor = options.majorThreshold;
+}
+
+Heap::~Heap()
+{
+    std::free(nursery);
+    for (auto block : blocks)
+        std::free(block);
+    for (auto object : largeObjects)
+        std::free(object);
+}
+
+Heap::Block *Heap::newBlock()
+{
+    void *memory = std::aligned_alloc(options.blockBytes, options.blockBytes);
+    if (!memory)
+        throw std::bad_alloc();
+
+    auto block = static_cast<Block *>(memory);
+    block->cardCount = options.blockBytes >> CardShift;
+    block->top = block->firstObject();
+    block->end = static_cast<char *>(memory) + options.blockBytes;
+    block->epoch = epoch;
+    block->dirty = false;
+    std::memset(block->cards(), 0, block->cardCount);
+
+    // Cards that start in the block header.
+    auto first = static_cast<std::uint16_t>(
+        (block->firstObject() - static_cast<char *>(memory)) / 8);
+    for (std::size_t c = 0; c <= (std::size_t(first) * 8 >> CardShift); c++)
+        block->crossing()[c] = first;
+
+    blocks.push_back(block);
+    return block;
+}
+
+Heap::Block *Heap::blockOf(const void *p) const
+{
+    return reinterpret_cast<Block *>(reinterpret_cast<std::uintptr_t>(p) &
+                                     ~(options.blockBytes - 1));
+}
+
+char *Heap::allocateOld(std::size_t size)
+{
+    if (!currentBlock ||
+        static_cast<std::size_t>(currentBlock->end - currentBlock->top) < size)
+        currentBlock = newBlock();
+
+    char *base = reinterpret_cast<char *>(currentBlock);
+    char *p = currentBlock->top;
+    currentBlock->top += size;
+    oldBytes += size;
+
+    // The cards that start inside the new object.
+    std::size_t offset = p - base;
+    auto words = static_cast<std::uint16_t>(offset / 8);
+    std::size_t cardBytes = std::size_t(1) << CardShift;
+    std::size_t first = (offset + cardBytes - 1) >> CardShift;
+    std::size_t last = (offset + size - 1) >> CardShift;
+    for (std::size_t c = first; c <= last; c++)
+        currentBlock->crossing()[c] = words;
+
+    return p;
+}
+
+void Heap::checkLimit(std::size_t size)
+{
+    if (allocationLimit && counters.bytesAllocated + size > allocationLimit)
+        throw HeapLimitError("Heap allocation limit exceeded.");
+}
+
+Obj *Heap::allocateSlow(ObjType type, std::size_t size)
+{
+    if (size > options.blockBytes / 4)
+        return allocateLarge(type, size);
+
+    checkLimit(size);
+    collectMinor();
+    return allocate(type, size);
+}
+
+Obj *Heap::allocateLarge(ObjType type, std::size_t size)
+{
+    checkLimit(size);
+    if (oldGenerationBytes() + size > nextMajor)
+        collectMajor();
+
+    auto object = static_cast<Obj *>(std::malloc(size));
+    if (!object)
+        throw std::bad_alloc();
+
+    *object = {type, Obj::Large, 0, static_cast<std::uint32_t>(size)};
+    largeObjects.push_back(object);
+    largeBytes += size;
+    counters.objectsAllocated++;
+    counters.bytesAllocated += size;
+    return object;
+}
+
+void Heap::rememberSlow(Obj *holder, const void *slot)
+{
+    if (holder->flags & (Obj::Large | Obj::Image)) {
+        if (!(holder->flags & Obj::Remembered)) {
+            holder->flags |= Obj::Remembered;
+            rememberedLarge.push_back(holder);
+        }
+        return;
+    }
+
+    Block *block = blockOf(holder);
+    std::size_t offset = static_cast<const char *>(slot) -
+                         reinterpret_cast<const char *>(block);
+    block->cards()[offset >> CardShift] = 1;
+    block->dirty = true;
+}
+
+// Copies a nursery object, or in a major collection any object that is not
+// in a block of the current epoch, and updates the reference to the copy.
+void Heap::forward(Obj *&object)
+{
+    Obj *from = object;
+
+    if (from->flags & Obj::Forwarded) {
+        object = *reinterpret_cast<Obj **>(from + 1);
+        return;
+    }
+
+    if (!isYoung(from)) {
+        if (!major || (from->flags & Obj::Image))
+            return;
+        if (from->flags & Obj::Large) {
+            if (!(from->flags & Obj::Marked)) {
+                from->flags |= Obj::Marked;
+                gray.push_back(from);
+            }
+            return;
+        }
+        if (blockOf(from)->epoch == epoch)
+            return;
+    }
+
+    auto to = reinterpret_cast<Obj *>(allocateOld(from->size));
+    std::memcpy(to, from, from->size);
+    from->flags |= Obj::Forwarded;
+    *reinterpret_cast<Obj **>(from + 1) = to;
+    if (!major)
+        counters.bytesPromoted += from->size;
+
+    gray.push_back(to);
+    object = to;
+}
+
+void Heap::traceRoots()
+{
+    HeapTracer tracer(*this);
+
+    for (auto source : rootSources)
+        source->traceRoots(tracer);
+    for (auto values : rootVectors) {
+        for (auto &value : *values)
+            tracer.visit(value);
+    }
+    for (auto pointer : rootedPointers)
+        tracer.visit(*pointer);
+    for (auto value : rootedValues)
+        tracer.visit(*value);
+}
+
+// Image objects are not marked, so their references are treated as roots.
+void Heap::traceImages()
+{
+    for (auto &image : images) {
+        for (char *p = image.begin; p < image.end;) {
+            auto object = reinterpret_cast<Obj *>(p);
+            forEachReference(object, [&](Obj *&ref) { forward(ref); });
+            p += object->size;
+        }
+    }
+}
+
+// Traces the old objects that overlap a dirty card, and the remembered large
+// objects. Only those can refer to the nursery.
+void Heap::scanDirtyCards()
+{
+    auto trace = [&](Obj *object) {
+        forEachReference(object, [&](Obj *&ref) { forward(ref); });
+    };
+
+    // Promotion appends blocks, so iterate by index.
+    for (std::size_t b = 0; b < blocks.size(); b++) {
+        Block *block = blocks[b];
+        if (!block->dirty)
+            continue;
+
+        char *base = reinterpret_cast<char *>(block);
+        std::uint8_t *cards = block->cards();
+        Obj *traced = nullptr;
+
+        for (std::size_t c = 0; c < block->cardCount; c++) {
+            if (!cards[c])
+                continue;
+            cards[c] = 0;
+
+            char *p = base + block->crossing()[c] * std::size_t(8);
+            char *cardEnd = base + ((c + 1) << CardShift);
+            while (p < cardEnd && p < block->top) {
+                auto object = reinterpret_cast<Obj *>(p);
+                // An object that spans several dirty cards is traced once.
+                if (object != traced) {
+                    trace(object);
+                    traced = object;
+                }
+                p += object->size;
+            }
+        }
+
+        block->dirty = false;
+    }
+
+    for (auto object : rememberedLarge) {
+        object->flags &= ~Obj::Remembered;
+        trace(object);
+    }
+    rememberedLarge.clear();
+}
+
+void Heap::drain()
+{
+    while (!gray.empty()) {
+        Obj *object = gray.back();
+        gray.pop_back();
+        forEachReference(object, [&](Obj *&ref) { forward(ref); });
+    }
+}
+
+void Heap::collectMinor()
+{
+    GRAVLAX_TRACE_SCOPE("Heap::collectMinor");
+    std::uint64_t start = nowNanos();
+
+    traceRoots();
+    scanDirtyCards();
+    drain();
+
+#ifndef NDEBUG
+    // Make stale references to the nursery fail loudly.
+    std::memset(nursery, 0xdb, nurseryTop - nursery);
+#endif
+    nurseryTop = nursery;
+
+    counters.minorCollections++;
+    counters.minorPauses.record(nowNanos() - start);
+
+    if (oldGenerationBytes() > nextMajor)
+        collectMajor();
+}
+
+void Heap::collectMajor()
+{
+    GRAVLAX_TRACE_SCOPE("Heap::collectMajor");
+    std::uint64_t start = nowNanos();
+
+    major = true;
+    epoch++;
+
+    std::vector<Block *> fromBlocks;
+    fromBlocks.swap(blocks);
+    currentBlock = nullptr;
+    oldBytes = 0;
+
+    traceRoots();
+    traceImages();
+    drain();
+    sweepInterned();
+
+    for (auto block : fromBlocks)
+        std::free(block);
+
+    // Sweep the large objects.
+    std::size_t kept = 0;
+    largeBytes = 0;
+    for (auto object : largeObjects) {
+        if (object->flags & Obj::Marked) {
+            object->flags &= ~(Obj::Marked | Obj::Remembered);
+            largeObjects[kept++] = object;
+            largeBytes += object->size;
+        } else {
+            std::free(object);
+        }
+    }
+    largeObjects.resize(kept);
+    // Nothing is young any more.
+    for (auto object : rememberedLarge)
+        object->flags &= ~Obj::Remembered;
+    rememberedLarge.clear();
+
+#ifndef NDEBUG
+    std::memset(nursery, 0xdb, nurseryTop - nursery);
+#endif
+    nurseryTop = nursery;
+    major = false;
+    nextMajor = std::max(options.majorThreshold, 2 * oldGenerationBytes());
+
+    counters.majorCollections++;
+    counters.majorPauses.record(nowNanos() - start);
+}
+
+// The intern set does not keep its strings alive. Runs after a major
+// collection has traced everything, when the strings that survived have been
+// copied and the others are still readable in the blocks that are about to be
+// freed, which the removal needs for their hashes. Minor collections can skip
+// the set because interned strings are never young.
+void Heap::sweepInterned()
+{
+    interned.forEach([](Table::Entry &entry) {
+        Obj *s = entry.key;
+        if (s->flags & Obj::Forwarded)
+            entry.key = *reinterpret_cast<ObjString **>(s + 1);
+    });
+    interned.removeIf([&](const Table::Entry &entry) {
+        Obj *s = entry.key;
+        if (s->flags & Obj::Image)
+            return false;
+        if (s->flags & Obj::Large)
+            return !(s->flags & Obj::Marked);
+        return blockOf(s)->epoch != epoch;
+    });
+}
+
+void Heap::collect(bool full)
+{
+    if (full) {
+        collectMajor();
+    } else {
+        collectMinor();
+    }
+}
+
+void Heap::addImage(char *begin, char *end)
+{
+    images.push_back({begin, end});
+
+    for (char *p = begin; p < end;) {
+        auto object = reinterpret_cast<Obj *>(p);
+        p += object->size;
+        if (!(object->flags & Obj::Interned))
+            continue;
+
+        // Strings of the heap that are equal to an image string are no
+        // longer interned, and compare by contents from now on.
+        auto s = static_cast<ObjString *>(object);
+        if (ObjString *existing = interned.findString(s->view(), s->hash)) {
+            existing->flags &= ~Obj::Interned;
+            interned.remove(existing);
+        }
+        interned.set(s, Value());
+    }
+}
+
+void Heap::addRoots(RootSource *source)
+{
+    rootSources.push_back(source);
+}
+
+void Heap::removeRoots(RootSource *source)
+{
+    std::erase(rootSources, source);
+}
+
+void Heap::addRoots(std::vector<Value> *values)
+{
+    rootVectors.push_back(values);
+}
+
+void Heap::removeRoots(std::vector<Value> *values)
+{
+    std::erase(rootVectors, values);
+}
+
+ObjString *Heap::string(std::string_view chars)
+{
+    auto s = static_cast<ObjString *>(
+        allocate(ObjType::String, sizeof(ObjString) + chars.size() + 1));
+    s->length = static_cast<std::uint32_t>(chars.size());
+    s->hash = hashChars(chars);
+    std::memcpy(s->chars(), chars.data(), chars.size());
+    s->chars()[chars.size()] = '\0';
+    return s;
+}
+
+ObjString *Heap::intern(std::string_view chars)
+{
+    std::uint32_t hash = hashChars(chars);
+    if (ObjString *s = interned.findString(chars, hash))
+        return s;
+
+    // Names and literals live about as long as the program, so they skip
+    // the nursery.
+    std::size_t size = align8(sizeof(ObjString) + chars.size() + 1);
+    Obj *object;
+    if (size > options.blockBytes / 4) {
+        object = allocateLarge(ObjType::String, size);
+    } else {
+        if (oldGenerationBytes() + size > nextMajor)
+            collectMajor();
+        object = reinterpret_cast<Obj *>(allocateOld(size));
+        *object = {ObjType::String, 0, 0, static_cast<std::uint32_t>(size)};
+        counters.objectsAllocated++;
+        counters.bytesAllocated += size;
+    }
+    object->flags |= Obj::Interned;
+
+    auto s = static_cast<ObjString *>(object);
+    s->length = static_cast<std::uint32_t>(chars.size());
+    s->hash = hash;
+    std::memcpy(s->chars(), chars.data(), chars.size());
+    s->chars()[chars.size()] = '\0';
+    interned.set(s, Value());
+    return s;
+}
+
+Obj *Heap::concat(Obj *a, Obj *b)
+{
+    std::uint32_t leftLength = stringLength(a);
+    std::uint32_t rightLength = stringLength(b);
+    if (leftLength == 0)
+        return b;
+    if (rightLength == 0)
+        return a;
+
+    Rooted<Obj> left(*this, a);
+    Rooted<Obj> right(*this, b);
+    std::uint32_t length = leftLength + rightLength;
+
+    if (length >= MinRopeLength) {
+        auto rope =
+            static_cast<ObjRope *>(allocate(ObjType::Rope, sizeof(ObjRope)));
+        rope->length = length;
+        rope->spare = 0;
+        rope->left = left;
+        rope->right = right;
+        rope->flat = nullptr;
+        return rope;
+    }
+
+    // Ropes are never this short, so both sides are flat.
+    auto s = static_cast<ObjString *>(
+        allocate(ObjType::String, sizeof(ObjString) + length + 1));
+    s->length = length;
+    std::memcpy(s->chars(), static_cast<ObjString *>(left.get())->chars(),
+                leftLength);
+    std::memcpy(s->chars() + leftLength,
+                static_cast<ObjString *>(right.get())->chars(), rightLength);
+    s->chars()[length] = '\0';
+    s->hash = hashChars(s->view());
+    return s;
+}
+
+ObjString *Heap::flatten(Obj *s)
+{
+    if (s->is(ObjType::String))
+        return static_cast<ObjString *>(s);
+    if (ObjString *flat = static_cast<ObjRope *>(s)->flat)
+        return flat;
+
+    Rooted<ObjRope> rope(*this, static_cast<ObjRope *>(s));
+    std::uint32_t length = rope->length;
+    auto flat = static_cast<ObjString *>(
+        allocate(ObjType::String, sizeof(ObjString) + length + 1));
+    flat->length = length;
+    flat->chars()[length] = '\0';
+
+    // Nothing below allocates. The pieces are copied from the back, so that
+    // the left leaning ropes of s = s + x need no stack.
+    char *end = flat->chars() + length;
+    std::vector<Obj *> pending;
+    Obj *node = rope;
+    for (;;) {
+        ObjString *piece;
+        if (node->is(ObjType::String)) {
+            piece = static_cast<ObjString *>(node);
+        } else {
+            auto inner = static_cast<ObjRope *>(node);
+            if (!inner->flat) {
+                pending.push_back(inner->left);
+                node = inner->right;
+                continue;
+            }
+            piece = inner->flat;
+        }
+
+        end -= piece->length;
+        std::memcpy(end, piece->chars(), piece->length);
+        if (pending.empty())
+            break;
+        node = pending.back();
+        pending.pop_back();
+    }
+
+    flat->hash = hashChars(flat->view());
+    // The pieces are garbage now unless something else refers to them.
+    rope->left = nullptr;
+    rope->right = nullptr;
+    rope->flat = flat;
+    writeBarrier(rope, &rope->flat, Value::fromObject(flat));
+    return flat;
+}
+
+ObjInstance *Heap::instance(std::uint32_t fieldCount)
+{
+    auto instance = static_cast<ObjInstance *>(allocate(
+        ObjType::Instance, sizeof(ObjInstance) + fieldCount * sizeof(Value)));
+    instance->fieldCount = fieldCount;
+    instance->spare = 0;
+    instance->shape = nullptr;
+    instance->klass = nullptr;
+    instance->overflow = nullptr;
+    for (std::uint32_t i = 0; i < fieldCount; i++)
+        new (&instance->fields()[i]) Value();
+    return instance;
+}
+
+ObjInstance *Heap::instance(ObjClass *klass)
+{
+    Rooted<ObjClass> rooted(*this, klass);
+    ObjInstance *instance = this->instance(klass->instanceSlots);
+    instance->shape = rooted->instanceShape;
+    instance->klass = rooted;
+    return instance;
+}
+
+ObjClass *Heap::klass(ObjString *name, ShapeTree &shapes)
+{
+    Rooted<ObjString> rootedName(*this, name);
+    auto klass =
+        static_cast<ObjClass *>(allocate(ObjType::Class, sizeof(ObjClass)));
+    klass->name = rootedName;
+    klass->instanceShape = shapes.newRoot();
+    klass->methodShape = shapes.newRoot();
+    klass->methods = nullptr;
+    klass->instanceSlots = 4;
+    klass->spare = 0;
+    return klass;
+}
+
+ObjSlots *Heap::slots(std::uint32_t capacity)
+{
+    auto slots = static_cast<ObjSlots *>(allocate(
+        ObjType::Slots, sizeof(ObjSlots) + capacity * sizeof(Value)));
+    slots->capacity = capacity;
+    slots->spare = 0;
+    for (std::uint32_t i = 0; i < capacity; i++)
+        new (&slots->values()[i]) Value();
+    return slots;
+}
+
+ObjFunction *Heap::function(ObjString *name, const void *code,
+                            std::uint32_t arity, std::uint32_t upvalueCount)
+{
+    Rooted<ObjString> rootedName(*this, name);
+    auto function = static_cast<ObjFunction *>(
+        allocate(ObjType::Function, sizeof(ObjFunction)));
+    function->name = rootedName;
+    function->code = code;
+    function->arity = arity;
+    function->upvalueCount = upvalueCount;
+    return function;
+}
+
+ObjClosure *Heap::closure(ObjFunction *function)
+{
+    Rooted<ObjFunction> rooted(*this, function);
+    std::uint32_t count = function->upvalueCount;
+    auto closure = static_cast<ObjClosure *>(
+        allocate(ObjType::Closure,
+                 sizeof(ObjClosure) + count * sizeof(ObjUpvalue *)));
+    closure->function = rooted;
+    closure->upvalueCount = count;
+    closure->spare = 0;
+    for (std::uint32_t i = 0; i < count; i++)
+        closure->upvalues()[i] = nullptr;
+    return closure;
+}
+
+ObjUpvalue *Heap::upvalue(std::uint32_t slot)
+{
+    auto upvalue = static_cast<ObjUpvalue *>(
+        allocate(ObjType::Upvalue, sizeof(ObjUpvalue)));
+    upvalue->slot = slot;
+    upvalue->open = 1;
+    new (&upvalue->closed) Value();
+    return upvalue;
+}
+
+ObjNative *Heap::native(ObjString *name, NativeFn function,
+                        std::uint32_t arity)
+{
+    Rooted<ObjString> rootedName(*this, name);
+    auto native =
+        static_cast<ObjNative *>(allocate(ObjType::Native, sizeof(ObjNative)));
+    native->function = function;
+    native->name = rootedName;
+    native->arity = arity;
+    native->spare = 0;
+    return native;
+}
+
+}; // namespace gravlax::runtime
@@ -0,0 +1,131 @@
+#include <algorithm>
+
+#include <gravlax/runtime/property.h>
+
+namespace
+{
+using namespace gravlax::runtime;
+
+// Instances of a class get at most this many inline slots.
+constexpr std::uint32_t MaxInstanceSlots = 16;
+
+// Makes room for index in the overflow slots of the instance.
+void reserveSlot(Heap &heap, Rooted<ObjInstance> &instance,
+                 std::uint32_t index)
+{
+    if (index < slotCapacity(instance))
+        return;
+
+    std::uint32_t old = instance->overflow ? instance->overflow->capacity : 0;
+    std::uint32_t capacity =
+        std::max(index + 1 - instance->fieldCount, std::max(4u, old * 2));
+
+    ObjSlots *slots = heap.slots(capacity);
+    // Large slots are allocated old, and then the young values copied in
+    // have to be remembered.
+    for (std::uint32_t i = 0; i < old; i++) {
+        Value value = instance->overflow->values()[i];
+        slots->values()[i] = value;
+        heap.writeBarrier(slots, &slots->values()[i], value);
+    }
+    instance->overflow = slots;
+    heap.writeBarrier(instance, &instance->overflow, Value::fromObject(slots));
+}
+
+}; // namespace
+
+namespace gravlax::runtime
+{
+
+bool getPropertySlow(ObjInstance *instance, std::string_view name,
+                     PropertyCache &cache, Value &result)
+{
+    cache.misses++;
+    if (!instance->shape)
+        return false;
+
+    int index = instance->shape->lookup(name);
+    if (index >= 0) {
+        cache.add({instance->shape, instance->shape,
+                   static_cast<std::uint32_t>(index),
+                   PropertyCache::Kind::Field});
+        result = instance->slot(index);
+        return true;
+    }
+
+    ObjClass *klass = instance->klass;
+    index = klass ? klass->methodShape->lookup(name) : -1;
+    if (index >= 0) {
+        cache.add({instance->shape, instance->shape,
+                   static_cast<std::uint32_t>(index),
+                   PropertyCache::Kind::Method});
+        result = klass->methods->values()[index];
+        return true;
+    }
+
+    return false;
+}
+
+void setPropertySlow(Heap &heap, ObjInstance *instance, std::string_view name,
+                     Value value, PropertyCache &cache)
+{
+    cache.misses++;
+
+    Shape *shape = instance->shape;
+    int index = shape->lookup(name);
+    if (index >= 0) {
+        cache.add({shape, shape, static_cast<std::uint32_t>(index),
+                   PropertyCache::Kind::Field});
+        storeSlot(heap, instance, index, value);
+        return;
+    }
+
+    Shape *target = shape->withProperty(name);
+    std::uint32_t slot = target->slotCount() - 1;
+
+    Rooted<ObjInstance> rooted(heap, instance);
+    RootedValue rootedValue(heap, value);
+    reserveSlot(heap, rooted, slot);
+
+    // Let later instances of the class start with room for all fields.
+    if (ObjClass *klass = rooted->klass) {
+        klass->instanceSlots = std::min(
+            std::max(klass->instanceSlots, target->slotCount()),
+            MaxInstanceSlots);
+    }
+
+    cache.add({shape, target, slot, PropertyCache::Kind::Add});
+    rooted->shape = target;
+    storeSlot(heap, rooted, slot, rootedValue);
+}
+
+void defineMethod(Heap &heap, ObjClass *klass, std::string_view name,
+                  Value method)
+{
+    Rooted<ObjClass> rooted(heap, klass);
+    RootedValue rootedMethod(heap, method);
+
+    int index = klass->methodShape->lookup(name);
+    if (index < 0) {
+        rooted->methodShape = rooted->methodShape->withProperty(name);
+        index = static_cast<int>(rooted->methodShape->slotCount() - 1);
+    }
+
+    std::uint32_t capacity = rooted->methods ? rooted->methods->capacity : 0;
+    if (static_cast<std::uint32_t>(index) >= capacity) {
+        ObjSlots *slots = heap.slots(std::max(4u, capacity * 2));
+        for (std::uint32_t i = 0; i < capacity; i++) {
+            Value value = rooted->methods->values()[i];
+            slots->values()[i] = value;
+            heap.writeBarrier(slots, &slots->values()[i], value);
+        }
+        rooted->methods = slots;
+        heap.writeBarrier(rooted, &rooted->methods, Value::fromObject(slots));
+    }
+
+    Value &slot = rooted->methods->values()[index];
+    slot = rootedMethod;
+    heap.writeBarrier(rooted->methods, &slot, rootedMethod);
+}
+
+}; // namespace gravlax::runtime
@@ -0,0 +1,54 @@
+#include <gravlax/runtime/shape.h>
+
+namespace gravlax::runtime
+{
+
+Shape::Shape(Shape *parent, std::string_view key)
+    : parent(parent), key(key), count(parent->count + 1)
+{
+}
+
+int Shape::lookup(std::string_view name) const
+{
+    for (const Shape *shape = this; shape->parent; shape = shape->parent) {
+        if (shape->key == name)
+            return static_cast<int>(shape->count - 1);
+    }
+    return -1;
+}
+
+Shape *Shape::withProperty(std::string_view name)
+{
+    // Most shapes have one or two transitions, a scan beats a map.
+    for (auto &child : transitions) {
+        if (child->key == name)
+            return child.get();
+    }
+
+    transitions.push_back(std::unique_ptr<Shape>(new Shape(this, name)));
+    return transitions.back().get();
+}
+
+std::size_t Shape::treeSize() const
+{
+    std::size_t size = 1;
+    for (auto &child : transitions)
+        size += child->treeSize();
+    return size;
+}
+
+Shape *ShapeTree::newRoot()
+{
+    roots.push_back(std::make_unique<Shape>());
+    return roots.back().get();
+}
+
+std::size_t ShapeTree::shapeCount() const
+{
+    std::size_t count = 0;
+    for (auto &root : roots)
+        count += root->treeSize();
+    return count;
+}
+
+}; // namespace gravlax::runtime
@@ -0,0 +1,253 @@
+#include <bit>
+#include <cstring>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <gravlax/runtime/heap.h>
+#include <gravlax/runtime/table.h>
+
+namespace
+{
+
+using gravlax::runtime::Table;
+
+// The control bytes of one probe, as a bit mask per question.
+class Group
+{
+#if defined(__SSE2__)
+    __m128i bytes;
+
+  public:
+    explicit Group(const std::uint8_t *control)
+        : bytes(_mm_loadu_si128(reinterpret_cast<const __m128i *>(control)))
+    {
+    }
+
+    std::uint32_t match(std::uint8_t tag) const
+    {
+        return static_cast<std::uint32_t>(_mm_movemask_epi8(
+            _mm_cmpeq_epi8(bytes, _mm_set1_epi8(static_cast<char>(tag)))));
+    }
+
+    // Empty is the only control byte with the high bit set.
+    std::uint32_t matchEmpty() const
+    {
+        return static_cast<std::uint32_t>(_mm_movemask_epi8(bytes));
+    }
+#else
+    const std::uint8_t *bytes;
+
+  public:
+    explicit Group(const std::uint8_t *control) : bytes(control) {}
+
+    std::uint32_t match(std::uint8_t tag) const
+    {
+        std::uint32_t bits = 0;
+        for (std::size_t i = 0; i < Table::GroupSize; i++)
+            bits |= std::uint32_t(bytes[i] == tag) << i;
+        return bits;
+    }
+
+    std::uint32_t matchEmpty() const
+    {
+        std::uint32_t bits = 0;
+        for (std::size_t i = 0; i < Table::GroupSize; i++)
+            bits |= std::uint32_t(bytes[i] >> 7) << i;
+        return bits;
+    }
+#endif
+};
+
+// Whether slot k lies in the cyclic range (from, to].
+bool between(std::size_t from, std::size_t k, std::size_t to)
+{
+    return from <= to ? from < k && k <= to : from < k || k <= to;
+}
+
+}; // namespace
+
+namespace gravlax::runtime
+{
+
+Table::Table(Table &&other) noexcept
+    : control(std::move(other.control)), entries(std::move(other.entries)),
+      mask(std::exchange(other.mask, 0)), count(std::exchange(other.count, 0)),
+      shift(std::exchange(other.shift, 64))
+{
+}
+
+Table &Table::operator=(Table &&other) noexcept
+{
+    control = std::move(other.control);
+    entries = std::move(other.entries);
+    mask = std::exchange(other.mask, 0);
+    count = std::exchange(other.count, 0);
+    shift = std::exchange(other.shift, 64);
+    return *this;
+}
+
+Table::~Table() = default;
+
+void Table::setControl(std::size_t i, std::uint8_t c)
+{
+    control[i] = c;
+    if (i < GroupSize)
+        control[mask + 1 + i] = c;
+}
+
+std::ptrdiff_t Table::indexOf(const ObjString *key) const
+{
+    if (!entries)
+        return -1;
+
+    std::uint8_t t = tag(key->hash);
+    for (std::size_t pos = home(key->hash);; pos = (pos + GroupSize) & mask) {
+        Group group(&control[pos]);
+        for (std::uint32_t bits = group.match(t); bits; bits &= bits - 1) {
+            std::size_t i = (pos + std::countr_zero(bits)) & mask;
+            if (entries[i].key == key)
+                return static_cast<std::ptrdiff_t>(i);
+        }
+        // A run has no holes, so the key would have been before this one.
+        if (group.matchEmpty())
+            return -1;
+    }
+}
+
+std::size_t Table::freeSlot(std::uint32_t hash) const
+{
+    for (std::size_t pos = home(hash);; pos = (pos + GroupSize) & mask) {
+        if (std::uint32_t bits = Group(&control[pos]).matchEmpty())
+            return (pos + std::countr_zero(bits)) & mask;
+    }
+}
+
+Value *Table::find(const ObjString *key)
+{
+    std::ptrdiff_t i = indexOf(key);
+    return i < 0 ? nullptr : &entries[i].value;
+}
+
+bool Table::get(const ObjString *key, Value &value) const
+{
+    std::ptrdiff_t i = indexOf(key);
+    if (i < 0)
+        return false;
+    value = entries[i].value;
+    return true;
+}
+
+bool Table::set(ObjString *key, Value value)
+{
+    std::ptrdiff_t i = indexOf(key);
+    if (i >= 0) {
+        entries[i].value = value;
+        return false;
+    }
+
+    // At most 7/8 full, so that runs stay a group or two long.
+    if ((count + 1) * 8 > capacity() * 7)
+        resize(capacity() ? capacity() * 2 : GroupSize);
+
+    std::size_t slot = freeSlot(key->hash);
+    setControl(slot, tag(key->hash));
+    entries[slot] = {key, value};
+    count++;
+    return true;
+}
+
+bool Table::remove(const ObjString *key)
+{
+    std::ptrdiff_t i = indexOf(key);
+    if (i < 0)
+        return false;
+    erase(static_cast<std::size_t>(i));
+    return true;
+}
+
+// Moves every later entry of the run that may live in the hole into it, so
+// that no lookup runs into the hole before finding its key.
+void Table::erase(std::size_t hole)
+{
+    setControl(hole, Empty);
+    entries[hole] = {};
+    count--;
+
+    for (std::size_t j = (hole + 1) & mask; isFull(control[j]);
+         j = (j + 1) & mask) {
+        // An entry whose home lies after the hole has to stay behind it.
+        if (between(hole, home(entries[j].key->hash), j))
+            continue;
+
+        setControl(hole, control[j]);
+        entries[hole] = entries[j];
+        setControl(j, Empty);
+        entries[j] = {};
+        hole = j;
+    }
+}
+
+void Table::clear()
+{
+    if (!entries)
+        return;
+    std::memset(control.get(), Empty, capacity() + GroupSize);
+    for (std::size_t i = 0; i <= mask; i++)
+        entries[i] = {};
+    count = 0;
+}
+
+ObjString *Table::findString(std::string_view chars,
+                             std::uint32_t hash) const
+{
+    if (!entries)
+        return nullptr;
+
+    std::uint8_t t = tag(hash);
+    for (std::size_t pos = home(hash);; pos = (pos + GroupSize) & mask) {
+        Group group(&control[pos]);
+        for (std::uint32_t bits = group.match(t); bits; bits &= bits - 1) {
+            ObjString *key = entries[(pos + std::countr_zero(bits)) & mask].key;
+            if (key->hash == hash && key->view() == chars)
+                return key;
+        }
+        if (group.matchEmpty())
+            return nullptr;
+    }
+}
+
+void Table::trace(Tracer &tracer)
+{
+    forEach([&](Entry &entry) {
+        tracer.visit(reinterpret_cast<Obj *&>(entry.key));
+        tracer.visit(entry.value);
+    });
+}
+
+void Table::resize(std::size_t newCapacity)
+{
+    auto oldControl = std::move(control);
+    auto oldEntries = std::move(entries);
+    std::size_t oldCapacity = capacity();
+
+    control = std::make_unique<std::uint8_t[]>(newCapacity + GroupSize);
+    std::memset(control.get(), Empty, newCapacity + GroupSize);
+    entries = std::make_unique<Entry[]>(newCapacity);
+    mask = newCapacity - 1;
+    shift = 64 - std::countr_zero(newCapacity);
+
+    // Keys are distinct, so they go straight into the first free slot.
+    for (std::size_t i = 0; i < oldCapacity; i++) {
+        if (!isFull(oldControl[i]))
+            continue;
+        std::uint32_t hash = oldEntries[i].key->hash;
+        std::size_t slot = freeSlot(hash);
+        setControl(slot, tag(hash));
+        entries[slot] = oldEntries[i];
+    }
+}
+
+}; // namespace gravlax::runtime
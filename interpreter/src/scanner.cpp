@@ -1,236 +1,217 @@
+#include <charconv>
+
 #include <fmt/core.h>
+#include <gravlax/lexer.h>
 #include <gravlax/scanner.h>
-#include <iostream>
+#include <gravlax/stats.h>
+#include <gravlax/trace.h>
+#include <gravlax/utf8.h>
 
 namespace gravlax
 {
 
-Scanner::Scanner()
+Scanner::Scanner() {}
+
+Scanner::Scanner(Diagnostics &diagnostics) : Scanner()
 {
-    keywords["and"] = Token::Type::AND;
-    keywords["class"] = Token::Type::CLASS;
-    keywords["else"] = Token::Type::ELSE;
-    keywords["false"] = Token::Type::FALSE;
-    keywords["for"] = Token::Type::FOR;
-    keywords["fun"] = Token::Type::FUN;
-    keywords["if"] = Token::Type::IF;
-    keywords["nil"] = Token::Type::NIL;
-    keywords["or"] = Token::Type::OR;
-    keywords["print"] = Token::Type::PRINT;
-    keywords["return"] = Token::Type::RETURN;
-    keywords["super"] = Token::Type::SUPER;
-    keywords["this"] = Token::Type::THIS;
-    keywords["true"] = Token::Type::TRUE;
-    keywords["var"] = Token::Type::VAR;
-    keywords["while"] = Token::Type::WHILE;
+    this->diagnostics = &diagnostics;
 }
 
 Scanner::~Scanner() {}
 
 std::unique_ptr<std::vector<Token>> Scanner::scanString(const std::string &code)
 {
+    GRAVLAX_STATS_PHASE(Scan);
+    GRAVLAX_TRACE_SCOPE("Scanner::scanString");
+
     this->code = code;
+    start = 0;
+    current = 0;
+    resuming = false;
+    validated = 0;
+    ascii = true;
+    invalid = false;
+    validate(true);
+    lines.reset(this->code);
+    // A guess that avoids most of the regrowth for typical sources without
+    // reserving a token per byte.
+    tokens.reserve(code.size() / 4 + 16);
     scanTokens();
     return std::make_unique<std::vector<Token>>(std::move(tokens));
 }
 
-void Scanner::scanTokens()
+void Scanner::startStream()
 {
+    code.clear();
+    lines.reset(code);
+    tokens.clear();
+    start = 0;
+    current = 0;
+    validated = 0;
+    ascii = true;
+    invalid = false;
+    streaming = true;
+    resuming = false;
+}
+
+std::vector<Token> &Scanner::feed(std::string_view chunk)
+{
+    GRAVLAX_STATS_PHASE(Scan);
+
+    tokens.clear();
+    if (invalid)
+        return tokens;
+
+    code.append(chunk);
+    validate(false);
+    lines.reset(code);
+
     while (!isAtEnd()) {
-        // We are at the beginning of the next lexeme.
         start = current;
         scanToken();
+        if (starved) {
+            starved = false;
+            current = start;
+            break;
+        }
     }
-
-    tokens.push_back(Token(Token::Type::END_OF_FILE, "", {}, line));
+    return tokens;
 }
 
-bool Scanner::match(char expected)
+std::vector<Token> &Scanner::finish()
 {
-    if (isAtEnd())
-        return false;
-    if (code[current] != expected)
-        return false;
+    GRAVLAX_STATS_PHASE(Scan);
 
-    current++;
-    return true;
+    streaming = false;
+    tokens.clear();
+    validate(true);
+    lines.reset(code);
+    scanTokens();
+    return tokens;
 }
 
-char Scanner::peek()
+void Scanner::scanTokens()
 {
-    if (isAtEnd()) {
-        return '\0';
+    while (!isAtEnd()) {
+        // We are at the beginning of the next lexeme.
+        start = current;
+        scanToken();
     }
-    return code[current];
-}
 
-char Scanner::isDigit(char c)
-{
-    if (c >= '0' && c <= '9') {
-        return true;
-    }
-    return false;
+    tokens.push_back(Token(Token::Type::END_OF_FILE, "", {}, current));
 }
 
-char Scanner::peekNext()
+void Scanner::validate(bool complete)
 {
-    if (current + 1 >= code.length())
-        return '\0';
-    return code[current + 1];
+    auto check = utf8::validate(std::string_view(code).substr(validated));
+    ascii = ascii && check.ascii;
+    validated += check.valid;
+    if (validated == code.size() || (check.truncated && !complete))
+        return;
+
+    error(static_cast<int>(validated), "Invalid UTF-8.");
+    code.resize(validated);
+    invalid = true;
+    // The pending lexeme may have run into what was cut.
+    resuming = false;
 }
 
-void Scanner::number()
+void Scanner::identifier()
 {
-    while (isDigit(peek()))
-        advance();
-
-    // Look for a fractional part.
-    if (peek() == '.' && isDigit(peekNext())) {
-        // Consume the "."
-        advance();
+    // The DFA takes any byte from 0x80 up into a name, and the name really
+    // ends at the first character that cannot be part of it.
+    std::size_t end = start;
+    while (end < static_cast<std::size_t>(current)) {
+        if (static_cast<unsigned char>(code[end]) < 0x80) {
+            end++;
+            continue;
+        }
+        std::size_t next = end;
+        char32_t c = utf8::decode(code, next);
+        if (!(end == static_cast<std::size_t>(start) ? utf8::isXidStart(c)
+                                                     : utf8::isXidContinue(c)))
+            break;
+        end = next;
+    }
 
-        while (isDigit(peek()))
-            advance();
+    if (end == static_cast<std::size_t>(start)) {
+        // Not a name at all, the error quotes the whole character.
+        utf8::decode(code, end);
+        current = static_cast<int>(end);
+        error(start, fmt::format("Unexpected character \'{}\'",
+                                 code.substr(start, current - start)));
+        return;
+    }
+    if (end == static_cast<std::size_t>(current)) {
+        addToken(Token::Type::IDENTIFIER);
+        return;
     }
 
-    double value = std::stod(code.substr(start, current - start));
+    // What is left of the name may be a keyword.
+    current = static_cast<int>(end);
+    addToken(lexer::scan(std::string_view(code).substr(0, end), start).type);
+}
+
+void Scanner::number()
+{
+    // The lexeme is known to be valid, and from_chars parses it in place.
+    double value = 0;
+    std::from_chars(code.data() + start, code.data() + current, value);
     addToken(Token::Type::NUMBER, value);
 }
 
 void Scanner::scanToken()
 {
-    char c = advance();
-    // fmt::print("Found character {} at offset {}\n", c, current - 1);
-    switch (c) {
-    case '(':
-        addToken(Token::Type::LEFT_PAREN);
-        break;
-    case ')':
-        addToken(Token::Type::RIGHT_PAREN);
-        break;
-    case '{':
-        addToken(Token::Type::LEFT_BRACE);
-        break;
-    case '}':
-        addToken(Token::Type::RIGHT_BRACE);
-        break;
-    case ',':
-        addToken(Token::Type::COMMA);
-        break;
-    case '.':
-        addToken(Token::Type::DOT);
-        break;
-    case '-':
-        addToken(Token::Type::MINUS);
-        break;
-    case '+':
-        addToken(Token::Type::PLUS);
-        break;
-    case ';':
-        addToken(Token::Type::SEMICOLON);
-        break;
-    case '*':
-        addToken(Token::Type::STAR);
-        break;
-    case '!':
-        addToken(match('=') ? Token::Type::BANG_EQUAL : Token::Type::BANG);
-        break;
-    case '=':
-        addToken(match('=') ? Token::Type::EQUAL_EQUAL : Token::Type::EQUAL);
-        break;
-    case '<':
-        addToken(match('=') ? Token::Type::LESS_EQUAL : Token::Type::LESS);
-        break;
-    case '>':
-        addToken(match('=') ? Token::Type::GREATER_EQUAL
-                            : Token::Type::GREATER);
-        break;
-    case '/':
-        if (match('/')) {
-            // A comment goes until the end of the line.
-            while (peek() != '\n' && !isAtEnd()) {
-                advance();
-            }
-        } else {
-            addToken(Token::Type::SLASH);
-        }
-        break;
-    case ' ':
-    case '\r':
-    case '\t':
-        // Ignore whitespace.
-        break;
-
-    case '\n':
-        line++;
-        break;
-
-    case '"':
-        string();
-        break;
+    using Kind = lexer::Lexeme::Kind;
+
+    lexer::Progress progress = resuming ? pending : lexer::startAt(start);
+    resuming = false;
+    lexer::advance(code, progress);
+    // The DFA stops at the first byte that cannot extend the lexeme. If it
+    // ran out of input instead, the next chunk may extend it.
+    if (streaming && progress.current == static_cast<int>(code.size())) {
+        starved = true;
+        pending = progress;
+        resuming = true;
+        return;
+    }
+    lexer::Lexeme lexeme = lexer::match(code, start, progress);
+    start = lexeme.begin;
+    current = lexeme.end;
 
-    default:
-        if (isDigit(c)) {
+    switch (lexeme.kind) {
+    case Kind::Token:
+        if (lexeme.type == Token::Type::NUMBER)
             number();
-        } else if (isAlpha(c)) {
+        else if (lexeme.type == Token::Type::STRING)
+            string();
+        else if (lexeme.type == Token::Type::IDENTIFIER && !ascii)
             identifier();
-        } else {
-            error(line, fmt::format("Unexpected character \'{}\'", c));
-        }
+        else
+            addToken(lexeme.type);
+        break;
+    case Kind::Whitespace:
+    case Kind::Comment:
+        break;
+    case Kind::Unterminated:
+        error(start, "Unterminated string.");
+        break;
+    case Kind::Unexpected:
+        error(start, fmt::format("Unexpected character \'{}\'", code[start]));
         break;
     }
 }
 
 void Scanner::string()
 {
-    while (peek() != '"' && !isAtEnd()) {
-        if (peek() == '\n')
-            line++;
-        advance();
-    }
-
-    if (isAtEnd()) {
-        error(line, "Unterminated string.");
-        return;
-    }
-
-    // The closing ".
-    advance();
-
     // Trim the surrounding quotes.
-    std::string value = code.substr(start + 1, current - start - 2);
-    addToken(Token::Type::STRING, value);
-}
-
-void Scanner::identifier()
-{
-    while (isAlphaNumeric(peek()))
-        advance();
-
-    std::string text = code.substr(start, current - start);
-    auto it = keywords.find(text);
-
-    if (it == keywords.end()) {
-        addToken(Token::Type::IDENTIFIER);
-    } else {
-        addToken(it->second);
-    }
-}
-
-bool Scanner::isAlpha(char c)
-{
-    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    std::string value(code, start + 1, current - start - 2);
+    addToken(Token::Type::STRING, std::move(value));
 }
 
-bool Scanner::isAlphaNumeric(char c)
+void Scanner::error(int offset, std::string msg)
 {
-    return isAlpha(c) || isDigit(c);
-}
-
-void Scanner::error(int line, std::string msg)
-{
-    hadError = true;
-    std::cout << msg << std::endl;
+    diagnostics->error(offset, std::move(msg));
 }
 
 bool Scanner::isAtEnd()
@@ -238,11 +219,6 @@ bool Scanner::isAtEnd()
     return current >= code.length();
 }
 
-char Scanner::advance()
-{
-    return code[current++];
-}
-
 void Scanner::addToken(Token::Type tokenType)
 {
     addToken(tokenType, {});
@@ -250,8 +226,11 @@ void Scanner::addToken(Token::Type tokenType)
 
 void Scanner::addToken(Token::Type tokenType, Token::Literal literal)
 {
-    std::string lexeme = code.substr(start, current - start);
-    tokens.push_back(Token(tokenType, lexeme, literal, line));
+    GRAVLAX_STATS_COUNT_TOKEN(tokenType);
+
+    // Lexemes shorter than the small string buffer do not allocate.
+    tokens.emplace_back(tokenType, std::string(code, start, current - start),
+                        std::move(literal), start);
 }
 
 }; // namespace gravlax
\ No newline at end of file
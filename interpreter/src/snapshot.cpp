@@ -0,0 +1,460 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+
+#include <gravlax/executor.h>
+#include <gravlax/snapshot.h>
+#include <gravlax/trace.h>
+
+#include <gravlax/generated/stmt_function.h>
+
+namespace
+{
+using namespace gravlax::runtime;
+
+using gravlax::SnapshotError;
+using Function = gravlax::generated::Function<Value>;
+
+enum class ValueKind : std::uint8_t { Nil, Bool, Number, Object };
+
+// Appends the metadata in native byte order, the snapshot is only read by
+// the build that wrote it.
+class MetadataWriter
+{
+    std::string bytes;
+
+  public:
+    template <typename T> void put(T value)
+    {
+        bytes.append(reinterpret_cast<const char *>(&value), sizeof value);
+    }
+
+    void put(std::string_view s)
+    {
+        put(static_cast<std::uint32_t>(s.size()));
+        bytes.append(s);
+    }
+
+    const std::string &data() const { return bytes; }
+};
+
+class MetadataReader
+{
+    std::string_view bytes;
+
+    void need(std::size_t size)
+    {
+        if (bytes.size() < size)
+            throw SnapshotError("The snapshot is truncated.");
+    }
+
+  public:
+    explicit MetadataReader(std::string_view bytes) : bytes(bytes) {}
+
+    template <typename T> T get()
+    {
+        T value;
+        need(sizeof value);
+        std::memcpy(&value, bytes.data(), sizeof value);
+        bytes.remove_prefix(sizeof value);
+        return value;
+    }
+
+    std::string_view string()
+    {
+        auto size = get<std::uint32_t>();
+        need(size);
+        std::string_view s = bytes.substr(0, size);
+        bytes.remove_prefix(size);
+        return s;
+    }
+};
+
+std::uint64_t alignUp(std::uint64_t n, std::uint64_t alignment)
+{
+    return (n + alignment - 1) & ~(alignment - 1);
+}
+
+// Closes the file on every way out of the constructor.
+struct FileDescriptor {
+    int fd;
+    ~FileDescriptor()
+    {
+        if (fd >= 0)
+            ::close(fd);
+    }
+};
+
+}; // namespace
+
+namespace gravlax
+{
+using namespace gravlax::runtime;
+
+Snapshot::Snapshot(const std::string &path)
+{
+    FileDescriptor file{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (file.fd < 0)
+        throw SnapshotError(fmt::format("Could not open '{}': {}", path,
+                                        std::strerror(errno)));
+
+    Header header;
+    struct stat status;
+    if (::pread(file.fd, &header, sizeof header, 0) != sizeof header ||
+        std::memcmp(header.magic, Magic, sizeof Magic) != 0 ||
+        header.version != Version ||
+        header.valueSize != sizeof(runtime::Value))
+        throw SnapshotError(
+            fmt::format("'{}' is not a snapshot of this version.", path));
+    if (::fstat(file.fd, &status) != 0 ||
+        header.imageOffset % ImageAlignment != 0 ||
+        sizeof header + header.metadataSize > header.imageOffset ||
+        header.imageOffset + header.imageSize >
+            static_cast<std::uint64_t>(status.st_size))
+        throw SnapshotError(fmt::format("'{}' is truncated.", path));
+
+    fileBytes = header.imageOffset;
+    void *mapped =
+        ::mmap(nullptr, fileBytes, PROT_READ, MAP_PRIVATE, file.fd, 0);
+    if (mapped == MAP_FAILED)
+        throw SnapshotError(fmt::format("Could not map '{}': {}", path,
+                                        std::strerror(errno)));
+    this->file = static_cast<char *>(mapped);
+    metadataBegin = this->file + sizeof header;
+    metadataBytes = header.metadataSize;
+
+    imageBytes = header.imageSize;
+    if (imageBytes == 0)
+        return;
+
+    // Copy-on-write: pages that the process never writes stay shared with
+    // the page cache and with every other process that maps the snapshot.
+#ifdef MAP_FIXED_NOREPLACE
+    int fixed = MAP_FIXED_NOREPLACE;
+#else
+    int fixed = 0;
+#endif
+    mapped = ::mmap(basePointer(), imageBytes, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | fixed, file.fd,
+                    static_cast<off_t>(header.imageOffset));
+    if (mapped == MAP_FAILED) {
+        mapped = ::mmap(nullptr, imageBytes, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE, file.fd,
+                        static_cast<off_t>(header.imageOffset));
+    }
+    if (mapped == MAP_FAILED) {
+        int error = errno;
+        ::munmap(this->file, fileBytes);
+        throw SnapshotError(fmt::format("Could not map '{}': {}", path,
+                                        std::strerror(error)));
+    }
+    imageBegin = static_cast<char *>(mapped);
+}
+
+Snapshot::~Snapshot()
+{
+    if (imageBegin)
+        ::munmap(imageBegin, imageBytes);
+    ::munmap(file, fileBytes);
+}
+
+void Executor::saveSnapshot(const std::string &path,
+                            std::string_view prelude)
+{
+    GRAVLAX_TRACE_SCOPE("Executor::saveSnapshot");
+
+    if (image)
+        throw SnapshotError("Can't save an executor that loaded a snapshot.");
+
+    // Everything reachable from the globals, in the order it is found, and
+    // where each object goes in the image.
+    std::unordered_map<const Obj *, std::uint64_t> offsets;
+    std::vector<Obj *> order;
+    std::uint64_t imageSize = 0;
+    auto add = [&](Obj *object) {
+        if (offsets.emplace(object, imageSize).second) {
+            order.push_back(object);
+            imageSize += object->size;
+        }
+    };
+
+    for (std::size_t i = 0; i < defined.size(); i++) {
+        if (defined[i] && globals[i].isObject())
+            add(globals[i].asObject());
+    }
+    for (std::size_t i = 0; i < order.size(); i++) {
+        Obj *object = order[i];
+        // Shapes live outside of the heap and have no place in the image.
+        if (object->is(ObjType::Instance) || object->is(ObjType::Class) ||
+            object->is(ObjType::Slots))
+            throw SnapshotError(
+                "Can't save classes or instances in a snapshot.");
+        forEachReference(object, [&](Obj *&ref) { add(ref); });
+    }
+
+    MetadataWriter metadata;
+    metadata.put(prelude);
+
+    // Copy the objects and point their references into the image as it
+    // will be mapped.
+    std::vector<char> bytes(imageSize);
+    std::vector<std::uint64_t> relocations;
+    std::vector<std::uint64_t> nativeObjects;
+    std::vector<std::pair<std::uint64_t, const Function *>> functions;
+    for (Obj *object : order) {
+        std::uint64_t offset = offsets.at(object);
+        auto copy = reinterpret_cast<Obj *>(&bytes[offset]);
+        std::memcpy(copy, object, object->size);
+        copy->flags = (object->flags & Obj::Interned) | Obj::Image;
+
+        forEachReference(copy, [&](Obj *&ref) {
+            ref = reinterpret_cast<Obj *>(Snapshot::Base + offsets.at(ref));
+            relocations.push_back(reinterpret_cast<char *>(&ref) -
+                                  bytes.data());
+        });
+
+        if (copy->is(ObjType::Function)) {
+            auto function = static_cast<ObjFunction *>(copy);
+            auto node = static_cast<const Function *>(function->code);
+            if (node->lazy.sourceEnd > prelude.size())
+                throw SnapshotError(fmt::format(
+                    "'{}' was not declared by the prelude.",
+                    node->name.lexeme));
+            functions.emplace_back(offset, node);
+            function->code = nullptr;
+        } else if (copy->is(ObjType::Native)) {
+            nativeObjects.push_back(offset);
+            static_cast<ObjNative *>(copy)->function = nullptr;
+        } else if (copy->is(ObjType::Upvalue)) {
+            if (static_cast<ObjUpvalue *>(copy)->open)
+                throw SnapshotError("Can't save a running executor.");
+        }
+    }
+
+    metadata.put(static_cast<std::uint64_t>(relocations.size()));
+    for (auto offset : relocations)
+        metadata.put(offset);
+
+    metadata.put(static_cast<std::uint32_t>(nativeObjects.size()));
+    for (auto offset : nativeObjects)
+        metadata.put(offset);
+
+    metadata.put(static_cast<std::uint32_t>(functions.size()));
+    for (auto &[offset, node] : functions) {
+        metadata.put(offset);
+        metadata.put(std::string_view(node->name.lexeme));
+        metadata.put(node->name.offset);
+        metadata.put(static_cast<std::uint32_t>(node->params.size()));
+        for (auto &param : node->params) {
+            metadata.put(std::string_view(param.lexeme));
+            metadata.put(param.offset);
+        }
+        metadata.put(node->lazy.sourceBegin);
+        metadata.put(node->lazy.sourceEnd);
+        metadata.put(static_cast<std::uint32_t>(node->info.upvalues.size()));
+        for (std::size_t i = 0; i < node->info.upvalues.size(); i++) {
+            metadata.put(static_cast<std::uint8_t>(
+                node->info.upvalues[i].isLocal));
+            metadata.put(node->info.upvalues[i].index);
+            metadata.put(std::string_view(node->info.captures[i].name));
+            metadata.put(node->info.captures[i].depth);
+        }
+    }
+
+    std::uint32_t globalCount = 0;
+    for (auto flag : defined)
+        globalCount += flag;
+    metadata.put(globalCount);
+    for (std::size_t i = 0; i < defined.size(); i++) {
+        if (!defined[i])
+            continue;
+        Value value = globals[i];
+        metadata.put(std::string_view(names.name(i)));
+        if (value.isBool()) {
+            metadata.put(ValueKind::Bool);
+            metadata.put(static_cast<std::uint8_t>(value.asBool()));
+        } else if (value.isNumber()) {
+            metadata.put(ValueKind::Number);
+            metadata.put(value.asNumber());
+        } else if (value.isObject()) {
+            metadata.put(ValueKind::Object);
+            metadata.put(offsets.at(value.asObject()));
+        } else {
+            metadata.put(ValueKind::Nil);
+        }
+    }
+
+    Snapshot::Header header{};
+    std::memcpy(header.magic, Snapshot::Magic, sizeof header.magic);
+    header.version = Snapshot::Version;
+    header.valueSize = sizeof(Value);
+    header.base = Snapshot::Base;
+    header.metadataSize = metadata.data().size();
+    header.imageOffset = alignUp(sizeof header + header.metadataSize,
+                                 Snapshot::ImageAlignment);
+    header.imageSize = imageSize;
+
+    // Loaded snapshots map the file, so it is replaced rather than rewritten
+    // in place: truncating it would fault every process that has it mapped.
+    std::string temporary = path + ".tmp";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(&header), sizeof header);
+    out.write(metadata.data().data(),
+              static_cast<std::streamsize>(metadata.data().size()));
+    std::string padding(
+        header.imageOffset - sizeof header - header.metadataSize, '\0');
+    out.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    out.close();
+    if (!out) {
+        std::remove(temporary.c_str());
+        throw SnapshotError(fmt::format("Could not write '{}'.", path));
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        int error = errno;
+        std::remove(temporary.c_str());
+        throw SnapshotError(fmt::format("Could not write '{}': {}", path,
+                                        std::strerror(error)));
+    }
+}
+
+void Executor::loadSnapshot(const std::string &path)
+{
+    GRAVLAX_TRACE_SCOPE("Executor::loadSnapshot");
+
+    if (image || !programs.empty())
+        throw SnapshotError(
+            "A snapshot has to be loaded before anything runs.");
+
+    auto loaded = std::make_unique<Snapshot>(path);
+    MetadataReader in(loaded->metadata());
+    char *begin = loaded->image();
+    std::size_t size = loaded->imageSize();
+    auto object = [&](std::uint64_t offset, ObjType type) {
+        auto o = reinterpret_cast<Obj *>(begin + offset);
+        if (offset >= size || !o->is(type))
+            throw SnapshotError("The snapshot is corrupt.");
+        return o;
+    };
+
+    std::string_view source = in.string();
+
+    // Only an image that did not get its base address has to be touched
+    // here, which unshares every page with a pointer.
+    auto relocationCount = in.get<std::uint64_t>();
+    auto delta = reinterpret_cast<std::uintptr_t>(begin) - Snapshot::Base;
+    for (std::uint64_t i = 0; i < relocationCount; i++) {
+        auto offset = in.get<std::uint64_t>();
+        if (offset + sizeof(void *) > size)
+            throw SnapshotError("The snapshot is corrupt.");
+        if (delta)
+            *reinterpret_cast<std::uintptr_t *>(begin + offset) += delta;
+    }
+
+    auto nativeCount = in.get<std::uint32_t>();
+    for (std::uint32_t i = 0; i < nativeCount; i++) {
+        auto native = static_cast<ObjNative *>(
+            object(in.get<std::uint64_t>(), ObjType::Native));
+        auto it = natives.find(std::string(native->name->view()));
+        if (it == natives.end())
+            throw SnapshotError(
+                fmt::format("The snapshot needs the native function '{}'.",
+                            native->name->view()));
+        native->function = it->second;
+    }
+
+    // The functions come back lazy, their bodies are scanned from the
+    // prelude on their first call. So do the constants of their bodies,
+    // which are cached by node.
+    Program restored;
+    auto functionCount = in.get<std::uint32_t>();
+    for (std::uint32_t i = 0; i < functionCount; i++) {
+        auto function = static_cast<ObjFunction *>(
+            object(in.get<std::uint64_t>(), ObjType::Function));
+        std::string name(in.string());
+        Token nameToken(Token::Type::IDENTIFIER, name, in.get<int>());
+
+        std::vector<Token> params;
+        auto paramCount = in.get<std::uint32_t>();
+        for (std::uint32_t p = 0; p < paramCount; p++) {
+            std::string param(in.string());
+            params.emplace_back(Token::Type::IDENTIFIER, param, in.get<int>());
+        }
+
+        auto node = std::make_shared<Function>(
+            std::move(nameToken), std::move(params),
+            std::vector<std::shared_ptr<Stmt<Value>>>{});
+        node->lazy.sourceBegin = in.get<std::uint32_t>();
+        node->lazy.sourceEnd = in.get<std::uint32_t>();
+        if (node->lazy.sourceBegin > node->lazy.sourceEnd ||
+            node->lazy.sourceEnd > source.size())
+            throw SnapshotError("The snapshot is corrupt.");
+        node->lazy.source = source;
+
+        auto upvalueCount = in.get<std::uint32_t>();
+        for (std::uint32_t u = 0; u < upvalueCount; u++) {
+            bool isLocal = in.get<std::uint8_t>();
+            auto index = in.get<std::uint32_t>();
+            node->info.upvalues.push_back({isLocal, index});
+            std::string capture(in.string());
+            node->info.captures.push_back(
+                {std::move(capture), in.get<std::uint16_t>()});
+        }
+
+        function->code = node.get();
+        restored.push_back(std::move(node));
+    }
+
+    std::vector<std::pair<std::uint32_t, Value>> values;
+    auto globalCount = in.get<std::uint32_t>();
+    for (std::uint32_t i = 0; i < globalCount; i++) {
+        std::uint32_t index = names.indexOf(std::string(in.string()));
+        Value value;
+        switch (in.get<ValueKind>()) {
+        case ValueKind::Nil:
+            break;
+        case ValueKind::Bool:
+            value = Value::fromBool(in.get<std::uint8_t>());
+            break;
+        case ValueKind::Number:
+            value = Value::fromNumber(in.get<double>());
+            break;
+        case ValueKind::Object: {
+            auto offset = in.get<std::uint64_t>();
+            if (offset >= size)
+                throw SnapshotError("The snapshot is corrupt.");
+            value = Value::fromObject(
+                reinterpret_cast<Obj *>(begin + offset));
+            break;
+        }
+        default:
+            throw SnapshotError("The snapshot is corrupt.");
+        }
+        values.emplace_back(index, value);
+    }
+
+    // Nothing throws from here on.
+    objects.addImage(begin, begin + size);
+    image = std::move(loaded);
+    programs.push_back(std::move(restored));
+
+    globals.resize(names.size());
+    defined.resize(names.size());
+    for (auto &[index, value] : values) {
+        globals[index] = value;
+        defined[index] = true;
+    }
+}
+
+}; // namespace gravlax
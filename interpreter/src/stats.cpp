@@ -0,0 +1,193 @@
+#include <ctime>
+
+#include <sys/resource.h>
+
+#include <fmt/core.h>
+
+#include <gravlax/stats.h>
+
+namespace
+{
+using namespace gravlax::stats;
+
+thread_local Stats threadStats{};
+thread_local Allocations threadTotals{};
+
+std::uint64_t nanos(clockid_t clock)
+{
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+double millis(std::uint64_t nanos)
+{
+    return nanos / 1e6;
+}
+
+}; // namespace
+
+namespace gravlax::stats
+{
+
+const char *phaseName(Phase phase)
+{
+    switch (phase) {
+    case Phase::None:
+        return "other";
+    case Phase::Load:
+        return "load";
+    case Phase::Scan:
+        return "scan";
+    case Phase::Parse:
+        return "parse";
+    case Phase::Resolve:
+        return "resolve";
+    case Phase::Print:
+        return "print";
+    case Phase::Evaluate:
+        return "evaluate";
+    }
+    return "unknown";
+}
+
+Stats &current()
+{
+    return threadStats;
+}
+
+void reset()
+{
+    Phase phase = threadStats.phase;
+    threadStats = Stats{};
+    threadStats.phase = phase;
+}
+
+Allocations threadAllocations()
+{
+    return threadTotals;
+}
+
+void recordAllocation(std::size_t size)
+{
+    threadTotals.count++;
+    threadTotals.bytes += size;
+#if GRAVLAX_ENABLE_STATS
+    Stats &stats = threadStats;
+    PhaseStats &phase = stats.phases[static_cast<int>(stats.phase)];
+    phase.allocations++;
+    phase.bytesAllocated += size;
+#endif
+}
+
+std::uint64_t peakRss()
+{
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#if defined(__APPLE__)
+    return usage.ru_maxrss;
+#else
+    return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+PhaseTimer::PhaseTimer(Phase phase) : phase(phase), outer(threadStats.phase)
+{
+    if (phase == outer)
+        return;
+
+    threadStats.phase = phase;
+    wallStart = nanos(CLOCK_MONOTONIC);
+    cpuStart = nanos(CLOCK_THREAD_CPUTIME_ID);
+}
+
+PhaseTimer::~PhaseTimer()
+{
+    if (phase == outer)
+        return;
+
+    PhaseStats &stats = threadStats.phases[static_cast<int>(phase)];
+    stats.calls++;
+    stats.wallNanos += nanos(CLOCK_MONOTONIC) - wallStart;
+    stats.cpuNanos += nanos(CLOCK_THREAD_CPUTIME_ID) - cpuStart;
+    threadStats.phase = outer;
+}
+
+std::string formatText(const Stats &stats)
+{
+    std::string s;
+
+    s += fmt::format("{:<10} {:>8} {:>12} {:>12} {:>10} {:>12}\n", "phase",
+                     "calls", "wall ms", "cpu ms", "allocs", "bytes");
+    for (int i = 0; i < PhaseCount; i++) {
+        const PhaseStats &phase = stats.phases[i];
+        if (phase.calls == 0 && phase.allocations == 0)
+            continue;
+        s += fmt::format("{:<10} {:>8} {:>12.3f} {:>12.3f} {:>10} {:>12}\n",
+                         phaseName(static_cast<Phase>(i)), phase.calls,
+                         millis(phase.wallNanos), millis(phase.cpuNanos),
+                         phase.allocations, phase.bytesAllocated);
+    }
+
+    s += "tokens:";
+    for (int i = 0; i < Token::TypeCount; i++) {
+        if (stats.tokens[i] != 0) {
+            s += fmt::format(" {}={}",
+                             Token::type_as_string(static_cast<Token::Type>(i)),
+                             stats.tokens[i]);
+        }
+    }
+    s += "\nnodes:";
+    for (int i = 0; i < generated::ExprKindCount; i++) {
+        if (stats.nodes[i] != 0) {
+            s += fmt::format(" {}={}", generated::ExprKindNames[i],
+                             stats.nodes[i]);
+        }
+    }
+    s += fmt::format("\npeak rss: {} KiB\n", peakRss() / 1024);
+
+    return s;
+}
+
+std::string formatJson(const Stats &stats)
+{
+    std::string s = "{\"phases\":{";
+
+    for (int i = 0; i < PhaseCount; i++) {
+        const PhaseStats &phase = stats.phases[i];
+        if (i != 0)
+            s += ",";
+        s += fmt::format("\"{}\":{{\"calls\":{},\"wall_ns\":{},\"cpu_ns\":{},"
+                         "\"allocations\":{},\"bytes_allocated\":{}}}",
+                         phaseName(static_cast<Phase>(i)), phase.calls,
+                         phase.wallNanos, phase.cpuNanos, phase.allocations,
+                         phase.bytesAllocated);
+    }
+
+    s += "},\"tokens\":{";
+    bool first = true;
+    for (int i = 0; i < Token::TypeCount; i++) {
+        if (stats.tokens[i] == 0)
+            continue;
+        s += fmt::format("{}\"{}\":{}", first ? "" : ",",
+                         Token::type_as_string(static_cast<Token::Type>(i)),
+                         stats.tokens[i]);
+        first = false;
+    }
+
+    s += "},\"nodes\":{";
+    first = true;
+    for (int i = 0; i < generated::ExprKindCount; i++) {
+        if (stats.nodes[i] == 0)
+            continue;
+        s += fmt::format("{}\"{}\":{}", first ? "" : ",",
+                         generated::ExprKindNames[i], stats.nodes[i]);
+        first = false;
+    }
+
+    s += fmt::format("}},\"peak_rss_bytes\":{}}}", peakRss());
+    return s;
+}
+
+}; // namespace gravlax::stats
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include <fmt/core.h>
+
+#include <gravlax/trace.h>
+
+namespace
+{
+using gravlax::trace::Event;
+
+// Written only by its own thread. Buffers are linked into a list with a
+// compare-and-swap when a thread records its first event and are never
+// freed, so the events of finished threads can still be written out.
+struct ThreadBuffer {
+    std::uint32_t tid;
+    std::unique_ptr<Event[]> events;
+    std::uint64_t mask;
+    std::atomic<std::uint64_t> head{0};
+    ThreadBuffer *next = nullptr;
+
+    ThreadBuffer(std::uint32_t tid, std::size_t capacity)
+        : tid(tid), events(new Event[capacity]), mask(capacity - 1)
+    {
+    }
+};
+
+std::atomic<ThreadBuffer *> buffers{nullptr};
+std::atomic<std::uint32_t> nextTid{1};
+std::atomic<std::size_t> bufferCapacity{1 << 16};
+
+thread_local ThreadBuffer *localBuffer = nullptr;
+
+ThreadBuffer &threadBuffer()
+{
+    if (localBuffer)
+        return *localBuffer;
+
+    auto buffer = new ThreadBuffer(nextTid.fetch_add(1),
+                                   bufferCapacity.load());
+
+    ThreadBuffer *head = buffers.load(std::memory_order_relaxed);
+    do {
+        buffer->next = head;
+    } while (!buffers.compare_exchange_weak(head, buffer,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed));
+
+    localBuffer = buffer;
+    return *buffer;
+}
+
+void writeEscaped(std::string &s, const char *text)
+{
+    for (; *text; text++) {
+        if (*text == '"' || *text == '\\')
+            s += '\\';
+        s += *text;
+    }
+}
+
+}; // namespace
+
+namespace gravlax::trace
+{
+
+namespace detail
+{
+
+std::atomic<bool> enabled{false};
+
+std::uint64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void record(const char *name, std::uint64_t beginNanos)
+{
+    ThreadBuffer &buffer = threadBuffer();
+    std::uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    buffer.events[head & buffer.mask] = {name, beginNanos, now()};
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+}; // namespace detail
+
+void start(std::size_t capacity)
+{
+    bufferCapacity = std::bit_ceil(std::max<std::size_t>(capacity, 1));
+    detail::enabled.store(true);
+}
+
+void stop()
+{
+    detail::enabled.store(false);
+}
+
+bool isEnabled()
+{
+    return detail::enabled.load(std::memory_order_relaxed);
+}
+
+void clear()
+{
+    for (auto b = buffers.load(std::memory_order_acquire); b; b = b->next)
+        b->head.store(0, std::memory_order_relaxed);
+}
+
+std::size_t threadEventCount()
+{
+    ThreadBuffer &buffer = threadBuffer();
+    return std::min<std::uint64_t>(buffer.head.load(), buffer.mask + 1);
+}
+
+void writeChromeJson(std::ostream &out)
+{
+    std::string s = "{\"traceEvents\":[";
+    bool first = true;
+
+    for (auto b = buffers.load(std::memory_order_acquire); b; b = b->next) {
+        std::uint64_t head = b->head.load(std::memory_order_acquire);
+        std::uint64_t capacity = b->mask + 1;
+        std::uint64_t begin = head > capacity ? head - capacity : 0;
+
+        if (head == 0)
+            continue;
+
+        s += fmt::format("{}{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                         "\"tid\":{},\"args\":{{\"name\":\"thread {}\"}}}}",
+                         first ? "" : ",", b->tid, b->tid);
+        first = false;
+
+        for (std::uint64_t i = begin; i < head; i++) {
+            const Event &event = b->events[i & b->mask];
+            s += ",{\"name\":\"";
+            writeEscaped(s, event.name);
+            s += fmt::format(
+                "\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},"
+                "\"dur\":{:.3f}}}",
+                b->tid, event.beginNanos / 1e3,
+                (event.endNanos - event.beginNanos) / 1e3);
+        }
+    }
+
+    s += "],\"displayTimeUnit\":\"ns\"}\n";
+    out << s;
+}
+
+}; // namespace gravlax::trace
@@ -0,0 +1,109 @@
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <gravlax/utf8.h>
+
+namespace
+{
+
+// The offset of the first byte from i up that is not ASCII, or size.
+std::size_t skipAscii(const unsigned char *data, std::size_t i,
+                      std::size_t size)
+{
+#if defined(__SSE2__)
+    auto load = [&](std::size_t at) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + at));
+    };
+
+    // The sign bits of four loads are or-ed together, so that a block of
+    // ASCII costs one test.
+    for (; i + 64 <= size; i += 64) {
+        __m128i any = _mm_or_si128(_mm_or_si128(load(i), load(i + 16)),
+                                   _mm_or_si128(load(i + 32), load(i + 48)));
+        if (_mm_movemask_epi8(any) != 0)
+            break;
+    }
+    for (; i + 16 <= size; i += 16) {
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(load(i)));
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+#endif
+
+    while (i < size && data[i] < 0x80)
+        i++;
+    return i;
+}
+
+}; // namespace
+
+namespace gravlax::utf8
+{
+
+Validation validate(std::string_view text)
+{
+    const auto *data = reinterpret_cast<const unsigned char *>(text.data());
+    const std::size_t size = text.size();
+    bool ascii = true;
+
+    std::size_t i = 0;
+    while ((i = skipAscii(data, i, size)) < size) {
+        // The ranges of Table 3-7 of the Unicode Standard. Only the second
+        // byte may be narrower than 80..BF.
+        unsigned char lead = data[i];
+        unsigned char low = 0x80;
+        unsigned char high = 0xbf;
+        std::size_t length;
+        if (lead >= 0xc2 && lead <= 0xdf) {
+            length = 2;
+        } else if (lead >= 0xe0 && lead <= 0xef) {
+            length = 3;
+            if (lead == 0xe0)
+                low = 0xa0;
+            else if (lead == 0xed)
+                high = 0x9f;
+        } else if (lead >= 0xf0 && lead <= 0xf4) {
+            length = 4;
+            if (lead == 0xf0)
+                low = 0x90;
+            else if (lead == 0xf4)
+                high = 0x8f;
+        } else {
+            return {i, false, ascii};
+        }
+
+        for (std::size_t k = 1; k < length; k++) {
+            if (i + k == size)
+                return {i, true, ascii};
+            if (data[i + k] < low || data[i + k] > high)
+                return {i, false, ascii};
+            low = 0x80;
+            high = 0xbf;
+        }
+        i += length;
+        ascii = false;
+    }
+    return {size, false, ascii};
+}
+
+char32_t decode(std::string_view text, std::size_t &offset)
+{
+    auto byte = [&](std::size_t at) {
+        return static_cast<char32_t>(static_cast<unsigned char>(text[at]));
+    };
+
+    char32_t lead = byte(offset);
+    std::size_t length = lead < 0x80   ? 1
+                         : lead < 0xe0 ? 2
+                         : lead < 0xf0 ? 3
+                                       : 4;
+    // The payload bits of the lead byte.
+    char32_t c = length == 1 ? lead : lead & (0x7f >> length);
+    for (std::size_t k = 1; k < length; k++)
+        c = (c << 6) | (byte(offset + k) & 0x3f);
+    offset += length;
+    return c;
+}
+
+}; // namespace gravlax::utf8
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+#include <gravlax/stats.h>
+
+// Test binaries link the allocation hook, which counts the allocations made
+// by each thread, so that tests can put a budget on the allocations of a
+// code path.
+namespace gravlax::testing
+{
+
+using stats::Allocations;
+using stats::threadAllocations;
+
+// Counts the allocations made by the calling thread while it is alive.
+class AllocationScope
+{
+    Allocations start = threadAllocations();
+
+  public:
+    Allocations used() const
+    {
+        Allocations now = threadAllocations();
+        return {now.count - start.count, now.bytes - start.bytes};
+    }
+
+    std::uint64_t count() const { return used().count; }
+};
+
+// Number of allocations made by f().
+std::uint64_t countAllocations(auto &&f)
+{
+    AllocationScope scope;
+    f();
+    return scope.count();
+}
+
+}; // namespace gravlax::testing
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include <gravlax/embed.h>
+
+namespace gravlax::testing
+{
+
+// The script of code, which has to compile.
+inline std::shared_ptr<const Script> prepare(const char *code)
+{
+    Diagnostics diagnostics;
+    auto script = Script::prepare(code, diagnostics);
+    EXPECT_FALSE(diagnostics.hadError());
+    return script;
+}
+
+}; // namespace gravlax::testing
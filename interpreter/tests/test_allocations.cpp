@@ -0,0 +1,122 @@
+#include <string>
+
+#include <fmt/core.h>
+
+#include <gtest/gtest.h>
+
+#include <allocation_counter.h>
+#include <gravlax/parser.h>
+#include <gravlax/scanner.h>
+
+using gravlax::testing::countAllocations;
+
+// Allocation budgets for the front end. A failure here means that a change
+// made scanning or parsing allocate more than it needs to.
+class AllocationTest : public ::testing::Test
+{
+  public:
+    gravlax::Scanner scanner;
+    gravlax::Parser<std::string> parser;
+
+    // A source of n short tokens: numbers, operators, identifiers and
+    // keywords, none of which has a lexeme that needs a heap buffer.
+    static std::string shortTokens(int n)
+    {
+        std::string code;
+        const char *tokens[] = {"12.5", "+", "name", "*",
+                                "true", "-", "x",    ";"};
+        for (int i = 0; i < n; i++) {
+            code += tokens[i % 8];
+            code += ' ';
+        }
+        return code;
+    }
+
+    // 1 + 2 + ... with n literals, which parses into 2n - 1 nodes.
+    static std::string sum(int n)
+    {
+        std::string code = "1";
+        for (int i = 2; i <= n; i++)
+            code += fmt::format(" + {}", i);
+        return code;
+    }
+
+    void SetUp() override
+    {
+        // Warm up the static keyword table.
+        scanner.scanString("and");
+    }
+};
+
+TEST_F(AllocationTest, ScanningShortTokensOnlyAllocatesContainers)
+{
+    for (int n : {10, 1000, 100000}) {
+        auto code = shortTokens(n);
+        auto allocations =
+            countAllocations([&] { scanner.scanString(code); });
+
+        // The source copy, the token vector and its owner.
+        EXPECT_LE(allocations, 4) << n << " tokens";
+    }
+}
+
+TEST_F(AllocationTest, LongLexemesAllocateOnceEach)
+{
+    std::string code;
+    for (int i = 0; i < 1000; i++)
+        code += fmt::format("a_rather_long_identifier_{} ", i);
+
+    auto allocations = countAllocations([&] { scanner.scanString(code); });
+    EXPECT_LE(allocations, 1000 + 4);
+}
+
+TEST_F(AllocationTest, LongStringsAllocateLexemeAndValue)
+{
+    std::string code;
+    for (int i = 0; i < 1000; i++)
+        code += "\"a string literal that is long enough\" ";
+
+    auto allocations = countAllocations([&] { scanner.scanString(code); });
+    EXPECT_LE(allocations, 2 * 1000 + 4);
+}
+
+TEST_F(AllocationTest, ParsingAllocatesOneBlockPerNode)
+{
+    for (int n : {10, 1000}) {
+        auto tokens = scanner.scanString(sum(n));
+        auto allocations =
+            countAllocations([&] { parser.parse(std::move(tokens)); });
+
+        EXPECT_LE(allocations, (2 * n - 1) + 2) << n << " literals";
+    }
+}
+
+TEST_F(AllocationTest, ParsingOperatorsDoesNotCopyLexemes)
+{
+    // Unary and grouped operands, and long identifiers as operands, which
+    // are copied into their nodes once.
+    std::string code = "-(a_rather_long_identifier)";
+    for (int i = 0; i < 100; i++)
+        code += " * !(a_rather_long_identifier == -1)";
+    int nodes = 2 + 100 * 6;
+
+    auto tokens = scanner.scanString(code);
+    auto allocations =
+        countAllocations([&] { parser.parse(std::move(tokens)); });
+
+    EXPECT_LE(allocations, nodes + 101 + 2);
+}
+
+TEST_F(AllocationTest, ParsingAProgramAddsTheStatementList)
+{
+    std::string code;
+    for (int i = 0; i < 100; i++)
+        code += "1 + 2; ";
+
+    auto tokens = scanner.scanString(code);
+    auto allocations =
+        countAllocations([&] { parser.parseProgram(std::move(tokens)); });
+
+    // Three nodes per statement and the regrowth of the statement list.
+    EXPECT_LE(allocations, 300 + 10);
+}
@@ -0,0 +1,172 @@
+#include <cmath>
+#include <random>
+
+#include <fmt/core.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <gravlax/batch.h>
+#include <gravlax/interpreter.h>
+#include <gravlax/parser.h>
+#include <gravlax/scanner.h>
+
+using gravlax::BatchColumn;
+using gravlax::BatchProgram;
+using gravlax::BatchResult;
+using gravlax::Interpreter;
+using gravlax::Value;
+
+class BatchTest : public ::testing::Test
+{
+  public:
+    gravlax::Scanner scanner;
+    gravlax::Parser<Value> parser;
+
+    std::vector<std::string> names{"a", "b", "c"};
+    std::vector<std::vector<double>> values;
+    std::vector<std::vector<std::uint8_t>> valid;
+    std::vector<BatchColumn> columns;
+    std::size_t rows = 0;
+
+    // Random numbers with some nils and NaNs. The row count is not a
+    // multiple of the chunk size.
+    void makeColumns(std::size_t rows)
+    {
+        std::mt19937 rng(1234);
+        std::uniform_int_distribution<int> dist(-4, 4);
+
+        this->rows = rows;
+        values.assign(names.size(), std::vector<double>(rows));
+        valid.assign(names.size(), std::vector<std::uint8_t>(rows));
+
+        for (std::size_t c = 0; c < names.size(); c++) {
+            for (std::size_t i = 0; i < rows; i++) {
+                int r = dist(rng);
+                values[c][i] = r == 3 ? NAN : r;
+                valid[c][i] = r != -4;
+            }
+            columns.push_back({values[c].data(), valid[c].data()});
+        }
+    }
+
+    std::shared_ptr<gravlax::Expr<Value>> parse(const std::string &code)
+    {
+        auto expr = parser.parse(scanner.scanString(code));
+        EXPECT_TRUE(expr) << code;
+        return expr;
+    }
+
+    // Evaluates code once per row with the interpreter and checks that the
+    // batch program computes the same.
+    void expectSameAsInterpreter(const std::string &code)
+    {
+        auto expr = parse(code);
+        std::string error;
+        auto program = BatchProgram::compile(*expr, names, error);
+        ASSERT_TRUE(program) << error;
+
+        BatchResult result;
+        program->evaluate(columns, rows, result);
+
+        Interpreter interpreter;
+        for (std::size_t i = 0; i < rows; i++) {
+            for (std::size_t c = 0; c < names.size(); c++) {
+                interpreter.define(names[c], valid[c][i] ? Value(values[c][i])
+                                                         : Value());
+            }
+
+            Value expected;
+            try {
+                expected = interpreter.evaluate(*expr);
+            } catch (gravlax::RuntimeError &) {
+                ASSERT_TRUE(result.error[i]) << code << " row " << i;
+                ASSERT_FALSE(result.valid[i]);
+                continue;
+            }
+
+            ASSERT_FALSE(result.error[i]) << code << " row " << i;
+            if (std::holds_alternative<std::monostate>(expected)) {
+                ASSERT_FALSE(result.valid[i]);
+            } else if (auto b = std::get_if<bool>(&expected)) {
+                ASSERT_EQ(BatchResult::Type::Bool, result.type);
+                ASSERT_TRUE(result.valid[i]);
+                ASSERT_EQ(*b, result.values[i] != 0) << code << " row " << i;
+            } else {
+                double d = std::get<double>(expected);
+                ASSERT_EQ(BatchResult::Type::Number, result.type);
+                ASSERT_TRUE(result.valid[i]);
+                if (std::isnan(d)) {
+                    ASSERT_TRUE(std::isnan(result.values[i]));
+                } else {
+                    ASSERT_EQ(d, result.values[i]) << code << " row " << i;
+                }
+            }
+        }
+    }
+};
+
+TEST_F(BatchTest, Arithmetic)
+{
+    makeColumns(5000);
+    expectSameAsInterpreter("a + b * c");
+    expectSameAsInterpreter("-(a - 1.5) / (b - c)");
+}
+
+TEST_F(BatchTest, Comparison)
+{
+    makeColumns(5000);
+    expectSameAsInterpreter("a < b");
+    expectSameAsInterpreter("a * 2 >= c");
+    expectSameAsInterpreter("a == b");
+    expectSameAsInterpreter("a != nil");
+    expectSameAsInterpreter("(a > b) == (b > c)");
+    expectSameAsInterpreter("(a > b) == 1");
+}
+
+TEST_F(BatchTest, Logic)
+{
+    makeColumns(5000);
+    expectSameAsInterpreter("!a");
+    expectSameAsInterpreter("!(a < b)");
+    expectSameAsInterpreter("!!nil");
+}
+
+TEST_F(BatchTest, TypeErrors)
+{
+    makeColumns(100);
+    expectSameAsInterpreter("a + true");
+    expectSameAsInterpreter("-(a < b)");
+    expectSameAsInterpreter("nil < a");
+    expectSameAsInterpreter("!(a + nil)");
+}
+
+TEST_F(BatchTest, Constants)
+{
+    makeColumns(10);
+    expectSameAsInterpreter("1 + 2");
+    expectSameAsInterpreter("nil");
+}
+
+TEST_F(BatchTest, SharedSubexpressionsComputedOnce)
+{
+    makeColumns(3000);
+    parser.shareSubexpressions(true);
+
+    auto expr = parse("(a + b) * (a + b) - (a + b)");
+    std::string error;
+    auto program = BatchProgram::compile(*expr, names, error);
+    ASSERT_TRUE(program);
+    // a, b, a + b, *, -
+    EXPECT_EQ(5, program->instructions().size());
+
+    expectSameAsInterpreter("(a + b) * (a + b) - (a + b)");
+}
+
+TEST_F(BatchTest, CompileErrors)
+{
+    std::string error;
+    EXPECT_FALSE(BatchProgram::compile(*parse("a + d"), names, error));
+    EXPECT_EQ("Unknown column 'd'.", error);
+    EXPECT_FALSE(BatchProgram::compile(*parse("a + \"x\""), names, error));
+}
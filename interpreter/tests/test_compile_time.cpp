@@ -0,0 +1,110 @@
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <gravlax/ast_printer.h>
+#include <gravlax/compile_time.h>
+#include <gravlax/interpreter.h>
+#include <gravlax/parser.h>
+#include <gravlax/scanner.h>
+
+using gravlax::compile_time_parse;
+using gravlax::ExprKind;
+using gravlax::Interpreter;
+using gravlax::StaticNode;
+using gravlax::Token;
+using gravlax::Value;
+
+namespace
+{
+
+constexpr auto sum = compile_time_parse<"1 + 2.5 * -x">();
+
+// The tokens and the tree are constants.
+static_assert(sum.tokens.size() == 7);
+static_assert(sum.tokens[0].type == Token::Type::NUMBER);
+static_assert(sum.tokens[2].number == 2.5);
+static_assert(sum.lexeme(sum.tokens[5]) == "x");
+static_assert(sum.tokens[6].type == Token::Type::END_OF_FILE);
+static_assert(sum.nodes[sum.root].kind == ExprKind::Binary);
+static_assert(sum.lexeme(sum.tokens[sum.nodes[sum.root].token]) == "+");
+
+// Every token makes at most one node, so the array never overflows.
+constexpr auto grouped = compile_time_parse<"((((a))))">();
+static_assert(grouped.nodeCount == 1);
+static_assert(grouped.nodes[grouped.root].kind == ExprKind::Variable);
+
+constexpr auto call =
+    compile_time_parse<"f(1, \"two\", g()) // trailing comment">();
+static_assert(call.nodes[call.root].kind == ExprKind::Call);
+static_assert(call.nodes[call.nodes[call.nodes[call.root].right].next].next !=
+              StaticNode::None);
+
+static_assert(gravlax::lexer::numberValue("0.1") == 0.1);
+static_assert(gravlax::lexer::numberValue("123.456") == 123.456);
+static_assert(gravlax::lexer::numberValue("9007199254740993") ==
+              9007199254740992.0);
+static_assert(gravlax::lexer::numberValue("0.000000000000000000000000001") ==
+              1e-27);
+
+// The tree that the Parser makes of the same source.
+std::string parsed(const std::string &code)
+{
+    gravlax::Scanner scanner;
+    gravlax::Parser<std::string> parser;
+    auto expr = parser.parse(scanner.scanString(code));
+    EXPECT_TRUE(expr);
+    return gravlax::AstPrinter().print(*expr);
+}
+
+template <typename Ast> std::string built(const Ast &ast)
+{
+    gravlax::ExprFactory<std::string> factory;
+    return gravlax::AstPrinter().print(*ast.build(factory));
+}
+
+}; // namespace
+
+TEST(CompileTimeTest, BuildsWhatTheParserMakes)
+{
+    EXPECT_EQ(parsed(std::string(sum.source)), built(sum));
+    EXPECT_EQ(parsed(std::string(call.source)), built(call));
+
+    constexpr auto logic =
+        compile_time_parse<"a = !b or c and d != nil == (e >= 3)">();
+    EXPECT_EQ(parsed(std::string(logic.source)), built(logic));
+
+    constexpr auto strings =
+        compile_time_parse<"\"multi\nline\" + \"\" <= true">();
+    EXPECT_EQ(parsed(std::string(strings.source)), built(strings));
+}
+
+TEST(CompileTimeTest, Evaluates)
+{
+    constexpr auto ast = compile_time_parse<"(1 + 2) * 3 - 4 / 8">();
+    gravlax::ExprFactory<Value> factory;
+    Interpreter interpreter;
+    EXPECT_EQ("8.5", Interpreter::stringify(
+                         interpreter.evaluate(*ast.build(factory))));
+
+    constexpr auto text = compile_time_parse<"\"a\" + \"b\" == \"ab\"">();
+    EXPECT_EQ("true", Interpreter::stringify(
+                          interpreter.evaluate(*text.build(factory))));
+}
+
+// Literals get the same values as the scanner's std::from_chars.
+TEST(CompileTimeTest, NumbersMatchTheScanner)
+{
+    constexpr auto ast =
+        compile_time_parse<"0 + 3.14159 + 1234567.0625 + 0.3">();
+    gravlax::Scanner scanner;
+    auto tokens = scanner.scanString(std::string(ast.source));
+
+    ASSERT_EQ(tokens->size(), ast.tokens.size());
+    for (std::size_t i = 0; i < tokens->size(); i++) {
+        if ((*tokens)[i].type == Token::Type::NUMBER) {
+            EXPECT_EQ(std::get<double>((*tokens)[i].literal),
+                      ast.tokens[i].number);
+        }
+    }
+}
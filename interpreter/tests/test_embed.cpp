@@ -0,0 +1,157 @@
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <gravlax/embed.h>
+#include <prepare_script.h>
+
+using gravlax::Context;
+using gravlax::Diagnostics;
+using gravlax::RuntimeError;
+using gravlax::Script;
+using gravlax::testing::prepare;
+
+namespace
+{
+
+double scale(double x, int factor)
+{
+    return x * factor;
+}
+
+std::string shout(std::string_view s, bool loud)
+{
+    std::string result(s);
+    return loud ? result + "!" : result;
+}
+
+std::string lastWord;
+
+void remember(const std::string &word)
+{
+    lastWord = word;
+}
+
+}; // namespace
+
+TEST(EmbedTest, PreparedScriptsRunWithDifferentBindings)
+{
+    auto script = prepare("print transform(3);");
+    std::ostringstream out;
+
+    Context twice(script, out);
+    twice.bind<[](double x) { return x * 2; }>("transform");
+    twice.run();
+    twice.run();
+
+    Context squared(script, out);
+    squared.bind<[](double x) { return x * x; }>("transform");
+    squared.run();
+
+    EXPECT_EQ("6\n6\n9\n", out.str());
+}
+
+TEST(EmbedTest, BindingsConvertArguments)
+{
+    auto script = prepare("print scale(1.5, 4);\n"
+                          "var long = \"\";\n"
+                          "for (var i = 0; i < 40; i = i + 1)\n"
+                          "  long = long + \"ab\";\n"
+                          "print shout(long, true) == long + \"!\";\n"
+                          "print shout(\"hi\", false);\n"
+                          "print remember(\"word\");");
+    std::ostringstream out;
+    Context context(script, out);
+    context.bind<scale>("scale");
+    context.bind<shout>("shout");
+    context.bind<remember>("remember");
+    context.run();
+
+    EXPECT_EQ("6\ntrue\nhi\nnil\n", out.str());
+    EXPECT_EQ("word", lastWord);
+}
+
+TEST(EmbedTest, BadArgumentsAreRuntimeErrors)
+{
+    auto script = prepare("scale(\"x\", 2);");
+    std::ostringstream out;
+    Context context(script, out);
+    context.bind<scale>("scale");
+
+    try {
+        context.run();
+        FAIL() << "no error";
+    } catch (RuntimeError &error) {
+        EXPECT_STREQ("Operand must be a number.", error.what());
+        EXPECT_EQ(")", error.token.lexeme);
+    }
+}
+
+TEST(EmbedTest, HostCallsScriptFunctions)
+{
+    auto script = prepare("var total = 0;\n"
+                          "fun add(n) { total = total + n; return total; }\n"
+                          "fun greet(name) { return \"hello \" + name; }\n"
+                          "fun nothing() {}");
+    std::ostringstream out;
+    Context context(script, out);
+    context.run();
+
+    auto add = context.function("add");
+    EXPECT_EQ(2, context.call<double>(add, 2));
+    EXPECT_EQ(5, context.call<int>(add, 3.0));
+    EXPECT_EQ("hello you",
+              context.call<std::string>(context.function("greet"), "you"));
+    EXPECT_TRUE(context.call(context.function("nothing")).isNil());
+
+    EXPECT_THROW(context.call<double>(add), RuntimeError);
+    EXPECT_THROW(context.call<double>(context.function("missing")),
+                 RuntimeError);
+    EXPECT_THROW(context.call<bool>(add, 1), RuntimeError);
+    // The failed calls left the context usable.
+    EXPECT_EQ(11, context.call<double>(add, 5));
+}
+
+TEST(EmbedTest, PrepareReportsErrors)
+{
+    Diagnostics diagnostics;
+    EXPECT_EQ(nullptr, Script::prepare("fun f( { }", diagnostics));
+    EXPECT_TRUE(diagnostics.hadError());
+}
+
+// One script, a context per thread.
+TEST(EmbedTest, ContextsOnThreads)
+{
+    auto script = prepare("fun fib(n) {\n"
+                          "  if (n < 2) return n;\n"
+                          "  return fib(n - 1) + fib(n - 2);\n"
+                          "}\n"
+                          "print name() + \" \" + digits(fib(15));");
+
+    std::vector<std::string> outputs(4);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < outputs.size(); t++) {
+        threads.emplace_back([&, t] {
+            std::ostringstream out;
+            Context context(script, out);
+            context.bind<[](double n) { return std::to_string(int(n)); }>(
+                "digits");
+            context.bind<[] { return "thread"; }>("name");
+            context.run();
+            for (int i = 0; i < 10; i++) {
+                EXPECT_EQ(55, context.call<double>(context.function("fib"),
+                                                   10));
+            }
+            outputs[t] = out.str();
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    for (auto &output : outputs)
+        EXPECT_EQ("thread 610\n", output);
+}
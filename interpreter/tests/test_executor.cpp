@@ -0,0 +1,399 @@
+#include <chrono>
+#include <optional>
+#include <sstream>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <gravlax/executor.h>
+#include <gravlax/parser.h>
+#include <gravlax/resolver.h>
+#include <gravlax/scanner.h>
+
+#include <gravlax/generated/binary.h>
+#include <gravlax/generated/stmt_print.h>
+
+using gravlax::BudgetError;
+using gravlax::Executor;
+using gravlax::RuntimeError;
+
+class ExecutorTest : public ::testing::Test
+{
+  public:
+    std::ostringstream out;
+    Executor executor{out};
+    bool lazyFunctions = false;
+
+    // Runs the program and returns what it printed.
+    std::string run(const char *code)
+    {
+        gravlax::Diagnostics diagnostics;
+        gravlax::Scanner scanner(diagnostics);
+        gravlax::Parser<Executor::Value> parser(diagnostics);
+        gravlax::Resolver<Executor::Value> resolver(executor.globalNames(),
+                                                   diagnostics);
+        parser.setLazyFunctions(lazyFunctions);
+
+        auto program = parser.parseStatements(scanner.scanString(code));
+        auto script = resolver.resolve(program);
+        EXPECT_FALSE(diagnostics.hadError());
+
+        out.str("");
+        executor.execute(std::move(program), script);
+        return out.str();
+    }
+
+    std::string runtimeError(const char *code)
+    {
+        try {
+            run(code);
+        } catch (RuntimeError &error) {
+            return error.what();
+        }
+        return "";
+    }
+};
+
+TEST_F(ExecutorTest, StatementsAndScopes)
+{
+    EXPECT_EQ("3\nglobal\nblock\nglobal\n",
+              run("var a = 1 + 2;\n"
+                  "print a;\n"
+                  "var s = \"global\";\n"
+                  "print s;\n"
+                  "{ var s = \"block\"; print s; }\n"
+                  "print s;"));
+}
+
+TEST_F(ExecutorTest, ControlFlow)
+{
+    EXPECT_EQ("0\n1\n2\nyes\nnil\nx\n",
+              run("for (var i = 0; i < 3; i = i + 1) print i;\n"
+                  "if (1 > 2) print \"no\"; else print \"yes\";\n"
+                  "print true and nil;\n"
+                  "print nil or \"x\";"));
+}
+
+TEST_F(ExecutorTest, Functions)
+{
+    EXPECT_EQ("55\n<fn fib>\n<native fn>\nnil\n",
+              run("fun fib(n) {\n"
+                  "  if (n < 2) return n;\n"
+                  "  return fib(n - 1) + fib(n - 2);\n"
+                  "}\n"
+                  "print fib(10);\n"
+                  "print fib;\n"
+                  "print clock;\n"
+                  "fun nothing() {}\n"
+                  "print nothing();"));
+}
+
+TEST_F(ExecutorTest, ClosuresShareCapturedVariables)
+{
+    EXPECT_EQ("1\n2\n12\n",
+              run("var get; var set;\n"
+                  "fun make() {\n"
+                  "  var count = 0;\n"
+                  "  fun g() { return count; }\n"
+                  "  fun s(v) { count = v; }\n"
+                  "  get = g; set = s;\n"
+                  "  count = 1;\n"
+                  "}\n"
+                  "make();\n"
+                  "print get();\n"
+                  "set(2);\n"
+                  "print get();\n"
+                  "fun counter() {\n"
+                  "  var i = 10;\n"
+                  "  fun next() { i = i + 1; return i; }\n"
+                  "  return next;\n"
+                  "}\n"
+                  "var next = counter();\n"
+                  "next();\n"
+                  "print next();"));
+}
+
+TEST_F(ExecutorTest, EachIterationGetsItsOwnVariable)
+{
+    EXPECT_EQ("0\n1\n2\n",
+              run("var f0; var f1; var f2;\n"
+                  "for (var i = 0; i < 3; i = i + 1) {\n"
+                  "  var j = i;\n"
+                  "  fun f() { print j; }\n"
+                  "  if (j == 0) f0 = f;\n"
+                  "  if (j == 1) f1 = f;\n"
+                  "  if (j == 2) f2 = f;\n"
+                  "}\n"
+                  "f0(); f1(); f2();"));
+}
+
+TEST_F(ExecutorTest, GlobalsOutliveTheProgram)
+{
+    run("var greeting = \"hi\"; fun greet(name) { return greeting + name; }");
+    EXPECT_EQ("hi bob\n", run("print greet(\" bob\");"));
+
+    Executor::Value value;
+    ASSERT_TRUE(executor.global("greeting", value));
+    EXPECT_EQ("hi", executor.stringify(value));
+    EXPECT_FALSE(executor.global("missing", value));
+}
+
+TEST_F(ExecutorTest, LazyFunctionsRunLikeEagerOnes)
+{
+    lazyFunctions = true;
+    EXPECT_EQ("1\n2\n610\ninner\nouter\nlate\n",
+              run("fun makeCounter() {\n"
+                  "  var i = 0;\n"
+                  "  fun count() {\n"
+                  "    i = i + 1;\n"
+                  "    fun show() { print i; }\n"
+                  "    show();\n"
+                  "  }\n"
+                  "  return count;\n"
+                  "}\n"
+                  "var c = makeCounter();\n"
+                  "c(); c();\n"
+                  "fun fib(n) {\n"
+                  "  if (n < 2) return n;\n"
+                  "  return fib(n - 1) + fib(n - 2);\n"
+                  "}\n"
+                  "print fib(15);\n"
+                  "{\n"
+                  "  var a = \"outer\";\n"
+                  "  fun f() { var a = \"inner\"; fun g() { print a; } g(); }\n"
+                  "  f();\n"
+                  "  fun h() { print a; }\n"
+                  "  h();\n"
+                  "}\n"
+                  "fun later() { return global; }\n"
+                  "var global = \"late\";\n"
+                  "print later();"));
+}
+
+TEST_F(ExecutorTest, LazyBodiesAreCheckedOnTheirFirstCall)
+{
+    lazyFunctions = true;
+    EXPECT_EQ("Could not compile 'broken'.",
+              runtimeError("fun broken() { var = 1; }\n"
+                           "fun unused() { return return; }\n"
+                           "print \"runs\";\n"
+                           "broken();"));
+    EXPECT_EQ("runs\n", out.str());
+    ASSERT_EQ(1, executor.compileErrors().count());
+    EXPECT_EQ("Expect variable name.",
+              executor.compileErrors().all()[0].message);
+}
+
+TEST_F(ExecutorTest, StringsBuiltPieceByPiece)
+{
+    EXPECT_EQ("true\nfalse\n" + std::string(100, '-') + "\n",
+              run("var a = \"\"; var b = \"\";\n"
+                  "for (var i = 0; i < 20000; i = i + 1) {\n"
+                  "  a = a + \"ab\";\n"
+                  "  b = \"ba\" + b;\n"
+                  "}\n"
+                  "print \"a\" + b == a + \"a\";\n"
+                  "print a == b;\n"
+                  "var line = \"\";\n"
+                  "for (var i = 0; i < 10; i = i + 1)\n"
+                  "  line = line + \"----------\";\n"
+                  "print line;"));
+}
+
+TEST_F(ExecutorTest, RuntimeErrors)
+{
+    EXPECT_EQ("Undefined variable 'x'.", runtimeError("print x;"));
+    EXPECT_EQ("Undefined variable 'y'.", runtimeError("y = 1;"));
+    EXPECT_EQ("Can only call functions and classes.",
+              runtimeError("\"f\"();"));
+    EXPECT_EQ("Expected 1 arguments but got 2.",
+              runtimeError("fun f(a) {} f(1, 2);"));
+    EXPECT_EQ("Operands must be two numbers or two strings.",
+              runtimeError("print 1 + \"a\";"));
+    EXPECT_EQ("Stack overflow.", runtimeError("fun f() { f(); } f();"));
+
+    // Still usable afterwards.
+    EXPECT_EQ("2\n", run("print 1 + 1;"));
+}
+
+TEST_F(ExecutorTest, ClosuresSurviveAFailedProgram)
+{
+    runtimeError("var f;\n"
+                 "{ var captured = \"kept\"; fun g() { print captured; }\n"
+                 "  f = g; nil(); }");
+    EXPECT_EQ("kept\n", run("f();"));
+}
+
+// Sites that saw numbers first still handle strings and errors after they
+// have been rewritten, and the other way around.
+TEST_F(ExecutorTest, QuickenedOperatorsFallBack)
+{
+    executor.setQuickening(true);
+    EXPECT_EQ("0.5\n1.5\nab\n3\nxy\ntrue\nfalse\ntrue\nfalse\n",
+              run("fun add(a, b) { return a + b; }\n"
+                  "fun same(a, b) { return a == b; }\n"
+                  "fun cat(a, b) { return a + b; }\n"
+                  "for (var i = 0; i < 2; i = i + 1) print add(i, 0.5);\n"
+                  "print add(\"a\", \"b\");\n"
+                  "print add(1, 2);\n"
+                  "print cat(\"x\", \"y\");\n"
+                  "print same(1, 1);\n"
+                  "print same(0 / 0, 0 / 0);\n"
+                  "print same(\"s\", \"s\");\n"
+                  "print same(1, nil);"));
+    EXPECT_EQ("3\n", run("print cat(1, 2);"));
+    EXPECT_EQ("Operands must be two numbers or two strings.",
+              runtimeError("print add(1, \"a\");"));
+    EXPECT_EQ("Operands must be numbers.",
+              runtimeError("fun less(a, b) { return a < b; }\n"
+                           "print less(1, 2);\n"
+                           "print less(nil, 2);"));
+}
+
+TEST_F(ExecutorTest, QuickeningRewritesSites)
+{
+    using gravlax::Quickening;
+    using Binary = gravlax::generated::Binary<Executor::Value>;
+    using Print = gravlax::generated::Print<Executor::Value>;
+
+    gravlax::Diagnostics diagnostics;
+    gravlax::Scanner scanner(diagnostics);
+    gravlax::Parser<Executor::Value> parser(diagnostics);
+    gravlax::Resolver<Executor::Value> resolver(executor.globalNames(),
+                                               diagnostics);
+    auto program = parser.parseStatements(scanner.scanString(
+        "print 1 < 2; print \"a\" + \"b\"; print 1 + nil;"));
+    auto script = resolver.resolve(program);
+    ASSERT_FALSE(diagnostics.hadError());
+
+    auto site = [&](int i) -> Quickening & {
+        auto &print = static_cast<Print &>(*program[i]);
+        return static_cast<Binary &>(*print.expression).quickening;
+    };
+    EXPECT_EQ(site(0).load(), Quickening::Op::Unobserved);
+
+    executor.setQuickening(true);
+    EXPECT_THROW(executor.run(program, script), RuntimeError);
+    EXPECT_EQ(site(0).load(), Quickening::Op::LessNumbers);
+    EXPECT_EQ(site(1).load(), Quickening::Op::ConcatStrings);
+    EXPECT_EQ(site(2).load(), Quickening::Op::Generic);
+}
+
+class ExecutorBudgetTest : public ExecutorTest
+{
+  public:
+    // The reason the program ran out of budget, if it did.
+    std::optional<BudgetError::Reason> exhausted(const char *code)
+    {
+        try {
+            run(code);
+        } catch (BudgetError &error) {
+            return error.reason;
+        }
+        return {};
+    }
+};
+
+// Every call and loop iteration is a step.
+TEST_F(ExecutorBudgetTest, Steps)
+{
+    executor.setBudget({.steps = 6});
+    EXPECT_EQ(std::nullopt,
+              exhausted("fun f() {}\n"
+                        "for (var i = 0; i < 5; i = i + 1) {}\n"
+                        "f();"));
+    EXPECT_EQ(BudgetError::Reason::Steps,
+              exhausted("for (var i = 0; i < 7; i = i + 1) {}"));
+
+    // More than one check interval.
+    executor.setBudget({.steps = 3000});
+    EXPECT_EQ(std::nullopt,
+              exhausted("for (var i = 0; i < 3000; i = i + 1) {}"));
+    EXPECT_EQ(BudgetError::Reason::Steps,
+              exhausted("fun f(n) { if (n > 0) f(n - 1); }\n"
+                        "while (true) f(100);"));
+
+    // Each run starts with the whole budget, and a host call is a run too.
+    executor.setBudget({.steps = 2});
+    run("fun g() { return 1; }");
+    Executor::Value g;
+    ASSERT_TRUE(executor.global("g", g));
+    EXPECT_EQ(1, executor.call(g, nullptr, 0).asNumber());
+}
+
+TEST_F(ExecutorBudgetTest, Deadline)
+{
+    executor.setBudget({.time = std::chrono::milliseconds(20)});
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(BudgetError::Reason::Deadline, exhausted("while (true) {}"));
+    EXPECT_LT(std::chrono::steady_clock::now() - start,
+              std::chrono::seconds(5));
+}
+
+TEST_F(ExecutorBudgetTest, HeapBytes)
+{
+    executor.setBudget({.heapBytes = 4 << 20});
+    EXPECT_EQ(BudgetError::Reason::Heap,
+              exhausted("var keep = \"\";\n"
+                        "while (true) { fun f() {} keep = keep + \"x\"; }"));
+
+    // One large allocation is checked before it is made. Comparing the
+    // ropes flattens them into two strings of 2 MiB.
+    const char *doubling = "var s = \"0123456789abcdef\";\n"
+                           "var t = s;\n"
+                           "for (var i = 0; i < 17; i = i + 1) {\n"
+                           "  s = s + s;\n"
+                           "  t = t + t;\n"
+                           "}\n"
+                           "s == t;";
+    executor.setBudget({.heapBytes = 1 << 20});
+    EXPECT_EQ(BudgetError::Reason::Heap,
+              exhausted(doubling));
+
+    // Not for what the next run allocates.
+    executor.setBudget({});
+    EXPECT_EQ(std::nullopt,
+              exhausted(doubling));
+}
+
+TEST_F(ExecutorBudgetTest, PreemptFromAnotherThread)
+{
+    std::thread preempter([this] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        executor.preempt();
+    });
+    EXPECT_EQ(BudgetError::Reason::Preempted,
+              exhausted("fun spin() { while (true) {} }\nspin();"));
+    preempter.join();
+
+    // The executor is ready for the next program.
+    EXPECT_EQ("2\n", run("print 1 + 1;"));
+}
+
+TEST(ExecutorHeapTest, ValuesSurviveCollections)
+{
+    std::ostringstream out;
+    Executor executor(out, {.nurseryBytes = 4096, .blockBytes = 1 << 14});
+    gravlax::Diagnostics diagnostics;
+    gravlax::Scanner scanner(diagnostics);
+    gravlax::Parser<Executor::Value> parser(diagnostics);
+    gravlax::Resolver<Executor::Value> resolver(executor.globalNames(),
+                                               diagnostics);
+
+    auto program = parser.parseStatements(scanner.scanString(
+        "fun make(s) { fun get() { return s; } return get; }\n"
+        "var keep = make(\"a\" + \"b\");\n"
+        "var s = \"\";\n"
+        "for (var i = 0; i < 500; i = i + 1) {\n"
+        "  var f = make(\"x\");\n"
+        "  s = s + f();\n"
+        "}\n"
+        "print keep();\n"
+        "print s == s + \"\";"));
+    auto script = resolver.resolve(program);
+    ASSERT_FALSE(diagnostics.hadError());
+
+    executor.execute(std::move(program), script);
+    EXPECT_EQ("ab\ntrue\n", out.str());
+    EXPECT_GT(executor.heap().stats().minorCollections, 0);
+}
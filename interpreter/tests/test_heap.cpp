@@ -0,0 +1,408 @@
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <gravlax/runtime/heap.h>
+
+using gravlax::runtime::Heap;
+using gravlax::runtime::HeapOptions;
+using gravlax::runtime::Obj;
+using gravlax::runtime::ObjInstance;
+using gravlax::runtime::ObjRope;
+using gravlax::runtime::ObjString;
+using gravlax::runtime::ObjType;
+using gravlax::runtime::PauseHistogram;
+using gravlax::runtime::RootedValue;
+using gravlax::runtime::Rooted;
+using gravlax::runtime::RootSource;
+using gravlax::runtime::Tracer;
+using gravlax::runtime::Value;
+
+namespace
+{
+
+// Small spaces, so that the tests collect often.
+HeapOptions smallHeap()
+{
+    HeapOptions options;
+    options.nurseryBytes = 16 << 10;
+    options.blockBytes = 16 << 10;
+    options.majorThreshold = 64 << 10;
+    return options;
+}
+
+ObjInstance *asInstance(Value value)
+{
+    return static_cast<ObjInstance *>(value.asObject());
+}
+
+}; // namespace
+
+TEST(HeapTest, AllocatesStringsInTheNursery)
+{
+    Heap heap;
+    ObjString *s = heap.string("hello");
+
+    EXPECT_EQ("hello", s->view());
+    EXPECT_EQ('\0', s->chars()[5]);
+    EXPECT_TRUE(heap.isYoung(s));
+    EXPECT_EQ(1, heap.stats().objectsAllocated);
+}
+
+TEST(HeapTest, RootedObjectsArePromoted)
+{
+    Heap heap;
+    Rooted<ObjString> s(heap, heap.string("survivor"));
+    ObjString *before = s;
+
+    heap.collect();
+
+    EXPECT_NE(before, s.get());
+    EXPECT_FALSE(heap.isYoung(s));
+    EXPECT_EQ("survivor", s->view());
+    EXPECT_EQ(1, heap.stats().minorCollections);
+    EXPECT_EQ(0, heap.nurseryUsed());
+}
+
+TEST(HeapTest, UnreachableObjectsAreNotPromoted)
+{
+    Heap heap;
+    for (int i = 0; i < 1000; i++)
+        heap.string("garbage");
+
+    heap.collect();
+
+    EXPECT_EQ(0, heap.stats().bytesPromoted);
+    EXPECT_EQ(0, heap.oldGenerationBytes());
+}
+
+TEST(HeapTest, RootVectorsAndSourcesAreTraced)
+{
+    struct Globals : RootSource {
+        Value value;
+        void traceRoots(Tracer &tracer) override { tracer.visit(value); }
+    };
+
+    Heap heap;
+    std::vector<Value> stack;
+    Globals globals;
+    heap.addRoots(&stack);
+    heap.addRoots(&globals);
+
+    stack.push_back(Value::fromObject(heap.string("on the stack")));
+    stack.push_back(Value::fromNumber(1));
+    globals.value = Value::fromObject(heap.string("a global"));
+
+    heap.collect();
+    heap.collect(true);
+
+    EXPECT_EQ("on the stack", gravlax::runtime::asString(stack[0])->view());
+    EXPECT_EQ(1, stack[1].asNumber());
+    EXPECT_EQ("a global", gravlax::runtime::asString(globals.value)->view());
+
+    heap.removeRoots(&stack);
+    heap.removeRoots(&globals);
+}
+
+TEST(HeapTest, SharedReferencesStayShared)
+{
+    Heap heap;
+    Rooted<ObjInstance> a(heap, heap.instance(2));
+    ObjString *s = heap.string("shared");
+    heap.setField(a, 0, Value::fromObject(s));
+    heap.setField(a, 1, Value::fromObject(s));
+
+    heap.collect();
+
+    EXPECT_EQ(a->fields()[0].asObject(), a->fields()[1].asObject());
+}
+
+TEST(HeapTest, WriteBarrierKeepsYoungObjectsOfOldOnes)
+{
+    Heap heap;
+    Rooted<ObjInstance> old(heap, heap.instance(1));
+    heap.collect();
+    ASSERT_FALSE(heap.isYoung(old));
+
+    heap.setField(old, 0, Value::fromObject(heap.string("young")));
+    heap.collect();
+
+    Value field = old->fields()[0];
+    EXPECT_FALSE(heap.isYoung(field.asObject()));
+    EXPECT_EQ("young", gravlax::runtime::asString(field)->view());
+}
+
+TEST(HeapTest, WriteBarrierFarIntoLargeBlocks)
+{
+    HeapOptions options;
+    options.blockBytes = 4 << 20;
+    Heap heap(options);
+    std::vector<Value> stack;
+    heap.addRoots(&stack);
+
+    for (int i = 0; i < 40000; i++)
+        stack.push_back(Value::fromObject(heap.instance(1)));
+    heap.collect();
+    ObjInstance *last = asInstance(stack.back());
+    ASSERT_FALSE(heap.isYoung(last));
+
+    heap.setField(last, 0, Value::fromObject(heap.string("young")));
+    heap.collect();
+
+    Value field = asInstance(stack.back())->fields()[0];
+    EXPECT_FALSE(heap.isYoung(field.asObject()));
+    EXPECT_EQ("young", gravlax::runtime::asString(field)->view());
+
+    heap.removeRoots(&stack);
+}
+
+TEST(HeapTest, LargeObjectsAreRememberedAndSwept)
+{
+    Heap heap;
+    std::size_t fields = 1 << 14;
+    auto large = heap.instance(static_cast<std::uint32_t>(fields));
+    EXPECT_FALSE(heap.isYoung(large));
+    EXPECT_TRUE(large->flags & Obj::Large);
+
+    {
+        Rooted<ObjInstance> rooted(heap, large);
+        heap.setField(rooted, 7, Value::fromObject(heap.string("young")));
+        heap.collect();
+
+        EXPECT_EQ(large, rooted.get());
+        EXPECT_EQ("young",
+                  gravlax::runtime::asString(rooted->fields()[7])->view());
+    }
+
+    EXPECT_GT(heap.oldGenerationBytes(), fields * sizeof(Value));
+    heap.collect(true);
+    EXPECT_EQ(0, heap.oldGenerationBytes());
+}
+
+TEST(HeapTest, MajorCollectionCompactsTheOldGeneration)
+{
+    Heap heap(smallHeap());
+    std::vector<Value> roots;
+    heap.addRoots(&roots);
+
+    for (int i = 0; i < 1000; i++)
+        roots.push_back(Value::fromObject(heap.string(std::to_string(i))));
+    heap.collect();
+    std::size_t full = heap.oldGenerationBytes();
+
+    // Keep every tenth string.
+    std::vector<Value> kept;
+    for (std::size_t i = 0; i < roots.size(); i += 10)
+        kept.push_back(roots[i]);
+    roots = kept;
+
+    heap.collect(true);
+
+    EXPECT_LT(heap.oldGenerationBytes(), full / 5);
+    for (std::size_t i = 0; i < roots.size(); i++) {
+        EXPECT_EQ(std::to_string(i * 10),
+                  gravlax::runtime::asString(roots[i])->view());
+    }
+    heap.removeRoots(&roots);
+}
+
+TEST(HeapTest, ConcatKeepsItsOperandsAcrossCollections)
+{
+    Heap heap(smallHeap());
+    std::string expected;
+    Rooted<Obj> s(heap, heap.string(""));
+
+    for (int i = 0; i < 2000; i++) {
+        RootedValue piece(heap, Value::fromObject(heap.string("ab")));
+        s = heap.concat(s, piece.get().asObject());
+        expected += "ab";
+    }
+
+    ObjString *flat = heap.flatten(s);
+    EXPECT_EQ(expected, flat->view());
+    EXPECT_EQ(gravlax::runtime::hashChars(expected), flat->hash);
+    EXPECT_GT(heap.stats().minorCollections, 0);
+    EXPECT_GT(heap.stats().majorCollections, 0);
+}
+
+TEST(HeapTest, LongConcatenationsAreFlattenedOnce)
+{
+    Heap heap;
+    std::string half(Heap::MinRopeLength / 2, 'a');
+    Rooted<ObjString> a(heap, heap.string(half));
+
+    Obj *shorter = heap.concat(a, heap.string("b"));
+    EXPECT_EQ(ObjType::String, shorter->type);
+    EXPECT_EQ(a.get(), heap.concat(a, heap.string("")));
+
+    Rooted<Obj> rope(heap, heap.concat(a, heap.string(half + "c")));
+    ASSERT_EQ(ObjType::Rope, rope->type);
+    EXPECT_EQ(Heap::MinRopeLength + 1, gravlax::runtime::stringLength(rope));
+
+    ObjString *flat = heap.flatten(rope);
+    EXPECT_EQ(half + half + "c", flat->view());
+    EXPECT_EQ(flat, heap.flatten(rope));
+    EXPECT_EQ(nullptr, static_cast<ObjRope *>(rope.get())->left);
+
+    // The flat string is kept by the rope across collections.
+    heap.collect(true);
+    EXPECT_EQ(half + half + "c", heap.flatten(rope)->view());
+}
+
+// Flattening and collecting ropes that are far deeper than the C++ stack.
+TEST(HeapTest, DeepRopes)
+{
+    Heap heap(smallHeap());
+    Rooted<ObjString> piece(heap, heap.string(std::string(40, 'x')));
+    Rooted<Obj> left(heap, piece);
+    Rooted<Obj> right(heap, piece);
+
+    constexpr int Depth = 100000;
+    for (int i = 1; i < Depth; i++) {
+        left = heap.concat(left, piece);
+        right = heap.concat(piece, right);
+    }
+    heap.collect(true);
+
+    std::string expected(40 * Depth, 'x');
+    EXPECT_EQ(expected, heap.flatten(left)->view());
+    EXPECT_EQ(expected, heap.flatten(right)->view());
+}
+
+TEST(HeapTest, InternedStringsAreSharedAndOld)
+{
+    Heap heap;
+    ObjString *a = heap.intern("name");
+    ObjString *b = heap.intern(std::string("na") + "me");
+
+    EXPECT_EQ(a, b);
+    EXPECT_NE(a, heap.intern("other"));
+    EXPECT_FALSE(heap.isYoung(a));
+    EXPECT_TRUE(a->flags & Obj::Interned);
+    EXPECT_FALSE(heap.string("name")->flags & Obj::Interned);
+    EXPECT_EQ(2, heap.internedCount());
+}
+
+TEST(HeapTest, InternSetDropsDeadStrings)
+{
+    Heap heap(smallHeap());
+    Rooted<ObjString> kept(heap, heap.intern("kept"));
+    for (int i = 0; i < 200; i++)
+        heap.intern("dropped" + std::to_string(i));
+    ASSERT_EQ(201, heap.internedCount());
+
+    // Minor collections leave the set alone.
+    heap.collect();
+    EXPECT_EQ(201, heap.internedCount());
+
+    heap.collect(true);
+    EXPECT_EQ(1, heap.internedCount());
+    EXPECT_EQ(kept.get(), heap.intern("kept"));
+    EXPECT_EQ("kept", kept->view());
+    EXPECT_NE(nullptr, heap.intern("dropped7"));
+    EXPECT_EQ(2, heap.internedCount());
+}
+
+// Mutates a random object graph through the write barrier and checks it
+// against a model after many minor and major collections.
+TEST(HeapTest, RandomGraphStress)
+{
+    constexpr int FieldCount = 4;
+    constexpr int RootCount = 64;
+
+    Heap heap(smallHeap());
+    std::vector<Value> roots(RootCount);
+    heap.addRoots(&roots);
+
+    // Field 0 of every instance holds its id. The model maps ids to the ids
+    // of the instances in the other fields, or -1.
+    std::unordered_map<int, std::vector<int>> model;
+    std::mt19937 rng(42);
+    int nextId = 0;
+
+    auto idOf = [](Value value) {
+        return value.isObject()
+                   ? static_cast<int>(asInstance(value)->fields()[0].asNumber())
+                   : -1;
+    };
+
+    for (int step = 0; step < 50000; step++) {
+        int r = rng() % RootCount;
+        switch (rng() % 4) {
+        case 0: {
+            auto instance = heap.instance(FieldCount);
+            instance->fields()[0] = Value::fromNumber(nextId);
+            model[nextId] = std::vector<int>(FieldCount, -1);
+            nextId++;
+            roots[r] = Value::fromObject(instance);
+            break;
+        }
+        case 1:
+        case 2: {
+            int other = rng() % RootCount;
+            if (!roots[r].isObject())
+                break;
+            int field = 1 + rng() % (FieldCount - 1);
+            heap.setField(asInstance(roots[r]), field, roots[other]);
+            model[idOf(roots[r])][field] = idOf(roots[other]);
+            break;
+        }
+        case 3: {
+            // Follow a reference, which keeps older objects in play.
+            if (!roots[r].isObject())
+                break;
+            roots[rng() % RootCount] =
+                asInstance(roots[r])->fields()[1 + rng() % (FieldCount - 1)];
+            break;
+        }
+        }
+        // Garbage between the live objects.
+        heap.string("filler");
+    }
+
+    EXPECT_GT(heap.stats().minorCollections, 10);
+    EXPECT_GT(heap.stats().majorCollections, 0);
+
+    std::vector<Value> pending(roots.begin(), roots.end());
+    std::unordered_map<int, Obj *> seen;
+    while (!pending.empty()) {
+        Value value = pending.back();
+        pending.pop_back();
+        if (!value.isObject())
+            continue;
+
+        auto instance = asInstance(value);
+        ASSERT_EQ(ObjType::Instance, instance->type);
+        int id = idOf(value);
+        auto [it, added] = seen.emplace(id, instance);
+        ASSERT_EQ(instance, it->second) << "object " << id << " duplicated";
+        if (!added)
+            continue;
+
+        for (int f = 1; f < FieldCount; f++) {
+            ASSERT_EQ(model[id][f], idOf(instance->fields()[f]));
+            pending.push_back(instance->fields()[f]);
+        }
+    }
+
+    heap.removeRoots(&roots);
+}
+
+TEST(PauseHistogramTest, BucketsByPowersOfTwo)
+{
+    PauseHistogram histogram;
+    histogram.record(500);
+    histogram.record(1500);
+    histogram.record(3000);
+    histogram.record(3000);
+
+    EXPECT_EQ(1, histogram.buckets[0]);
+    EXPECT_EQ(1, histogram.buckets[1]);
+    EXPECT_EQ(2, histogram.buckets[2]);
+    EXPECT_EQ(1, histogram.percentileMicros(0.25));
+    EXPECT_EQ(4, histogram.percentileMicros(0.99));
+    EXPECT_EQ(3000, histogram.maxNanos);
+}
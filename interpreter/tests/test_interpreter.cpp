@@ -0,0 +1,86 @@
+#include <fmt/core.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <gravlax/interpreter.h>
+#include <gravlax/parser.h>
+#include <gravlax/scanner.h>
+
+using gravlax::Interpreter;
+using gravlax::RuntimeError;
+using gravlax::Token;
+using gravlax::Value;
+
+class InterpreterTest : public ::testing::Test
+{
+  public:
+    gravlax::Scanner scanner;
+    gravlax::Parser<Value> parser;
+    Interpreter interpreter;
+
+    Value eval(const std::string &code)
+    {
+        auto expr = parser.parse(scanner.scanString(code));
+        EXPECT_TRUE(expr) << code;
+        return interpreter.evaluate(*expr);
+    }
+
+    std::string print(const std::string &code)
+    {
+        return Interpreter::stringify(eval(code));
+    }
+};
+
+TEST_F(InterpreterTest, Arithmetic)
+{
+    EXPECT_EQ("7", print("1 + 2 * 3"));
+    EXPECT_EQ("-1.5", print("-(3 / 2)"));
+    EXPECT_EQ("2", print("(1 + 1) * (3 - 2)"));
+}
+
+TEST_F(InterpreterTest, Comparison)
+{
+    EXPECT_EQ("true", print("1 < 2"));
+    EXPECT_EQ("false", print("2 <= 1"));
+    EXPECT_EQ("true", print("1 == 1"));
+    EXPECT_EQ("false", print("1 == true"));
+    EXPECT_EQ("true", print("nil == nil"));
+    EXPECT_EQ("true", print("\"a\" != \"b\""));
+}
+
+TEST_F(InterpreterTest, Truthiness)
+{
+    EXPECT_EQ("true", print("!nil"));
+    EXPECT_EQ("true", print("!false"));
+    EXPECT_EQ("false", print("!0"));
+    EXPECT_EQ("false", print("!\"\""));
+}
+
+TEST_F(InterpreterTest, Strings)
+{
+    EXPECT_EQ("foobar", print("\"foo\" + \"bar\""));
+}
+
+TEST_F(InterpreterTest, Variables)
+{
+    interpreter.define("a", 2.0);
+    interpreter.define("b", Value());
+    EXPECT_EQ("4", print("a * a"));
+    EXPECT_EQ("true", print("b == nil"));
+}
+
+TEST_F(InterpreterTest, RuntimeErrors)
+{
+    EXPECT_THROW(eval("1 + \"a\""), RuntimeError);
+    EXPECT_THROW(eval("-nil"), RuntimeError);
+    EXPECT_THROW(eval("true < 1"), RuntimeError);
+
+    try {
+        eval("1 +\nundefined");
+        FAIL();
+    } catch (RuntimeError &e) {
+        EXPECT_EQ("Undefined variable 'undefined'.", std::string(e.what()));
+        EXPECT_EQ(2, scanner.lineIndex().line(e.token.offset));
+    }
+}
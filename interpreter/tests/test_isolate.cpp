@@ -0,0 +1,124 @@
+#include <atomic>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <gravlax/isolate.h>
+#include <prepare_script.h>
+
+using gravlax::Context;
+using gravlax::Isolate;
+using gravlax::RuntimeError;
+using gravlax::Scheduler;
+using gravlax::testing::prepare;
+
+TEST(IsolateTest, TasksOfAnIsolateRunInOrder)
+{
+    auto script = prepare("var log = \"\";"
+                          "fun add(n) { log = log + n; return log; }");
+    std::ostringstream out;
+    Isolate isolate(script, out);
+    isolate.context().run();
+
+    Scheduler scheduler(4);
+    std::string last;
+    for (int i = 0; i < 500; i++)
+        scheduler.post(isolate, [i, &last](Context &context) {
+            last = context.call<std::string>(context.function("add"),
+                                             std::to_string(i % 10));
+        });
+    scheduler.wait();
+
+    std::string expected;
+    for (int i = 0; i < 500; i++)
+        expected += std::to_string(i % 10);
+    EXPECT_EQ(last, expected);
+}
+
+TEST(IsolateTest, IsolatesHaveTheirOwnGlobals)
+{
+    auto script = prepare("var count = 0; fun bump() { count = count + 1; "
+                          "return count; }");
+    std::ostringstream out;
+    std::vector<std::unique_ptr<Isolate>> isolates;
+    for (int i = 0; i < 32; i++) {
+        isolates.push_back(std::make_unique<Isolate>(script, out));
+        isolates.back()->context().run();
+    }
+
+    Scheduler scheduler(3);
+    std::vector<double> counts(isolates.size());
+    for (int round = 0; round < 100; round++)
+        for (std::size_t i = 0; i < isolates.size(); i++)
+            scheduler.post(*isolates[i], [&counts, i](Context &context) {
+                counts[i] = context.call<double>(context.function("bump"));
+            });
+    scheduler.wait();
+
+    for (double count : counts)
+        EXPECT_EQ(count, 100);
+}
+
+TEST(IsolateTest, TasksPostFromTasks)
+{
+    auto script = prepare("fun id(n) { return n; }");
+    std::ostringstream out;
+    Isolate first(script, out);
+    Isolate second(script, out);
+    first.context().run();
+    second.context().run();
+
+    Scheduler scheduler(2);
+    std::atomic<int> hops{0};
+    std::function<void(Context &)> bounce = [&](Context &context) {
+        int n = context.call<int>(context.function("id"), hops.load() + 1);
+        hops = n;
+        if (n < 1000)
+            scheduler.post(n % 2 ? second : first, bounce);
+    };
+    scheduler.post(first, bounce);
+    scheduler.wait();
+
+    EXPECT_EQ(hops, 1000);
+}
+
+TEST(IsolateTest, WaitRethrowsTheFirstError)
+{
+    auto script = prepare("fun fail() { return nil + 1; }");
+    std::ostringstream out;
+    Isolate isolate(script, out);
+
+    Scheduler scheduler(2);
+    int ran = 0;
+    scheduler.post(isolate, [](Context &context) {
+        context.call(context.function("fail"));
+    });
+    scheduler.post(isolate, [](Context &) {
+        throw std::logic_error("second");
+    });
+    scheduler.post(isolate, [&ran](Context &) { ran++; });
+    EXPECT_THROW(scheduler.wait(), RuntimeError);
+    EXPECT_EQ(ran, 1);
+
+    // The error was reported once.
+    scheduler.post(isolate, [&ran](Context &) { ran++; });
+    EXPECT_NO_THROW(scheduler.wait());
+    EXPECT_EQ(ran, 2);
+}
+
+TEST(IsolateTest, DestructorRunsPostedTasks)
+{
+    auto script = prepare("");
+    std::ostringstream out;
+    Isolate isolate(script, out);
+    int ran = 0;
+    {
+        Scheduler scheduler(2);
+        for (int i = 0; i < 100; i++)
+            scheduler.post(isolate, [&ran](Context &) { ran++; });
+    }
+    EXPECT_EQ(ran, 100);
+}
@@ -0,0 +1,84 @@
+#include <fmt/core.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <gravlax/line_index.h>
+#include <gravlax/scanner.h>
+
+using gravlax::LineIndex;
+using gravlax::Token;
+
+class LineIndexTest : public ::testing::Test
+{
+};
+
+TEST_F(LineIndexTest, EmptySource)
+{
+    LineIndex index("");
+    EXPECT_EQ(1, index.lineCount());
+    EXPECT_EQ(1, index.line(0));
+    EXPECT_EQ(1, index.column(0));
+    EXPECT_EQ("", index.lineText(1));
+}
+
+TEST_F(LineIndexTest, LinesAndColumns)
+{
+    LineIndex index("a\nbc\n\nd");
+    EXPECT_EQ(4, index.lineCount());
+
+    EXPECT_EQ(1, index.line(0));
+    EXPECT_EQ(2, index.line(2));
+    EXPECT_EQ(2, index.column(3));
+    EXPECT_EQ(3, index.line(5));
+    EXPECT_EQ(4, index.line(6));
+    EXPECT_EQ(1, index.column(6));
+
+    EXPECT_EQ("a", index.lineText(1));
+    EXPECT_EQ("bc", index.lineText(2));
+    EXPECT_EQ("", index.lineText(3));
+    EXPECT_EQ("d", index.lineText(4));
+    EXPECT_EQ("", index.lineText(5));
+}
+
+TEST_F(LineIndexTest, CarriageReturnIsNotPartOfLineText)
+{
+    LineIndex index("foo\r\nbar\r\n");
+    EXPECT_EQ("foo", index.lineText(1));
+    EXPECT_EQ("bar", index.lineText(2));
+    EXPECT_EQ(3, index.lineCount());
+}
+
+TEST_F(LineIndexTest, LongLinesCrossVectorBoundaries)
+{
+    std::string code;
+    for (int i = 0; i < 100; i++) {
+        code += std::string(i % 37, 'x');
+        code += '\n';
+    }
+
+    LineIndex index(code);
+    EXPECT_EQ(101, index.lineCount());
+
+    int offset = 0;
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(i + 1, index.line(offset));
+        EXPECT_EQ(i % 37, index.lineText(i + 1).size());
+        offset += i % 37 + 1;
+    }
+}
+
+TEST_F(LineIndexTest, ScannerTokenLocations)
+{
+    gravlax::Scanner scanner;
+    auto tokens = scanner.scanString("var a;\n  print \"x\ny\" + a;");
+    const LineIndex &lines = scanner.lineIndex();
+
+    ASSERT_EQ(Token::Type::PRINT, (*tokens)[3].type);
+    EXPECT_EQ(2, lines.line((*tokens)[3].offset));
+    EXPECT_EQ(3, lines.column((*tokens)[3].offset));
+
+    ASSERT_EQ(Token::Type::PLUS, (*tokens)[5].type);
+    EXPECT_EQ(3, lines.line((*tokens)[5].offset));
+    EXPECT_EQ(4, lines.column((*tokens)[5].offset));
+}
@@ -3,10 +3,13 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <gravlax/ast_printer.h>
 #include <gravlax/parser.h>
 #include <gravlax/scanner.h>
 
 using gravlax::Token;
+using Binary = gravlax::generated::Binary<std::string>;
+using Unary = gravlax::generated::Unary<std::string>;
 using ::testing::_;
 using ::testing::Eq;
 using ::testing::InSequence;
@@ -25,3 +28,204 @@ TEST_F(ParserTest, test_parser)
     std::unique_ptr<std::vector<Token>> tokens = scanner.scanString(code);
     parser.parse(std::move(tokens));
 }
+
+TEST_F(ParserTest, ParseExpression)
+{
+    gravlax::AstPrinter printer;
+    auto expr = parser.parse(scanner.scanString("-1 + 2 * (3 - 4) == !nil"));
+    ASSERT_TRUE(expr);
+    EXPECT_FALSE(parser.hadError());
+    EXPECT_EQ("(== (+ (- 1.000000) (* 2.000000 (- 3.000000 4.000000))) (! "
+              "Nil))",
+              printer.print(*expr));
+}
+
+TEST_F(ParserTest, ErrorIsReportedWithoutThrowing)
+{
+    EXPECT_FALSE(parser.parse(scanner.scanString("(1 + 2")));
+    ASSERT_EQ(1, parser.errors().count());
+    EXPECT_EQ("[line 1:7] Error at end: Expect ')' after expression.",
+              gravlax::Diagnostics::format(parser.errors().all()[0],
+                                           scanner.lineIndex()));
+}
+
+TEST_F(ParserTest, RecoversAndReportsEveryError)
+{
+    auto program = parser.parseProgram(
+        scanner.scanString("1 + ;\n2 * 3;\nvar foo = 10;\n(4;\n5 == 5;"));
+
+    EXPECT_EQ(2, program.size());
+    ASSERT_EQ(3, parser.errors().count());
+
+    auto &errors = parser.errors().all();
+    auto &lines = scanner.lineIndex();
+    EXPECT_EQ(1, lines.line(errors[0].offset));
+    EXPECT_EQ(" at ';'", errors[0].where);
+    EXPECT_EQ(3, lines.line(errors[1].offset));
+    EXPECT_EQ(" at 'var'", errors[1].where);
+    EXPECT_EQ(4, lines.line(errors[2].offset));
+    EXPECT_EQ("Expect ')' after expression.", errors[2].message);
+}
+
+TEST_F(ParserTest, SharedDiagnostics)
+{
+    gravlax::Diagnostics diagnostics;
+    gravlax::Scanner scanner(diagnostics);
+    gravlax::Parser<std::string> parser(diagnostics);
+
+    parser.parseProgram(scanner.scanString("1 # 2;\n\"open"));
+
+    ASSERT_EQ(3, diagnostics.count());
+    EXPECT_EQ("[line 1:3] Error: Unexpected character '#'",
+              gravlax::Diagnostics::format(diagnostics.all()[0],
+                                           scanner.lineIndex()));
+    EXPECT_EQ("[line 2:1] Error: Unterminated string.",
+              gravlax::Diagnostics::format(diagnostics.all()[1],
+                                           scanner.lineIndex()));
+    EXPECT_EQ(" at '2'", diagnostics.all()[2].where);
+}
+
+TEST_F(ParserTest, StructuralHashIsStable)
+{
+    gravlax::Parser<std::string> other;
+    auto a = parser.parse(scanner.scanString("1 + 2 * 3"));
+    auto b = other.parse(scanner.scanString("1 + 2 * 3"));
+    auto c = other.parse(scanner.scanString("1 + 2 * 4"));
+    auto d = other.parse(scanner.scanString("1 - 2 * 3"));
+
+    ASSERT_TRUE(a && b && c && d);
+    EXPECT_NE(a, b);
+    EXPECT_EQ(a->structuralHash(), b->structuralHash());
+    EXPECT_NE(a->structuralHash(), c->structuralHash());
+    EXPECT_NE(a->structuralHash(), d->structuralHash());
+}
+
+TEST_F(ParserTest, NoSharingByDefault)
+{
+    auto expr = parser.parse(scanner.scanString("(1 + 2) * (1 + 2)"));
+    auto &binary = static_cast<Binary &>(*expr);
+    EXPECT_NE(binary.left, binary.right);
+    EXPECT_EQ(0, parser.factory().sharedNodeCount());
+}
+
+TEST_F(ParserTest, SharedSubexpressions)
+{
+    gravlax::AstPrinter printer;
+    parser.shareSubexpressions(true);
+
+    auto expr =
+        parser.parse(scanner.scanString("(1 + 2) * (1 + 2) - -(1 + 2)"));
+    ASSERT_TRUE(expr);
+    EXPECT_EQ("(- (* (+ 1.000000 2.000000) (+ 1.000000 2.000000)) (- (+ "
+              "1.000000 2.000000)))",
+              printer.print(*expr));
+
+    auto &minus = static_cast<Binary &>(*expr);
+    auto &times = static_cast<Binary &>(*minus.left);
+    auto &negate = static_cast<Unary &>(*minus.right);
+    EXPECT_EQ(times.left, times.right);
+    EXPECT_EQ(times.left, negate.right);
+
+    // 1, 2, (1 + 2), *, unary -, binary -
+    EXPECT_EQ(6, parser.factory().sharedNodeCount());
+
+    // Sharing also works across parses
+    auto again = parser.parse(scanner.scanString("1 + 2"));
+    EXPECT_EQ(times.left, again);
+    EXPECT_EQ(6, parser.factory().sharedNodeCount());
+}
+
+TEST_F(ParserTest, SharingKeepsDistinctLiterals)
+{
+    parser.shareSubexpressions(true);
+    auto expr = parser.parse(scanner.scanString("1 == true"));
+    auto &binary = static_cast<Binary &>(*expr);
+    EXPECT_NE(binary.left, binary.right);
+    EXPECT_EQ(3, parser.factory().sharedNodeCount());
+}
+
+TEST_F(ParserTest, ParseStatements)
+{
+    gravlax::AstPrinter printer;
+    auto program = parser.parseStatements(scanner.scanString(
+        "var a = 1;\n"
+        "fun add(x, y) { return x + y; }\n"
+        "for (var i = 0; i < 2; i = i + 1) print add(a, i);\n"
+        "if (a or !a) a = 2; else {}"));
+
+    ASSERT_FALSE(parser.hadError());
+    ASSERT_EQ(4, program.size());
+    EXPECT_EQ("(var a = 1.000000)", printer.print(*program[0]));
+    EXPECT_EQ("(fun add(x y) (return (+ x y)))", printer.print(*program[1]));
+    EXPECT_EQ("(block (var i = 0.000000) (while (< i 2.000000) (block (print "
+              "(call add a i)) (; (= i (+ i 1.000000))))))",
+              printer.print(*program[2]));
+    EXPECT_EQ("(if-else (or a (! a)) (; (= a 2.000000)) (block))",
+              printer.print(*program[3]));
+}
+
+TEST_F(ParserTest, StatementErrorsRecoverInsideBlocks)
+{
+    auto program = parser.parseStatements(
+        scanner.scanString("{ var = 1; print 2; }\n"
+                           "1 = 2;\n"
+                           "fun f(a b) {}\n"
+                           "print 3"));
+
+    // The block keeps its good statement, the assignment is reported but
+    // parses on.
+    EXPECT_EQ(2, program.size());
+    ASSERT_EQ(4, parser.errors().count());
+    auto &errors = parser.errors().all();
+    EXPECT_EQ("Expect variable name.", errors[0].message);
+    EXPECT_EQ("Invalid assignment target.", errors[1].message);
+    EXPECT_EQ("Expect ')' after parameters.", errors[2].message);
+    EXPECT_EQ("Expect ';' after value.", errors[3].message);
+}
+
+TEST_F(ParserTest, StatementsAreNeverShared)
+{
+    parser.shareSubexpressions(true);
+    auto program =
+        parser.parseStatements(scanner.scanString("print a; print a;"));
+    auto &first = static_cast<gravlax::generated::Print<std::string> &>(
+        *program[0]);
+    auto &second = static_cast<gravlax::generated::Print<std::string> &>(
+        *program[1]);
+    EXPECT_NE(first.expression, second.expression);
+    EXPECT_TRUE(parser.factory().isSharing());
+}
+
+TEST_F(ParserTest, LazyFunctionBodiesAreSkipped)
+{
+    gravlax::AstPrinter printer;
+    parser.setLazyFunctions(true);
+    auto program = parser.parseStatements(
+        scanner.scanString("fun f(a) { if (a) { var = ; } }\n"
+                           "print 1;\n"
+                           "fun g() { {"));
+
+    // Only the unbalanced braces are noticed.
+    ASSERT_EQ(1, parser.errors().count());
+    EXPECT_EQ("Expect '}' after block.", parser.errors().all()[0].message);
+    ASSERT_EQ(2, program.size());
+    EXPECT_EQ("(fun f(a))", printer.print(*program[0]));
+
+    auto &f = static_cast<gravlax::generated::Function<std::string> &>(
+        *program[0]);
+    ASSERT_TRUE(f.lazy.isPending());
+    auto &tokens = *f.lazy.tokens;
+    EXPECT_EQ("if", tokens[f.lazy.begin].lexeme);
+    // The closing brace of the function, not the one of the block.
+    EXPECT_EQ("}", tokens[f.lazy.end].lexeme);
+    EXPECT_EQ("}", tokens[f.lazy.end - 1].lexeme);
+    EXPECT_EQ(Token::Type::PRINT, tokens[f.lazy.end + 1].type);
+
+    // The body parses on its own, with its errors.
+    gravlax::Parser<std::string> bodyParser;
+    auto body = bodyParser.parseLazyBody(f.lazy);
+    ASSERT_EQ(1, body.size());
+    EXPECT_EQ("(if a (block))", printer.print(*body[0]));
+    ASSERT_EQ(1, bodyParser.errors().count());
+    EXPECT_EQ("Expect variable name.", bodyParser.errors().all()[0].message);
+}
@@ -0,0 +1,209 @@
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <gravlax/ast_printer.h>
+#include <gravlax/pipeline.h>
+
+using gravlax::Diagnostics;
+using gravlax::Parser;
+using gravlax::Scanner;
+using gravlax::Token;
+using gravlax::utils::Generator;
+
+namespace
+{
+
+const char *script = "// A comment with \"quotes\" and ; in it\n"
+                     "var greeting = \"hello,\n  wörld → 🌍\";\n"
+                     "var größe = 1; print größe;\n"
+                     "fun count(n) {\n"
+                     "  for (var i = 0; i < n; i = i + 1) {\n"
+                     "    if (i >= 2.5) print i; else print -i;\n"
+                     "  }\n"
+                     "}\n"
+                     "if (true) { count(3); } else count(1);\n"
+                     "{ var a = 1; { print a; } }\n"
+                     "print greeting != nil and 12.75 <= 13;";
+
+// The source in chunks of a fixed size.
+Generator<std::string_view> pieces(std::string_view source, std::size_t size)
+{
+    for (std::size_t i = 0; i < source.size(); i += size)
+        co_yield source.substr(i, size);
+}
+
+std::string
+print(const std::vector<std::shared_ptr<gravlax::Stmt<std::string>>> &program)
+{
+    gravlax::AstPrinter printer;
+    std::string text;
+    for (auto &stmt : program)
+        text += printer.print(*stmt) + "\n";
+    return text;
+}
+
+// The write end of a pipe, closed when done.
+struct Pipe {
+    int fds[2];
+
+    Pipe() { EXPECT_EQ(0, ::pipe(fds)); }
+    ~Pipe()
+    {
+        ::close(fds[0]);
+        if (fds[1] >= 0)
+            ::close(fds[1]);
+    }
+
+    void write(std::string_view s)
+    {
+        EXPECT_EQ(s.size(), ::write(fds[1], s.data(), s.size()));
+    }
+    void close()
+    {
+        ::close(fds[1]);
+        fds[1] = -1;
+    }
+};
+
+}; // namespace
+
+// Every chunk size gives the tokens of scanning the whole source at once,
+// strings and comments that straddle chunks included.
+TEST(PipelineTest, ChunksScanLikeTheWholeSource)
+{
+    Scanner whole;
+    auto expected = whole.scanString(script);
+
+    for (std::size_t size = 1; size <= 64; size++) {
+        Scanner scanner;
+        std::vector<Token> tokens;
+        for (Token &token : gravlax::scanChunks(scanner, pieces(script, size)))
+            tokens.push_back(token);
+
+        ASSERT_EQ(expected->size(), tokens.size()) << "chunks of " << size;
+        for (std::size_t i = 0; i < tokens.size(); i++) {
+            EXPECT_EQ((*expected)[i].type, tokens[i].type);
+            EXPECT_EQ((*expected)[i].lexeme, tokens[i].lexeme);
+            EXPECT_EQ((*expected)[i].offset, tokens[i].offset);
+            EXPECT_EQ((*expected)[i].literal, tokens[i].literal);
+        }
+        EXPECT_EQ(script, scanner.source());
+        EXPECT_FALSE(scanner.hadError());
+    }
+}
+
+// A string that spans many chunks is scanned once, not again from its
+// opening quote with every chunk.
+TEST(PipelineTest, LongStringInSmallChunks)
+{
+    std::string text(1 << 20, 'x');
+    std::string source = "print \"" + text + "\";";
+    Scanner scanner;
+    std::vector<Token> tokens;
+    for (Token &token : gravlax::scanChunks(scanner, pieces(source, 16)))
+        tokens.push_back(token);
+
+    ASSERT_EQ(4u, tokens.size());
+    EXPECT_EQ(Token::Type::STRING, tokens[1].type);
+    EXPECT_EQ(Token::Literal(text), tokens[1].literal);
+    EXPECT_EQ(Token::Type::SEMICOLON, tokens[2].type);
+    EXPECT_FALSE(scanner.hadError());
+}
+
+// An unterminated string is only an error once the input has ended.
+TEST(PipelineTest, UnterminatedStringAtTheEnd)
+{
+    Diagnostics diagnostics;
+    Scanner scanner(diagnostics);
+    std::size_t count = 0;
+    for (Token &token :
+         gravlax::scanChunks(scanner, pieces("print \"abc def", 3))) {
+        (void)token;
+        count++;
+    }
+
+    EXPECT_EQ(2u, count);
+    ASSERT_EQ(1, diagnostics.count());
+    EXPECT_EQ(6, diagnostics.all()[0].offset);
+}
+
+TEST(PipelineTest, StreamParsesLikeTheWholeSource)
+{
+    Scanner whole;
+    Parser<std::string> wholeParser;
+    std::string expected =
+        print(wholeParser.parseStatements(whole.scanString(script)));
+
+    for (std::size_t size : {1, 7, 4096}) {
+        Pipe pipe;
+        pipe.write(script);
+        pipe.close();
+
+        Scanner scanner;
+        Parser<std::string> parser;
+        EXPECT_EQ(expected, print(gravlax::parseStream(pipe.fds[0], scanner,
+                                                       parser, size)));
+        EXPECT_FALSE(parser.hadError());
+    }
+}
+
+// A statement comes out as soon as the token after it is in, while the
+// writer still holds the pipe open.
+TEST(PipelineTest, StatementsArriveBeforeTheInputEnds)
+{
+    Pipe pipe;
+    pipe.write("print 1;\nvar a = ");
+
+    Scanner scanner;
+    Parser<std::string> parser;
+    auto statements = gravlax::parseTokens(
+        parser,
+        gravlax::scanChunks(scanner, gravlax::readChunks(pipe.fds[0])));
+    gravlax::AstPrinter printer;
+
+    auto it = statements.begin();
+    ASSERT_NE(it, statements.end());
+    EXPECT_EQ("(print 1.000000)", printer.print(**it));
+
+    pipe.write("2;\nprint a;");
+    pipe.close();
+    ++it;
+    ASSERT_NE(it, statements.end());
+    EXPECT_EQ("(var a = 2.000000)", printer.print(**it));
+    ++it;
+    ASSERT_NE(it, statements.end());
+    EXPECT_EQ("(print a)", printer.print(**it));
+    ++it;
+    EXPECT_EQ(it, statements.end());
+}
+
+// Errors in one statement leave the others alone, and their offsets point
+// into the whole input.
+TEST(PipelineTest, ErrorsAreReportedAtTheirOffsets)
+{
+    Pipe pipe;
+    pipe.write("print 1;\nvar = 2;\nprint 3;");
+    pipe.close();
+
+    Diagnostics diagnostics;
+    Scanner scanner(diagnostics);
+    Parser<std::string> parser(diagnostics);
+    auto program = gravlax::parseStream(pipe.fds[0], scanner, parser, 4);
+
+    EXPECT_EQ(2u, program.size());
+    ASSERT_EQ(1, diagnostics.count());
+    EXPECT_EQ("[line 2:5] Error at '=': Expect variable name.",
+              Diagnostics::format(diagnostics.all()[0], scanner.lineIndex()));
+}
+
+TEST(PipelineTest, ReadErrorsThrow)
+{
+    EXPECT_THROW(
+        for (auto chunk : gravlax::readChunks(-1)) { (void)chunk; },
+        std::system_error);
+}
@@ -0,0 +1,128 @@
+#include <sstream>
+
+#include <fmt/core.h>
+
+#include <gtest/gtest.h>
+
+#include <gravlax/executor.h>
+#include <gravlax/parser.h>
+#include <gravlax/profiler.h>
+#include <gravlax/resolver.h>
+#include <gravlax/scanner.h>
+
+using gravlax::Executor;
+using gravlax::LineIndex;
+using gravlax::profiler::Profile;
+
+namespace
+{
+
+const char *script = "fun inner(n) {\n"
+                     "  tick();\n"
+                     "  var i = 0;\n"
+                     "  while (i < n) i = i + 1;\n"
+                     "}\n"
+                     "fun outer() {\n"
+                     "  inner(3);\n"
+                     "}\n"
+                     "outer();\n";
+
+// Makes a sample due, like the timer would.
+Executor::Value tick(gravlax::runtime::Heap &, const Executor::Value *)
+{
+    gravlax::profiler::detail::pending.store(true);
+    return {};
+}
+
+// Runs script, with a sample due from the start or not.
+void run(Executor &executor, bool due)
+{
+    executor.defineNative("tick", tick, 0);
+    gravlax::Diagnostics diagnostics;
+    gravlax::Scanner scanner(diagnostics);
+    gravlax::Parser<Executor::Value> parser(diagnostics);
+    gravlax::Resolver<Executor::Value> resolver(executor.globalNames(),
+                                               diagnostics);
+    auto program = parser.parseStatements(scanner.scanString(script));
+    auto info = resolver.resolve(program);
+    ASSERT_FALSE(diagnostics.hadError());
+
+    gravlax::profiler::detail::pending.store(due);
+    executor.execute(std::move(program), info);
+}
+
+}; // namespace
+
+// The first safe point takes the sample, the call of outer. Natives are
+// not safe points.
+TEST(ProfilerTest, SamplesAtSafePoints)
+{
+    std::ostringstream out;
+    Executor executor(out);
+    Profile profile;
+    executor.setProfile(&profile);
+
+    run(executor, true);
+    // And the loop after the tick.
+    EXPECT_EQ(2, profile.sampleCount());
+    EXPECT_FALSE(gravlax::profiler::due());
+}
+
+// A sample in a loop has the whole stack, with the line of each call.
+TEST(ProfilerTest, RecordsTheStack)
+{
+    std::ostringstream out;
+    Executor executor(out);
+    Profile profile;
+    executor.setProfile(&profile);
+    run(executor, false);
+
+    std::ostringstream collapsed;
+    profile.writeCollapsed(collapsed, LineIndex(script));
+    EXPECT_EQ("<script>:9;outer:7;inner:4 1\n", collapsed.str());
+
+    std::string report = profile.formatHotSpots(LineIndex(script));
+    EXPECT_NE(std::string::npos, report.find("inner line 4"));
+}
+
+// Without a profile the sample stays due.
+TEST(ProfilerTest, LeavesSamplesToProfiledExecutors)
+{
+    std::ostringstream out;
+    Executor executor(out);
+    run(executor, false);
+    EXPECT_TRUE(gravlax::profiler::due());
+    gravlax::profiler::detail::pending.store(false);
+}
+
+TEST(ProfilerTest, CountsHotSpots)
+{
+    Profile profile;
+    profile.record({{"<script>", 0}, {"f", 2}, {"f", 2}});
+    profile.record({{"<script>", 0}, {"f", 2}, {"f", 2}});
+    profile.record({{"<script>", 0}, {"g", 4}});
+
+    std::ostringstream collapsed;
+    LineIndex lines("a\nb\nc");
+    profile.writeCollapsed(collapsed, lines);
+    EXPECT_EQ("<script>:1;f:2;f:2 2\n<script>:1;g:3 1\n", collapsed.str());
+
+    // Recursion counts once towards the total.
+    std::string report = profile.formatHotSpots(lines);
+    EXPECT_NE(std::string::npos, report.find("3 samples"));
+    EXPECT_NE(std::string::npos, report.find(fmt::format(
+                                     "{:<40} {:>8} {:>7.1f}", "f", 2, 66.7)));
+    EXPECT_NE(std::string::npos, report.find("f line 2"));
+}
+
+// The timer raises the flag while the process burns CPU.
+TEST(ProfilerTest, TimerSetsTheFlag)
+{
+    gravlax::profiler::start(1000);
+    volatile double x = 0;
+    for (long i = 0; i < 1'000'000'000 && !gravlax::profiler::due(); i++)
+        x = x + 1;
+    gravlax::profiler::stop();
+    EXPECT_FALSE(gravlax::profiler::due());
+    EXPECT_GT(x, 0);
+}
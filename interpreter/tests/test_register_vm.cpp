@@ -0,0 +1,191 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <gravlax/interpreter.h>
+#include <gravlax/parser.h>
+#include <gravlax/register_vm.h>
+#include <gravlax/scanner.h>
+
+using gravlax::Interpreter;
+using gravlax::RegisterProgram;
+using gravlax::RuntimeError;
+using gravlax::Value;
+using Op = RegisterProgram::Op;
+
+class RegisterVmTest : public ::testing::Test
+{
+  public:
+    gravlax::Scanner scanner;
+    gravlax::Parser<Value> parser;
+
+    std::shared_ptr<gravlax::Expr<Value>> parse(const std::string &code)
+    {
+        auto expr = parser.parse(scanner.scanString(code));
+        EXPECT_TRUE(expr) << code;
+        return expr;
+    }
+
+    std::unique_ptr<RegisterProgram> compile(const std::string &code)
+    {
+        std::string error;
+        auto program = RegisterProgram::compile(*parse(code), error);
+        EXPECT_TRUE(program) << error;
+        return program;
+    }
+
+    // Evaluates code with both the Interpreter and a register program, with
+    // the same inputs, and checks that they agree, errors included.
+    void expectSameAsInterpreter(
+        const std::string &code,
+        const std::vector<std::pair<std::string, Value>> &values)
+    {
+        auto expr = parse(code);
+        std::string error;
+        auto program = RegisterProgram::compile(*expr, error);
+        ASSERT_TRUE(program) << error;
+
+        Interpreter interpreter;
+        std::vector<Value> inputs;
+        for (auto &name : program->inputs()) {
+            for (auto &[n, value] : values) {
+                if (n == name) {
+                    inputs.push_back(value);
+                    interpreter.define(n, value);
+                }
+            }
+        }
+
+        Value expected;
+        std::string expectedError;
+        try {
+            expected = interpreter.evaluate(*expr);
+        } catch (RuntimeError &e) {
+            expectedError = e.what();
+        }
+
+        std::vector<Value> frame;
+        try {
+            Value actual = program->evaluate(inputs, frame);
+            EXPECT_EQ(expectedError, "") << code;
+            EXPECT_EQ(Interpreter::stringify(actual),
+                      Interpreter::stringify(expected))
+                << code;
+        } catch (RuntimeError &e) {
+            EXPECT_EQ(e.what(), expectedError) << code;
+        }
+    }
+};
+
+TEST_F(RegisterVmTest, MatchesInterpreter)
+{
+    std::vector<std::pair<std::string, Value>> values{
+        {"a", 3.0}, {"b", -2.5}, {"s", std::string("x")}, {"t", true},
+        {"n", Value()}};
+    for (const char *code : {
+             "1 + 2 * 3",
+             "a * a - b / 4",
+             "(a + b) * (a - b) / (1 - a)",
+             "2 - a",
+             "10 / b",
+             "-a + -3",
+             "-(-a)",
+             "!a",
+             "!n == true",
+             "a > 2 == b <= -2.5",
+             "1 < a",
+             "a != 3",
+             "s + s + \"y\"",
+             "s == \"x\"",
+             "a + s",
+             "-s",
+             "n * 2",
+             "3 > s",
+             "t and a",
+             "n and a",
+             "n or b * 2",
+             "a or s + 1",
+             "a > 1 and b < 0 or s",
+             "(a > 1 or s + 1) and (b + a) * 2",
+             "a",
+             "4",
+             "\"lit\"",
+             "nil",
+         })
+        expectSameAsInterpreter(code, values);
+}
+
+TEST_F(RegisterVmTest, NumberLiteralsAreOperands)
+{
+    auto program = compile("a * 2 + -1.5");
+    ASSERT_TRUE(program);
+    auto &code = program->instructions();
+    ASSERT_EQ(code.size(), 2u);
+    EXPECT_EQ(code[0].op, Op::MultiplyK);
+    EXPECT_EQ(code[0].k, 2);
+    EXPECT_EQ(code[1].op, Op::AddK);
+    EXPECT_EQ(code[1].k, -1.5);
+
+    program = compile("1 - a");
+    ASSERT_TRUE(program);
+    EXPECT_EQ(program->instructions()[0].op, Op::KSubtract);
+}
+
+TEST_F(RegisterVmTest, TemporariesAreReused)
+{
+    // A left-leaning chain needs one temporary however long it is.
+    auto program = compile("a + b + a * b + a / b + (a - b) * 2");
+    ASSERT_TRUE(program);
+    EXPECT_EQ(program->registerCount(), 2u + 2u);
+
+    std::vector<Value> inputs{4.0, 2.0};
+    EXPECT_EQ(std::get<double>(program->evaluate(inputs)),
+              4 + 2 + 4 * 2 + 4 / 2 + (4 - 2) * 2);
+}
+
+TEST_F(RegisterVmTest, ErrorsPointAtTheOperator)
+{
+    auto program = compile("a + 1 - b");
+    ASSERT_TRUE(program);
+
+    std::vector<Value> inputs{1.0, std::string("s")};
+    try {
+        program->evaluate(inputs);
+        FAIL();
+    } catch (RuntimeError &e) {
+        EXPECT_STREQ(e.what(), "Operands must be numbers.");
+        EXPECT_EQ(e.token.type, gravlax::Token::Type::MINUS);
+    }
+
+    inputs.pop_back();
+    EXPECT_THROW(program->evaluate(inputs), RuntimeError);
+}
+
+TEST_F(RegisterVmTest, AssignmentsAndCallsAreNotCompiled)
+{
+    std::string error;
+    EXPECT_FALSE(RegisterProgram::compile(*parse("a = 1"), error));
+    EXPECT_EQ(error, "Assign is not supported in register programs.");
+    EXPECT_FALSE(RegisterProgram::compile(*parse("f(1)"), error));
+}
+
+namespace
+{
+
+// A balanced sum of count strings, which keeps the tree shallow.
+std::string strings(int count)
+{
+    if (count == 1)
+        return "\"s\"";
+    return "(" + strings(count / 2) + " + " + strings(count - count / 2) + ")";
+}
+
+}; // namespace
+
+TEST_F(RegisterVmTest, TooManyConstants)
+{
+    std::string error;
+    EXPECT_FALSE(RegisterProgram::compile(*parse(strings(70000)), error));
+    EXPECT_EQ(error, "Expression is too large.");
+}
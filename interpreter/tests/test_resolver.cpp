@@ -0,0 +1,251 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <gravlax/parser.h>
+#include <gravlax/resolver.h>
+#include <gravlax/scanner.h>
+
+using gravlax::Diagnostics;
+using gravlax::FunctionInfo;
+using gravlax::Resolution;
+using gravlax::Stmt;
+using gravlax::UpvalueDescriptor;
+using Kind = Resolution::Kind;
+using Block = gravlax::generated::Block<std::string>;
+using Expression = gravlax::generated::Expression<std::string>;
+using Function = gravlax::generated::Function<std::string>;
+using Print = gravlax::generated::Print<std::string>;
+using Return = gravlax::generated::Return<std::string>;
+using Var = gravlax::generated::Var<std::string>;
+using Variable = gravlax::generated::Variable<std::string>;
+using Assign = gravlax::generated::Assign<std::string>;
+using ::testing::ElementsAre;
+
+class ResolverTest : public ::testing::Test
+{
+  public:
+    Diagnostics diagnostics;
+    gravlax::Scanner scanner{diagnostics};
+    gravlax::Parser<std::string> parser{diagnostics};
+    gravlax::Globals globals;
+    gravlax::Resolver<std::string> resolver{globals, diagnostics};
+
+    std::vector<std::shared_ptr<Stmt<std::string>>> program;
+    FunctionInfo script;
+
+    void resolve(const char *code)
+    {
+        program = parser.parseStatements(scanner.scanString(code));
+        script = resolver.resolve(program);
+    }
+
+    std::vector<std::string> errors()
+    {
+        std::vector<std::string> messages;
+        for (auto &diagnostic : diagnostics.all())
+            messages.push_back(diagnostic.message);
+        return messages;
+    }
+
+    template <typename T> static T &as(std::shared_ptr<Stmt<std::string>> &s)
+    {
+        return static_cast<T &>(*s);
+    }
+
+    // The variable read by `print name;`.
+    static Resolution printed(std::shared_ptr<Stmt<std::string>> &s)
+    {
+        return static_cast<Variable &>(*as<Print>(s).expression).resolution;
+    }
+};
+
+TEST_F(ResolverTest, GlobalsGetDenseIndices)
+{
+    resolve("var a = 1; var b = 2; print b; print a; print c;");
+    ASSERT_FALSE(diagnostics.hadError());
+
+    EXPECT_EQ((Resolution{Kind::Global, 0, 0}),
+              as<Var>(program[0]).resolution);
+    EXPECT_EQ((Resolution{Kind::Global, 0, 1}),
+              as<Var>(program[1]).resolution);
+    EXPECT_EQ((Resolution{Kind::Global, 0, 1}), printed(program[2]));
+    EXPECT_EQ((Resolution{Kind::Global, 0, 0}), printed(program[3]));
+    // Not declared anywhere, left for the executor to report.
+    EXPECT_EQ((Resolution{Kind::Global, 0, 2}), printed(program[4]));
+    EXPECT_EQ(3, globals.size());
+    EXPECT_EQ("c", globals.name(2));
+    EXPECT_EQ(0, script.slotCount);
+}
+
+TEST_F(ResolverTest, SiblingBlocksShareSlots)
+{
+    resolve("{ var a; var b; print a; }\n"
+            "{ var c; print c; { var d; print d; } }");
+    ASSERT_FALSE(diagnostics.hadError());
+
+    auto &first = as<Block>(program[0]);
+    auto &second = as<Block>(program[1]);
+    EXPECT_EQ((Resolution{Kind::Local, 0, 0}), printed(first.statements[2]));
+    EXPECT_EQ((Resolution{Kind::Local, 0, 0}), printed(second.statements[1]));
+    auto &inner = as<Block>(second.statements[2]);
+    EXPECT_EQ(1, inner.info.firstSlot);
+    EXPECT_EQ((Resolution{Kind::Local, 0, 1}), printed(inner.statements[1]));
+    EXPECT_FALSE(inner.info.captures);
+    EXPECT_EQ(2, script.slotCount);
+}
+
+TEST_F(ResolverTest, ParametersComeFirst)
+{
+    resolve("fun f(a, b) { var c; { var d; } { var e; var g; print b; } }");
+    ASSERT_FALSE(diagnostics.hadError());
+
+    auto &f = as<Function>(program[0]);
+    EXPECT_EQ((Resolution{Kind::Global, 0, 0}), f.resolution);
+    EXPECT_EQ((Resolution{Kind::Local, 0, 2}),
+              as<Var>(f.body[0]).resolution);
+    EXPECT_EQ(5, f.info.slotCount);
+    EXPECT_TRUE(f.info.upvalues.empty());
+
+    auto &block = as<Block>(f.body[2]);
+    EXPECT_EQ(3, block.info.firstSlot);
+    EXPECT_EQ((Resolution{Kind::Local, 0, 1}), printed(block.statements[2]));
+}
+
+TEST_F(ResolverTest, ClosuresCaptureOnlyWhatTheyUse)
+{
+    resolve("fun outer() {\n"
+            "  var a; var b; var c;\n"
+            "  fun inner() { c = b; return c; }\n"
+            "  return inner;\n"
+            "}");
+    ASSERT_FALSE(diagnostics.hadError());
+
+    auto &outer = as<Function>(program[0]);
+    auto &inner = as<Function>(outer.body[3]);
+    EXPECT_EQ((Resolution{Kind::Local, 0, 3}), inner.resolution);
+    EXPECT_THAT(inner.info.upvalues,
+                ElementsAre(UpvalueDescriptor{true, 1},
+                            UpvalueDescriptor{true, 2}));
+
+    auto &assign =
+        static_cast<Assign &>(*as<Expression>(inner.body[0]).expression);
+    EXPECT_EQ((Resolution{Kind::Upvalue, 1, 1}), assign.resolution);
+    auto &value = static_cast<Variable &>(*as<Return>(inner.body[1]).value);
+    EXPECT_EQ((Resolution{Kind::Upvalue, 1, 1}), value.resolution);
+}
+
+TEST_F(ResolverTest, CapturesThroughEnclosingFunctions)
+{
+    resolve("{\n"
+            "  var x; var y;\n"
+            "  fun a() { fun b() { fun c() { print y; } } }\n"
+            "}");
+    ASSERT_FALSE(diagnostics.hadError());
+
+    auto &block = as<Block>(program[0]);
+    EXPECT_TRUE(block.info.captures);
+    auto &a = as<Function>(block.statements[2]);
+    auto &b = as<Function>(a.body[0]);
+    auto &c = as<Function>(b.body[0]);
+
+    EXPECT_THAT(a.info.upvalues, ElementsAre(UpvalueDescriptor{true, 1}));
+    EXPECT_THAT(b.info.upvalues, ElementsAre(UpvalueDescriptor{false, 0}));
+    EXPECT_THAT(c.info.upvalues, ElementsAre(UpvalueDescriptor{false, 0}));
+    EXPECT_EQ((Resolution{Kind::Upvalue, 3, 0}), printed(c.body[0]));
+}
+
+TEST_F(ResolverTest, ReportsErrors)
+{
+    resolve("return 1;\n"
+            "{ var a = 1; var a = 2; }\n"
+            "{ var b = b; }\n"
+            "fun f(x, x) {}\n"
+            "var g = g;");
+
+    const char *duplicate = "Already a variable with this name in this scope.";
+    const char *initializer =
+        "Can't read local variable in its own initializer.";
+    EXPECT_THAT(errors(),
+                ElementsAre("Can't return from top-level code.", duplicate,
+                            initializer, duplicate));
+}
+
+TEST_F(ResolverTest, ShadowingInAnInnerScopeIsFine)
+{
+    resolve("{ var a = 1; { var a = a; print a; } }");
+
+    // The inner a is still being initialized.
+    EXPECT_THAT(errors(), ElementsAre("Can't read local variable in its own "
+                                      "initializer."));
+
+    diagnostics.clear();
+    resolve("{ var a = 1; { var b = a; var a = b; print a; } }");
+    EXPECT_FALSE(diagnostics.hadError());
+    auto &inner = as<Block>(as<Block>(program[0]).statements[1]);
+    EXPECT_EQ((Resolution{Kind::Local, 0, 2}), printed(inner.statements[2]));
+}
+
+TEST_F(ResolverTest, LazyBodiesResolveLikeEagerOnes)
+{
+    const char *code = "fun outer(p) {\n"
+                       "  var a; var b; var c;\n"
+                       "  fun inner() {\n"
+                       "    var c;\n"
+                       "    fun deeper() { print a + c; }\n"
+                       "  }\n"
+                       "}";
+    resolve(code);
+    ASSERT_FALSE(diagnostics.hadError());
+    auto eager = as<Function>(as<Function>(program[0]).body[3]).info;
+
+    parser.setLazyFunctions(true);
+    resolve(code);
+    ASSERT_FALSE(diagnostics.hadError());
+    auto &outer = as<Function>(program[0]);
+    ASSERT_TRUE(outer.lazy.isPending());
+    EXPECT_TRUE(outer.info.upvalues.empty());
+
+    outer.body = parser.parseLazyBody(outer.lazy);
+    resolver.resolveLazy(outer);
+    ASSERT_FALSE(diagnostics.hadError());
+    EXPECT_EQ(5, outer.info.slotCount);
+
+    // Captures a, and also c because the body mentions a c, which turns out
+    // to be a local of its own.
+    auto &inner = as<Function>(outer.body[3]);
+    ASSERT_TRUE(inner.lazy.isPending());
+    EXPECT_THAT(eager.upvalues, ElementsAre(UpvalueDescriptor{true, 1}));
+    EXPECT_THAT(inner.info.upvalues, ElementsAre(UpvalueDescriptor{true, 3},
+                                                 UpvalueDescriptor{true, 1}));
+
+    inner.body = parser.parseLazyBody(inner.lazy);
+    resolver.resolveLazy(inner);
+    auto &deeper = as<Function>(inner.body[1]);
+    deeper.body = parser.parseLazyBody(deeper.lazy);
+    resolver.resolveLazy(deeper);
+    ASSERT_FALSE(diagnostics.hadError());
+
+    EXPECT_THAT(deeper.info.upvalues, ElementsAre(UpvalueDescriptor{false, 1},
+                                                  UpvalueDescriptor{true, 0}));
+    auto &print = as<Print>(deeper.body[0]);
+    auto &sum = static_cast<gravlax::generated::Binary<std::string> &>(
+        *print.expression);
+    EXPECT_EQ((Resolution{Kind::Upvalue, 2, 0}),
+              static_cast<Variable &>(*sum.left).resolution);
+    EXPECT_EQ((Resolution{Kind::Upvalue, 1, 1}),
+              static_cast<Variable &>(*sum.right).resolution);
+}
+
+TEST_F(ResolverTest, LazyBodiesReportErrorsWhenResolved)
+{
+    parser.setLazyFunctions(true);
+    resolve("fun f(x) { var y = 1; var y = 2; return x; }");
+    ASSERT_FALSE(diagnostics.hadError());
+
+    auto &f = as<Function>(program[0]);
+    f.body = parser.parseLazyBody(f.lazy);
+    resolver.resolveLazy(f);
+    EXPECT_THAT(errors(),
+                ElementsAre("Already a variable with this name in this "
+                            "scope."));
+}
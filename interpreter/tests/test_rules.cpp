@@ -0,0 +1,148 @@
+#include <fmt/core.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <gravlax/rules.h>
+
+using gravlax::Interpreter;
+using gravlax::RuleCompiler;
+using gravlax::RuleProgram;
+using gravlax::RuleResult;
+using gravlax::Value;
+
+class RulesTest : public ::testing::Test
+{
+  public:
+    std::vector<std::string> errors;
+    std::vector<RuleResult> results;
+
+    std::vector<Value> bind(const RuleProgram &program,
+                            std::map<std::string, Value> values)
+    {
+        std::vector<Value> inputs(program.inputs().size());
+        for (auto &[name, value] : values) {
+            int index = program.inputIndex(name);
+            if (index >= 0)
+                inputs[index] = value;
+        }
+        return inputs;
+    }
+};
+
+TEST_F(RulesTest, EvaluatesAllRules)
+{
+    auto program = RuleCompiler::compile(
+        {"a + 1", "a * b > 10", "name + \"!\"", "!flag", "42"}, errors);
+    EXPECT_TRUE(errors.empty());
+    ASSERT_EQ(5, program.ruleCount());
+
+    program.evaluate(bind(program, {{"a", 4.0},
+                                    {"b", 3.0},
+                                    {"name", std::string("x")},
+                                    {"flag", false}}),
+                     results);
+
+    ASSERT_EQ(5, results.size());
+    EXPECT_EQ("5", Interpreter::stringify(results[0].value));
+    EXPECT_EQ("true", Interpreter::stringify(results[1].value));
+    EXPECT_EQ("x!", Interpreter::stringify(results[2].value));
+    EXPECT_EQ("true", Interpreter::stringify(results[3].value));
+    EXPECT_EQ("42", Interpreter::stringify(results[4].value));
+    for (auto &result : results)
+        EXPECT_EQ(nullptr, result.error);
+}
+
+TEST_F(RulesTest, SharesSubexpressionsAndConstants)
+{
+    auto program = RuleCompiler::compile(
+        {"(a + b) * 2", "(a + b) * 2 > 10", "(a + b) - 2", "a + b"}, errors);
+
+    // a + b, * 2, > 10, - 2
+    EXPECT_EQ(4, program.instructions().size());
+    // 2, 10
+    EXPECT_EQ(2, program.constantPool().size());
+    EXPECT_EQ(2, program.inputs().size());
+
+    program.evaluate(bind(program, {{"a", 1.0}, {"b", 2.0}}), results);
+    EXPECT_EQ("6", Interpreter::stringify(results[0].value));
+    EXPECT_EQ("false", Interpreter::stringify(results[1].value));
+    EXPECT_EQ("1", Interpreter::stringify(results[2].value));
+    EXPECT_EQ("3", Interpreter::stringify(results[3].value));
+}
+
+TEST_F(RulesTest, RuntimeErrorsStayInTheirRules)
+{
+    auto program =
+        RuleCompiler::compile({"-a", "a == nil", "(-a) * 2", "b + 1", "-a + b"},
+                              errors);
+
+    program.evaluate(bind(program, {{"b", 1.0}}), results);
+    EXPECT_STREQ("Operand must be a number.", results[0].error);
+    EXPECT_EQ(nullptr, results[1].error);
+    EXPECT_EQ("true", Interpreter::stringify(results[1].value));
+    EXPECT_STREQ("Operand must be a number.", results[2].error);
+    EXPECT_EQ(nullptr, results[3].error);
+    EXPECT_STREQ("Operand must be a number.", results[4].error);
+}
+
+TEST_F(RulesTest, ParseErrorsKeepRuleIndices)
+{
+    auto program = RuleCompiler::compile({"1 +", "2", "(3"}, errors);
+
+    ASSERT_EQ(2, errors.size());
+    EXPECT_EQ("rule 0: [line 1:4] Error at end: Expect expression.",
+              errors[0]);
+    EXPECT_EQ("rule 2: [line 1:3] Error at end: Expect ')' after expression.",
+              errors[1]);
+
+    program.evaluate({}, results);
+    ASSERT_EQ(3, results.size());
+    EXPECT_NE(nullptr, results[0].error);
+    EXPECT_EQ("2", Interpreter::stringify(results[1].value));
+    EXPECT_NE(nullptr, results[2].error);
+}
+
+// Operands that are themselves and, or or unary expressions keep the
+// operator of their own instruction.
+TEST_F(RulesTest, LogicalOperands)
+{
+    auto program = RuleCompiler::compile(
+        {"1 - (a or b)", "(a or b) - 1", "2 * (a and b)", "a and -c",
+         "n or b", "n and c", "-(n or b)"},
+        errors);
+    EXPECT_TRUE(errors.empty());
+
+    program.evaluate(bind(program, {{"a", 4.0}, {"b", 3.0}}), results);
+    ASSERT_EQ(7, results.size());
+    EXPECT_EQ("-3", Interpreter::stringify(results[0].value));
+    EXPECT_EQ("3", Interpreter::stringify(results[1].value));
+    EXPECT_EQ("6", Interpreter::stringify(results[2].value));
+    // c is missing, which only matters when the right operand is taken.
+    EXPECT_STREQ("Operand must be a number.", results[3].error);
+    EXPECT_EQ("3", Interpreter::stringify(results[4].value));
+    EXPECT_EQ(nullptr, results[5].error);
+    EXPECT_EQ("nil", Interpreter::stringify(results[5].value));
+    EXPECT_EQ("-3", Interpreter::stringify(results[6].value));
+    for (int i : {0, 1, 2, 4, 6})
+        EXPECT_EQ(nullptr, results[i].error);
+}
+
+TEST_F(RulesTest, AssignmentsAndCallsAreRejected)
+{
+    auto program =
+        RuleCompiler::compile({"1 - (x = 3)", "f(1) + 1", "2 * a"}, errors);
+
+    ASSERT_EQ(2, errors.size());
+    EXPECT_EQ("rule 0: [line 1:6] Error at 'x': Can't assign in a rule.",
+              errors[0]);
+    EXPECT_EQ("rule 1: [line 1:4] Error at ')': "
+              "Can't call functions in a rule.",
+              errors[1]);
+
+    program.evaluate(bind(program, {{"a", 2.0}}), results);
+    ASSERT_EQ(3, results.size());
+    EXPECT_NE(nullptr, results[0].error);
+    EXPECT_NE(nullptr, results[1].error);
+    EXPECT_EQ("4", Interpreter::stringify(results[2].value));
+}
@@ -192,3 +192,72 @@ TEST_F(ScannerTest, Comment)
 {
     expect("// comment", {Token::Type::END_OF_FILE});
 }
+
+// The longest match wins, and keywords only when they are the whole word.
+TEST_F(ScannerTest, LongestMatch)
+{
+    expect("<== fo for fork _if 12.x \"a//b\"//c",
+           {Token::Type::LESS_EQUAL,
+            Token::Type::EQUAL,
+            {Token::Type::IDENTIFIER, "fo"},
+            Token::Type::FOR,
+            {Token::Type::IDENTIFIER, "fork"},
+            {Token::Type::IDENTIFIER, "_if"},
+            {Token::Type::NUMBER, 12},
+            Token::Type::DOT,
+            {Token::Type::IDENTIFIER, "x"},
+            {Token::Type::STRING, "a//b"},
+            Token::Type::END_OF_FILE});
+}
+
+TEST_F(ScannerTest, Errors)
+{
+    expect("a @ \"open", {{Token::Type::IDENTIFIER, "a"},
+                          Token::Type::END_OF_FILE});
+    ASSERT_EQ(2, scanner.errors().count());
+    EXPECT_EQ(2, scanner.errors().all()[0].offset);
+    EXPECT_EQ("Unterminated string.", scanner.errors().all()[1].message);
+}
+
+// Names may use the characters of UAX #31, in UTF-8.
+TEST_F(ScannerTest, UnicodeNames)
+{
+    expect("var größe = \"→\"; print π_2 + 名前;",
+           {Token::Type::VAR,
+            {Token::Type::IDENTIFIER, "größe"},
+            Token::Type::EQUAL,
+            {Token::Type::STRING, "→"},
+            Token::Type::SEMICOLON,
+            Token::Type::PRINT,
+            {Token::Type::IDENTIFIER, "π_2"},
+            Token::Type::PLUS,
+            {Token::Type::IDENTIFIER, "名前"},
+            Token::Type::SEMICOLON,
+            Token::Type::END_OF_FILE});
+    EXPECT_FALSE(scanner.hadError());
+}
+
+// A character that cannot be part of a name ends it, and one that cannot
+// start a name is a single error.
+TEST_F(ScannerTest, UnicodeNameEnds)
+{
+    expect("and→ a€b", {Token::Type::AND,
+                        {Token::Type::IDENTIFIER, "a"},
+                        {Token::Type::IDENTIFIER, "b"},
+                        Token::Type::END_OF_FILE});
+    ASSERT_EQ(2, scanner.errors().count());
+    EXPECT_EQ("Unexpected character '→'", scanner.errors().all()[0].message);
+    EXPECT_EQ(3, scanner.errors().all()[0].offset);
+    EXPECT_EQ("Unexpected character '€'", scanner.errors().all()[1].message);
+}
+
+// Scanning stops at the first byte that is not UTF-8.
+TEST_F(ScannerTest, InvalidUtf8)
+{
+    expect("a \"\xc3\x28\" b", {{Token::Type::IDENTIFIER, "a"},
+                                Token::Type::END_OF_FILE});
+    ASSERT_EQ(2, scanner.errors().count());
+    EXPECT_EQ("Invalid UTF-8.", scanner.errors().all()[0].message);
+    EXPECT_EQ(3, scanner.errors().all()[0].offset);
+    EXPECT_EQ("Unterminated string.", scanner.errors().all()[1].message);
+}
@@ -0,0 +1,242 @@
+#include <gtest/gtest.h>
+
+#include <gravlax/runtime/heap.h>
+#include <gravlax/runtime/property.h>
+#include <gravlax/runtime/shape.h>
+
+using gravlax::runtime::Heap;
+using gravlax::runtime::ObjClass;
+using gravlax::runtime::ObjInstance;
+using gravlax::runtime::PropertyCache;
+using gravlax::runtime::Rooted;
+using gravlax::runtime::Shape;
+using gravlax::runtime::ShapeTree;
+using gravlax::runtime::Value;
+using State = PropertyCache::State;
+
+class ShapeTest : public ::testing::Test
+{
+  public:
+    Heap heap;
+    ShapeTree shapes;
+
+    ObjClass *newClass(const char *name)
+    {
+        return heap.klass(heap.string(name), shapes);
+    }
+
+    void set(ObjInstance *instance, std::string_view name, double value)
+    {
+        PropertyCache cache;
+        gravlax::runtime::setProperty(heap, instance, name,
+                                      Value::fromNumber(value), cache);
+    }
+
+    double get(ObjInstance *instance, std::string_view name)
+    {
+        PropertyCache cache;
+        Value value;
+        EXPECT_TRUE(
+            gravlax::runtime::getProperty(instance, name, cache, value));
+        return value.asNumber();
+    }
+};
+
+TEST_F(ShapeTest, TransitionsAreShared)
+{
+    Shape *root = shapes.newRoot();
+    Shape *x = root->withProperty("x");
+    Shape *xy = x->withProperty("y");
+
+    EXPECT_EQ(x, root->withProperty("x"));
+    EXPECT_EQ(xy, root->withProperty("x")->withProperty("y"));
+    EXPECT_NE(xy, root->withProperty("y")->withProperty("x"));
+    EXPECT_EQ(2, xy->slotCount());
+    EXPECT_EQ(0, xy->lookup("x"));
+    EXPECT_EQ(1, xy->lookup("y"));
+    EXPECT_EQ(-1, xy->lookup("z"));
+    EXPECT_EQ(5, shapes.shapeCount());
+}
+
+TEST_F(ShapeTest, InstancesWithTheSameFieldsShareTheirShape)
+{
+    Rooted<ObjClass> point(heap, newClass("Point"));
+    Rooted<ObjInstance> a(heap, heap.instance(point));
+    Rooted<ObjInstance> b(heap, heap.instance(point));
+
+    set(a, "x", 1);
+    set(a, "y", 2);
+    set(b, "x", 3);
+    set(b, "y", 4);
+
+    EXPECT_EQ(a->shape, b->shape);
+    EXPECT_EQ(1, get(a, "x"));
+    EXPECT_EQ(4, get(b, "y"));
+
+    set(a, "x", 5);
+    EXPECT_EQ(a->shape, b->shape);
+    EXPECT_EQ(5, get(a, "x"));
+}
+
+TEST_F(ShapeTest, UndefinedPropertiesAreNotFound)
+{
+    Rooted<ObjClass> klass(heap, newClass("Empty"));
+    ObjInstance *instance = heap.instance(klass);
+    PropertyCache cache;
+    Value value;
+
+    EXPECT_FALSE(
+        gravlax::runtime::getProperty(instance, "missing", cache, value));
+    EXPECT_EQ(State::Uninitialized, cache.state());
+}
+
+TEST_F(ShapeTest, FieldsOverflowTheInlineSlots)
+{
+    Rooted<ObjClass> klass(heap, newClass("Wide"));
+    Rooted<ObjInstance> instance(heap, heap.instance(klass));
+    std::uint32_t inlineSlots = instance->fieldCount;
+
+    for (int i = 0; i < 40; i++)
+        set(instance, "f" + std::to_string(i), i);
+    heap.collect();
+    heap.collect(true);
+
+    ASSERT_NE(nullptr, instance->overflow);
+    for (int i = 0; i < 40; i++)
+        EXPECT_EQ(i, get(instance, "f" + std::to_string(i)));
+
+    // New instances of the class start out wider.
+    EXPECT_GT(heap.instance(klass)->fieldCount, inlineSlots);
+}
+
+// Overflow slots that grow past a quarter block are allocated old, and the
+// young values copied into them have to be remembered.
+TEST_F(ShapeTest, LargeOverflowKeepsYoungFields)
+{
+    Rooted<ObjClass> klass(heap, newClass("Huge"));
+    Rooted<ObjInstance> instance(heap, heap.instance(klass));
+    heap.collect();
+
+    int count = 4100;
+    PropertyCache cache;
+    for (int i = 0; i < count; i++) {
+        auto value = Value::fromObject(heap.string("s" + std::to_string(i)));
+        gravlax::runtime::setProperty(heap, instance, "f" + std::to_string(i),
+                                      value, cache);
+    }
+    // Only a number is stored after the slots grow.
+    set(instance, "last", 0);
+    heap.collect();
+    for (int i = 0; i < 1000; i++)
+        heap.string(std::string(64, 'x'));
+
+    for (int i = 0; i < count; i++) {
+        Value value;
+        ASSERT_TRUE(gravlax::runtime::getProperty(
+            instance, "f" + std::to_string(i), cache, value));
+        EXPECT_EQ("s" + std::to_string(i),
+                  gravlax::runtime::asString(value)->view());
+    }
+}
+
+TEST_F(ShapeTest, CacheGoesFromMonomorphicToMegamorphic)
+{
+    Rooted<ObjClass> klass(heap, newClass("Shapes"));
+    std::vector<Value> instances;
+    heap.addRoots(&instances);
+
+    // Instances that all have x, each after a different first field.
+    for (int i = 0; i < PropertyCache::Ways + 1; i++) {
+        auto instance = heap.instance(klass);
+        instances.push_back(Value::fromObject(instance));
+        set(instance, "first" + std::to_string(i), 0);
+        set(instance, "x", i);
+    }
+
+    PropertyCache cache;
+    Value value;
+    auto at = [&](int i) {
+        return static_cast<ObjInstance *>(instances[i].asObject());
+    };
+
+    gravlax::runtime::getProperty(at(0), "x", cache, value);
+    EXPECT_EQ(State::Monomorphic, cache.state());
+    gravlax::runtime::getProperty(at(0), "x", cache, value);
+    EXPECT_EQ(1, cache.misses);
+
+    gravlax::runtime::getProperty(at(1), "x", cache, value);
+    EXPECT_EQ(State::Polymorphic, cache.state());
+
+    for (int i = 0; i < PropertyCache::Ways + 1; i++) {
+        ASSERT_TRUE(gravlax::runtime::getProperty(at(i), "x", cache, value));
+        EXPECT_EQ(i, value.asNumber());
+    }
+    EXPECT_EQ(State::Megamorphic, cache.state());
+
+    heap.removeRoots(&instances);
+}
+
+TEST_F(ShapeTest, SetCachesTheTransition)
+{
+    Rooted<ObjClass> klass(heap, newClass("Pair"));
+    PropertyCache first;
+    PropertyCache second;
+
+    for (int i = 0; i < 10; i++) {
+        Rooted<ObjInstance> instance(heap, heap.instance(klass));
+        gravlax::runtime::setProperty(heap, instance, "a",
+                                      Value::fromNumber(i), first);
+        gravlax::runtime::setProperty(heap, instance, "b",
+                                      Value::fromNumber(-i), second);
+        EXPECT_EQ(i, get(instance, "a"));
+        EXPECT_EQ(-i, get(instance, "b"));
+    }
+
+    EXPECT_EQ(1, first.misses);
+    EXPECT_EQ(1, second.misses);
+    EXPECT_EQ(State::Monomorphic, first.state());
+}
+
+TEST_F(ShapeTest, MethodsAreFoundThroughTheClass)
+{
+    Rooted<ObjClass> klass(heap, newClass("Greeter"));
+    gravlax::runtime::defineMethod(heap, klass, "greet",
+                                   Value::fromObject(heap.string("hello")));
+    for (int i = 0; i < 10; i++) {
+        gravlax::runtime::defineMethod(heap, klass,
+                                       "m" + std::to_string(i),
+                                       Value::fromNumber(i));
+    }
+    Rooted<ObjInstance> instance(heap, heap.instance(klass));
+    heap.collect();
+
+    PropertyCache cache;
+    Value value;
+    for (int i = 0; i < 3; i++) {
+        ASSERT_TRUE(
+            gravlax::runtime::getProperty(instance, "greet", cache, value));
+        EXPECT_EQ("hello", gravlax::runtime::asString(value)->view());
+    }
+    EXPECT_EQ(1, cache.misses);
+    EXPECT_EQ(7, get(instance, "m7"));
+
+    // A field shadows the method, and the instance's new shape misses.
+    set(instance, "greet", 42);
+    ASSERT_TRUE(
+        gravlax::runtime::getProperty(instance, "greet", cache, value));
+    EXPECT_EQ(42, value.asNumber());
+    EXPECT_EQ(2, cache.misses);
+}
+
+TEST_F(ShapeTest, ClassesGetTheirOwnShapes)
+{
+    Rooted<ObjClass> a(heap, newClass("A"));
+    Rooted<ObjClass> b(heap, newClass("B"));
+    Rooted<ObjInstance> x(heap, heap.instance(a));
+    Rooted<ObjInstance> y(heap, heap.instance(b));
+
+    set(x, "v", 1);
+    set(y, "v", 2);
+
+    EXPECT_NE(x->shape, y->shape);
+}
@@ -0,0 +1,236 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <gravlax/executor.h>
+#include <gravlax/parser.h>
+#include <gravlax/resolver.h>
+#include <gravlax/scanner.h>
+#include <gravlax/snapshot.h>
+
+using gravlax::Executor;
+using gravlax::SnapshotError;
+using gravlax::runtime::HeapOptions;
+using gravlax::runtime::Obj;
+
+namespace
+{
+
+// Closures over state, a long string built piece by piece, a native under
+// another name and functions that are only called after the snapshot.
+const char *prelude = "var greeting = \"hello\";\n"
+                      "var answer = 42;\n"
+                      "var ready = true;\n"
+                      "var nothing;\n"
+                      "var now = clock;\n"
+                      "fun counter(start) {\n"
+                      "  var i = start;\n"
+                      "  fun next() { i = i + 1; return i; }\n"
+                      "  return next;\n"
+                      "}\n"
+                      "var ticks = counter(10);\n"
+                      "ticks();\n"
+                      "var report = \"\";\n"
+                      "for (var i = 0; i < 20; i = i + 1)\n"
+                      "  report = report + \"line \" + \"of text;\";\n"
+                      "var stash;\n"
+                      "var fetch;\n"
+                      "fun box() {\n"
+                      "  var v;\n"
+                      "  fun put(x) { v = x; }\n"
+                      "  fun get() { return v; }\n"
+                      "  stash = put;\n"
+                      "  fetch = get;\n"
+                      "}\n"
+                      "box();\n"
+                      "fun greet(name) {\n"
+                      "  fun exclaim(s) { return s + \"!\"; }\n"
+                      "  return exclaim(greeting + \", \" + name);\n"
+                      "}\n";
+
+// An executor with its own output.
+struct Instance {
+    std::ostringstream out;
+    Executor executor;
+
+    explicit Instance(HeapOptions options = {}) : executor(out, options) {}
+
+    // Runs the program and returns what it printed.
+    std::string run(const std::string &code, bool lazyFunctions = true)
+    {
+        gravlax::Diagnostics diagnostics;
+        gravlax::Scanner scanner(diagnostics);
+        gravlax::Parser<Executor::Value> parser(diagnostics);
+        gravlax::Resolver<Executor::Value> resolver(executor.globalNames(),
+                                                   diagnostics);
+        parser.setLazyFunctions(lazyFunctions);
+
+        auto program = parser.parseStatements(scanner.scanString(code));
+        auto script = resolver.resolve(program);
+        EXPECT_FALSE(diagnostics.hadError());
+
+        out.str("");
+        executor.execute(std::move(program), script);
+        return out.str();
+    }
+};
+
+class SnapshotTest : public ::testing::Test
+{
+  public:
+    // Named after the test, so that tests can run in parallel.
+    std::string path =
+        ::testing::TempDir() + "gravlax_" +
+        ::testing::UnitTest::GetInstance()->current_test_info()->name() +
+        ".snapshot";
+
+    void TearDown() override { std::remove(path.c_str()); }
+
+    void save(bool lazyFunctions = true)
+    {
+        Instance instance;
+        instance.run(prelude, lazyFunctions);
+        instance.executor.saveSnapshot(path, prelude);
+    }
+};
+
+}; // namespace
+
+TEST_F(SnapshotTest, RestoresThePreludesGlobals)
+{
+    save();
+    Instance instance;
+    instance.executor.loadSnapshot(path);
+
+    EXPECT_EQ("hello\n42\ntrue\nnil\n<native fn>\n12\n13\n",
+              instance.run("print greeting;\n"
+                           "print answer;\n"
+                           "print ready;\n"
+                           "print nothing;\n"
+                           "print now;\n"
+                           "print ticks();\n"
+                           "print ticks();"));
+    EXPECT_EQ("hello, world!\n<fn greet>\n",
+              instance.run("print greet(\"world\");\n"
+                           "print greet;"));
+    EXPECT_EQ("true\n", instance.run("print now() > 0;"));
+
+    std::string report;
+    for (int i = 0; i < 20; i++)
+        report += "line of text;";
+    EXPECT_EQ(report + "\n", instance.run("print report;"));
+}
+
+// Eagerly parsed functions come back lazy all the same.
+TEST_F(SnapshotTest, EagerPreludes)
+{
+    save(false);
+    Instance instance;
+    instance.executor.loadSnapshot(path);
+
+    EXPECT_EQ("12\nhello, you!\n",
+              instance.run("print ticks(); print greet(\"you\");", false));
+}
+
+TEST_F(SnapshotTest, ImageStringsStayInterned)
+{
+    save();
+    Instance instance;
+    gravlax::runtime::Heap &heap = instance.executor.heap();
+    Obj *before = heap.intern("greet");
+    instance.executor.loadSnapshot(path);
+
+    Executor::Value greeting;
+    ASSERT_TRUE(instance.executor.global("greeting", greeting));
+    EXPECT_TRUE(greeting.asObject()->flags & Obj::Image);
+    EXPECT_EQ(greeting.asObject(), heap.intern("hello"));
+    // The function's name came with the image and replaced the heap's.
+    EXPECT_NE(before, heap.intern("greet"));
+    EXPECT_EQ("true\ntrue\n", instance.run("print greeting == \"hello\";\n"
+                                           "print \"greet\" == "
+                                           "\"gr\" + \"eet\";"));
+}
+
+// Image objects that are written young references keep them alive, and are
+// never moved or freed.
+TEST_F(SnapshotTest, SurvivesCollections)
+{
+    save();
+    HeapOptions options;
+    options.nurseryBytes = 16 << 10;
+    options.blockBytes = 16 << 10;
+    options.majorThreshold = 64 << 10;
+    Instance instance(options);
+    instance.executor.loadSnapshot(path);
+
+    EXPECT_EQ("ok\n",
+              instance.run("for (var i = 0; i < 2000; i = i + 1) {\n"
+                           "  stash(\"item \" + greeting + \" \" + \"x\");\n"
+                           "  report = fetch() + \"\";\n"
+                           "}\n"
+                           "print \"ok\";"));
+    EXPECT_GT(instance.executor.heap().stats().minorCollections, 0u);
+    instance.executor.heap().collect(true);
+
+    EXPECT_EQ("item hello x\nitem hello x\n12\nhello, there!\n",
+              instance.run("print fetch();\n"
+                           "print report;\n"
+                           "print ticks();\n"
+                           "print greet(\"there\");"));
+}
+
+// The second mapping in a process cannot get the base address. Each executor
+// writes to its own copy of the image.
+TEST_F(SnapshotTest, SecondLoadIsRelocated)
+{
+    save();
+    Instance first;
+    Instance second;
+    first.executor.loadSnapshot(path);
+    second.executor.loadSnapshot(path);
+
+    EXPECT_TRUE(second.executor.snapshot()->relocated());
+    EXPECT_EQ("12\n13\n", first.run("print ticks(); print ticks();"));
+    EXPECT_EQ("12\nhello, again!\n",
+              second.run("print ticks(); print greet(\"again\");"));
+}
+
+TEST_F(SnapshotTest, SavingReplacesTheFile)
+{
+    save();
+    Instance loaded;
+    loaded.executor.loadSnapshot(path);
+
+    // The mapping of the old file stays valid and nothing is left behind.
+    save(false);
+    EXPECT_EQ("12\nhello, there!\n",
+              loaded.run("print ticks(); print greet(\"there\");"));
+    EXPECT_FALSE(std::ifstream(path + ".tmp").is_open());
+
+    Instance reloaded;
+    reloaded.executor.loadSnapshot(path);
+    EXPECT_EQ("12\n", reloaded.run("print ticks();"));
+}
+
+TEST_F(SnapshotTest, Errors)
+{
+    {
+        std::ofstream out(path);
+        out << "var not = \"a snapshot\";\n";
+    }
+    Instance instance;
+    EXPECT_THROW(instance.executor.loadSnapshot(path), SnapshotError);
+    EXPECT_THROW(instance.executor.loadSnapshot(path + ".missing"),
+                 SnapshotError);
+
+    save();
+    instance.run("print 1;");
+    EXPECT_THROW(instance.executor.loadSnapshot(path), SnapshotError);
+
+    Instance loaded;
+    loaded.executor.loadSnapshot(path);
+    EXPECT_THROW(loaded.executor.saveSnapshot(path, prelude), SnapshotError);
+}
@@ -0,0 +1,101 @@
+#include <fmt/core.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <gravlax/ast_printer.h>
+#include <gravlax/parser.h>
+#include <gravlax/scanner.h>
+#include <gravlax/stats.h>
+
+using gravlax::ExprKind;
+using gravlax::Token;
+using gravlax::stats::Phase;
+using ::testing::HasSubstr;
+
+#if GRAVLAX_ENABLE_STATS
+
+class StatsTest : public ::testing::Test
+{
+  public:
+    gravlax::Scanner scanner;
+    gravlax::Parser<std::string> parser;
+
+    void SetUp() override { gravlax::stats::reset(); }
+
+    const gravlax::stats::Stats &stats() { return gravlax::stats::current(); }
+};
+
+TEST_F(StatsTest, CountsTokensAndNodes)
+{
+    parser.parse(scanner.scanString("1 + 2 * a"));
+
+    EXPECT_EQ(2, stats().tokens[Token::Type::NUMBER]);
+    EXPECT_EQ(1, stats().tokens[Token::Type::PLUS]);
+    EXPECT_EQ(1, stats().tokens[Token::Type::IDENTIFIER]);
+    EXPECT_EQ(2, stats().nodes[static_cast<int>(ExprKind::Binary)]);
+    EXPECT_EQ(2, stats().nodes[static_cast<int>(ExprKind::Literal)]);
+    EXPECT_EQ(1, stats().nodes[static_cast<int>(ExprKind::Variable)]);
+}
+
+TEST_F(StatsTest, SharedNodesAreCountedOnce)
+{
+    parser.shareSubexpressions(true);
+    parser.parse(scanner.scanString("(1 + 2) * (1 + 2)"));
+
+    EXPECT_EQ(2, stats().nodes[static_cast<int>(ExprKind::Binary)]);
+    EXPECT_EQ(2, stats().nodes[static_cast<int>(ExprKind::Literal)]);
+}
+
+TEST_F(StatsTest, TimesPhases)
+{
+    gravlax::AstPrinter printer;
+    auto expr = parser.parse(scanner.scanString("1 + 2"));
+    printer.print(*expr);
+    printer.print(*expr);
+
+    auto &phases = stats().phases;
+    EXPECT_EQ(1, phases[static_cast<int>(Phase::Scan)].calls);
+    EXPECT_EQ(1, phases[static_cast<int>(Phase::Parse)].calls);
+    EXPECT_EQ(2, phases[static_cast<int>(Phase::Print)].calls);
+    EXPECT_EQ(0, phases[static_cast<int>(Phase::Evaluate)].calls);
+    EXPECT_EQ(Phase::None, stats().phase);
+}
+
+TEST_F(StatsTest, NestedPhaseIsCountedOnce)
+{
+    {
+        GRAVLAX_STATS_PHASE(Evaluate);
+        GRAVLAX_STATS_PHASE(Evaluate);
+    }
+    EXPECT_EQ(1, stats().phases[static_cast<int>(Phase::Evaluate)].calls);
+}
+
+TEST_F(StatsTest, CountsAllocationsPerPhase)
+{
+    auto before = gravlax::stats::threadAllocations();
+    parser.parse(scanner.scanString("1 + 2 * a"));
+    auto after = gravlax::stats::threadAllocations();
+
+    auto &parse = stats().phases[static_cast<int>(Phase::Parse)];
+    EXPECT_GT(parse.allocations, 0);
+    EXPECT_GT(parse.bytesAllocated, 0);
+    EXPECT_GE(after.count - before.count, parse.allocations);
+}
+
+TEST_F(StatsTest, Reports)
+{
+    parser.parse(scanner.scanString("1 + 2"));
+
+    std::string text = gravlax::stats::formatText(stats());
+    EXPECT_THAT(text, HasSubstr("scan"));
+    EXPECT_THAT(text, HasSubstr("NUMBER=2"));
+    EXPECT_THAT(text, HasSubstr("Binary=1"));
+
+    std::string json = gravlax::stats::formatJson(stats());
+    EXPECT_THAT(json, HasSubstr("\"parse\":{\"calls\":1,"));
+    EXPECT_THAT(json, HasSubstr("\"tokens\":{\"PLUS\":1,\"NUMBER\":2}"));
+    EXPECT_THAT(json, HasSubstr("\"peak_rss_bytes\":"));
+}
+
+#endif
@@ -0,0 +1,198 @@
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <gravlax/runtime/heap.h>
+#include <gravlax/runtime/table.h>
+
+using gravlax::runtime::Heap;
+using gravlax::runtime::HeapOptions;
+using gravlax::runtime::ObjString;
+using gravlax::runtime::RootSource;
+using gravlax::runtime::Table;
+using gravlax::runtime::Tracer;
+using gravlax::runtime::Value;
+
+namespace
+{
+
+// Strings that stay put for the test, there is nothing to collect them.
+std::vector<ObjString *> makeKeys(Heap &heap, int count)
+{
+    std::vector<ObjString *> keys;
+    for (int i = 0; i < count; i++)
+        keys.push_back(heap.string("key" + std::to_string(i)));
+    return keys;
+}
+
+}; // namespace
+
+TEST(TableTest, SetGetRemove)
+{
+    Heap heap;
+    auto keys = makeKeys(heap, 3);
+    Table table;
+    Value value;
+
+    EXPECT_FALSE(table.get(keys[0], value));
+    EXPECT_EQ(nullptr, table.find(keys[0]));
+    EXPECT_FALSE(table.remove(keys[0]));
+
+    EXPECT_TRUE(table.set(keys[0], Value::fromNumber(1)));
+    EXPECT_TRUE(table.set(keys[1], Value::fromNumber(2)));
+    EXPECT_FALSE(table.set(keys[0], Value::fromNumber(3)));
+    EXPECT_EQ(2, table.size());
+
+    ASSERT_TRUE(table.get(keys[0], value));
+    EXPECT_EQ(3, value.asNumber());
+    EXPECT_EQ(2, table.find(keys[1])->asNumber());
+    EXPECT_FALSE(table.get(keys[2], value));
+
+    EXPECT_TRUE(table.remove(keys[0]));
+    EXPECT_FALSE(table.get(keys[0], value));
+    EXPECT_TRUE(table.get(keys[1], value));
+    EXPECT_EQ(1, table.size());
+}
+
+TEST(TableTest, KeysAreComparedByAddress)
+{
+    Heap heap;
+    ObjString *a = heap.string("same");
+    ObjString *b = heap.string("same");
+    Table table;
+
+    table.set(a, Value::fromNumber(1));
+    EXPECT_EQ(nullptr, table.find(b));
+    EXPECT_EQ(a, table.findString("same", a->hash));
+    EXPECT_EQ(nullptr, table.findString("other", a->hash));
+}
+
+TEST(TableTest, GrowsAtSevenEighths)
+{
+    Heap heap;
+    auto keys = makeKeys(heap, 1000);
+    Table table;
+
+    for (int i = 0; i < 1000; i++)
+        table.set(keys[i], Value::fromNumber(i));
+
+    EXPECT_EQ(1000, table.size());
+    EXPECT_EQ(2048, table.capacity());
+    for (int i = 0; i < 1000; i++)
+        ASSERT_EQ(i, table.find(keys[i])->asNumber());
+}
+
+// Every key hashes the same, so they all fight over one run that wraps
+// around the end of the table, and every removal has to shift the run.
+TEST(TableTest, RemovalShiftsCollidingKeys)
+{
+    Heap heap;
+    auto keys = makeKeys(heap, 12);
+    for (auto key : keys)
+        key->hash = 0x12345678;
+    Table table;
+
+    for (int i = 0; i < 12; i++)
+        table.set(keys[i], Value::fromNumber(i));
+    for (int i = 0; i < 12; i += 3)
+        ASSERT_TRUE(table.remove(keys[i]));
+
+    for (int i = 0; i < 12; i++) {
+        Value *value = table.find(keys[i]);
+        if (i % 3 == 0) {
+            EXPECT_EQ(nullptr, value);
+        } else {
+            ASSERT_NE(nullptr, value);
+            EXPECT_EQ(i, value->asNumber());
+        }
+    }
+}
+
+// Against std::unordered_map. With no tombstones, churn at a steady size
+// never grows the table.
+TEST(TableTest, ChurnMatchesUnorderedMap)
+{
+    Heap heap;
+    auto keys = makeKeys(heap, 200);
+    Table table;
+    std::unordered_map<ObjString *, double> model;
+    std::mt19937 random(42);
+
+    for (int step = 0; step < 20000; step++) {
+        ObjString *key = keys[random() % keys.size()];
+        if (random() % 2) {
+            table.set(key, Value::fromNumber(step));
+            model[key] = step;
+        } else {
+            ASSERT_EQ(model.erase(key) == 1, table.remove(key));
+        }
+    }
+
+    EXPECT_EQ(model.size(), table.size());
+    EXPECT_EQ(256, table.capacity());
+    for (auto key : keys) {
+        Value value;
+        auto it = model.find(key);
+        ASSERT_EQ(it != model.end(), table.get(key, value));
+        if (it != model.end()) {
+            EXPECT_EQ(it->second, value.asNumber());
+        }
+    }
+}
+
+TEST(TableTest, RemoveIf)
+{
+    Heap heap;
+    auto keys = makeKeys(heap, 100);
+    Table table;
+    for (int i = 0; i < 100; i++)
+        table.set(keys[i], Value::fromNumber(i));
+
+    table.removeIf([](const Table::Entry &entry) {
+        return static_cast<int>(entry.value.asNumber()) % 2 == 0;
+    });
+
+    EXPECT_EQ(50, table.size());
+    for (int i = 0; i < 100; i++)
+        EXPECT_EQ(i % 2 == 1, table.find(keys[i]) != nullptr);
+}
+
+TEST(TableTest, TracedTablesFollowTheirObjects)
+{
+    HeapOptions options;
+    options.nurseryBytes = 16 << 10;
+    options.blockBytes = 16 << 10;
+    Heap heap(options);
+
+    struct Owner : RootSource {
+        Table table;
+        void traceRoots(Tracer &tracer) override { table.trace(tracer); }
+    } owner;
+    heap.addRoots(&owner);
+
+    for (int i = 0; i < 50; i++) {
+        ObjString *value = heap.string("value" + std::to_string(i));
+        gravlax::runtime::Rooted<ObjString> rooted(heap, value);
+        ObjString *key = heap.string("key" + std::to_string(i));
+        owner.table.set(key, Value::fromObject(rooted));
+    }
+    heap.collect();
+    heap.collect(true);
+
+    for (int i = 0; i < 50; i++) {
+        std::string name = "key" + std::to_string(i);
+        ObjString *key = owner.table.findString(
+            name, gravlax::runtime::hashChars(name));
+        ASSERT_NE(nullptr, key);
+        EXPECT_FALSE(heap.isYoung(key));
+        Value value;
+        ASSERT_TRUE(owner.table.get(key, value));
+        EXPECT_EQ("value" + std::to_string(i),
+                  gravlax::runtime::asString(value)->view());
+    }
+
+    heap.removeRoots(&owner);
+}
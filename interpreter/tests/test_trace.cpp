@@ -0,0 +1,124 @@
+#include <sstream>
+#include <thread>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <gravlax/parser.h>
+#include <gravlax/scanner.h>
+#include <gravlax/trace.h>
+
+using ::testing::HasSubstr;
+using ::testing::Not;
+
+#if GRAVLAX_ENABLE_TRACE
+
+class TraceTest : public ::testing::Test
+{
+  public:
+    void SetUp() override
+    {
+        gravlax::trace::clear();
+        gravlax::trace::start();
+    }
+
+    void TearDown() override
+    {
+        gravlax::trace::stop();
+        gravlax::trace::clear();
+    }
+
+    std::string json()
+    {
+        std::ostringstream out;
+        gravlax::trace::writeChromeJson(out);
+        return out.str();
+    }
+};
+
+TEST_F(TraceTest, RecordsFrontEndSpans)
+{
+    gravlax::Scanner scanner;
+    gravlax::Parser<std::string> parser;
+    parser.parse(scanner.scanString("1 + 2"));
+
+    EXPECT_EQ(2u, gravlax::trace::threadEventCount());
+
+    auto s = json();
+    EXPECT_THAT(s, HasSubstr("\"traceEvents\":["));
+    EXPECT_THAT(s, HasSubstr("{\"name\":\"Scanner::scanString\",\"ph\":\"X\""));
+    EXPECT_THAT(s, HasSubstr("{\"name\":\"Parser::parse\",\"ph\":\"X\""));
+    EXPECT_THAT(s, HasSubstr("\"ph\":\"M\""));
+}
+
+TEST_F(TraceTest, NothingRecordedWhenStopped)
+{
+    gravlax::trace::stop();
+    {
+        GRAVLAX_TRACE_SCOPE("stopped");
+    }
+
+    EXPECT_EQ(0u, gravlax::trace::threadEventCount());
+    EXPECT_THAT(json(), Not(HasSubstr("stopped")));
+}
+
+TEST_F(TraceTest, NestedSpansEndInOrder)
+{
+    {
+        GRAVLAX_TRACE_SCOPE("outer");
+        GRAVLAX_TRACE_SCOPE("inner");
+    }
+
+    auto s = json();
+    auto inner = s.find("\"inner\"");
+    auto outer = s.find("\"outer\"");
+    ASSERT_NE(std::string::npos, inner);
+    ASSERT_NE(std::string::npos, outer);
+    EXPECT_LT(inner, outer);
+}
+
+TEST_F(TraceTest, ThreadsGetTheirOwnBuffers)
+{
+    std::thread worker([] {
+        GRAVLAX_TRACE_SCOPE("worker");
+    });
+    worker.join();
+    {
+        GRAVLAX_TRACE_SCOPE("main");
+    }
+
+    EXPECT_EQ(1u, gravlax::trace::threadEventCount());
+
+    auto s = json();
+    auto tid = [&](const char *name) {
+        auto at = s.find(name);
+        auto from = s.find("\"tid\":", at) + 6;
+        return s.substr(from, s.find(',', from) - from);
+    };
+    EXPECT_NE(tid("\"worker\""), tid("\"main\""));
+}
+
+TEST_F(TraceTest, FullBufferKeepsNewestEvents)
+{
+    gravlax::trace::start(4);
+
+    std::size_t count = 0;
+    std::thread worker([&] {
+        const char *names[] = {"e0", "e1", "e2", "e3", "e4", "e5"};
+        for (auto name : names) {
+            GRAVLAX_TRACE_SCOPE(name);
+        }
+        count = gravlax::trace::threadEventCount();
+    });
+    worker.join();
+
+    EXPECT_EQ(4u, count);
+
+    auto s = json();
+    EXPECT_THAT(s, Not(HasSubstr("\"e0\"")));
+    EXPECT_THAT(s, Not(HasSubstr("\"e1\"")));
+    EXPECT_THAT(s, HasSubstr("\"e2\""));
+    EXPECT_THAT(s, HasSubstr("\"e5\""));
+}
+
+#endif
@@ -0,0 +1,91 @@
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <gravlax/utf8.h>
+
+using gravlax::utf8::decode;
+using gravlax::utf8::isXidContinue;
+using gravlax::utf8::isXidStart;
+using gravlax::utf8::validate;
+
+TEST(Utf8Test, Ascii)
+{
+    // Long enough for the 64 and 16 byte blocks and the tail.
+    std::string text(100, 'x');
+    auto check = validate(text);
+    EXPECT_EQ(100, check.valid);
+    EXPECT_TRUE(check.ascii);
+    EXPECT_FALSE(check.truncated);
+
+    EXPECT_TRUE(validate("").ascii);
+}
+
+TEST(Utf8Test, Valid)
+{
+    for (std::string text : {"ä", "→", "🌍", "߿ࠀ￿\U00010000",
+                             "\U0010ffff"}) {
+        // At each offset, so that every block size meets the sequence.
+        for (std::size_t pad = 0; pad < 70; pad++) {
+            std::string padded = std::string(pad, ' ') + text + "!";
+            auto check = validate(padded);
+            EXPECT_EQ(padded.size(), check.valid) << text << " at " << pad;
+            EXPECT_FALSE(check.ascii);
+        }
+    }
+}
+
+TEST(Utf8Test, Invalid)
+{
+    // Continuation without a lead, overlong forms, surrogates, past
+    // U+10FFFF, and leads that never occur.
+    for (std::string text : {"\x80", "\xc0\xaf", "\xc1\xbf", "\xe0\x80\xaf",
+                             "\xed\xa0\x80", "\xf0\x80\x80\xaf",
+                             "\xf4\x90\x80\x80", "\xf5\x80\x80\x80", "\xff",
+                             "\xc3\x28", "\xe2\x82\x28"}) {
+        std::string padded = std::string(20, 'a') + text;
+        auto check = validate(padded);
+        EXPECT_EQ(20, check.valid);
+        EXPECT_FALSE(check.truncated);
+    }
+}
+
+// A sequence cut off by the end of the text may be completed later.
+TEST(Utf8Test, Truncated)
+{
+    auto check = validate("ab\xf0\x9f\x8c");
+    EXPECT_EQ(2, check.valid);
+    EXPECT_TRUE(check.truncated);
+
+    EXPECT_TRUE(validate("\xe2").truncated);
+    EXPECT_FALSE(validate("\xe2(").truncated);
+}
+
+TEST(Utf8Test, Decode)
+{
+    std::string text = "aä→\U0001f30d";
+    std::size_t offset = 0;
+    EXPECT_EQ(U'a', decode(text, offset));
+    EXPECT_EQ(U'ä', decode(text, offset));
+    EXPECT_EQ(U'→', decode(text, offset));
+    EXPECT_EQ(U'\U0001f30d', decode(text, offset));
+    EXPECT_EQ(text.size(), offset);
+}
+
+TEST(Utf8Test, Xid)
+{
+    EXPECT_TRUE(isXidStart(U'ä'));
+    EXPECT_TRUE(isXidStart(U'π'));
+    EXPECT_TRUE(isXidStart(U'名'));
+    EXPECT_TRUE(isXidStart(U'\U00020000'));
+    EXPECT_FALSE(isXidStart(U'́'));
+    EXPECT_TRUE(isXidContinue(U'́'));
+    EXPECT_TRUE(isXidContinue(U'٣'));
+    EXPECT_FALSE(isXidStart(U'٣'));
+    EXPECT_TRUE(isXidContinue(U'\U000e0100'));
+
+    for (char32_t c : {U' ', U'→', U'€', U'🌍', U'\U0010ffff'}) {
+        EXPECT_FALSE(isXidStart(c));
+        EXPECT_FALSE(isXidContinue(c));
+    }
+}
@@ -15,15 +15,38 @@ using gravlax::utils::trim_string;
 struct ExpressionData {
     std::string name;
     std::vector<std::pair<std::string, std::string>> fields;
+    // Filled in by later passes, i.e. the resolver, or by the executor as it
+    // runs. Annotations are not constructor parameters and do not take part
+    // in the structural hash.
+    std::vector<std::pair<std::string, std::string>> annotations = {};
 };
 
 // clang-format off
 std::vector<ExpressionData> expressionData = {
-    {"Binary", 
+    {"Assign",
+        {
+            {"Token", "name"},
+            {"Expr", "value"}
+        },
+        {
+            {"Resolution", "resolution"}
+        }
+    },
+    {"Binary",
         {
             {"Expr", "left"},
             {"Token", "oper"},
             {"Expr", "right"}
+        },
+        {
+            {"Quickening", "quickening"}
+        }
+    },
+    {"Call",
+        {
+            {"Expr", "callee"},
+            {"Token", "paren"},
+            {"List<Expr>", "arguments"}
         }
     },
     {"Grouping",
@@ -36,11 +59,88 @@ std::vector<ExpressionData> expressionData = {
             { "Token::Literal", "value" }
         }
     },
+    {"Logical",
+        {
+            {"Expr", "left"},
+            {"Token", "oper"},
+            {"Expr", "right"}
+        }
+    },
     {"Unary",
         {
             { "Token", "oper" },
             { "Expr", "right" }
         }
+    },
+    {"Variable",
+        {
+            { "Token", "name" }
+        },
+        {
+            {"Resolution", "resolution"}
+        }
+    }
+};
+
+std::vector<ExpressionData> statementData = {
+    {"Block",
+        {
+            {"List<Stmt>", "statements"}
+        },
+        {
+            {"BlockInfo", "info"}
+        }
+    },
+    {"Expression",
+        {
+            {"Expr", "expression"}
+        }
+    },
+    {"Function",
+        {
+            {"Token", "name"},
+            {"List<Token>", "params"},
+            {"List<Stmt>", "body"}
+        },
+        {
+            {"Resolution", "resolution"},
+            {"FunctionInfo", "info"},
+            {"LazyBody", "lazy"}
+        }
+    },
+    {"If",
+        {
+            {"Expr", "condition"},
+            {"Stmt", "thenBranch"},
+            {"Stmt", "elseBranch"}
+        }
+    },
+    {"Print",
+        {
+            {"Expr", "expression"}
+        }
+    },
+    {"Return",
+        {
+            {"Token", "keyword"},
+            {"Expr", "value"}
+        }
+    },
+    {"Var",
+        {
+            {"Token", "name"},
+            {"Expr", "initializer"}
+        },
+        {
+            {"Resolution", "resolution"}
+        }
+    },
+    {"While",
+        {
+            {"Token", "keyword"},
+            {"Expr", "condition"},
+            {"Stmt", "body"}
+        }
     }
 };
 // clang-format on
@@ -48,12 +148,20 @@ std::vector<ExpressionData> expressionData = {
 struct AstGenerator {
     std::string outputDir;
     std::string baseClassName;
+    // Prepended to the names of the generated files.
+    std::string filePrefix;
 
-    AstGenerator(std::string_view outputDir, std::string_view baseClassName)
-        : outputDir(outputDir), baseClassName(baseClassName)
+    AstGenerator(std::string_view outputDir, std::string_view baseClassName,
+                 std::string_view filePrefix = "")
+        : outputDir(outputDir), baseClassName(baseClassName),
+          filePrefix(filePrefix)
     {
     }
 
+    // Expressions are hashed so that the parser can share them, statements
+    // are not.
+    bool hashed() const { return baseClassName == "Expr"; }
+
     void generate(const std::vector<ExpressionData> &expressionData)
     {
         generateVisitorBase(expressionData);
@@ -91,7 +199,8 @@ struct AstGenerator {
         // std::ostream &out = std::cout;
 
         std::ofstream out;
-        std::string path = fmt::format("{}/{}", outputDir, "visitor_base.h");
+        std::string path =
+            fmt::format("{}/{}visitor_base.h", outputDir, filePrefix);
         out.open(path);
 
         out << "#pragma once\n";
@@ -104,6 +213,21 @@ struct AstGenerator {
             out << fmt::format("template <typename> struct {};\n", type.name);
         }
 
+        // Node kinds, so that trees can be inspected without a visitor
+        out << fmt::format("enum class {}Kind {{\n", baseClassName);
+        for (auto &type : types) {
+            out << fmt::format("{},\n", type.name);
+        }
+        out << "};\n";
+        out << fmt::format("inline constexpr int {}KindCount = {};\n",
+                           baseClassName, types.size());
+        out << fmt::format("inline constexpr const char *{}KindNames[] = {{\n",
+                           baseClassName);
+        for (auto &type : types) {
+            out << fmt::format("\"{}\",\n", type.name);
+        }
+        out << "};\n";
+
         out << "template <typename R>\n";
         out << fmt::format("class {}VisitorBase {{\n", baseClassName);
         out << "public:\n";
@@ -120,8 +244,8 @@ struct AstGenerator {
     void generateType(const ExpressionData &type)
     {
         std::ofstream out;
-        std::string path =
-            fmt::format("{}/{}.h", outputDir, to_lowercase(type.name));
+        std::string path = fmt::format("{}/{}{}.h", outputDir, filePrefix,
+                                       to_lowercase(type.name));
         out.open(path);
 
         generateType(out, type);
@@ -131,27 +255,43 @@ struct AstGenerator {
 
     void generateType(std::ostream &out, const ExpressionData &type)
     {
-        writeHeader(out);
+        writeHeader(out, type);
         writeType(out, type);
     }
 
-    void writeHeader(std::ostream &out)
+    void writeHeader(std::ostream &out, const ExpressionData &type)
     {
         out << "#pragma once\n\n";
 
-        out << "#include <gravlax/expression.h>\n";
+        out << "#include <vector>\n\n";
+
+        if (hashed()) {
+            out << "#include <gravlax/expression.h>\n";
+        } else {
+            out << "#include <gravlax/statement.h>\n";
+        }
+        if (!type.annotations.empty())
+            out << "#include <gravlax/resolution.h>\n";
         out << "#include <gravlax/token.h>\n\n";
     }
 
-    std::string field_to_string(std::pair<std::string, std::string> field)
+    // List<T> fields become vectors of whatever T becomes.
+    std::string fieldType(const std::string &type)
     {
-        if (field.first.find("std::variant") != std::string::npos ||
-            field.first == "Token" || field.first == "Token::Literal") {
-            return fmt::format("{} {}", templatize(field.first), field.second);
-        } else {
-            return fmt::format("std::shared_ptr<{}> {}",
-                               templatize(field.first), field.second);
+        if (type.starts_with("List<") && type.ends_with(">")) {
+            return fmt::format("std::vector<{}>",
+                               fieldType(type.substr(5, type.size() - 6)));
+        }
+        if (type.find("std::variant") != std::string::npos ||
+            type == "Token" || type == "Token::Literal") {
+            return templatize(type);
         }
+        return fmt::format("std::shared_ptr<{}>", templatize(type));
+    }
+
+    std::string field_to_string(std::pair<std::string, std::string> field)
+    {
+        return fmt::format("{} {}", fieldType(field.first), field.second);
     }
 
     std::string templatize(const std::string &type)
@@ -180,6 +320,10 @@ struct AstGenerator {
         for (auto &field : type.fields) {
             out << fmt::format("{};\n", field_to_string(field));
         }
+        for (auto &annotation : type.annotations) {
+            out << fmt::format("{} {}{{}};\n", annotation.first,
+                               annotation.second);
+        }
         out << "\n";
 
         // Constructor
@@ -197,15 +341,34 @@ struct AstGenerator {
         // Constructor Initializers
         f.clear();
         for (auto &field : type.fields) {
-            f.push_back(fmt::format("{}({})", field.second, field.second));
+            f.push_back(fmt::format("{}(std::move({}))", field.second,
+                                    field.second));
         }
         out << string_join(f, ", ");
 
-        out << "\n{}\n";
+        // Structural hash over the node kind and all of its fields. The
+        // arguments have been moved from, so hash the members.
+        if (hashed()) {
+            f.clear();
+            f.push_back(fmt::format("{}Kind::{}", baseClassName, type.name));
+            for (auto &field : type.fields) {
+                f.push_back(fmt::format("this->{}", field.second));
+            }
+            out << fmt::format(
+                "\n{{\n    this->hash = hashNode({});\n}}\n",
+                string_join(f, ", "));
+        } else {
+            out << "\n{\n}\n";
+        }
+
+        out << fmt::format(
+            "{}Kind kind() const override {{ return {}Kind::{}; }}\n",
+            baseClassName, baseClassName, type.name);
 
-        out << "R accept(ExprVisitorBase<R> & visitor) override {\n";
-        out << fmt::format("    return visitor.visit{}Expr(*this);\n",
-                           type.name);
+        out << fmt::format("R accept({}VisitorBase<R> & visitor) override {{\n",
+                           baseClassName);
+        out << fmt::format("    return visitor.visit{}{}(*this);\n",
+                           type.name, baseClassName);
         out << "};\n";
 
         out << "};\n\n";
@@ -217,4 +380,7 @@ int main(int argc, char *argv[])
 {
     AstGenerator gen(argv[1], "Expr");
     gen.generate(expressionData);
+
+    AstGenerator stmt(argv[1], "Stmt", "stmt_");
+    stmt.generate(statementData);
 }
\ No newline at end of file
@@ -0,0 +1,588 @@
+#include <bitset>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include <gravlax/utils/string_tokenizer.h>
+
+using gravlax::utils::trim_string;
+
+// Turns tokens.spec into Token::Type with its names, and a minimized DFA
+// over byte classes that lexer::scan() runs.
+
+using CharSet = std::bitset<256>;
+
+struct Rule {
+    std::string name;
+    // The comments above the token, for the enum.
+    std::vector<std::string> comments;
+    // A regular expression, or a literal spelling if literal is set. Empty
+    // for tokens without a spelling.
+    std::string pattern;
+    bool literal = false;
+    bool skip = false;
+};
+
+// Thompson's construction. Each state has character edges and epsilon
+// edges, and at most one accepting rule.
+struct Nfa {
+    struct State {
+        std::vector<std::pair<CharSet, int>> edges;
+        std::vector<int> epsilon;
+        int accept = -1;
+    };
+
+    std::vector<State> states;
+
+    int add()
+    {
+        states.emplace_back();
+        return static_cast<int>(states.size()) - 1;
+    }
+};
+
+// A fragment of the NFA under construction, from its entry to its exit.
+struct Fragment {
+    int entry;
+    int exit;
+};
+
+class RegexParser
+{
+    Nfa &nfa;
+    const std::string &pattern;
+    std::size_t pos = 0;
+
+    [[noreturn]] void fail(const std::string &message)
+    {
+        throw std::runtime_error(fmt::format("/{}/ at {}: {}", pattern, pos,
+                                             message));
+    }
+
+    bool atEnd() const { return pos >= pattern.size(); }
+    char peek() const { return atEnd() ? '\0' : pattern[pos]; }
+
+    char escaped()
+    {
+        if (atEnd())
+            fail("escape at the end");
+        switch (char c = pattern[pos++]) {
+        case 'n':
+            return '\n';
+        case 'r':
+            return '\r';
+        case 't':
+            return '\t';
+        case 'x': {
+            // \xHH, the byte with that value.
+            int value = 0;
+            for (int i = 0; i < 2; i++) {
+                char h = peek();
+                int digit = std::isdigit(static_cast<unsigned char>(h))
+                                ? h - '0'
+                                : std::isxdigit(static_cast<unsigned char>(h))
+                                      ? (h | 0x20) - 'a' + 10
+                                      : -1;
+                if (digit < 0)
+                    fail("\\x needs two hex digits");
+                value = value * 16 + digit;
+                pos++;
+            }
+            return static_cast<char>(value);
+        }
+        default:
+            return c;
+        }
+    }
+
+    Fragment chars(const CharSet &set)
+    {
+        Fragment f{nfa.add(), nfa.add()};
+        nfa.states[f.entry].edges.push_back({set, f.exit});
+        return f;
+    }
+
+    CharSet charClass()
+    {
+        CharSet set;
+        bool negated = peek() == '^';
+        if (negated)
+            pos++;
+        while (!atEnd() && peek() != ']') {
+            char c = pattern[pos++];
+            unsigned char low = c == '\\' ? escaped() : c;
+            unsigned char high = low;
+            if (peek() == '-' && pos + 1 < pattern.size() &&
+                pattern[pos + 1] != ']') {
+                pos++;
+                c = pattern[pos++];
+                high = c == '\\' ? escaped() : c;
+            }
+            for (int b = low; b <= high; b++)
+                set.set(b);
+        }
+        if (atEnd())
+            fail("unterminated class");
+        pos++;
+        return negated ? ~set : set;
+    }
+
+    Fragment atom()
+    {
+        char c = pattern[pos++];
+        CharSet set;
+        switch (c) {
+        case '(': {
+            Fragment f = alternation();
+            if (peek() != ')')
+                fail("expected ')'");
+            pos++;
+            return f;
+        }
+        case '[':
+            return chars(charClass());
+        case '\\':
+            set.set(static_cast<unsigned char>(escaped()));
+            return chars(set);
+        case '*':
+        case '+':
+        case '?':
+        case ')':
+        case '|':
+            fail(fmt::format("unexpected '{}'", c));
+        default:
+            set.set(static_cast<unsigned char>(c));
+            return chars(set);
+        }
+    }
+
+    Fragment repetition()
+    {
+        Fragment f = atom();
+        while (peek() == '*' || peek() == '+' || peek() == '?') {
+            char op = pattern[pos++];
+            Fragment r{nfa.add(), nfa.add()};
+            nfa.states[r.entry].epsilon.push_back(f.entry);
+            nfa.states[f.exit].epsilon.push_back(r.exit);
+            if (op != '+')
+                nfa.states[r.entry].epsilon.push_back(r.exit);
+            if (op != '?')
+                nfa.states[f.exit].epsilon.push_back(f.entry);
+            f = r;
+        }
+        return f;
+    }
+
+    Fragment concatenation()
+    {
+        int entry = nfa.add();
+        Fragment f{entry, entry};
+        while (!atEnd() && peek() != '|' && peek() != ')') {
+            Fragment next = repetition();
+            nfa.states[f.exit].epsilon.push_back(next.entry);
+            f.exit = next.exit;
+        }
+        return f;
+    }
+
+    Fragment alternation()
+    {
+        Fragment f = concatenation();
+        while (peek() == '|') {
+            pos++;
+            Fragment other = concatenation();
+            Fragment both{nfa.add(), nfa.add()};
+            nfa.states[both.entry].epsilon = {f.entry, other.entry};
+            nfa.states[f.exit].epsilon.push_back(both.exit);
+            nfa.states[other.exit].epsilon.push_back(both.exit);
+            f = both;
+        }
+        return f;
+    }
+
+  public:
+    RegexParser(Nfa &nfa, const std::string &pattern)
+        : nfa(nfa), pattern(pattern)
+    {
+    }
+
+    Fragment parse()
+    {
+        Fragment f = alternation();
+        if (!atEnd())
+            fail("unbalanced ')'");
+        return f;
+    }
+};
+
+struct Dfa {
+    // Bytes that no pattern tells apart share a class.
+    std::vector<int> byteClass = std::vector<int>(256);
+    int classCount = 0;
+    // transitions[state][class]. State 0 is dead, 1 is the start.
+    std::vector<std::vector<int>> transitions;
+    // The rule a state accepts, or -1.
+    std::vector<int> accepts;
+};
+
+struct LexerGenerator {
+    std::vector<Rule> rules;
+    Nfa nfa;
+    int start = 0;
+    Dfa dfa;
+
+    void readSpec(std::istream &in)
+    {
+        std::vector<std::string> comments;
+        std::string line;
+        int number = 0;
+        while (std::getline(in, line)) {
+            number++;
+            line = trim_string(line, " \t\r");
+            if (line.empty()) {
+                comments.clear();
+                continue;
+            }
+            if (line[0] == '#') {
+                comments.push_back(trim_string(line.substr(1)));
+                continue;
+            }
+
+            Rule rule;
+            std::istringstream words(line);
+            words >> rule.name;
+            if (rule.name == "skip") {
+                rule.skip = true;
+                words >> rule.name;
+            }
+            std::string rest;
+            std::getline(words, rest);
+            rest = trim_string(rest);
+
+            if (rest.size() >= 2 && rest.front() == '"' &&
+                rest.back() == '"') {
+                rule.literal = true;
+                rule.pattern = rest.substr(1, rest.size() - 2);
+            } else if (rest.size() >= 2 && rest.front() == '/' &&
+                       rest.back() == '/') {
+                rule.pattern = rest.substr(1, rest.size() - 2);
+            } else if (!rest.empty() || rule.skip) {
+                throw std::runtime_error(
+                    fmt::format("line {}: expected \"literal\" or /pattern/",
+                                number));
+            }
+            if (!rule.skip)
+                rule.comments = std::move(comments);
+            comments.clear();
+            rules.push_back(std::move(rule));
+        }
+    }
+
+    // Skip rules are numbered after the tokens.
+    std::vector<const Rule *> ordered() const
+    {
+        std::vector<const Rule *> result;
+        for (auto &rule : rules)
+            if (!rule.skip)
+                result.push_back(&rule);
+        for (auto &rule : rules)
+            if (rule.skip)
+                result.push_back(&rule);
+        return result;
+    }
+
+    void buildNfa()
+    {
+        start = nfa.add();
+        auto order = ordered();
+        for (std::size_t i = 0; i < order.size(); i++) {
+            const Rule &rule = *order[i];
+            if (rule.pattern.empty())
+                continue;
+
+            Fragment f;
+            if (rule.literal) {
+                f.entry = f.exit = nfa.add();
+                for (unsigned char c : rule.pattern) {
+                    int next = nfa.add();
+                    CharSet set;
+                    set.set(c);
+                    nfa.states[f.exit].edges.push_back({set, next});
+                    f.exit = next;
+                }
+            } else {
+                f = RegexParser(nfa, rule.pattern).parse();
+            }
+            nfa.states[start].epsilon.push_back(f.entry);
+            nfa.states[f.exit].accept = static_cast<int>(i);
+        }
+    }
+
+    // Which of two accepting rules a state that accepts both takes.
+    bool better(int a, int b) const
+    {
+        if (b < 0)
+            return true;
+        auto order = ordered();
+        if (order[a]->literal != order[b]->literal)
+            return order[a]->literal;
+        return a < b;
+    }
+
+    void computeByteClasses()
+    {
+        std::map<std::vector<bool>, int> signatures;
+        for (int b = 0; b < 256; b++) {
+            std::vector<bool> signature;
+            for (auto &state : nfa.states)
+                for (auto &[set, target] : state.edges)
+                    signature.push_back(set.test(b));
+            auto [it, inserted] = signatures.emplace(
+                signature, static_cast<int>(signatures.size()));
+            dfa.byteClass[b] = it->second;
+        }
+        dfa.classCount = static_cast<int>(signatures.size());
+    }
+
+    std::set<int> closure(std::set<int> states) const
+    {
+        std::vector<int> work(states.begin(), states.end());
+        while (!work.empty()) {
+            int s = work.back();
+            work.pop_back();
+            for (int t : nfa.states[s].epsilon)
+                if (states.insert(t).second)
+                    work.push_back(t);
+        }
+        return states;
+    }
+
+    // Subset construction over byte classes.
+    void buildDfa()
+    {
+        std::vector<int> representative(dfa.classCount);
+        for (int b = 255; b >= 0; b--)
+            representative[dfa.byteClass[b]] = b;
+
+        std::map<std::set<int>, int> ids;
+        std::vector<std::set<int>> sets;
+        auto id = [&](const std::set<int> &set) {
+            auto [it, inserted] =
+                ids.emplace(set, static_cast<int>(sets.size()));
+            if (inserted)
+                sets.push_back(set);
+            return it->second;
+        };
+        id({});
+        id(closure({start}));
+
+        for (std::size_t d = 0; d < sets.size(); d++) {
+            std::vector<int> row(dfa.classCount);
+            int accept = -1;
+            for (int s : sets[d]) {
+                int a = nfa.states[s].accept;
+                if (a >= 0 && better(a, accept))
+                    accept = a;
+            }
+            for (int c = 0; c < dfa.classCount; c++) {
+                std::set<int> next;
+                for (int s : sets[d])
+                    for (auto &[set, target] : nfa.states[s].edges)
+                        if (set.test(representative[c]))
+                            next.insert(target);
+                row[c] = id(closure(std::move(next)));
+            }
+            dfa.transitions.push_back(std::move(row));
+            dfa.accepts.push_back(accept);
+        }
+    }
+
+    // Moore's partition refinement, keeping the dead state at 0 and the
+    // start at 1.
+    void minimize()
+    {
+        std::size_t n = dfa.transitions.size();
+        std::vector<int> block(n);
+        for (std::size_t s = 0; s < n; s++)
+            block[s] = dfa.accepts[s] + 1;
+
+        for (;;) {
+            std::map<std::vector<int>, int> signatures;
+            std::vector<int> next(n);
+            // The dead state's block is numbered first.
+            for (std::size_t s = 0; s < n; s++) {
+                std::vector<int> signature = {block[s]};
+                for (int target : dfa.transitions[s])
+                    signature.push_back(block[target]);
+                auto [it, inserted] = signatures.emplace(
+                    signature, static_cast<int>(signatures.size()));
+                next[s] = it->second;
+            }
+            bool stable = signatures.size() ==
+                          std::set<int>(block.begin(), block.end()).size();
+            block = std::move(next);
+            if (stable)
+                break;
+        }
+
+        // Number blocks by first appearance, so that dead and start stay.
+        std::map<int, int> renumbered;
+        for (std::size_t s = 0; s < n; s++)
+            renumbered.emplace(block[s], static_cast<int>(renumbered.size()));
+        if (renumbered[block[0]] != 0 || renumbered[block[1]] != 1)
+            throw std::runtime_error("the start state is dead");
+
+        Dfa minimal;
+        minimal.byteClass = dfa.byteClass;
+        minimal.classCount = dfa.classCount;
+        minimal.transitions.resize(renumbered.size());
+        minimal.accepts.resize(renumbered.size());
+        for (std::size_t s = 0; s < n; s++) {
+            int m = renumbered[block[s]];
+            minimal.accepts[m] = dfa.accepts[s];
+            minimal.transitions[m].clear();
+            for (int target : dfa.transitions[s])
+                minimal.transitions[m].push_back(renumbered[block[target]]);
+        }
+        dfa = std::move(minimal);
+    }
+
+    void generate()
+    {
+        buildNfa();
+        computeByteClasses();
+        buildDfa();
+        minimize();
+    }
+
+    static std::string ints(const std::vector<int> &values)
+    {
+        std::string text;
+        for (std::size_t i = 0; i < values.size(); i++) {
+            text += fmt::format("{},", values[i]);
+            text += i % 16 == 15 ? "\n" : " ";
+        }
+        return text;
+    }
+
+    std::string tokenTypeHeader() const
+    {
+        std::string out = "#pragma once\n\n";
+        out += "namespace gravlax::generated {\n\n";
+        out += "enum TokenType {\n";
+        std::size_t count = 0;
+        for (auto &rule : rules) {
+            if (rule.skip)
+                continue;
+            for (auto &comment : rule.comments)
+                out += fmt::format("// {}\n", comment);
+            out += fmt::format("{},\n", rule.name);
+            count++;
+        }
+        out += "};\n";
+        out += fmt::format("inline constexpr int TokenTypeCount = {};\n",
+                           count);
+        out += "inline constexpr const char *TokenTypeNames[] = {\n";
+        for (auto &rule : rules)
+            if (!rule.skip)
+                out += fmt::format("\"{}\",\n", rule.name);
+        out += "};\n\n";
+        out += "}; // namespace gravlax::generated\n";
+        return out;
+    }
+
+    std::string tablesHeader() const
+    {
+        std::size_t states = dfa.transitions.size();
+        const char *stateType =
+            states <= 256 ? "std::uint8_t" : "std::uint16_t";
+
+        std::string out = "#pragma once\n\n";
+        out += "#include <cstdint>\n\n";
+        out += "#include <gravlax/generated/token_type.h>\n\n";
+        out += "namespace gravlax::generated::lexer {\n\n";
+        out += fmt::format("inline constexpr int ClassCount = {};\n",
+                           dfa.classCount);
+        out += fmt::format("inline constexpr int StateCount = {};\n", states);
+        out += "inline constexpr int DeadState = 0;\n";
+        out += "inline constexpr int StartState = 1;\n\n";
+        out += "// What a state accepts: a TokenType, a skip rule or "
+               "NoMatch.\n";
+        out += "inline constexpr std::int16_t NoMatch = -1;\n";
+        auto order = ordered();
+        for (std::size_t i = 0; i < order.size(); i++)
+            if (order[i]->skip)
+                out += fmt::format("inline constexpr std::int16_t {} = {};\n",
+                                   order[i]->name, i);
+        out += "\n";
+
+        out += "inline constexpr std::uint8_t ByteClass[256] = {\n";
+        out += ints(dfa.byteClass);
+        out += "};\n\n";
+
+        out += fmt::format("inline constexpr {} Transitions[StateCount]"
+                           "[ClassCount] = {{\n",
+                           stateType);
+        for (auto &row : dfa.transitions)
+            out += "{" + ints(row) + "},\n";
+        out += "};\n\n";
+
+        out += "inline constexpr std::int16_t Accepts[StateCount] = {\n";
+        out += ints(dfa.accepts);
+        out += "};\n\n";
+        out += "}; // namespace gravlax::generated::lexer\n";
+        return out;
+    }
+};
+
+// Leaves files that did not change alone, so that their dependents are not
+// rebuilt.
+void writeIfChanged(const std::string &path, const std::string &text)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream old;
+    old << in.rdbuf();
+    if (in && old.str() == text)
+        return;
+
+    std::ofstream out(path, std::ios::binary);
+    out << text;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3) {
+        std::cerr << "Usage: lexer_generator <tokens.spec> <output dir>\n";
+        return 64;
+    }
+
+    std::ifstream spec(argv[1]);
+    if (!spec) {
+        std::cerr << fmt::format("Could not read '{}'\n", argv[1]);
+        return 66;
+    }
+
+    LexerGenerator gen;
+    try {
+        gen.readSpec(spec);
+        gen.generate();
+    } catch (std::runtime_error &error) {
+        std::cerr << fmt::format("{}: {}\n", argv[1], error.what());
+        return 65;
+    }
+
+    writeIfChanged(fmt::format("{}/token_type.h", argv[2]),
+                   gen.tokenTypeHeader());
+    writeIfChanged(fmt::format("{}/lexer_tables.h", argv[2]),
+                   gen.tablesHeader());
+    return 0;
+}
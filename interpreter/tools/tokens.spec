@@ -0,0 +1,68 @@
+# The tokens of Lox, read by lexer_generator. Lines are
+#
+#     NAME "literal"
+#     NAME /pattern/
+#     NAME
+#     skip NAME /pattern/
+#
+# Token names become Token::Type in the order given, a token without a
+# spelling only gets its name. skip rules match the text between tokens.
+# At each offset the lexer takes the longest match; a literal wins over a
+# pattern of the same length, and an earlier line over a later one.
+# Patterns know characters, \ escapes (\n, \r, \t and \xHH), [classes]
+# with ranges and ^, (), |, *, + and ?. The comments right above a token
+# are copied into the enum.
+
+# Single-character tokens.
+LEFT_PAREN      "("
+RIGHT_PAREN     ")"
+LEFT_BRACE      "{"
+RIGHT_BRACE     "}"
+COMMA           ","
+DOT             "."
+MINUS           "-"
+PLUS            "+"
+SEMICOLON       ";"
+SLASH           "/"
+STAR            "*"
+
+# One or two character tokens.
+BANG            "!"
+BANG_EQUAL      "!="
+EQUAL           "="
+EQUAL_EQUAL     "=="
+GREATER         ">"
+GREATER_EQUAL   ">="
+LESS            "<"
+LESS_EQUAL      "<="
+
+# Literals.
+# Bytes from 0x80 up are the parts of UTF-8 characters, which the Scanner
+# narrows down to the XID_Start and XID_Continue code points.
+IDENTIFIER      /[A-Za-z_\x80-\xff][A-Za-z_0-9\x80-\xff]*/
+STRING          /"[^"]*"/
+NUMBER          /[0-9]+(\.[0-9]+)?/
+
+# Keywords.
+AND             "and"
+CLASS           "class"
+ELSE            "else"
+FALSE           "false"
+FUN             "fun"
+FOR             "for"
+IF              "if"
+NIL             "nil"
+OR              "or"
+PRINT           "print"
+RETURN          "return"
+SUPER           "super"
+THIS            "this"
+TRUE            "true"
+VAR             "var"
+WHILE           "while"
+
+END_OF_FILE
+
+skip WHITESPACE /[ \t\r\n]+/
+# A comment goes until the end of the line.
+skip COMMENT    /\/\/[^\n]*/
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+# Writes src/xid_tables.cpp, the XID_Start and XID_Continue properties of
+# the code points from U+0080 up, from the Unicode database that Python was
+# built with. ASCII is left to the lexer's DFA.
+#
+#     python3 tools/xid_tables.py > src/xid_tables.cpp
+
+import sys
+import unicodedata
+
+SHIFT = 8
+BLOCK = 1 << SHIFT
+
+
+def xid_start(c):
+    return c >= 0x80 and chr(c).isidentifier()
+
+
+def xid_continue(c):
+    return c >= 0x80 and ("a" + chr(c)).isidentifier()
+
+
+def two_level(name, prop):
+    last = max(c for c in range(0x110000) if prop(c))
+    blocks = {}
+    index = []
+    for high in range((last >> SHIFT) + 1):
+        bits = 0
+        for low in range(BLOCK):
+            if prop((high << SHIFT) | low):
+                bits |= 1 << low
+        index.append(blocks.setdefault(bits, len(blocks)))
+    assert len(blocks) <= 256 and BLOCK == 256
+
+    out = [f"const std::uint8_t {name}Index[{len(index)}] = {{"]
+    for i in range(0, len(index), 16):
+        out.append("    " + ", ".join(str(b) for b in index[i:i + 16]) + ",")
+    out.append("};")
+    out.append("")
+    words = BLOCK // 64
+    out.append(f"const std::uint64_t {name}Blocks[{len(blocks)}][{words}] = {{")
+    for bits in blocks:
+        row = [f"0x{(bits >> (64 * w)) & (2**64 - 1):016x}"
+               for w in range(words)]
+        out.append(f"    {{{row[0]}, {row[1]},")
+        out.append(f"     {row[2]}, {row[3]}}},")
+    out.append("};")
+    return "\n".join(out)
+
+
+print(f"""// Generated by tools/xid_tables.py from Unicode \
+{unicodedata.unidata_version}, do not edit.
+
+#include <cstddef>
+#include <cstdint>
+
+#include <gravlax/utf8.h>
+
+namespace
+{{
+
+// A bitmap of {BLOCK} code points per block, and the block of each run of
+// {BLOCK} code points. Most blocks are all clear or all set, and shared.
+{two_level("start", xid_start)}
+
+{two_level("continue", xid_continue)}
+
+template <std::size_t N, std::size_t B>
+bool lookup(const std::uint8_t (&index)[N],
+            const std::uint64_t (&blocks)[B][{BLOCK // 64}], char32_t c)
+{{
+    if ((c >> {SHIFT}) >= N)
+        return false;
+    const std::uint64_t *block = blocks[index[c >> {SHIFT}]];
+    return (block[(c >> 6) & {BLOCK // 64 - 1}] >> (c & 63)) & 1;
+}}
+
+}}; // namespace
+
+namespace gravlax::utf8
+{{
+
+bool isXidStart(char32_t c)
+{{
+    return lookup(startIndex, startBlocks, c);
+}}
+
+bool isXidContinue(char32_t c)
+{{
+    return lookup(continueIndex, continueBlocks, c);
+}}
+
+}}; // namespace gravlax::utf8""")